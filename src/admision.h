@@ -0,0 +1,145 @@
+/*
+ * ============================================================================
+ * ADMISIÓN - Cubetas de fichas para limitar publicaciones
+ * ============================================================================
+ *
+ * Cualquier cliente podía inundar un broker: cada publicación se aceptaba y
+ * se distribuía en el momento, y un solo publisher descontrolado dejaba sin
+ * servicio a los demás. Con este header los brokers limitan la tasa:
+ *
+ *   - Cubeta: "tasa" fichas por segundo hasta un máximo de "ráfaga". Cada
+ *     publicación gasta una ficha; sin fichas, se rechaza. Una cubeta
+ *     nueva arranca llena. Un lote más grande que la ráfaga entra solo con
+ *     la cubeta llena y la deja en negativo (deuda).
+ *   - TablaCubetas: una cubeta por clave (ej: ip y puerto del publisher) en
+ *     una tabla de tamaño fijo. Si no hay lugar se recicla la cubeta usada
+ *     hace más tiempo entre las ADMISION_SONDEO revisadas (para un cliente
+ *     inactivo, su cubeta ya estaría llena: se pierde poco).
+ *
+ * Uso:
+ *   LimiteTasa l;  limite_parsear(&l, "200:400");   // 200/s, ráfagas de 400
+ *   tabla_cubetas_iniciar(&t, 4096);
+ *   tabla_cubetas_tomar(&t, clave, &l, lineas, reloj_ms(), &admitida);
+ *   if (!admitida) ... (rechazar: el rechazo ya quedó contado en la entrada)
+ *   cada tanto: EntradaCubeta peor = tabla_cubetas_peor(&t);
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef ADMISION_H
+#define ADMISION_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ADMISION_SONDEO  16          // Lugares revisados por clave en TablaCubetas
+
+typedef struct {
+    double tasa;                     // Fichas por segundo (0 = sin límite)
+    double rafaga;                   // Máximo acumulable
+} LimiteTasa;
+
+typedef struct {
+    double fichas;
+    unsigned long long ultimo_ms;    // Última recarga (0 = cubeta nueva: llena)
+} Cubeta;
+
+typedef struct {
+    unsigned long long clave;
+    Cubeta cubeta;                   // ultimo_ms == 0: lugar libre
+    unsigned long rechazos;          // Desde el último reporte
+} EntradaCubeta;
+
+typedef struct {
+    EntradaCubeta *entradas;
+    unsigned int capacidad;          // Potencia de 2
+} TablaCubetas;
+
+/**
+ * limite_parsear - "tasa" o "tasa:ráfaga" (por defecto la ráfaga es un
+ * segundo de tasa). Retorna 0 si OK.
+ */
+static inline int limite_parsear(LimiteTasa *l, const char *texto) {
+    char *fin;
+    l->tasa = strtod(texto, &fin);
+    l->rafaga = *fin == ':' ? strtod(fin + 1, &fin) : l->tasa;
+    if (*fin != '\0' || l->tasa <= 0 || l->rafaga < 1) return -1;
+    return 0;
+}
+
+/** cubeta_alcanza - Recarga la cubeta y dice si alcanza para costo fichas */
+static inline int cubeta_alcanza(Cubeta *c, const LimiteTasa *l, double costo, unsigned long long ahora) {
+    if (c->ultimo_ms == 0) {
+        c->fichas = l->rafaga;
+    } else if (ahora > c->ultimo_ms) {
+        c->fichas += (double)(ahora - c->ultimo_ms) * l->tasa / 1000.0;
+        if (c->fichas > l->rafaga) c->fichas = l->rafaga;
+    }
+    c->ultimo_ms = ahora ? ahora : 1;
+    return c->fichas >= (costo < l->rafaga ? costo : l->rafaga);
+}
+
+/** cubeta_tomar - Gasta costo fichas si alcanzan. Retorna 1 si se admitió. */
+static inline int cubeta_tomar(Cubeta *c, const LimiteTasa *l, double costo, unsigned long long ahora) {
+    if (!cubeta_alcanza(c, l, costo, ahora)) return 0;
+    c->fichas -= costo;
+    return 1;
+}
+
+/** cubeta_devolver - Reintegra fichas tomadas (otro control rechazó lo mismo) */
+static inline void cubeta_devolver(Cubeta *c, double costo) {
+    c->fichas += costo;
+}
+
+/** tabla_cubetas_iniciar - Tabla vacía de capacidad (potencia de 2) cubetas */
+static inline int tabla_cubetas_iniciar(TablaCubetas *t, unsigned int capacidad) {
+    t->entradas = calloc(capacidad, sizeof(EntradaCubeta));
+    t->capacidad = t->entradas != NULL ? capacidad : 0;
+    return t->entradas != NULL ? 0 : -1;
+}
+
+/** tabla_cubetas_buscar - Cubeta de la clave (la crea o recicla si no está) */
+static inline EntradaCubeta *tabla_cubetas_buscar(TablaCubetas *t, unsigned long long clave) {
+    unsigned long long h = clave * 0x9E3779B97F4A7C15ULL;
+    unsigned int inicio = (unsigned int)(h >> 32) & (t->capacidad - 1);
+    EntradaCubeta *victima = &t->entradas[inicio];
+    for (unsigned int k = 0; k < ADMISION_SONDEO && k < t->capacidad; k++) {
+        EntradaCubeta *e = &t->entradas[(inicio + k) & (t->capacidad - 1)];
+        if (e->cubeta.ultimo_ms != 0 && e->clave == clave) return e;
+        if (e->cubeta.ultimo_ms < victima->cubeta.ultimo_ms) victima = e;
+    }
+    memset(victima, 0, sizeof(*victima));
+    victima->clave = clave;
+    return victima;
+}
+
+/**
+ * tabla_cubetas_tomar - Gasta costo fichas de la cubeta de la clave
+ *
+ * Retorna la entrada; admitida queda en 1 o 0 (y un rechazo se suma a
+ * entrada->rechazos).
+ */
+static inline EntradaCubeta *tabla_cubetas_tomar(TablaCubetas *t, unsigned long long clave, const LimiteTasa *l,
+                                                 double costo, unsigned long long ahora, int *admitida) {
+    EntradaCubeta *e = tabla_cubetas_buscar(t, clave);
+    *admitida = cubeta_tomar(&e->cubeta, l, costo, ahora);
+    if (!*admitida) e->rechazos++;
+    return e;
+}
+
+/**
+ * tabla_cubetas_peor - Copia de la entrada con más rechazos desde el último
+ * reporte (rechazos = 0 si no hubo) y pone todos los contadores en 0
+ */
+static inline EntradaCubeta tabla_cubetas_peor(TablaCubetas *t) {
+    EntradaCubeta peor;
+    memset(&peor, 0, sizeof(peor));
+    for (unsigned int i = 0; i < t->capacidad; i++) {
+        if (t->entradas[i].rechazos > peor.rechazos) peor = t->entradas[i];
+        t->entradas[i].rechazos = 0;
+    }
+    return peor;
+}
+
+#endif /* ADMISION_H */
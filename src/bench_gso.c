@@ -0,0 +1,176 @@
+/*
+ * BENCH GSO - CPU por millón de datagramas con y sin GSO/GRO
+ *
+ * Mide lo que cuestan en CPU los envíos y recepciones UDP de los brokers
+ * cuando salen de a uno (sendto/recvfrom) y cuando usan udp_lotes.h:
+ *
+ *   1. sendto  + recvfrom : un syscall por datagrama en cada lado
+ *   2. GSO     + recvfrom : lotes de UDP_MAX_SEGMENTOS por sendmsg()
+ *   3. GSO     + GRO      : además el receptor lee varios juntos
+ *
+ * Emisor y receptor son dos hilos sobre loopback; cada uno mide su propio
+ * tiempo de CPU (usuario + sistema, RUSAGE_THREAD). Se informa el costo por
+ * millón de datagramas (enviados para el emisor, recibidos para el
+ * receptor) y el ahorro contra el caso 1. En loopback el
+ * "hardware" es el propio kernel, así que el ahorro de GSO es el de los
+ * syscalls y el recorrido de la pila; con una placa con offload es mayor.
+ *
+ * Solo Linux. Compilar con:
+ *   gcc -O2 src/bench_gso.c -o bench_gso -pthread
+ * Uso:
+ *   ./bench_gso [datagramas] [bytes]     (por defecto 1000000 y 200)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "udp_lotes.h"
+
+#ifndef __linux__
+#error "bench_gso mide UDP_SEGMENT/UDP_GRO: solo Linux"
+#endif
+
+#define BUFFER_RECEPCION (8 << 20)   // Que el receptor no pierda por ráfagas
+#define FIN_MS           500         // Sin datos en este tiempo: terminó
+
+typedef struct {
+    SOCKET sock;
+    long recibidos;                  // Datagramas (segmentos) recibidos
+    double cpu_ms;
+} Receptor;
+
+typedef struct {
+    const char *nombre;
+    double cpu_emisor, cpu_receptor; // ms por millón de datagramas
+    long recibidos;
+    double segundos;
+} Resultado;
+
+/** cpu_hilo_ms - CPU (usuario + sistema) consumida por el hilo actual */
+static double cpu_hilo_ms(void) {
+    struct rusage r;
+    getrusage(RUSAGE_THREAD, &r);
+    return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000.0 +
+           (r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1000.0;
+}
+
+static void *recibir(void *arg) {
+    Receptor *r = arg;
+    static char buf[UDP_MAX_LOTE];
+    struct sockaddr_in origen;
+    int segmento;
+    double inicio = cpu_hilo_ms();
+    while (1) {
+        int bytes = udp_recibir(r->sock, buf, sizeof(buf), &origen, &segmento);
+        if (bytes < 0) break;                        // Timeout: no llega más
+        if (segmento <= 0) segmento = bytes;
+        r->recibidos += segmento > 0 ? (bytes + segmento - 1) / segmento : 1;
+    }
+    r->cpu_ms = cpu_hilo_ms() - inicio;   // Esperando en recvmsg no se consume CPU
+    return NULL;
+}
+
+/**
+ * correr - Una prueba: n datagramas de tam bytes, con o sin GSO en el
+ * emisor y GRO en el receptor. Retorna -1 si el kernel no soporta lo pedido.
+ */
+static int correr(Resultado *res, long n, int tam, int gso, int gro) {
+    SOCKET rx = socket(AF_INET, SOCK_DGRAM, 0);
+    SOCKET tx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in destino;
+    socklen_t largo = sizeof(destino);
+    int buffer = BUFFER_RECEPCION;
+
+    memset(&destino, 0, sizeof(destino));
+    destino.sin_family = AF_INET;
+    destino.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(rx, (struct sockaddr*)&destino, sizeof(destino));
+    getsockname(rx, (struct sockaddr*)&destino, &largo);
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    red_timeout_recepcion(rx, FIN_MS);
+    if ((gro && !udp_gro_activar(rx)) || (gso && !udp_gso_probar(tx))) {
+        closesocket(rx);
+        closesocket(tx);
+        return -1;
+    }
+
+    Receptor r = {rx, 0, 0};
+    pthread_t hilo;
+    pthread_create(&hilo, NULL, recibir, &r);
+
+    // Un solo mensaje de ejemplo: todos los segmentos de un lote lo comparten
+    static PlanMensaje plantilla;
+    PlanMensaje *lote[UDP_MAX_SEGMENTOS];
+    plantilla.destino = destino;
+    plantilla.largo = tam;
+    memset(plantilla.datos, 'x', (size_t)tam);
+    for (int i = 0; i < UDP_MAX_SEGMENTOS; i++) lote[i] = &plantilla;
+
+    unsigned long long t0 = reloj_ms();
+    double inicio = cpu_hilo_ms();
+    for (long enviados = 0; enviados < n; ) {
+        int k = gso ? UDP_MAX_SEGMENTOS : 1;
+        if (k > n - enviados) k = (int)(n - enviados);
+        if (gso && k * tam > UDP_MAX_LOTE) k = UDP_MAX_LOTE / tam;
+        if (k > 1) {
+            if (udp_enviar_lote(tx, lote, k) != 0) {
+                perror("sendmsg GSO");
+                break;
+            }
+        } else {
+            sendto(tx, plantilla.datos, tam, 0, (struct sockaddr*)&destino, sizeof(destino));
+        }
+        enviados += k;
+    }
+    res->cpu_emisor = (cpu_hilo_ms() - inicio) * 1e6 / n;
+
+    pthread_join(hilo, NULL);
+    res->segundos = (reloj_ms() - t0 - FIN_MS) / 1000.0;
+    // El receptor se mide por lo que recibió (en loopback puede perder)
+    res->cpu_receptor = r.recibidos > 0 ? r.cpu_ms * 1e6 / r.recibidos : 0;
+    res->recibidos = r.recibidos;
+    closesocket(rx);
+    closesocket(tx);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+    int tam = argc > 2 ? atoi(argv[2]) : 200;
+    Resultado res[3] = {{"sendto + recvfrom", 0, 0, 0, 0},
+                        {"GSO    + recvfrom", 0, 0, 0, 0},
+                        {"GSO    + GRO     ", 0, 0, 0, 0}};
+    int ok[3];
+
+    if (n <= 0 || tam <= 0 || tam > PLAN_MAX_MENSAJE) {
+        printf("Uso: %s [datagramas] [bytes <= %d]\n", argv[0], PLAN_MAX_MENSAJE);
+        return 1;
+    }
+    printf("=== BENCH GSO/GRO: %ld datagramas de %d bytes ===\n\n", n, tam);
+    ok[0] = correr(&res[0], n, tam, 0, 0) == 0;
+    ok[1] = correr(&res[1], n, tam, 1, 0) == 0;
+    ok[2] = correr(&res[2], n, tam, 1, 1) == 0;
+
+    printf("%-18s %14s %14s %12s %10s\n", "", "emisor ms/M", "receptor ms/M", "recibidos", "segundos");
+    for (int i = 0; i < 3; i++) {
+        if (!ok[i]) {
+            printf("%-18s (no soportado por este kernel)\n", res[i].nombre);
+            continue;
+        }
+        printf("%-18s %14.0f %14.0f %12ld %10.2f\n", res[i].nombre, res[i].cpu_emisor,
+               res[i].cpu_receptor, res[i].recibidos, res[i].segundos);
+    }
+    printf("\nAhorro de CPU por millón de datagramas contra sendto + recvfrom:\n");
+    for (int i = 1; i < 3; i++) {
+        if (!ok[i] || !ok[0]) continue;
+        double base_rx = res[0].cpu_receptor, rx = res[i].cpu_receptor;
+        printf("  %s: emisor %.0f ms (%.0f%%), receptor %.0f ms (%.0f%%)\n", res[i].nombre,
+               res[0].cpu_emisor - res[i].cpu_emisor,
+               100.0 * (res[0].cpu_emisor - res[i].cpu_emisor) / res[0].cpu_emisor,
+               base_rx - rx, base_rx > 0 ? 100.0 * (base_rx - rx) / base_rx : 0);
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * BENCH LOCAL - Latencia de una vía: anillo en memoria compartida vs loopback
+ *
+ * Un proceso escritor publica mensajes de a uno (con una pausa entre cada
+ * uno, para que no se encolen) y un proceso lector hijo los recibe y mide
+ * cuánto tardó cada uno desde que el escritor tomó la hora hasta que el
+ * lector lo tuvo copiado. Se prueban tres formas:
+ *
+ *   1. giro  : memoria_local.h; el lector sondea local_leer() sin dormir.
+ *   2. futex : memoria_local.h; el lector duerme en local_dormir() y el
+ *              escritor lo despierta (como subscriber_quic --local).
+ *   3. udp   : sendto/recvfrom por 127.0.0.1 (como el transporte de red).
+ *
+ * Con una sola CPU el lector que gira compite con el escritor y los números
+ * de "giro" no significan nada: se avisa.
+ *
+ * Compilar con:
+ *   gcc -O2 src/bench_local.c -o bench_local
+ * Uso:
+ *   ./bench_local [mensajes] [pausa_us] [bytes]
+ *   (por defecto 100000, 20 y 64)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "plataforma.h"
+#include "memoria_local.h"
+
+#ifdef _WIN32
+int main(void) {
+    printf("bench_local necesita POSIX (memoria compartida y fork)\n");
+    return 1;
+}
+#else
+
+#include <sys/wait.h>
+
+typedef struct {
+    const char *nombre;
+    unsigned long long p50, p99, max;   // Nanosegundos
+    unsigned long long recibidos, perdidos;
+} Resultado;
+
+enum { GIRO, FUTEX, UDP };
+
+static unsigned long long ahora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+}
+
+static int comparar(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// ============================================================================
+// LECTOR (proceso hijo)
+// ============================================================================
+
+/**
+ * leer - Recibe hasta n mensajes y deja en r los percentiles
+ *
+ * Termina antes si pasa un segundo sin que llegue nada (el resto se cuenta
+ * como perdido).
+ */
+static void leer(int modo, int n, const char *prefijo, int sock, int listo, Resultado *r) {
+    unsigned long long *lat = malloc(sizeof(unsigned long long) * (size_t)n);
+    char buf[LOCAL_MAX_DATOS];
+    ZonaLocal *z = NULL;
+    CursorLocal c;
+    memset(&c, 0, sizeof(c));
+    if (lat == NULL) return;
+    if (modo != UDP) {
+        z = local_zona_abrir(prefijo);
+        if (z == NULL || local_cursor_abrir(&c, z, prefijo, "bench", 0) != 0) return;
+    }
+    if (write(listo, "1", 1) != 1) return;   // El escritor arranca recién ahora
+
+    unsigned long long ultimo = ahora_ns();
+    while ((int)r->recibidos < n && ahora_ns() - ultimo < 1000000000ULL) {
+        int largo;
+        unsigned int seq;
+        if (modo == UDP) {
+            struct timeval t = {0, 100000};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&t, sizeof(t));
+            largo = (int)recvfrom(sock, buf, sizeof(buf), 0, NULL, NULL);
+        } else {
+            unsigned int aviso = local_aviso(z);
+            largo = local_leer(&c, &seq, buf, sizeof(buf));
+            if (largo == 0 && modo == FUTEX) local_dormir(z, aviso, 100);
+        }
+        unsigned long long llegada = ahora_ns();
+        if (largo < (int)sizeof(unsigned long long)) continue;
+        unsigned long long enviado;
+        memcpy(&enviado, buf, sizeof(enviado));
+        lat[r->recibidos++] = llegada - enviado;
+        ultimo = llegada;
+    }
+
+    r->perdidos = (unsigned long long)n - r->recibidos + c.perdidos;
+    if (r->recibidos > 0) {
+        qsort(lat, (size_t)r->recibidos, sizeof(unsigned long long), comparar);
+        r->p50 = lat[r->recibidos / 2];
+        r->p99 = lat[r->recibidos * 99 / 100];
+        r->max = lat[r->recibidos - 1];
+    }
+    free(lat);
+    if (z != NULL) {
+        local_cursor_cerrar(&c);
+        local_zona_cerrar(z);
+    }
+}
+
+// ============================================================================
+// ESCRITOR
+// ============================================================================
+
+static int medir(int modo, int n, int pausa_us, int bytes, Resultado *r) {
+    char prefijo[LOCAL_MAX_NOMBRE];
+    ZonaLocal *z = NULL;
+    AnilloLocal *a = NULL;
+    int sock = -1, tubo_listo[2], tubo_res[2];
+    struct sockaddr_in destino;
+    socklen_t largo_destino = sizeof(destino);
+
+    snprintf(prefijo, sizeof(prefijo), "/pubsub-bench-%d", (int)getpid());
+    if (modo == UDP) {
+        memset(&destino, 0, sizeof(destino));
+        destino.sin_family = AF_INET;
+        destino.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0 || bind(sock, (struct sockaddr *)&destino, sizeof(destino)) != 0 ||
+            getsockname(sock, (struct sockaddr *)&destino, &largo_destino) != 0) return -1;
+    } else {
+        z = local_zona_crear(prefijo);
+        if (z == NULL || (a = local_anillo_crear(z, prefijo, "bench", 1024)) == NULL) return -1;
+    }
+    if (pipe(tubo_listo) != 0 || pipe(tubo_res) != 0) return -1;
+
+    pid_t hijo = fork();
+    if (hijo == 0) {
+        Resultado res = *r;
+        leer(modo, n, prefijo, sock, tubo_listo[1], &res);
+        if (write(tubo_res[1], &res, sizeof(res)) != sizeof(res)) _exit(1);
+        _exit(0);
+    }
+    char c;
+    if (hijo < 0 || read(tubo_listo[0], &c, 1) != 1) {
+        if (hijo > 0) waitpid(hijo, NULL, 0);
+        return -1;
+    }
+
+    char datos[LOCAL_MAX_DATOS];
+    memset(datos, 'x', sizeof(datos));
+    for (int i = 0; i < n; i++) {
+        unsigned long long t = ahora_ns();
+        memcpy(datos, &t, sizeof(t));
+        if (modo == UDP) {
+            sendto(sock, datos, (size_t)bytes, 0, (struct sockaddr *)&destino, sizeof(destino));
+        } else {
+            local_publicar(z, a, (unsigned int)i, datos, (size_t)bytes);
+        }
+        while (ahora_ns() - t < (unsigned long long)pausa_us * 1000) { }
+    }
+
+    int ok = read(tubo_res[0], r, sizeof(*r)) == sizeof(*r);
+    waitpid(hijo, NULL, 0);
+    close(tubo_listo[0]); close(tubo_listo[1]);
+    close(tubo_res[0]); close(tubo_res[1]);
+    if (sock >= 0) close(sock);
+    if (z != NULL) {
+        char nombre[LOCAL_MAX_NOMBRE];
+        local_nombre_anillo(nombre, prefijo, "bench");
+        shm_unlink(nombre);
+        shm_unlink(prefijo);
+    }
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    int pausa_us = argc > 2 ? atoi(argv[2]) : 20;
+    int bytes = argc > 3 ? atoi(argv[3]) : 64;
+    if (n <= 0 || pausa_us < 0 || bytes < (int)sizeof(unsigned long long) || bytes > LOCAL_MAX_DATOS) {
+        printf("Uso: %s [mensajes] [pausa_us] [bytes (8..%d)]\n", argv[0], LOCAL_MAX_DATOS);
+        return 1;
+    }
+
+    Resultado res[3] = {{"giro (memoria)", 0, 0, 0, 0, 0}, {"futex (memoria)", 0, 0, 0, 0, 0},
+                        {"udp (127.0.0.1)", 0, 0, 0, 0, 0}};
+    printf("=== BENCH LOCAL: %d mensajes de %d bytes, uno cada %d us ===\n\n", n, bytes, pausa_us);
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("AVISO: una sola CPU; el lector de \"giro\" le quita tiempo al escritor\n\n");
+    }
+
+    printf("%-18s %10s %10s %12s %10s\n", "", "p50 ns", "p99 ns", "max ns", "perdidos");
+    for (int m = GIRO; m <= UDP; m++) {
+        if (medir(m, n, pausa_us, bytes, &res[m]) != 0) {
+            printf("%-18s (no se pudo medir)\n", res[m].nombre);
+            continue;
+        }
+        printf("%-18s %10llu %10llu %12llu %10llu\n", res[m].nombre, res[m].p50, res[m].p99,
+               res[m].max, res[m].perdidos);
+    }
+    return 0;
+}
+
+#endif
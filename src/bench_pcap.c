@@ -0,0 +1,1054 @@
+/*
+ * ============================================================================
+ * BENCH PCAP - Repite contra un broker lo que publicaron los clientes en una
+ * captura (pcap o pcapng) y mide rendimiento y latencia de entrega
+ * ============================================================================
+ *
+ * Los benchmarks sintéticos publican mensajes del mismo tamaño a ritmo
+ * fijo; las capturas de Evidencias/ tienen la forma real del tráfico
+ * (ráfagas, pausas, largos de mensaje, temas). Este programa saca de una o
+ * más capturas las publicaciones de los publishers y las vuelve a enviar:
+ *
+ *   - TCP al puerto 6000: se reensamblan los segmentos de cada conexión
+ *     (sin retransmisiones) y se separan los mensajes con la misma regla
+ *     que broker_tcp (líneas con '\n' o un send() por mensaje). Se saltean
+ *     SUB, UNSUB y PING; el tema es la primera palabra.
+ *   - UDP "PUBLISH:tema:mensaje" (broker_udp), también en lotes.
+ *   - QUIC al puerto 7000: las líneas "tema:contenido" de los 'P', una vez
+ *     por seq (sin las retransmisiones).
+ *   Los alias "#id" se resuelven con las respuestas del broker que haya en
+ *   la misma captura ("ALIAS:id:tema" en UDP, 'T' en QUIC).
+ *
+ * Formatos: pcap clásico (µs y ns) y pcapng (SHB/IDB/EPB/SPB, con
+ * if_tsresol), sobre loopback de Windows/BSD (NULL/LOOP), Ethernet, IP sin
+ * enlace y Linux cooked (SLL/SLL2), IPv4 o IPv6.
+ *
+ * La repetición se hace con cliente_pub en el protocolo elegido, sin
+ * importar con cuál se capturó:
+ *
+ *   --velocidad N  : los tiempos originales divididos por N (1 = original)
+ *   --maximo       : sin esperas, tan rápido como acepte el broker
+ *   --temas K      : cada tema se publica en K copias "tema/000".."tema/K-1"
+ *   --publicadores P: P clientes, cada uno repite toda la captura
+ *   --repetir R    : la captura R veces seguidas
+ *
+ * Publicaciones = eventos × K × P × R. Un suscriptor propio (cliente_sub,
+ * un socket UDP o conexiones TCP con SUB) recibe todas las copias. A cada
+ * payload se le agrega " [r<pid>.<id>]" para reconocer la publicación y
+ * medir publicación → entrega; se informan entregadas, perdidas,
+ * duplicadas, rendimiento (entregas por segundo, de la primera
+ * publicación a la última entrega) y latencia p50/p90/p99/máx.
+ *
+ * Ejemplos (con el broker ya corriendo):
+ *   bench_pcap --captura Evidencias/TCP_10mensajes.pcapng --protocolo tcp
+ *   bench_pcap --captura Evidencias/udp_pubsub.pcap --protocolo quic \
+ *              --maximo --temas 50 --publicadores 4 --repetir 100
+ *   bench_pcap --captura Evidencias/tcp_pubsub.pcapng --listar
+ *
+ * Solo POSIX (Linux, macOS). Compilar con:
+ *   gcc -O2 src/bench_pcap.c src/cliente_pub.c src/cliente_sub.c -o bench_pcap
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "plataforma.h"
+#include "protocolo_quic.h"
+#include "tablas.h"
+#include "cliente_pub.h"
+#include "cliente_sub.h"
+
+#ifdef _WIN32
+#error "bench_pcap usa clock_gettime y select sobre sockets POSIX"
+#endif
+
+#define PUERTO_TCP        6000       // broker_tcp
+#define PUERTO_UDP        8080       // broker_udp
+#define MAX_CAPTURAS      16
+#define MAX_INTERFACES    16         // IDB por sección de un pcapng
+#define MAX_FLUJOS_PCAP   256        // Conexiones TCP / clientes QUIC en las capturas
+#define MAX_ALIAS_PCAP    256        // Alias vistos en las respuestas del broker
+#define TAM_LINEA_TCP     512        // TAM de broker_tcp
+#define MAX_PAYLOAD       400        // Lo que se repite de cada mensaje (el resto se corta)
+#define MAX_PUBLICADORES  64
+#define MAX_COPIAS        1000       // "tema/%03d"
+#define LARGO_SUB_TCP     450        // "SUB t1 t2 ...": entra en una línea de broker_tcp
+#define PAUSA_VUELTA_US   1000       // Entre una repetición de la captura y la siguiente
+#define ESPERA_FINAL_MS   3000       // Sin entregas nuevas en este tiempo: terminó
+#define LATIDO_UDP_MS     5000       // broker_udp da de baja a los 30 s sin PING
+#define TAM_DATAGRAMA     2048
+#define TEMAS_POR_SUB     64         // SUB_MAX_TEMAS de cliente_sub.c
+#define MAX_CONEXIONES_SUB 16        // broker_tcp acepta 50 conexiones en total
+
+// ============================================================================
+// EVENTOS EXTRAÍDOS
+// ============================================================================
+
+typedef struct {
+    unsigned long long t_us;         // Desde el primer paquete de su captura
+    int tema;                        // Id en temas_captura
+    char *datos;
+    int largo;
+    int orden;                       // Desempate estable al mezclar capturas
+} Evento;
+
+typedef struct {
+    unsigned char clave[36];         // Origen y destino (dirección + puerto)
+    int usado;
+    unsigned int proximo;            // TCP: próximo byte esperado
+    char pendiente[TAM_LINEA_TCP];   // TCP: como Conexion.pendiente en broker_tcp
+    int len_pendiente;
+    unsigned int max_seq;            // QUIC: seq más alto visto
+    unsigned long long vistos;       // QUIC: ventana de 64 seqs bajo max_seq
+} FlujoPcap;
+
+typedef struct {
+    unsigned int id;
+    int tema;
+    int quic;                        // Alias del broker QUIC o de broker_udp
+} AliasPcap;
+
+typedef struct {                     // Lo que se saltea, para el resumen
+    unsigned long paquetes, eventos, retransmisiones, control, sin_alias;
+} Conteo;
+
+static TablaTemas temas_captura;
+static Evento *eventos = NULL;
+static int num_eventos = 0, cap_eventos = 0;
+static FlujoPcap flujos[MAX_FLUJOS_PCAP];
+static AliasPcap alias_pcap[MAX_ALIAS_PCAP];
+static int num_alias = 0;
+static unsigned short puerto_quic = QUIC_PUERTO;
+static Conteo conteo;
+
+static unsigned long long reloj_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000ULL + (unsigned long long)t.tv_nsec / 1000;
+}
+
+static unsigned int leer16(const unsigned char *p, int be) {
+    return be ? (unsigned int)(p[0] << 8 | p[1]) : (unsigned int)(p[1] << 8 | p[0]);
+}
+
+static unsigned int leer32(const unsigned char *p, int be) {
+    return be ? (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3]
+              : (unsigned int)p[3] << 24 | (unsigned int)p[2] << 16 | (unsigned int)p[1] << 8 | p[0];
+}
+
+/**
+ * agregar_evento - Guarda una publicación de la captura
+ *
+ * El tema se adapta para que cliente_pub lo acepte en los tres protocolos
+ * (sin ':' ni espacios ni '#' inicial, y con lugar para "/%03d").
+ */
+static void agregar_evento(unsigned long long t_us, const char *tema, int largo_tema,
+                           const char *datos, int largo) {
+    char nombre[QUIC_MAX_TEMA - 4];
+    int n = 0;
+    for (int i = 0; i < largo_tema && n < (int)sizeof(nombre) - 1; i++) {
+        char c = tema[i];
+        if (c == ':' || c == ' ' || c == '\n' || c == '\r' || (n == 0 && c == ALIAS_PREFIJO)) c = '_';
+        nombre[n++] = c;
+    }
+    nombre[n] = '\0';
+    if (n == 0) return;
+    if (largo > MAX_PAYLOAD) largo = MAX_PAYLOAD;
+    while (largo > 0 && (datos[largo - 1] == '\r' || datos[largo - 1] == '\n')) largo--;
+
+    if (num_eventos == cap_eventos) {
+        cap_eventos = cap_eventos ? cap_eventos * 2 : 256;
+        eventos = realloc(eventos, sizeof(Evento) * (size_t)cap_eventos);
+        if (eventos == NULL) { printf("Sin memoria\n"); exit(1); }
+    }
+    Evento *e = &eventos[num_eventos];
+    e->t_us = t_us;
+    e->tema = tema_internar(&temas_captura, nombre);
+    e->datos = malloc((size_t)largo + 1);
+    if (e->tema < 0 || e->datos == NULL) { printf("Sin memoria\n"); exit(1); }
+    memcpy(e->datos, datos, (size_t)largo);
+    e->datos[largo] = '\0';
+    for (int i = 0; i < largo; i++) if (e->datos[i] == '\n') e->datos[i] = ' ';
+    e->largo = largo;
+    e->orden = num_eventos++;
+    conteo.eventos++;
+}
+
+static FlujoPcap *buscar_flujo(const unsigned char clave[36]) {
+    for (int i = 0; i < MAX_FLUJOS_PCAP; i++) {
+        if (flujos[i].usado && memcmp(flujos[i].clave, clave, 36) == 0) return &flujos[i];
+    }
+    for (int i = 0; i < MAX_FLUJOS_PCAP; i++) {
+        if (!flujos[i].usado) {
+            memset(&flujos[i], 0, sizeof(flujos[i]));
+            flujos[i].usado = 1;
+            memcpy(flujos[i].clave, clave, 36);
+            return &flujos[i];
+        }
+    }
+    return NULL;
+}
+
+static int alias_tema(unsigned int id, int quic) {
+    for (int i = 0; i < num_alias; i++) {
+        if (alias_pcap[i].id == id && alias_pcap[i].quic == quic) return alias_pcap[i].tema;
+    }
+    return -1;
+}
+
+static void alias_guardar(unsigned int id, const char *tema, int quic) {
+    int t = tema_internar(&temas_captura, tema);
+    if (t < 0) return;
+    for (int i = 0; i < num_alias; i++) {
+        if (alias_pcap[i].id == id && alias_pcap[i].quic == quic) { alias_pcap[i].tema = t; return; }
+    }
+    if (num_alias < MAX_ALIAS_PCAP) alias_pcap[num_alias++] = (AliasPcap){id, t, quic};
+}
+
+/**
+ * linea_publicada - "tema:contenido" (QUIC) o "PUBLISH:tema:mensaje" (UDP
+ * sin el prefijo); el tema puede ser un alias "#id"
+ */
+static void linea_publicada(unsigned long long t_us, const char *linea, int largo, int quic) {
+    const char *dos_puntos = memchr(linea, ':', (size_t)largo);
+    if (dos_puntos == NULL) return;
+    int largo_tema = (int)(dos_puntos - linea);
+    const char *datos = dos_puntos + 1;
+    int largo_datos = largo - largo_tema - 1;
+    if (largo_tema > 1 && linea[0] == ALIAS_PREFIJO) {
+        int t = alias_tema((unsigned int)strtoul(linea + 1, NULL, 10), quic);
+        if (t < 0) {
+            conteo.sin_alias++;
+            return;
+        }
+        const char *nombre = tema_nombre(&temas_captura, t);
+        agregar_evento(t_us, nombre, (int)strlen(nombre), datos, largo_datos);
+        return;
+    }
+    agregar_evento(t_us, linea, largo_tema, datos, largo_datos);
+}
+
+/** mensaje_tcp - Un mensaje completo para broker_tcp: "tema payload" */
+static void mensaje_tcp(unsigned long long t_us, const char *m) {
+    if (m[0] == '\0' || strncmp(m, "SUB ", 4) == 0 || strncmp(m, "UNSUB ", 6) == 0 ||
+        strcmp(m, "PING") == 0) {
+        conteo.control++;
+        return;
+    }
+    const char *espacio = strchr(m, ' ');
+    if (espacio == NULL) {
+        agregar_evento(t_us, m, (int)strlen(m), "", 0);
+    } else {
+        agregar_evento(t_us, m, (int)(espacio - m), espacio + 1, (int)strlen(espacio + 1));
+    }
+}
+
+/**
+ * segmento_tcp - Datos de un segmento hacia el broker TCP
+ *
+ * Se descartan las retransmisiones por número de secuencia y después se
+ * separan los mensajes como en el bucle de recv() de broker_tcp.
+ */
+static void segmento_tcp(unsigned long long t_us, const unsigned char clave[36], unsigned int seq,
+                         int syn, const unsigned char *datos, int largo) {
+    FlujoPcap *f = buscar_flujo(clave);
+    if (f == NULL) return;
+    if (syn) {
+        f->proximo = seq + 1;
+        f->len_pendiente = 0;
+        return;
+    }
+    if (largo <= 0) return;
+    if (f->proximo == 0 && f->len_pendiente == 0) f->proximo = seq;   // Captura empezada
+    int atrasado = (int)(f->proximo - seq);
+    unsigned int siguiente = seq + (unsigned int)largo;
+    if (atrasado >= largo) {
+        conteo.retransmisiones++;
+        return;
+    }
+    if (atrasado > 0) {                  // Se solapa en parte con lo ya visto
+        datos += atrasado;
+        largo -= atrasado;
+    } else if (atrasado < 0) {
+        f->len_pendiente = 0;            // Hueco: la captura perdió segmentos
+    }
+    f->proximo = siguiente;
+
+    int habia_pendiente = f->len_pendiente > 0;
+    int libre = TAM_LINEA_TCP - 1 - f->len_pendiente;
+    if (largo > libre) largo = libre;
+    memcpy(f->pendiente + f->len_pendiente, datos, (size_t)largo);
+    f->len_pendiente += largo;
+    f->pendiente[f->len_pendiente] = '\0';
+
+    char *inicio = f->pendiente;
+    char *fin = strchr(inicio, '\n');
+    if (fin == NULL && habia_pendiente && f->len_pendiente < TAM_LINEA_TCP - 1) return;
+    if (fin == NULL) {
+        f->len_pendiente = 0;
+        mensaje_tcp(t_us, inicio);
+        return;
+    }
+    while (fin != NULL) {
+        *fin = '\0';
+        if (fin > inicio && fin[-1] == '\r') fin[-1] = '\0';
+        if (inicio[0] != '\0') mensaje_tcp(t_us, inicio);
+        inicio = fin + 1;
+        fin = strchr(inicio, '\n');
+    }
+    f->len_pendiente = (int)strlen(inicio);
+    memmove(f->pendiente, inicio, (size_t)f->len_pendiente + 1);
+}
+
+/** datagrama_quic - 'P' de un publisher o 'T' (alias) del broker */
+static void datagrama_quic(unsigned long long t_us, const unsigned char clave[36], int al_broker,
+                           const unsigned char *datos, int largo) {
+    if (largo <= (int)PAQUETE_CABECERA) return;
+    char texto[QUIC_MAX_MENSAJE];
+    int n = largo - (int)PAQUETE_CABECERA;
+    if (n > QUIC_MAX_MENSAJE - 1) n = QUIC_MAX_MENSAJE - 1;
+    memcpy(texto, datos + PAQUETE_CABECERA, (size_t)n);
+    texto[n] = '\0';
+    n = (int)strlen(texto);
+    char tipo = (char)datos[4];
+
+    if (!al_broker && tipo == PKT_ALIAS) {           // "id:tema"
+        char *dos_puntos = strchr(texto, ':');
+        if (dos_puntos != NULL) alias_guardar((unsigned int)strtoul(texto, NULL, 10), dos_puntos + 1, 1);
+        return;
+    }
+    if (!al_broker || tipo != PKT_PUBLICACION) return;
+
+    // Cada seq una sola vez (el publisher reenvía el lote si no llega el ACK)
+    FlujoPcap *f = buscar_flujo(clave);
+    unsigned int seq = leer32(datos, 0);             // Host order del publisher (x86: little endian)
+    if (f == NULL) return;
+    if (f->max_seq != 0 && seq <= f->max_seq) {
+        unsigned int atras = f->max_seq - seq;
+        if (atras >= 64 || (f->vistos >> atras) & 1) {
+            conteo.retransmisiones++;
+            return;
+        }
+        f->vistos |= 1ULL << atras;
+    } else {
+        unsigned int avance = seq - f->max_seq;
+        f->vistos = avance >= 64 ? 0 : f->vistos << avance;
+        f->vistos |= 1;
+        f->max_seq = seq;
+    }
+    for (char *linea = texto; linea != NULL && *linea; ) {
+        char *fin = strchr(linea, '\n');
+        int len = fin ? (int)(fin - linea) : (int)strlen(linea);
+        linea_publicada(t_us, linea, len, 1);
+        linea = fin ? fin + 1 : NULL;
+    }
+}
+
+/** datagrama_udp - Líneas de broker_udp: "PUBLISH:..." o la respuesta "ALIAS:id:tema" */
+static void datagrama_udp(unsigned long long t_us, const unsigned char *datos, int largo) {
+    char texto[TAM_DATAGRAMA];
+    if (largo > (int)sizeof(texto) - 1) largo = (int)sizeof(texto) - 1;
+    memcpy(texto, datos, (size_t)largo);
+    texto[largo] = '\0';
+    for (char *linea = texto; linea != NULL && *linea; ) {
+        char *fin = strchr(linea, '\n');
+        if (fin) *fin = '\0';
+        if (strncmp(linea, "PUBLISH:", 8) == 0) {
+            linea_publicada(t_us, linea + 8, (int)strlen(linea + 8), 0);
+        } else if (strncmp(linea, "ALIAS:", 6) == 0 && strchr(linea + 6, ':') != NULL) {
+            alias_guardar((unsigned int)strtoul(linea + 6, NULL, 10), strchr(linea + 6, ':') + 1, 0);
+        } else if (strncmp(linea, "SUBSCRIBE:", 10) == 0 || strcmp(linea, "PING") == 0 ||
+                   strncmp(linea, "UNSUBSCRIBE:", 12) == 0) {
+            conteo.control++;
+        }
+        linea = fin ? fin + 1 : NULL;
+    }
+}
+
+/**
+ * paquete_ip - Un paquete IPv4 o IPv6 de la captura
+ *
+ * Los fragmentos IP se ignoran (los mensajes de los brokers caben en uno).
+ */
+static void paquete_ip(unsigned long long t_us, const unsigned char *p, int n) {
+    unsigned char clave[36];
+    int proto, cabecera;
+    conteo.paquetes++;
+    if (n < 20) return;
+    memset(clave, 0, sizeof(clave));
+    if ((p[0] >> 4) == 4) {
+        cabecera = (p[0] & 0x0F) * 4;
+        int total = (int)leer16(p + 2, 1);
+        if ((leer16(p + 6, 1) & 0x3FFF) != 0) return;     // Fragmento
+        if (total < n) n = total;                         // Relleno de Ethernet
+        proto = p[9];
+        memcpy(clave, p + 12, 4);
+        memcpy(clave + 16, p + 16, 4);
+    } else if ((p[0] >> 4) == 6 && n >= 40) {
+        cabecera = 40;
+        if (40 + (int)leer16(p + 4, 1) < n) n = 40 + (int)leer16(p + 4, 1);
+        proto = p[6];
+        memcpy(clave, p + 8, 16);
+        memcpy(clave + 16, p + 24, 16);
+    } else {
+        return;
+    }
+    if (cabecera > n) return;
+    p += cabecera;
+    n -= cabecera;
+
+    if (proto == 6 && n >= 20) {                          // TCP
+        int datos = (p[12] >> 4) * 4;
+        if (datos > n) return;
+        unsigned int destino = leer16(p + 2, 1);
+        memcpy(clave + 32, p, 4);
+        if (destino == PUERTO_TCP) {
+            segmento_tcp(t_us, clave, leer32(p + 4, 1), (p[13] & 0x02) != 0, p + datos, n - datos);
+        }
+    } else if (proto == 17 && n >= 8) {                   // UDP
+        unsigned int origen = leer16(p, 1), destino = leer16(p + 2, 1);
+        memcpy(clave + 32, p, 4);
+        if (destino == puerto_quic || origen == puerto_quic) {
+            datagrama_quic(t_us, clave, destino == puerto_quic, p + 8, n - 8);
+        } else {
+            datagrama_udp(t_us, p + 8, n - 8);
+        }
+    }
+}
+
+/** trama - Quita el encabezado de enlace según el linktype y pasa el IP */
+static void trama(unsigned long long t_us, unsigned int enlace, const unsigned char *p, int n) {
+    unsigned int tipo;
+    switch (enlace) {
+        case 0:                                           // NULL: familia en orden del host
+        case 108:                                         // LOOP: familia en orden de red
+            if (n < 4) return;
+            paquete_ip(t_us, p + 4, n - 4);               // IPv4 o IPv6 según la versión
+            return;
+        case 1:                                           // Ethernet (con o sin 802.1Q)
+            if (n < 14) return;
+            tipo = leer16(p + 12, 1);
+            p += 14;
+            n -= 14;
+            if (tipo == 0x8100 && n >= 4) {
+                tipo = leer16(p + 2, 1);
+                p += 4;
+                n -= 4;
+            }
+            break;
+        case 101: case 228: case 229:                     // IP sin enlace
+            paquete_ip(t_us, p, n);
+            return;
+        case 113:                                         // Linux cooked (SLL)
+            if (n < 16) return;
+            tipo = leer16(p + 14, 1);
+            p += 16;
+            n -= 16;
+            break;
+        case 276:                                         // Linux cooked v2 (SLL2)
+            if (n < 20) return;
+            tipo = leer16(p, 1);
+            p += 20;
+            n -= 20;
+            break;
+        default:
+            return;
+    }
+    if (tipo == 0x0800 || tipo == 0x86DD) paquete_ip(t_us, p, n);
+}
+
+// ============================================================================
+// LECTURA DE CAPTURAS
+// ============================================================================
+
+/** pcap_clasico - Encabezado de 24 bytes y registros de 16 */
+static int pcap_clasico(const unsigned char *d, size_t n, unsigned long long *t0) {
+    unsigned int magia = leer32(d, 0);
+    int be = magia == 0xD4C3B2A1 || magia == 0x4D3CB2A1;
+    int nanos = magia == 0xA1B23C4D || magia == 0x4D3CB2A1;
+    unsigned int enlace = leer32(d + 20, be) & 0x0FFFFFFF;
+    for (size_t o = 24; o + 16 <= n; ) {
+        unsigned long long t = (unsigned long long)leer32(d + o, be) * 1000000ULL +
+                               leer32(d + o + 4, be) / (nanos ? 1000 : 1);
+        unsigned int cap = leer32(d + o + 8, be);
+        if (o + 16 + cap > n) break;
+        if (*t0 == 0) *t0 = t;
+        trama(t - *t0, enlace, d + o + 16, (int)cap);
+        o += 16 + cap;
+    }
+    return 0;
+}
+
+/** pcapng - Bloques SHB, IDB (linktype y if_tsresol), EPB y SPB */
+static int pcapng(const unsigned char *d, size_t n, unsigned long long *t0) {
+    unsigned int enlaces[MAX_INTERFACES];
+    long double por_segundo[MAX_INTERFACES];
+    int interfaces = 0, be = 0;
+    unsigned long long ultimo = 0;
+
+    for (size_t o = 0; o + 12 <= n; ) {
+        unsigned int tipo = leer32(d + o, be);
+        if (tipo == 0x0A0D0D0A) {                         // SHB: orden de bytes por sección
+            be = leer32(d + o + 8, 0) == 0x4D3C2B1A;
+            interfaces = 0;
+        }
+        unsigned int largo = leer32(d + o + 4, be);
+        if (largo < 12 || o + largo > n) break;
+        const unsigned char *b = d + o;
+
+        if (tipo == 1 && largo >= 20 && interfaces < MAX_INTERFACES) {
+            enlaces[interfaces] = leer16(b + 8, be);
+            por_segundo[interfaces] = 1e6L;
+            for (size_t op = 16; op + 4 <= largo - 4; ) { // Opciones: código, largo, valor
+                unsigned int codigo = leer16(b + op, be), lo = leer16(b + op + 2, be);
+                if (codigo == 0) break;
+                if (codigo == 9 && lo >= 1) {             // if_tsresol
+                    unsigned char r = b[op + 4];
+                    long double v = 1;
+                    for (int i = 0; i < (r & 0x7F); i++) v *= (r & 0x80) ? 2 : 10;
+                    por_segundo[interfaces] = v;
+                }
+                op += 4 + ((lo + 3) & ~3u);
+            }
+            interfaces++;
+        } else if (tipo == 6 && largo >= 32) {            // EPB
+            unsigned int i = leer32(b + 8, be), cap = leer32(b + 20, be);
+            if (i < (unsigned int)interfaces && 28 + cap <= largo) {
+                unsigned long long ts = (unsigned long long)leer32(b + 12, be) << 32 | leer32(b + 16, be);
+                unsigned long long t = (unsigned long long)((long double)ts * 1e6L / por_segundo[i]);
+                if (*t0 == 0) *t0 = t;
+                ultimo = t - *t0;
+                trama(ultimo, enlaces[i], b + 28, (int)cap);
+            }
+        } else if (tipo == 3 && largo >= 16 && interfaces > 0) {  // SPB: sin tiempo
+            unsigned int cap = largo - 16;
+            if (cap > leer32(b + 8, be)) cap = leer32(b + 8, be);
+            trama(ultimo, enlaces[0], b + 12, (int)cap);
+        }
+        o += largo;
+    }
+    return 0;
+}
+
+/** leer_captura - Agrega a eventos las publicaciones de un archivo */
+static int leer_captura(const char *ruta) {
+    FILE *f = fopen(ruta, "rb");
+    if (f == NULL) {
+        printf("[!] No se pudo abrir %s\n", ruta);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *d = malloc(n > 0 ? (size_t)n : 1);
+    if (d == NULL || n < 24 || fread(d, 1, (size_t)n, f) != (size_t)n) {
+        printf("[!] %s: archivo vacío o ilegible\n", ruta);
+        fclose(f);
+        free(d);
+        return -1;
+    }
+    fclose(f);
+
+    // Cada captura empieza de cero: flujos, alias y su propio reloj
+    memset(flujos, 0, sizeof(flujos));
+    num_alias = 0;
+    memset(&conteo, 0, sizeof(conteo));
+    int antes = num_eventos, r = 0;
+    unsigned long long t0 = 0;
+    unsigned int magia = leer32(d, 0);
+    if (magia == 0x0A0D0D0A) {
+        pcapng(d, (size_t)n, &t0);
+    } else if (magia == 0xA1B2C3D4 || magia == 0xD4C3B2A1 || magia == 0xA1B23C4D || magia == 0x4D3CB2A1) {
+        pcap_clasico(d, (size_t)n, &t0);
+    } else {
+        printf("[!] %s: no es pcap ni pcapng\n", ruta);
+        r = -1;
+    }
+    free(d);
+    if (r == 0 && num_eventos > antes) {
+        // El cero pasa a ser la primera publicación: lo anterior (conexión,
+        // suscripciones) no se repite y solo demoraría el arranque
+        unsigned long long cero = eventos[antes].t_us;
+        for (int i = antes; i < num_eventos; i++) eventos[i].t_us -= cero;
+    }
+    if (r == 0) {
+        unsigned long long dur = num_eventos > antes ? eventos[num_eventos - 1].t_us : 0;
+        printf("%s: %lu paquetes, %lu publicaciones en %.3f s (saltados: %lu retransmisiones, "
+               "%lu de control, %lu alias sin resolver)\n", ruta, conteo.paquetes, conteo.eventos,
+               dur / 1e6, conteo.retransmisiones, conteo.control, conteo.sin_alias);
+    }
+    return r;
+}
+
+static int por_tiempo(const void *a, const void *b) {
+    const Evento *x = a, *y = b;
+    if (x->t_us != y->t_us) return x->t_us < y->t_us ? -1 : 1;
+    return x->orden - y->orden;
+}
+
+// ============================================================================
+// REPETICIÓN Y MEDICIÓN
+// ============================================================================
+
+typedef struct {
+    ProtocoloPub protocolo;
+    struct sockaddr_in broker;
+    double velocidad;                // 0 = --maximo
+    int copias, publicadores, repetir;
+} Opciones;
+
+typedef struct {
+    long total;                      // Publicaciones a hacer
+    unsigned long long *publicado_us; // Por id
+    unsigned char *entregado;
+    double *latencias;
+    long entregados, duplicados, confirmados, rechazadas;
+    unsigned long long primera_us, ultima_pub_us, ultima_us;
+    char marca[24];                  // " [r<pid>."
+} Medicion;
+
+// Suscriptor de medición: cliente_sub (QUIC) o sockets propios (TCP/UDP)
+typedef struct {
+    ClienteSub **subs;               // QUIC: TEMAS_POR_SUB temas por cliente
+    int num_subs;
+    SOCKET socks[MAX_CONEXIONES_SUB];    // TCP: una conexión por línea SUB; UDP: uno solo
+    char cola[MAX_CONEXIONES_SUB][32];   // TCP: marca partida entre dos recv()
+    int num_socks, confirmados;
+    unsigned long long latido_ms;
+} Receptor;
+
+static Medicion med;
+
+static void entrega(long id) {
+    unsigned long long ahora = reloj_us();
+    if (id < 0 || id >= med.total || med.publicado_us[id] == 0) return;
+    if (med.entregado[id]) {
+        med.duplicados++;
+        return;
+    }
+    med.entregado[id] = 1;
+    med.latencias[med.entregados++] = (ahora - med.publicado_us[id]) / 1000.0;
+    med.ultima_us = ahora;
+}
+
+/** buscar_marcas - Todas las " [r<pid>.<id>]" de un bloque (TCP llega pegado) */
+static void buscar_marcas(const char *datos, size_t len) {
+    size_t m = strlen(med.marca);
+    for (const char *p = datos; (size_t)(datos + len - p) > m; p++) {
+        p = memchr(p, ' ', (size_t)(datos + len - p));
+        if (p == NULL || (size_t)(datos + len - p) <= m) return;
+        if (memcmp(p, med.marca, m) != 0) continue;
+        const char *num = p + m, *fin = num;
+        while (fin < datos + len && *fin >= '0' && *fin <= '9') fin++;
+        if (fin < datos + len && *fin == ']' && fin > num) entrega(strtol(num, NULL, 10));
+    }
+}
+
+static void al_recibir(void *ctx, const char *tema, unsigned int seq, const char *datos, size_t len) {
+    (void)ctx;
+    (void)tema;
+    (void)seq;
+    buscar_marcas(datos, len);
+}
+
+static void al_completar(void *ctx, unsigned long long id, int estado) {
+    (void)ctx;
+    (void)id;
+    if (estado == PUB_CONFIRMADO) med.confirmados++;
+}
+
+/** copia_tema - Nombre del tema en la copia k ("tema" si hay una sola) */
+static void copia_tema(char *destino, int tema, int k, int copias) {
+    if (copias == 1) snprintf(destino, QUIC_MAX_TEMA, "%s", tema_nombre(&temas_captura, tema));
+    else snprintf(destino, QUIC_MAX_TEMA, "%s/%03d", tema_nombre(&temas_captura, tema), k);
+}
+
+/** receptor_crear - Suscribe todas las copias de todos los temas de la captura */
+static int receptor_crear(Receptor *r, const Opciones *o, const char *ip) {
+    int total = temas_captura.cantidad * o->copias;
+    char tema[QUIC_MAX_TEMA];
+    memset(r, 0, sizeof(*r));
+
+    if (o->protocolo == PUB_QUIC) {
+        r->subs = calloc((size_t)(total / TEMAS_POR_SUB + 1), sizeof(ClienteSub *));
+        if (r->subs == NULL) return -1;
+        for (int i = 0; i < total; i++) {
+            if (i % TEMAS_POR_SUB == 0) {
+                ConfigSub cs;
+                sub_config_defecto(&cs, ip);
+                cs.puerto = ntohs(o->broker.sin_port);
+                cs.al_recibir = al_recibir;
+                r->subs[r->num_subs] = sub_crear(&cs);
+                if (r->subs[r->num_subs] == NULL) return -1;
+                r->num_subs++;
+            }
+            copia_tema(tema, i / o->copias, i % o->copias, o->copias);
+            if (sub_suscribir(r->subs[r->num_subs - 1], tema) != 0) return -1;
+        }
+        return 0;
+    }
+
+    if (o->protocolo == PUB_UDP) {
+        int buffer = 8 << 20;            // Que las ráfagas de --maximo no se pierdan acá
+        r->socks[0] = socket(AF_INET, SOCK_DGRAM, 0);
+        if (r->socks[0] == INVALID_SOCKET) return -1;
+        setsockopt(r->socks[0], SOL_SOCKET, SO_RCVBUF, (const char *)&buffer, sizeof(buffer));
+        r->num_socks = 1;
+        for (int i = 0; i < total; i++) {
+            char linea[QUIC_MAX_TEMA + 16];
+            copia_tema(tema, i / o->copias, i % o->copias, o->copias);
+            int len = snprintf(linea, sizeof(linea), "SUBSCRIBE:%s", tema);
+            sendto(r->socks[0], linea, len, 0, (const struct sockaddr *)&o->broker, sizeof(o->broker));
+        }
+        r->latido_ms = reloj_ms();
+        red_no_bloqueante(r->socks[0]);
+        return 0;
+    }
+
+    // TCP: "SUB" reemplaza los temas de la conexión, así que cada línea va
+    // por una conexión propia
+    for (int i = 0; i < total; ) {
+        char linea[LARGO_SUB_TCP + QUIC_MAX_TEMA + 2] = "SUB";
+        size_t len = 3;
+        while (i < total && len < LARGO_SUB_TCP) {
+            copia_tema(tema, i / o->copias, i % o->copias, o->copias);
+            len += (size_t)snprintf(linea + len, sizeof(linea) - len, " %s", tema);
+            i++;
+        }
+        linea[len++] = '\n';
+        if (r->num_socks == MAX_CONEXIONES_SUB) {
+            printf("[!] Demasiados temas para broker_tcp (más de %d líneas SUB)\n", MAX_CONEXIONES_SUB);
+            return -1;
+        }
+        SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s == INVALID_SOCKET || connect(s, (const struct sockaddr *)&o->broker, sizeof(o->broker)) != 0) {
+            printf("[!] No se pudo conectar al broker TCP\n");
+            return -1;
+        }
+        r->socks[r->num_socks++] = s;
+        send(s, linea, len, MSG_NOSIGNAL);
+        red_no_bloqueante(s);
+    }
+    return 0;
+}
+
+/**
+ * receptor_atender - Lee todo lo que haya y busca las marcas
+ *
+ * En TCP las publicaciones llegan pegadas (broker_tcp no las separa); lo
+ * que queda después del último ' ' sin su ']' se guarda para el próximo
+ * recv() por si es una marca partida.
+ */
+static void receptor_atender(Receptor *r, const Opciones *o) {
+    char buffer[TAM_DATAGRAMA + 32];
+    for (int i = 0; i < r->num_subs; i++) sub_procesar(r->subs[i], 0);
+    for (int i = 0; i < r->num_socks; i++) {
+        while (1) {
+            size_t previo = strlen(r->cola[i]);
+            memcpy(buffer, r->cola[i], previo);
+            int n = recv(r->socks[i], buffer + previo, TAM_DATAGRAMA, 0);
+            if (n <= 0) break;
+            size_t len = previo + (size_t)n;
+            buffer[len] = '\0';
+            buscar_marcas(buffer, len);
+            if (o->protocolo != PUB_TCP) continue;
+            for (char *p = buffer; (p = strstr(p, "Suscripcion exitosa")) != NULL; p++) r->confirmados++;
+            r->cola[i][0] = '\0';
+            size_t espacio = len;
+            while (espacio > 0 && len - espacio < sizeof(r->cola[i]) - 1 && buffer[espacio - 1] != ' ') espacio--;
+            if (espacio > 0 && buffer[espacio - 1] == ' ' && memchr(buffer + espacio, ']', len - espacio) == NULL) {
+                memcpy(r->cola[i], buffer + espacio - 1, len - espacio + 2);
+            }
+        }
+    }
+    if (o->protocolo == PUB_UDP && reloj_ms() - r->latido_ms >= LATIDO_UDP_MS) {
+        sendto(r->socks[0], "PING", 4, 0, (const struct sockaddr *)&o->broker, sizeof(o->broker));
+        r->latido_ms = reloj_ms();
+    }
+}
+
+/** receptor_listo - Todas las suscripciones confirmadas (UDP no confirma) */
+static int receptor_listo(const Receptor *r, const Opciones *o) {
+    if (o->protocolo == PUB_TCP) return r->confirmados >= r->num_socks;
+    int confirmados = 0;
+    for (int i = 0; i < r->num_subs; i++) confirmados += sub_confirmados(r->subs[i]);
+    return confirmados >= temas_captura.cantidad * o->copias;
+}
+
+/** receptor_cerrar - Da de baja las suscripciones */
+static void receptor_cerrar(Receptor *r, const Opciones *o) {
+    for (int i = 0; i < r->num_subs; i++) sub_destruir(r->subs[i]);
+    free(r->subs);
+    if (o->protocolo == PUB_UDP && r->num_socks > 0) {
+        char tema[QUIC_MAX_TEMA], linea[QUIC_MAX_TEMA + 16];
+        for (int i = 0; i < temas_captura.cantidad * o->copias; i++) {
+            copia_tema(tema, i / o->copias, i % o->copias, o->copias);
+            int len = snprintf(linea, sizeof(linea), "UNSUBSCRIBE:%s", tema);
+            sendto(r->socks[0], linea, len, 0, (const struct sockaddr *)&o->broker, sizeof(o->broker));
+        }
+    }
+    for (int i = 0; i < r->num_socks; i++) closesocket(r->socks[i]);
+}
+
+/** girar - Espera actividad hasta espera_us en publicadores y receptor, y la atiende */
+static void girar(ClientePub **pubs, int num_pubs, Receptor *r, const Opciones *o,
+                  unsigned long long espera_us) {
+    fd_set lectura;
+    SOCKET mayor = 0;
+    FD_ZERO(&lectura);
+    for (int i = 0; i < num_pubs; i++) {
+        SOCKET s = pub_socket(pubs[i]);
+        if (s == INVALID_SOCKET) continue;
+        FD_SET(s, &lectura);
+        if (s > mayor) mayor = s;
+    }
+    for (int i = 0; i < r->num_subs; i++) {
+        FD_SET(sub_socket(r->subs[i]), &lectura);
+        if (sub_socket(r->subs[i]) > mayor) mayor = sub_socket(r->subs[i]);
+    }
+    for (int i = 0; i < r->num_socks; i++) {
+        FD_SET(r->socks[i], &lectura);
+        if (r->socks[i] > mayor) mayor = r->socks[i];
+    }
+    struct timeval tv = {(time_t)(espera_us / 1000000), (suseconds_t)(espera_us % 1000000)};
+    select((int)mayor + 1, &lectura, NULL, NULL, &tv);
+    for (int i = 0; i < num_pubs; i++) pub_procesar(pubs[i], 0);
+    receptor_atender(r, o);
+}
+
+static int comparar(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/** percentil - p en [0, 100] de un arreglo ya ordenado */
+static double percentil(const double *v, long n, double p) {
+    if (n == 0) return 0;
+    long i = (long)(p / 100.0 * (double)(n - 1) + 0.5);
+    return v[i];
+}
+
+/** repetir - Publica todos los eventos según o y espera las entregas */
+static int repetir(const Opciones *o) {
+    static const char *nombres[] = {"tcp", "udp", "quic"};
+    char ip[INET_ADDRSTRLEN], tema[QUIC_MAX_TEMA], texto[MAX_PAYLOAD + 40];
+    long por_evento = (long)o->copias * o->publicadores;
+    unsigned long long periodo = eventos[num_eventos - 1].t_us + PAUSA_VUELTA_US;
+    ClientePub *pubs[MAX_PUBLICADORES];
+    Receptor r;
+
+    memset(&med, 0, sizeof(med));
+    med.total = (long)num_eventos * por_evento * o->repetir;
+    med.publicado_us = calloc((size_t)med.total, sizeof(unsigned long long));
+    med.entregado = calloc((size_t)med.total, 1);
+    med.latencias = calloc((size_t)med.total, sizeof(double));
+    if (!med.publicado_us || !med.entregado || !med.latencias) {
+        printf("Sin memoria para %ld publicaciones\n", med.total);
+        return -1;
+    }
+    snprintf(med.marca, sizeof(med.marca), " [r%d.", (int)getpid());
+    inet_ntop(AF_INET, &o->broker.sin_addr, ip, sizeof(ip));
+
+    printf("\n=== REPETICIÓN: %d eventos x %d temas x %d publicadores x %d vueltas = %ld publicaciones ===\n",
+           num_eventos, o->copias, o->publicadores, o->repetir, med.total);
+    if (o->velocidad > 0) printf("%s %s:%d, velocidad %gx\n\n", nombres[o->protocolo], ip,
+                                 ntohs(o->broker.sin_port), o->velocidad);
+    else printf("%s %s:%d, al máximo\n\n", nombres[o->protocolo], ip, ntohs(o->broker.sin_port));
+
+    if (receptor_crear(&r, o, ip) != 0) {
+        printf("[!] No se pudo crear el suscriptor\n");
+        return -1;
+    }
+    unsigned long long limite = reloj_ms() + (o->protocolo == PUB_UDP ? 300 : 10000);
+    while (reloj_ms() < limite && (o->protocolo == PUB_UDP || !receptor_listo(&r, o))) {
+        girar(NULL, 0, &r, o, 5000);
+    }
+    if (o->protocolo != PUB_UDP && !receptor_listo(&r, o)) {
+        printf("[!] El broker %s:%d no confirmó las suscripciones\n", ip, ntohs(o->broker.sin_port));
+        receptor_cerrar(&r, o);
+        return -1;
+    }
+
+    for (int p = 0; p < o->publicadores; p++) {
+        ConfigPub cp;
+        pub_config_defecto(&cp, o->protocolo, ip);
+        cp.puerto = ntohs(o->broker.sin_port);
+        cp.al_completar = al_completar;
+        pubs[p] = pub_crear(&cp);
+        if (pubs[p] == NULL) {
+            printf("[!] No se pudo crear el publicador %d\n", p);
+            return -1;
+        }
+    }
+
+    // Publicación i = (vuelta, evento, publicador, copia); el turno sale
+    // del tiempo del evento en la captura
+    med.primera_us = reloj_us();
+    for (long i = 0; i < med.total; ) {
+        long global = i / por_evento;
+        int vuelta = (int)(global / num_eventos);
+        const Evento *e = &eventos[global % num_eventos];
+        int p = (int)(i % por_evento / o->copias), k = (int)(i % o->copias);
+        if (o->velocidad > 0) {
+            unsigned long long turno = med.primera_us +
+                (unsigned long long)(((double)vuelta * (double)periodo + (double)e->t_us) / o->velocidad);
+            unsigned long long ahora = reloj_us();
+            if (ahora < turno) {
+                girar(pubs, o->publicadores, &r, o, turno - ahora < 1000 ? turno - ahora : 1000);
+                continue;
+            }
+        }
+        copia_tema(tema, e->tema, k, o->copias);
+        int len = snprintf(texto, sizeof(texto), "%s%s%ld]", e->datos, med.marca, i);
+        med.publicado_us[i] = reloj_us();
+        if (pub_publicar(pubs[p], tema, texto, (size_t)len) > 0) {
+            med.ultima_pub_us = med.publicado_us[i];
+            i++;
+            continue;
+        }
+        med.publicado_us[i] = 0;
+        if (pub_pendientes(pubs[p]) == 0) {   // No es la cola: el mensaje no entra
+            med.rechazadas++;
+            i++;
+            continue;
+        }
+        girar(pubs, o->publicadores, &r, o, 1000);
+    }
+
+    // Esperar entregas hasta ESPERA_FINAL_MS sin novedades
+    long esperadas = med.total - med.rechazadas, vistos = -1;
+    unsigned long long ultimo_avance = reloj_ms();
+    while (med.entregados < esperadas && reloj_ms() - ultimo_avance < ESPERA_FINAL_MS) {
+        girar(pubs, o->publicadores, &r, o, 5000);
+        if (med.entregados != vistos) {
+            vistos = med.entregados;
+            ultimo_avance = reloj_ms();
+        }
+    }
+    // Un rato más para contar duplicados tardíos
+    for (unsigned long long fin = reloj_ms() + 200; reloj_ms() < fin; ) girar(pubs, o->publicadores, &r, o, 5000);
+
+    double publicando = (med.ultima_pub_us - med.primera_us) / 1e6;
+    double segundos = med.entregados > 0 ? (med.ultima_us - med.primera_us) / 1e6 : 0;
+    qsort(med.latencias, (size_t)med.entregados, sizeof(double), comparar);
+    printf("%12s %12s %12s %10s %10s\n", "publicadas", "confirmadas", "entregadas", "perdidas", "duplicadas");
+    printf("%12ld %12ld %12ld %10ld %10ld\n", esperadas, med.confirmados, med.entregados,
+           esperadas - med.entregados, med.duplicados);
+    if (med.rechazadas > 0) printf("(%ld mensajes no entran en un paquete y se saltearon)\n", med.rechazadas);
+    printf("\nOfrecido:    %10.0f publicaciones/s en %.3f s\n",
+           publicando > 0 ? esperadas / publicando : 0, publicando);
+    printf("Rendimiento: %10.0f entregas/s en %.3f s\n", segundos > 0 ? med.entregados / segundos : 0, segundos);
+    printf("Latencia (ms): p50 %.2f  p90 %.2f  p99 %.2f  máx %.2f\n",
+           percentil(med.latencias, med.entregados, 50), percentil(med.latencias, med.entregados, 90),
+           percentil(med.latencias, med.entregados, 99),
+           med.entregados ? med.latencias[med.entregados - 1] : 0);
+
+    for (int p = 0; p < o->publicadores; p++) pub_destruir(pubs[p]);
+    receptor_cerrar(&r, o);
+    free(med.publicado_us);
+    free(med.entregado);
+    free(med.latencias);
+    return esperadas == med.entregados ? 0 : 2;
+}
+
+// ============================================================================
+// FUNCIÓN PRINCIPAL
+// ============================================================================
+
+static int leer_destino(const char *texto, struct sockaddr_in *dir) {
+    char ip[64];
+    int puerto = 0;
+    if (sscanf(texto, "%63[^:]:%d", ip, &puerto) != 2 || puerto <= 0 || puerto > 65535) return -1;
+    memset(dir, 0, sizeof(*dir));
+    dir->sin_family = AF_INET;
+    dir->sin_port = htons((unsigned short)puerto);
+    return inet_pton(AF_INET, ip, &dir->sin_addr) == 1 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *capturas[MAX_CAPTURAS], *destino = NULL;
+    int num_capturas = 0, listar = 0;
+    Opciones o = {PUB_QUIC, {0}, 1, 1, 1, 1};
+
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--maximo") == 0) { o.velocidad = 0; continue; }
+        if (strcmp(argv[i], "--listar") == 0) { listar = 1; continue; }
+        if (v == NULL) {
+            printf("Falta el valor de %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--captura") == 0) {
+            if (num_capturas == MAX_CAPTURAS) {
+                printf("Máximo %d capturas\n", MAX_CAPTURAS);
+                return 1;
+            }
+            capturas[num_capturas++] = v;
+        }
+        else if (strcmp(argv[i], "--protocolo") == 0) {
+            if (strcmp(v, "tcp") == 0) o.protocolo = PUB_TCP;
+            else if (strcmp(v, "udp") == 0) o.protocolo = PUB_UDP;
+            else if (strcmp(v, "quic") == 0) o.protocolo = PUB_QUIC;
+            else {
+                printf("--protocolo espera tcp, udp o quic\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--broker") == 0) destino = v;
+        else if (strcmp(argv[i], "--puerto-quic") == 0) puerto_quic = (unsigned short)atoi(v);
+        else if (strcmp(argv[i], "--velocidad") == 0) o.velocidad = atof(v);
+        else if (strcmp(argv[i], "--temas") == 0) o.copias = atoi(v);
+        else if (strcmp(argv[i], "--publicadores") == 0) o.publicadores = atoi(v);
+        else if (strcmp(argv[i], "--repetir") == 0) o.repetir = atoi(v);
+        else {
+            printf("Opción desconocida: %s\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+    if (num_capturas == 0 || o.velocidad < 0 || o.copias < 1 || o.copias > MAX_COPIAS ||
+        o.publicadores < 1 || o.publicadores > MAX_PUBLICADORES || o.repetir < 1) {
+        printf("Uso: %s --captura archivo [--captura ...] [--protocolo tcp|udp|quic]\n"
+               "       [--broker ip:puerto] [--velocidad N | --maximo] [--temas K (<= %d)]\n"
+               "       [--publicadores P (<= %d)] [--repetir R] [--puerto-quic N] [--listar]\n",
+               argv[0], MAX_COPIAS, MAX_PUBLICADORES);
+        return 1;
+    }
+    if (destino == NULL) {
+        destino = o.protocolo == PUB_TCP ? "127.0.0.1:6000" : o.protocolo == PUB_UDP ? "127.0.0.1:8080"
+                                                                                   : "127.0.0.1:7000";
+    }
+    if (leer_destino(destino, &o.broker) != 0) {
+        printf("--broker espera ip:puerto\n");
+        return 1;
+    }
+    red_iniciar();
+
+    // Cada captura con su propio cero; al mezclarlas se superponen en el tiempo
+    printf("=== BENCH PCAP ===\n");
+    temas_iniciar(&temas_captura);
+    for (int i = 0; i < num_capturas; i++) {
+        if (leer_captura(capturas[i]) != 0) return 1;
+    }
+    if (num_eventos == 0) {
+        printf("Las capturas no tienen publicaciones\n");
+        return 1;
+    }
+    qsort(eventos, (size_t)num_eventos, sizeof(Evento), por_tiempo);
+    long bytes = 0;
+    for (int i = 0; i < num_eventos; i++) bytes += eventos[i].largo;
+    printf("Total: %d publicaciones en %d temas, %.3f s, %ld bytes de payload en promedio\n",
+           num_eventos, temas_captura.cantidad, eventos[num_eventos - 1].t_us / 1e6, bytes / num_eventos);
+
+    if (listar) {
+        for (int i = 0; i < num_eventos; i++) {
+            printf("%10.6f  %-24s %s\n", eventos[i].t_us / 1e6, tema_nombre(&temas_captura, eventos[i].tema),
+                   eventos[i].datos);
+        }
+        return 0;
+    }
+    return repetir(&o);
+}
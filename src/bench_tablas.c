@@ -0,0 +1,212 @@
+/*
+ * BENCH TABLAS - Fan-out con arreglo de structs vs columnas (tablas.h)
+ *
+ * Reproduce el recorrido que hace el broker QUIC en cada publicación:
+ * buscar la secuencia del tema y encontrar a todos sus suscriptores.
+ *
+ *   1. AoS : el Suscriptor de antes (char tema[50] + dirección + contadores,
+ *            ~96 bytes) y SecuenciaTema[]; se compara el texto del tema.
+ *   2. SoA : tablas.h; tema internado una vez (índice hash) y después un
+ *            unsigned int por suscriptor con columna_proximo(); la dirección
+ *            se lee solo de los que coinciden.
+ *
+ * Se informa el tiempo por fan-out y, si el kernel deja usar los contadores
+ * de hardware (perf_event_open; no en muchas máquinas virtuales), los
+ * fallos de L1 de datos y de último nivel de caché por fan-out.
+ *
+ * Compilar con:
+ *   gcc -O2 src/bench_tablas.c -o bench_tablas
+ * Uso:
+ *   ./bench_tablas [suscriptores] [temas] [publicaciones]
+ *   (por defecto 100000, 1000 y 2000)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "plataforma.h"
+#include "tablas.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+typedef struct {                     // Como era en broker_quic.c
+    char tema[50];
+    struct sockaddr_in addr;
+    unsigned int reproducir;
+    unsigned long long visto_ms;
+    unsigned int alias;
+    unsigned int limite;
+} SuscriptorAoS;
+
+typedef struct {
+    char tema[50];
+    unsigned int seq;
+} SecuenciaAoS;
+
+typedef struct {
+    const char *nombre;
+    double ns;                       // Por fan-out
+    double l1, llc;                  // Fallos por fan-out (-1 = sin contadores)
+    unsigned long long control;      // Suma de puertos: los dos métodos deben coincidir
+} Resultado;
+
+// ============================================================================
+// CONTADORES DE HARDWARE
+// ============================================================================
+
+#ifdef __linux__
+static int contador_abrir(unsigned int tipo, unsigned long long config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = tipo;
+    a.config = config;
+    a.disabled = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static int fd_l1 = -1, fd_llc = -1;
+
+static void contadores_iniciar(void) {
+    fd_l1 = contador_abrir(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    fd_llc = contador_abrir(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+}
+
+static void contadores_arrancar(void) {
+    if (fd_l1 >= 0) { ioctl(fd_l1, PERF_EVENT_IOC_RESET, 0); ioctl(fd_l1, PERF_EVENT_IOC_ENABLE, 0); }
+    if (fd_llc >= 0) { ioctl(fd_llc, PERF_EVENT_IOC_RESET, 0); ioctl(fd_llc, PERF_EVENT_IOC_ENABLE, 0); }
+}
+
+static double contador_leer(int fd) {
+    long long v;
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    return read(fd, &v, sizeof(v)) == sizeof(v) ? (double)v : -1;
+}
+#else
+static int fd_l1 = -1, fd_llc = -1;
+static void contadores_iniciar(void) {}
+static void contadores_arrancar(void) {}
+static double contador_leer(int fd) { (void)fd; return -1; }
+#endif
+
+static double ahora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void terminar(Resultado *r, double t0, int publicaciones) {
+    r->ns = (ahora_ns() - t0) / publicaciones;
+    double l1 = contador_leer(fd_l1), llc = contador_leer(fd_llc);
+    r->l1 = l1 < 0 ? -1 : l1 / publicaciones;
+    r->llc = llc < 0 ? -1 : llc / publicaciones;
+}
+
+// ============================================================================
+// LAS DOS FORMAS DE HACER EL FAN-OUT
+// ============================================================================
+
+static void fanout_aos(Resultado *r, SuscriptorAoS *subs, int n, SecuenciaAoS *seqs,
+                       int num_temas, char (*publicados)[50], int publicaciones) {
+    contadores_arrancar();
+    double t0 = ahora_ns();
+    for (int p = 0; p < publicaciones; p++) {
+        const char *tema = publicados[p];
+        for (int t = 0; t < num_temas; t++) {
+            if (strcmp(seqs[t].tema, tema) == 0) { seqs[t].seq++; break; }
+        }
+        for (int i = 0; i < n; i++) {
+            if (strcmp(subs[i].tema, tema) == 0) r->control += subs[i].addr.sin_port;
+        }
+    }
+    terminar(r, t0, publicaciones);
+}
+
+static void fanout_soa(Resultado *r, TablaTemas *temas, Columna *tema, Columna *addr, int n,
+                       Columna *seq, char (*publicados)[50], int publicaciones) {
+    contadores_arrancar();
+    double t0 = ahora_ns();
+    for (int p = 0; p < publicaciones; p++) {
+        int id = tema_buscar(temas, publicados[p]);
+        COLUMNA(*seq, unsigned int, id)++;
+        for (int i = columna_proximo(tema, n, (unsigned int)id, 0); i >= 0;
+             i = columna_proximo(tema, n, (unsigned int)id, i + 1)) {
+            r->control += COLUMNA(*addr, struct sockaddr_in, i).sin_port;
+        }
+    }
+    terminar(r, t0, publicaciones);
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    int num_temas = argc > 2 ? atoi(argv[2]) : 1000;
+    int publicaciones = argc > 3 ? atoi(argv[3]) : 2000;
+    if (n <= 0 || num_temas <= 0 || publicaciones <= 0) {
+        printf("Uso: %s [suscriptores] [temas] [publicaciones]\n", argv[0]);
+        return 1;
+    }
+
+    // Los mismos datos para los dos: tema al azar por suscriptor (semilla fija)
+    SuscriptorAoS *subs = calloc((size_t)n, sizeof(*subs));
+    SecuenciaAoS *seqs = calloc((size_t)num_temas, sizeof(*seqs));
+    char (*publicados)[50] = malloc(sizeof(*publicados) * (size_t)publicaciones);
+    TablaTemas temas;
+    Columna tema, addr, seq;
+    temas_iniciar(&temas);
+    columna_iniciar(&tema, sizeof(unsigned int));
+    columna_iniciar(&addr, sizeof(struct sockaddr_in));
+    columna_iniciar(&seq, sizeof(unsigned int));
+    if (subs == NULL || seqs == NULL || publicados == NULL ||
+        columna_asegurar(&tema, n) != 0 || columna_asegurar(&addr, n) != 0 ||
+        columna_asegurar(&seq, num_temas) != 0) {
+        printf("Sin memoria\n");
+        return 1;
+    }
+    for (int t = 0; t < num_temas; t++) {
+        snprintf(seqs[t].tema, sizeof(seqs[t].tema), "Partido/%d/Eventos", t);
+        tema_internar(&temas, seqs[t].tema);
+    }
+    srand(42);
+    for (int i = 0; i < n; i++) {
+        int t = rand() % num_temas;
+        strcpy(subs[i].tema, seqs[t].tema);
+        subs[i].addr.sin_port = htons((unsigned short)(10000 + i % 50000));
+        COLUMNA(tema, unsigned int, i) = (unsigned int)t;
+        COLUMNA(addr, struct sockaddr_in, i) = subs[i].addr;
+    }
+    for (int p = 0; p < publicaciones; p++) strcpy(publicados[p], seqs[rand() % num_temas].tema);
+
+    contadores_iniciar();
+    Resultado res[2] = {{"AoS (char tema[50])", 0, 0, 0, 0}, {"SoA (tablas.h)", 0, 0, 0, 0}};
+    printf("=== BENCH TABLAS: %d suscriptores, %d temas, %d publicaciones ===\n\n",
+           n, num_temas, publicaciones);
+    printf("Memoria recorrida por fan-out: AoS %zu KB, SoA %zu KB\n\n",
+           (size_t)n * sizeof(SuscriptorAoS) / 1024, (size_t)n * sizeof(unsigned int) / 1024);
+    fanout_aos(&res[0], subs, n, seqs, num_temas, publicados, publicaciones);
+    fanout_soa(&res[1], &temas, &tema, &addr, n, &seq, publicados, publicaciones);
+
+    printf("%-22s %12s %14s %14s\n", "", "us/fan-out", "fallos L1D", "fallos LLC");
+    for (int i = 0; i < 2; i++) {
+        printf("%-22s %12.1f", res[i].nombre, res[i].ns / 1000);
+        if (res[i].l1 >= 0) printf(" %14.0f", res[i].l1); else printf(" %14s", "-");
+        if (res[i].llc >= 0) printf(" %14.0f\n", res[i].llc); else printf(" %14s\n", "-");
+    }
+    if (fd_l1 < 0 && fd_llc < 0) printf("\n(sin contadores de hardware: perf_event_open no disponible)\n");
+    if (res[0].control != res[1].control) {
+        printf("\nERROR: los dos recorridos no encontraron los mismos suscriptores\n");
+        return 1;
+    }
+    printf("\nSoA es %.1fx más rápido por fan-out\n", res[0].ns / res[1].ns);
+    return 0;
+}
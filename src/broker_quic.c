@@ -16,16 +16,45 @@
  * 
  * Características Clave:
  *   ✓ Secuencias independientes por tema (evita falsos positivos de pérdida)
- *   ✓ Historial de 100 mensajes para retransmisión
+ *   ✓ Historial de 1024 mensajes para retransmisión
+ *   ✓ Estado retenido por tema: quien se suscribe tarde recibe los últimos
+ *     mensajes junto con el ACK
  *   ✓ ACKs manuales para confirmar recepción (simulando TCP sobre UDP)
  *   ✓ Verificación de tema en retransmisión (evita enviar datos incorrectos)
+ *   ✓ Reanudación: un subscriber que vuelve indica su último seq y recibe
+ *     lo que le faltó en lotes pausados antes de pasar a vivo
  *   ✓ Soporte para múltiples suscriptores por tema
+ *   ✓ Baja explícita ('U') y expiración de subscribers sin latidos ('H')
+ *   ✓ QoS por tema: 0 (sin garantías, camino rápido), 1 (al menos una
+ *     vez, por defecto) y 2 (exactamente una vez)
+ *   ✓ Alias numéricos de tema ('T'): "#id:contenido" en lugar del nombre
+ *     completo del tema en publicaciones y entregas
+ *   ✓ Control de flujo por créditos: el subscriber indica en sus ACKs hasta
+ *     qué seq puede recibir y el broker pausa el envío al llegar al límite
+ *   ✓ Prioridad de salida por tema: clase alta estricta y turnos ponderados
+ *     (WFQ) entre normal y baja antes de cada sendto() de publicaciones
+ *   ✓ Cluster opcional: varios brokers se reparten los temas por hashing
+ *     consistente y se reenvían paquetes por un enlace TCP persistente
+ *   ✓ Replicación opcional: un seguidor recibe secuencias, historial y
+ *     suscripciones del líder y toma el control si este cae
+ *   ✓ Hilos opcionales (--hilos N): cada tema pertenece a un hilo de
+ *     trabajo que tiene su estado propio (sin cerrojos, orden por tema)
+ *   ✓ Transporte local opcional (--local N): cada publicación se copia una
+ *     vez en un anillo del tema en memoria compartida para los subscribers
+ *     de la misma máquina
+ *   ✓ Fotos opcionales (--foto archivo): suscripciones y secuencias se
+ *     guardan periódicamente y se recuperan al reiniciar el broker
+ *   ✓ Mensajes fragmentados (ver protocolo_quic.h): cada fragmento es una
+ *     publicación más, con su seq, su lugar en el historial y su 'R'
+ *   ✓ Grupos de consumidores ("$grupo/g/tema", ver grupos.h): cada mensaje
+ *     del tema va a un solo miembro del grupo (turnos, carga o clave)
  * 
  * Limitaciones:
- *   - Historial limitado a 100 mensajes (buffer circular)
- *   - Sin persistencia (se pierde al reiniciar)
+ *   - Historial limitado a 1024 mensajes (buffer circular)
+ *   - El historial no se guarda en disco (la foto solo lleva suscripciones
+ *     y secuencias)
  *   - Sin cifrado (mensajes en texto plano)
- *   - Single-threaded (procesa un mensaje a la vez)
+ *   - Un solo hilo por defecto; con --hilos N no hay cluster ni replicación
  * 
  * Autor: Lab3 - Infraestructura de Comunicaciones
  * Fecha: Octubre 2025
@@ -35,76 +64,90 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <winsock2.h>
+#include <signal.h>
+#include "plataforma.h"
+#include "protocolo_quic.h"
+#include "planificador.h"
+#include "udp_lotes.h"
+#include "tablas.h"
+#include "hilos.h"
+#include "memoria_local.h"
+#include "foto.h"
+#include "admision.h"
+#include "grupos.h"
 
 // ============================================================================
 // CONSTANTES DE CONFIGURACIÓN
 // ============================================================================
 
-#define PUERTO 7000              // Puerto UDP donde escucha el broker
-#define MAX_SUBS 100             // Máximo número de suscriptores simultáneos
+#define PUERTO QUIC_PUERTO       // Puerto UDP donde escucha el broker
 #define BUFFER_SIZE 512          // Tamaño del buffer de recepción
-#define MAX_HISTORIAL 100        // Máximo de mensajes guardados para retransmisión
+#define MAX_HISTORIAL 1024       // Máximo de mensajes guardados para retransmisión
 
 // ============================================================================
 // ESTRUCTURAS DE DATOS
 // ============================================================================
 
-/**
- * Paquete - Unidad básica de comunicación QUIC
- * 
- * Esta estructura define el formato de TODOS los paquetes intercambiados
- * entre broker, publishers y subscribers. Similar a un "datagrama QUIC".
- * 
- * Campos:
- *   - seq: Número de secuencia para ordenar mensajes y detectar pérdidas
- *          (independiente por tema en el broker)
- *   - tipo: Indica el propósito del paquete:
- *           'S' = Suscripción (subscriber → broker)
- *           'P' = Publicación (publisher → broker → subscriber)
- *           'A' = ACK (confirmación bidireccional)
- *           'R' = Retransmisión (solicitud de reenvío)
- *   - mensaje: Payload del paquete, uso depende del tipo:
- *           'S': nombre del tema a suscribir
- *           'P': formato "tema:contenido"
- *           'A': "OK"
- *           'R': nombre del tema del mensaje perdido
- */
-typedef struct {
-    unsigned int seq;      
-    char tipo;             
-    char mensaje[500];     
-} Paquete;
+// Paquete (seq, tipo, mensaje) y los códigos de tipo están definidos en
+// protocolo_quic.h, compartido con publisher, subscriber y librerías cliente.
 
 /**
- * Suscriptor - Registro de un subscriber conectado
+ * Suscripciones - Tabla de subscribers conectados, una columna por campo
  * 
- * Almacena la información necesaria para enviar mensajes a un subscriber:
- *   - tema: El tema/canal al que está suscrito (ej: "Colombia vs Argentina")
- *   - addr: Dirección IP y puerto del subscriber para envío UDP
+ * Cada fila i es una suscripción (tema, dirección). Los campos viven en
+ * columnas separadas (tablas.h) en lugar de un struct por suscriptor:
+ *   - tema: Id del tema internado en temas (ej: "Colombia vs Argentina").
+ *     Es lo único que lee el fan-out de publicar() para cada fila.
+ *   - ip, puerto: Dirección del subscriber (orden de red), ver sub_addr()
+ *   - reproducir: Próximo seq a reenviar desde el historial mientras el
+ *     subscriber se pone al día (0 = recibe en vivo)
+ *   - visto_ms: Último 'S' o latido 'H' de esa dirección (para expirarla)
+ *   - alias: Id negociado con 'T' para enviarle "#id:contenido" en lugar
+ *     de "tema:contenido" (0 = texto completo)
+ *   - limite: Mayor seq que el subscriber aceptó recibir (crédito); 0 = sin
+ *     control de flujo
+ *   - confirmado: Acumulado de su último ACK (recibió todo hasta ese seq);
+ *     lo usan los grupos de consumidores
  * 
- * Nota: Un mismo subscriber puede aparecer múltiples veces si está
- * suscrito a varios temas diferentes.
+ * Las columnas crecen de a slabs: no hay máximo de suscriptores. Un mismo
+ * subscriber aparece en varias filas si está suscrito a varios temas.
  */
 typedef struct {
-    char tema[50];
-    struct sockaddr_in addr;
-} Suscriptor;
+    Columna tema;           // unsigned int
+    Columna ip;             // unsigned int
+    Columna puerto;         // unsigned short
+    Columna reproducir;     // unsigned int
+    Columna visto_ms;       // unsigned long long
+    Columna alias;          // unsigned int
+    Columna limite;         // unsigned int
+    Columna confirmado;     // unsigned int
+} Suscripciones;
+
+#define SUB_TEMA(i)       COLUMNA(subs.tema, unsigned int, i)
+#define SUB_IP(i)         COLUMNA(subs.ip, unsigned int, i)
+#define SUB_PUERTO(i)     COLUMNA(subs.puerto, unsigned short, i)
+#define SUB_REPRODUCIR(i) COLUMNA(subs.reproducir, unsigned int, i)
+#define SUB_VISTO(i)      COLUMNA(subs.visto_ms, unsigned long long, i)
+#define SUB_ALIAS(i)      COLUMNA(subs.alias, unsigned int, i)
+#define SUB_LIMITE(i)     COLUMNA(subs.limite, unsigned int, i)
+#define SUB_CONFIRMADO(i) COLUMNA(subs.confirmado, unsigned int, i)
 
 /**
  * MensajeHistorial - Entrada en el buffer circular de historial
  * 
- * El broker guarda los últimos 100 mensajes publicados para poder
- * retransmitirlos si un subscriber los perdió.
+ * El broker guarda los últimos 1024 mensajes publicados para poder
+ * retransmitirlos si un subscriber los perdió. Alcanza para un mensaje
+ * fragmentado de unos 470 KB: un fragmento perdido al principio todavía se
+ * puede pedir cuando sale el último.
  * 
  * Campos:
- *   - seq: Número de secuencia del mensaje (global, no por tema)
+ *   - seq: Número de secuencia del mensaje (del tema: se busca con seq + tema)
  *   - tema: Tema al que pertenece el mensaje
  *   - mensaje: Contenido del mensaje (sin tema, solo el contenido)
  * 
  * Funcionamiento del buffer circular:
- *   - Se guardan los últimos 100 mensajes
- *   - Al llegar a 100, vuelve a sobrescribir desde el índice 0
+ *   - Se guardan los últimos MAX_HISTORIAL mensajes
+ *   - Al llegar a MAX_HISTORIAL, vuelve a sobrescribir desde el índice 0
  *   - Mensajes antiguos se pierden (limitación de memoria)
  */
 typedef struct {
@@ -114,7 +157,7 @@ typedef struct {
 } MensajeHistorial;
 
 /**
- * SecuenciaTema - Contador de secuencia independiente por tema
+ * Secuencias por tema - Contador independiente por tema
  * 
  * DISEÑO CRÍTICO: Cada tema tiene su propia secuencia independiente
  * 
@@ -138,47 +181,114 @@ typedef struct {
  *     Subscriber de Colombia recibe: seq=1, luego seq=2
  *     No hay saltos, no hay falsos positivos ✓
  * 
- * Campos:
- *   - tema: Nombre del tema
- *   - seq: Último número de secuencia asignado para este tema
+ * Almacenamiento:
+ *   - temas: Cada nombre se interna una vez en un id denso (tablas.h); las
+ *     suscripciones y los alias guardan el id, no el texto
+ *   - seq_tema: Último número de secuencia asignado, columna indexada por id
  */
-typedef struct {
-    char tema[50];
-    unsigned int seq;
-} SecuenciaTema;
 
 // ============================================================================
 // VARIABLES GLOBALES
 // ============================================================================
 
-Suscriptor suscriptores[MAX_SUBS];  // Lista de todos los suscriptores activos
-int num_subs = 0;                    // Contador de suscriptores actuales
+// POR_HILO: con --hilos N cada hilo de trabajo tiene su copia y solo
+// guarda sus temas (ver HILOS DE TRABAJO); sin hilos es una global más
+
+POR_HILO Suscripciones subs;         // Todos los suscriptores activos (ver iniciar_tablas)
+POR_HILO int num_subs = 0;           // Contador de suscriptores actuales
+
+POR_HILO MensajeHistorial historial[MAX_HISTORIAL];  // Buffer circular de mensajes
+POR_HILO int historial_index = 0;                     // Índice actual en el buffer circular
+
+POR_HILO TablaTemas temas;           // Nombre de tema → id (sin máximo)
+POR_HILO Columna seq_tema;           // unsigned int: último seq de cada tema
 
-MensajeHistorial historial[MAX_HISTORIAL];  // Buffer circular de mensajes
-int historial_index = 0;                     // Índice actual en el buffer circular
+typedef struct {
+    AnilloLocal *anillo;               // NULL: sin transporte local para este tema
+    int intentado;                     // Ya se intentó crear (no reintentar en cada publicación)
+} AnilloTema;
+
+POR_HILO Columna anillos_tema;       // AnilloTema por id de tema (ver TRANSPORTE LOCAL)
+POR_HILO Columna cubetas_tema;       // Cubeta por id de tema (ver ADMISIÓN)
+POR_HILO Columna retenidos_tema;     // Retenido * por id de tema (ver ESTADO RETENIDO)
 
-SecuenciaTema secuencias_tema[50];  // Array de contadores de secuencia por tema
-int num_temas_seq = 0;               // Cantidad de temas diferentes con secuencia
+// Definidas más abajo (las llaman publicar y las funciones de suscripciones)
+void replica_registrar(char tipo, unsigned int seq, const char *tema, const char *mensaje,
+                       const struct sockaddr_in *addr);
+void retener(const char *tema, unsigned int seq, const char *mensaje);
+int sin_credito(int idx, unsigned int seq);
+void encolar_salida(SOCKET sock, const char *tema, const Paquete *pkt, int tam,
+                    const struct sockaddr_in *destino);
+void publicar_local(const char *tema, unsigned int seq, const char *mensaje);
+int es_miembro(const char *tema);
+const char *nombre_en_red(const char *tema, char *buf);
+const char *nombre_miembro(const char *tema, char *buf);
+int buscar_miembro(const char *nombre, struct sockaddr_in addr);
+void unirse_grupo(int id);
+void salir_grupo(int idx);
+void repartir_en_grupos(SOCKET sock, unsigned int tema, const char *mensaje, int garantias);
 
 // ============================================================================
 // FUNCIONES AUXILIARES
 // ============================================================================
 
+/** iniciar_tablas - Deja vacías las columnas de suscripciones y temas */
+void iniciar_tablas(void) {
+    columna_iniciar(&subs.tema, sizeof(unsigned int));
+    columna_iniciar(&subs.ip, sizeof(unsigned int));
+    columna_iniciar(&subs.puerto, sizeof(unsigned short));
+    columna_iniciar(&subs.reproducir, sizeof(unsigned int));
+    columna_iniciar(&subs.visto_ms, sizeof(unsigned long long));
+    columna_iniciar(&subs.alias, sizeof(unsigned int));
+    columna_iniciar(&subs.limite, sizeof(unsigned int));
+    columna_iniciar(&subs.confirmado, sizeof(unsigned int));
+    temas_iniciar(&temas);
+    columna_iniciar(&seq_tema, sizeof(unsigned int));
+    columna_iniciar(&anillos_tema, sizeof(AnilloTema));
+    columna_iniciar(&cubetas_tema, sizeof(Cubeta));
+    columna_iniciar(&retenidos_tema, sizeof(void *));
+}
+
+/**
+ * tema_id - Id del tema, internándolo si es nuevo (con seq 0)
+ * 
+ * Retorna -1 si el nombre es demasiado largo o no hay memoria.
+ */
+int tema_id(const char *tema) {
+    int id = tema_internar(&temas, tema);
+    if (id >= 0 && columna_asegurar(&seq_tema, id + 1) != 0) return -1;
+    return id;
+}
+
+/** sub_addr - Dirección del suscriptor i */
+struct sockaddr_in sub_addr(int i) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = SUB_IP(i);
+    addr.sin_port = SUB_PUERTO(i);
+    return addr;
+}
+
+/** sub_tema - Nombre del tema del suscriptor i */
+const char *sub_tema(int i) {
+    return tema_nombre(&temas, (int)SUB_TEMA(i));
+}
+
 /**
  * obtener_siguiente_seq - Obtiene el siguiente número de secuencia para un tema
  * 
  * Esta función implementa el sistema de secuencias independientes por tema.
  * 
  * Algoritmo:
- *   1. Buscar si el tema ya tiene una secuencia asignada
- *   2. Si existe: incrementar su secuencia y devolverla
- *   3. Si NO existe: crear nueva entrada con seq=1
+ *   1. Buscar el id del tema (internarlo si es nuevo, con seq=0)
+ *   2. Incrementar su secuencia y devolverla
  * 
  * Parámetros:
  *   @param tema: Nombre del tema (ej: "Colombia vs Argentina")
  * 
  * Retorna:
- *   Siguiente número de secuencia para ese tema
+ *   Siguiente número de secuencia para ese tema (0 si el tema no es válido)
  * 
  * Ejemplo de uso:
  *   seq1 = obtener_siguiente_seq("Colombia vs Argentina");  // Retorna 1
@@ -191,40 +301,26 @@ int num_temas_seq = 0;               // Cantidad de temas diferentes con secuenc
  *   Brasil:   seq=1, 2, 3...
  *   (Secuencias independientes)
  */
-unsigned int obtener_siguiente_seq(char *tema) {
-    // Buscar si el tema ya tiene secuencia asignada
-    for (int i = 0; i < num_temas_seq; i++) {
-        if (strcmp(secuencias_tema[i].tema, tema) == 0) {
-            // Tema encontrado: incrementar y devolver secuencia
-            return ++secuencias_tema[i].seq;
-        }
-    }
-    
-    // Tema nuevo: crear entrada con seq=1
-    if (num_temas_seq < 50) {
-        strcpy(secuencias_tema[num_temas_seq].tema, tema);
-        secuencias_tema[num_temas_seq].seq = 1;
-        num_temas_seq++;
-        return 1;
-    }
-    
-    return 1;  // Fallback si llegamos al límite de temas
+unsigned int obtener_siguiente_seq(const char *tema) {
+    int id = tema_id(tema);
+    if (id < 0) return 0;
+    return ++COLUMNA(seq_tema, unsigned int, id);
 }
 
 /**
  * guardar_historial - Guarda un mensaje en el buffer circular de historial
  * 
  * El historial permite retransmitir mensajes perdidos. Funciona como un
- * buffer circular: al llegar a MAX_HISTORIAL (100), vuelve al inicio.
+ * buffer circular: al llegar a MAX_HISTORIAL (1024), vuelve al inicio.
  * 
  * Comportamiento del buffer circular:
- *   Posiciones: [0] [1] [2] ... [98] [99]
- *                ↑                      ↑
- *              inicio                 final
+ *   Posiciones: [0] [1] [2] ... [1022] [1023]
+ *                ↑                          ↑
+ *              inicio                     final
  *   
- *   Mensajes 1-100: llenan posiciones 0-99
- *   Mensaje 101: sobrescribe posición 0
- *   Mensaje 102: sobrescribe posición 1
+ *   Mensajes 1-1024: llenan posiciones 0-1023
+ *   Mensaje 1025: sobrescribe posición 0
+ *   Mensaje 1026: sobrescribe posición 1
  *   ...
  * 
  * Parámetros:
@@ -244,18 +340,20 @@ void guardar_historial(unsigned int seq, char *tema, char *mensaje) {
 }
 
 /**
- * buscar_en_historial - Busca un mensaje por su número de secuencia
+ * buscar_en_historial - Busca un mensaje por su número de secuencia y tema
  * 
  * Cuando un subscriber detecta pérdida de paquete, solicita retransmisión
  * enviando el seq del mensaje perdido. Esta función busca ese mensaje
  * en el historial.
  * 
- * IMPORTANTE: Busca por seq GLOBAL, no por seq de tema.
- * El broker luego verifica que el tema coincida antes de retransmitir.
+ * IMPORTANTE: Las secuencias son POR TEMA, así que varios temas tienen un
+ * seq=42 en el historial. Se compara seq Y tema: buscar solo por seq
+ * devolvía el primero que apareciera y, si era de otro tema, el mensaje
+ * correcto quedaba inaccesible aunque estuviera guardado.
  * 
  * Parámetros:
  *   @param seq: Número de secuencia a buscar
- *   @param tema_out: [OUTPUT] Tema del mensaje encontrado
+ *   @param tema: Tema del mensaje buscado
  *   @param mensaje_out: [OUTPUT] Contenido del mensaje encontrado
  * 
  * Retorna:
@@ -263,19 +361,18 @@ void guardar_historial(unsigned int seq, char *tema, char *mensaje) {
  *   0 si no se encontró (mensaje muy antiguo o nunca existió)
  * 
  * Ejemplo:
- *   char tema[50], msg[500];
- *   if (buscar_en_historial(42, tema, msg)) {
- *       printf("Encontrado: tema=%s msg=%s\n", tema, msg);
+ *   char msg[500];
+ *   if (buscar_en_historial(42, "Colombia vs Argentina", msg)) {
+ *       printf("Encontrado: msg=%s\n", msg);
  *   } else {
  *       printf("Mensaje seq=42 no encontrado en historial\n");
  *   }
  */
-int buscar_en_historial(unsigned int seq, char *tema_out, char *mensaje_out) {
+int buscar_en_historial(unsigned int seq, const char *tema, char *mensaje_out) {
     // Buscar linealmente en todo el historial
     for (int i = 0; i < MAX_HISTORIAL; i++) {
-        if (historial[i].seq == seq) {
-            // Mensaje encontrado: copiar datos a las variables de salida
-            strcpy(tema_out, historial[i].tema);
+        if (historial[i].seq == seq && strcmp(historial[i].tema, tema) == 0) {
+            // Mensaje encontrado: copiar contenido a la variable de salida
             strcpy(mensaje_out, historial[i].mensaje);
             return 1;  // Éxito
         }
@@ -283,6 +380,45 @@ int buscar_en_historial(unsigned int seq, char *tema_out, char *mensaje_out) {
     return 0;  // No encontrado
 }
 
+/**
+ * primer_seq_en_historial - Menor seq guardado del tema que sea > desde
+ * 
+ * Retorna 0 si el historial no tiene ningún mensaje posterior a desde.
+ */
+unsigned int primer_seq_en_historial(const char *tema, unsigned int desde) {
+    unsigned int primero = 0;
+    for (int i = 0; i < MAX_HISTORIAL; i++) {
+        if (historial[i].seq > desde && (primero == 0 || historial[i].seq < primero) &&
+            strcmp(historial[i].tema, tema) == 0) {
+            primero = historial[i].seq;
+        }
+    }
+    return primero;
+}
+
+/** seq_actual - Último seq asignado al tema (0 si nunca se publicó) */
+unsigned int seq_actual(const char *tema) {
+    int id = tema_buscar(&temas, tema);
+    return id >= 0 ? COLUMNA(seq_tema, unsigned int, id) : 0;
+}
+
+/**
+ * buscar_suscripcion - Índice de la suscripción (tema, addr) o -1
+ *
+ * Con "$grupo/g/T" se busca addr entre los miembros del grupo (cada uno
+ * está suscrito a su tema interno, ver GRUPOS DE CONSUMIDORES).
+ */
+int buscar_suscripcion(const char *tema, struct sockaddr_in addr) {
+    if (grupo_tema(tema) != NULL && !es_miembro(tema)) return buscar_miembro(tema, addr);
+    int id = tema_buscar(&temas, tema);
+    if (id < 0) return -1;
+    for (int i = columna_proximo(&subs.tema, num_subs, (unsigned int)id, 0); i >= 0;
+         i = columna_proximo(&subs.tema, num_subs, (unsigned int)id, i + 1)) {
+        if (SUB_IP(i) == addr.sin_addr.s_addr && SUB_PUERTO(i) == addr.sin_port) return i;
+    }
+    return -1;
+}
+
 /**
  * agregar_suscripcion - Registra un nuevo suscriptor para un tema
  * 
@@ -292,6 +428,9 @@ int buscar_en_historial(unsigned int seq, char *tema_out, char *mensaje_out) {
  * Nota: Si un subscriber se suscribe a múltiples temas, aparecerá
  * múltiples veces en el array (una por cada tema).
  * 
+ * Con "$grupo/g/T" la suscripción queda en el tema interno de un miembro
+ * nuevo ("$grupo/g/T:n") y el miembro se suma al grupo.
+ * 
  * Parámetros:
  *   @param tema: Tema al que se suscribe
  *   @param addr: Dirección IP y puerto del subscriber
@@ -301,19 +440,34 @@ int buscar_en_historial(unsigned int seq, char *tema_out, char *mensaje_out) {
  *     - "Colombia vs Argentina"
  *     - "Brasil vs Uruguay"
  *   
- *   Resultado en array suscriptores[]:
- *     [0] tema="Colombia vs Argentina" addr=192.168.1.100:5000
- *     [1] tema="Brasil vs Uruguay"     addr=192.168.1.100:5000
+ *   Resultado en las columnas de subs (temas: 0 = Colombia, 1 = Brasil):
+ *     [0] tema=0 ip:puerto=192.168.1.100:5000
+ *     [1] tema=1 ip:puerto=192.168.1.100:5000
  */
 void agregar_suscripcion(char *tema, struct sockaddr_in addr) {
-    if (num_subs < MAX_SUBS) {
-        strcpy(suscriptores[num_subs].tema, tema);
-        suscriptores[num_subs].addr = addr;
-        num_subs++;
-        printf("[+] Suscriptor agregado para tema: %s\n", tema);
-    } else {
-        printf("[!] ERROR: Máximo de suscriptores alcanzado (%d)\n", MAX_SUBS);
+    char miembro[TABLA_MAX_TEMA];
+    const char *nombre = grupo_tema(tema) != NULL ? nombre_miembro(tema, miembro) : tema;
+    int id = nombre != NULL ? tema_id(nombre) : -1;
+    int i = num_subs;
+    if (id < 0 || columna_asegurar(&subs.tema, i + 1) != 0 || columna_asegurar(&subs.ip, i + 1) != 0 ||
+        columna_asegurar(&subs.puerto, i + 1) != 0 || columna_asegurar(&subs.reproducir, i + 1) != 0 ||
+        columna_asegurar(&subs.visto_ms, i + 1) != 0 || columna_asegurar(&subs.alias, i + 1) != 0 ||
+        columna_asegurar(&subs.limite, i + 1) != 0 || columna_asegurar(&subs.confirmado, i + 1) != 0) {
+        printf("[!] ERROR: No se pudo agregar el suscriptor de '%.49s' (tema inválido, grupo lleno o sin memoria)\n", tema);
+        return;
     }
+    SUB_TEMA(i) = (unsigned int)id;
+    SUB_IP(i) = addr.sin_addr.s_addr;
+    SUB_PUERTO(i) = addr.sin_port;
+    SUB_REPRODUCIR(i) = 0;
+    SUB_VISTO(i) = reloj_ms();
+    SUB_ALIAS(i) = 0;
+    SUB_LIMITE(i) = 0;
+    SUB_CONFIRMADO(i) = 0;
+    num_subs++;
+    if (grupo_tema(nombre) != NULL) unirse_grupo(id);
+    replica_registrar('S', 0, nombre, "", &addr);
+    printf("[+] Suscriptor agregado para tema: %s\n", nombre);
 }
 
 /**
@@ -326,8 +480,11 @@ void agregar_suscripcion(char *tema, struct sockaddr_in addr) {
  *   2. Guardar mensaje en historial (para posible retransmisión)
  *   3. Iterar sobre todos los suscriptores
  *   4. Para cada suscriptor del tema correspondiente:
- *      a. Crear paquete tipo 'P' con seq y "tema:mensaje"
- *      b. Enviar por UDP al suscriptor
+ *      a. Crear paquete tipo 'P' con seq y "tema:mensaje" (o "#id:mensaje"
+ *         si negoció un alias para el tema)
+ *      b. Enviar por UDP al suscriptor, solo los bytes útiles
+ *   5. Para cada grupo de consumidores del tema, publicar otra vez en el
+ *      tema interno del miembro elegido (que sale como "$grupo/g/T")
  * 
  * Formato del paquete enviado:
  *   pkt.seq = <número de secuencia del tema>
@@ -362,230 +519,2789 @@ void publicar(SOCKET sock, char *tema, char *mensaje) {
     // 1. Obtener secuencia específica para este tema
     //    (Colombia seq=1, Brasil seq=1 son independientes)
     unsigned int seq_actual = obtener_siguiente_seq(tema);
+    if (seq_actual == 0) {
+        printf("[!] ERROR: Tema inválido (máximo %d caracteres)\n", TABLA_MAX_TEMA - 1);
+        return;
+    }
+    unsigned int id = (unsigned int)tema_buscar(&temas, tema);
+    char en_red[TABLA_MAX_TEMA];
+    const char *nombre = nombre_en_red(tema, en_red);         // Miembro de un grupo: "$grupo/g/T"
+    const char *clase = grupo_tema(nombre) != NULL ? grupo_tema(nombre) : tema;   // Prioridad del tema real
     
     // 2. Guardar en historial para retransmisión futura
     guardar_historial(seq_actual, tema, mensaje);
-    
-    // 3. Enviar a todos los suscriptores del tema
-    for (int i = 0; i < num_subs; i++) {
-        // Verificar si este suscriptor está suscrito a este tema
-        if (strcmp(suscriptores[i].tema, tema) == 0) {
+    replica_registrar('P', seq_actual, tema, mensaje, NULL);   // Al seguidor, si hay
+    retener(tema, seq_actual, mensaje);
+    if (nombre == tema) publicar_local(tema, seq_actual, mensaje);   // Subscribers de esta máquina
+
+    // 3. Enviar a todos los suscriptores del tema: solo se recorre la
+    //    columna de ids de tema, el resto de la fila se lee si coincide
+    for (int i = columna_proximo(&subs.tema, num_subs, id, 0); i >= 0;
+         i = columna_proximo(&subs.tema, num_subs, id, i + 1)) {
+        // Si se está poniendo al día o se quedó sin crédito, este seq le
+        // llegará en la reproducción
+        if (SUB_REPRODUCIR(i) == 0 && !sin_credito(i, seq_actual)) {
             // Crear paquete QUIC
             pkt.seq = seq_actual;  // Secuencia específica del tema
             pkt.tipo = 'P';        // Publicación
             
             // Incluir tema en el mensaje: "tema:contenido"
             // Esto permite al subscriber identificar y filtrar mensajes
-            sprintf(pkt.mensaje, "%s:%s", tema, mensaje);
-            
-            // Enviar por UDP (sin confirmación en esta etapa)
-            sendto(sock, (char*)&pkt, sizeof(Paquete), 0,
-                   (struct sockaddr*)&suscriptores[i].addr, 
-                   sizeof(suscriptores[i].addr));
+            // (con alias basta el número: "#id:contenido")
+            if (SUB_ALIAS(i) != 0) {
+                snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%c%u:%s", ALIAS_PREFIJO, SUB_ALIAS(i), mensaje);
+            } else {
+                snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%.49s:%s", nombre, mensaje);
+            }
             
+            // Enviar por UDP (sin confirmación en esta etapa), pasando por
+            // la cola de salida con la prioridad del tema
+            struct sockaddr_in addr = sub_addr(i);
+            encolar_salida(sock, clase, &pkt, paquete_tam(&pkt), &addr);
+
             printf("[->] Enviado seq=%u a suscriptor de '%s'\n", pkt.seq, tema);
         }
     }
+
+    // 4. Un miembro de cada grupo del tema
+    repartir_en_grupos(sock, id, mensaje, 1);
 }
 
 // ============================================================================
-// FUNCIÓN PRINCIPAL
+// CALIDAD DE SERVICIO (QoS) POR TEMA
 // ============================================================================
+//
+// No todos los temas necesitan la misma garantía. La telemetría de alta
+// frecuencia (posición del balón, ritmo cardíaco) no justifica secuencia,
+// historial y un ACK por mensaje y por subscriber. Cada tema tiene un nivel,
+// configurado al iniciar el broker (--qos nivel:tema, por defecto 1):
+//
+//   QOS 0 - A lo sumo una vez: camino rápido. Sin seq, sin historial, sin
+//           estado retenido, sin réplica. El paquete se arma UNA vez y se
+//           envía como 'D' a cada subscriber, que no responde con ACK.
+//   QOS 1 - Al menos una vez: el camino normal (seq por tema, historial,
+//           'R' y ACK del subscriber). Si el publisher reintenta un lote
+//           cuyo ACK se perdió, sus mensajes se publican otra vez.
+//   QOS 2 - Exactamente una vez: como QoS 1, pero el broker recuerda los
+//           últimos lotes de cada publisher (dirección + seq del lote) y no
+//           vuelve a publicar los de un lote repetido; solo reenvía el ACK.
+//           Del lado del subscriber los duplicados ya se descartan por seq.
+// ============================================================================
+
+#define QOS_DEFECTO        1
+#define LOTES_RECORDADOS   256      // Lotes de publishers recordados para QoS 2
+
+typedef struct {
+    struct sockaddr_in origen;
+    unsigned int seq;
+} LoteVisto;
+
+// Los ids de temas son de cada hilo: los temas con --qos se internan en
+// su propia tabla (se llena al iniciar y después solo se lee)
+TablaTemas temas_qos;
+Columna niveles_qos;                 // unsigned char: nivel por id de temas_qos
+POR_HILO LoteVisto lotes_vistos[LOTES_RECORDADOS];
+POR_HILO int lotes_index = 0;
+
+/** fijar_qos - Configura el nivel de un tema ("--qos 0:Telemetria") */
+int fijar_qos(const char *arg) {
+    int nivel = arg[0] - '0';
+    if (nivel < 0 || nivel > 2 || arg[1] != ':' || arg[2] == '\0') return -1;
+    if (niveles_qos.tam == 0) {          // Primer --qos
+        temas_iniciar(&temas_qos);
+        columna_iniciar(&niveles_qos, sizeof(unsigned char));
+    }
+    int id = tema_internar(&temas_qos, arg + 2);
+    if (id < 0 || columna_asegurar(&niveles_qos, id + 1) != 0) return -1;
+    COLUMNA(niveles_qos, unsigned char, id) = (unsigned char)nivel;
+    return 0;
+}
+
+/** qos_de - Nivel de QoS del tema */
+int qos_de(const char *tema) {
+    int id = tema_buscar(&temas_qos, tema);
+    return id >= 0 ? COLUMNA(niveles_qos, unsigned char, id) : QOS_DEFECTO;
+}
 
 /**
- * main - Punto de entrada del broker QUIC
- * 
- * Ciclo principal del broker:
- *   1. Inicializar socket UDP en puerto 7000
- *   2. Escuchar mensajes indefinidamente
- *   3. Procesar según tipo de paquete:
- *      - 'S': Agregar suscripción y enviar ACK
- *      - 'P': Distribuir publicación y enviar ACK
- *      - 'R': Buscar en historial y retransmitir si corresponde
- *      - 'A': Ignorar (ACKs de subscribers)
- * 
- * Tipos de paquetes manejados:
- *   
- *   TIPO 'S' - SUSCRIPCIÓN:
- *     Subscriber → Broker
- *     pkt.mensaje = "Colombia vs Argentina"
- *     Acción: agregar_suscripcion() y enviar ACK
- *   
- *   TIPO 'P' - PUBLICACIÓN:
- *     Publisher → Broker
- *     pkt.mensaje = "Colombia vs Argentina:Gol"
- *     Acción: publicar() a suscriptores y enviar ACK
- *   
- *   TIPO 'R' - RETRANSMISIÓN:
- *     Subscriber → Broker
- *     pkt.seq = 5 (mensaje perdido)
- *     pkt.mensaje = "Colombia vs Argentina" (tema esperado)
- *     Acción: buscar seq=5 en historial, verificar tema, retransmitir
- *   
- *   TIPO 'A' - ACK:
- *     Subscriber → Broker (confirmación)
- *     Acción: ignorar (no requiere respuesta)
- * 
- * Retorna:
- *   0 en operación normal (nunca sale del bucle while)
+ * lote_repetido - Registra el lote (origen, seq) y dice si ya se había visto
+ *
+ * Solo se consulta si el lote trae algún tema QoS 2.
  */
-int main() {
-int main() {
-    // Variables locales
-    WSADATA wsa;                    // Datos de inicialización de Winsock
-    SOCKET sock;                    // Socket UDP del broker
-    struct sockaddr_in servidor, cliente;  // Direcciones de red
-    Paquete pkt, ack;              // Paquetes de entrada y salida
-    int tam_cliente = sizeof(cliente);
-    
-    // Inicializar Winsock (requerido en Windows para sockets)
-    WSAStartup(MAKEWORD(2,2), &wsa);
-    
-    // Crear socket UDP (SOCK_DGRAM)
-    // QUIC trabaja sobre UDP para evitar el handshake de TCP
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    
-    // Configurar dirección del servidor
-    servidor.sin_family = AF_INET;
-    servidor.sin_addr.s_addr = INADDR_ANY;  // Escuchar en todas las interfaces
-    servidor.sin_port = htons(PUERTO);       // Puerto 7000
-    
-    // Enlazar socket al puerto
-    bind(sock, (struct sockaddr*)&servidor, sizeof(servidor));
-    
-    printf("=== BROKER QUIC ===\n");
-    printf("Puerto: %d (UDP)\n", PUERTO);
-    printf("Esperando mensajes...\n\n");
-    
-    // ========================================================================
-    // BUCLE PRINCIPAL - Procesar mensajes indefinidamente
-    // ========================================================================
-    while (1) {
-        // Recibir paquete UDP (bloqueante)
-        // recvfrom() espera hasta que llegue un paquete
-        int bytes = recvfrom(sock, (char*)&pkt, sizeof(Paquete), 0,
-                            (struct sockaddr*)&cliente, &tam_cliente);
-        
-        if (bytes > 0) {
-            printf("\n[RX] Tipo='%c' Seq=%u\n", pkt.tipo, pkt.seq);
-            
-            // ================================================================
-            // CASO 1: SUSCRIPCIÓN (tipo 'S')
-            // ================================================================
-            // Subscriber envía: pkt.mensaje = "Colombia vs Argentina"
-            // Acción: Agregar a lista de suscriptores y confirmar con ACK
-            if (pkt.tipo == 'S') {
-                printf("     Suscripción a: %s\n", pkt.mensaje);
-                
-                // Registrar suscriptor en la lista
-                agregar_suscripcion(pkt.mensaje, cliente);
-                
-                // Enviar ACK de confirmación
-                ack.seq = pkt.seq;  // Eco del seq recibido
-                ack.tipo = 'A';
-                strcpy(ack.mensaje, "OK");
-                sendto(sock, (char*)&ack, sizeof(Paquete), 0,
-                       (struct sockaddr*)&cliente, tam_cliente);
-                printf("[<-] ACK enviado\n");
-                
-            // ================================================================
-            // CASO 2: PUBLICACIÓN (tipo 'P')
-            // ================================================================
-            // Publisher envía: pkt.mensaje = "TEMA:contenido"
-            // Acción: Distribuir a suscriptores del tema y confirmar con ACK
-            } else if (pkt.tipo == 'P') {
-                // Parsear mensaje: formato "TEMA:contenido"
-                char *tema = strtok(pkt.mensaje, ":");  // Extraer tema
-                char *msg = strtok(NULL, "");           // Extraer contenido
-                
-                if (tema && msg) {
-                    printf("     Publicación: tema='%s' msg='%s'\n", tema, msg);
-                    
-                    // Distribuir mensaje a todos los suscriptores del tema
-                    publicar(sock, tema, msg);
-                    
-                    // Enviar ACK al publisher para confirmar recepción
-                    ack.seq = pkt.seq;  // Eco del seq del publisher
-                    ack.tipo = 'A';
-                    strcpy(ack.mensaje, "OK");
-                    sendto(sock, (char*)&ack, sizeof(Paquete), 0,
-                           (struct sockaddr*)&cliente, tam_cliente);
-                    printf("[<-] ACK enviado\n");
-                } else {
-                    printf("[!] ERROR: Formato incorrecto de publicación\n");
-                }
-                
-            // ================================================================
-            // CASO 3: RETRANSMISIÓN (tipo 'R')
-            // ================================================================
-            // Subscriber envía:
-            //   pkt.seq = 5 (mensaje perdido)
-            //   pkt.mensaje = "Colombia vs Argentina" (tema esperado)
-            // Acción: Buscar seq=5 en historial, verificar tema, retransmitir
-            } else if (pkt.tipo == 'R') {
-                unsigned int seq_solicitado = pkt.seq;
-                char tema_solicitado[50];
-                strcpy(tema_solicitado, pkt.mensaje);  // Tema esperado por subscriber
-                
-                printf("     Solicitud de retransmisión: seq=%u tema='%s'\n", 
-                       seq_solicitado, tema_solicitado);
-                
-                char tema_retrans[50];
-                char msg_retrans[500];
-                
-                // Buscar mensaje en historial por seq
-                if (buscar_en_historial(seq_solicitado, tema_retrans, msg_retrans)) {
-                    // Mensaje encontrado en historial
-                    
-                    // VERIFICACIÓN CRÍTICA: El tema debe coincidir
-                    // Evita enviar "Brasil:Gol" a subscriber de "Colombia"
-                    if (strcmp(tema_retrans, tema_solicitado) == 0) {
-                        // Tema correcto: verificar que el subscriber está suscrito
-                        for (int i = 0; i < num_subs; i++) {
-                            // Verificar: mismo tema + misma IP + mismo puerto
-                            if (strcmp(suscriptores[i].tema, tema_retrans) == 0 &&
-                                cliente.sin_addr.s_addr == suscriptores[i].addr.sin_addr.s_addr &&
-                                cliente.sin_port == suscriptores[i].addr.sin_port) {
-                                
-                                // Crear paquete de retransmisión
-                                Paquete retrans;
-                                retrans.seq = seq_solicitado;  // Mismo seq del mensaje original
-                                retrans.tipo = 'P';             // Enviarlo como publicación normal
-                                sprintf(retrans.mensaje, "%s:%s", tema_retrans, msg_retrans);
-                                
-                                // Reenviar mensaje
-                                sendto(sock, (char*)&retrans, sizeof(Paquete), 0,
-                                       (struct sockaddr*)&cliente, sizeof(cliente));
-                                
-                                printf("[->] RETRANSMITIDO seq=%u de tema '%s' a suscriptor\n", 
-                                       seq_solicitado, tema_retrans);
-                                break;
-                            }
-                        }
-                    } else {
-                        // Tema incorrecto: no retransmitir
-                        printf("[!] seq=%u es de tema '%s', pero se solicitó tema '%s' - ignorando\n", 
-                               seq_solicitado, tema_retrans, tema_solicitado);
-                    }
-                } else {
-                    // Mensaje no encontrado en historial (muy antiguo o nunca existió)
-                    printf("[!] Mensaje seq=%u no encontrado en historial\n", seq_solicitado);
-                }
-                
-            // ================================================================
-            // CASO 4: ACK (tipo 'A')
-            // ================================================================
-            // Subscribers pueden enviar ACKs, pero el broker no los necesita
-            } else if (pkt.tipo == 'A') {
-                // Ignorar ACKs de subscribers
-                // (solo registrar en log si se desea)
+int lote_repetido(const struct sockaddr_in *origen, unsigned int seq) {
+    for (int i = 0; i < LOTES_RECORDADOS; i++) {
+        LoteVisto *l = &lotes_vistos[i];
+        if (l->seq == seq && l->origen.sin_port == origen->sin_port &&
+            l->origen.sin_addr.s_addr == origen->sin_addr.s_addr) {
+            return 1;
+        }
+    }
+    lotes_vistos[lotes_index].origen = *origen;
+    lotes_vistos[lotes_index].seq = seq;
+    lotes_index = (lotes_index + 1) % LOTES_RECORDADOS;
+    return 0;
+}
+
+/**
+ * publicar_sin_garantias - Camino rápido de QoS 0
+ *
+ * El paquete se arma una sola vez y se envía compacto a cada subscriber:
+ * nada de secuencia, historial, réplica ni log por envío.
+ */
+void publicar_sin_garantias(SOCKET sock, const char *tema, const char *mensaje) {
+    Paquete pkt;
+    pkt.seq = 0;
+    pkt.tipo = PKT_DATAGRAMA;
+    snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%.49s:%s", tema, mensaje);
+    int tam = paquete_tam(&pkt);
+    publicar_local(tema, 0, mensaje);
+
+    int id = tema_buscar(&temas, tema);
+    if (id < 0) return;   // Nadie se suscribió nunca
+    for (int i = columna_proximo(&subs.tema, num_subs, (unsigned int)id, 0); i >= 0;
+         i = columna_proximo(&subs.tema, num_subs, (unsigned int)id, i + 1)) {
+        struct sockaddr_in addr = sub_addr(i);
+        encolar_salida(sock, tema, &pkt, tam, &addr);
+    }
+    repartir_en_grupos(sock, (unsigned int)id, mensaje, 0);
+}
+
+// ============================================================================
+// PRIORIDAD DE SALIDA
+// ============================================================================
+//
+// Las publicaciones se enviaban en el orden en que llegaban: un gol que
+// entraba detrás de una ráfaga de telemetría esperaba a que salieran todos
+// esos envíos. Ahora publicar() no llama a sendto() sino que encola el
+// paquete con la clase de su tema (--prioridad clase:tema; 0 = alta,
+// 1 = normal por defecto, 2 = baja) y el bucle principal vacía la cola
+// después de leer todos los datagramas disponibles:
+//
+//   - Clase alta: prioridad estricta, sale primero.
+//   - Normal y baja: turnos ponderados (WFQ, 4 a 1 en bytes), así la baja
+//     absorbe la espera bajo sobrecarga sin quedarse sin salir.
+//   - Si el buffer de envío del socket se llena, lo que falta espera en la
+//     cola (select con escritura) en lugar de perderse en sendto(). Una
+//     clase llena descarta lo nuevo; el subscriber lo recupera con 'R'.
+//   - En Linux, una tanda de paquetes al mismo subscriber sale con un solo
+//     sendmsg() GSO (udp_lotes.h), y la recepción acepta GRO.
+//
+// La cola es una sola para el socket (el buffer de envío es el único punto
+// donde los envíos UDP se acumulan) y guarda el destino de cada paquete.
+// El orden dentro de un tema se mantiene: un tema tiene una sola clase.
+// Retransmisiones, reproducciones, estado retenido y ACKs salen directo.
+// ============================================================================
+
+#define COLA_SALIDA  512              // Paquetes por clase
+
+POR_HILO Planificador salida;
+atomic_int usar_gso = 0;              // Envío GSO disponible y habilitado (--gso 0 lo apaga); lo
+                                      // apaga cualquier hilo de trabajo al que el kernel se lo rechace
+
+/**
+ * vaciar_salida - Envía lo encolado por prioridad hasta vaciar o llenar el socket
+ *
+ * Con GSO, los paquetes de turno que van al mismo subscriber con el mismo
+ * tamaño (ej: una ráfaga de un tema) salen en un solo sendmsg(). Si el
+ * kernel o la placa de red lo rechazan, se apaga GSO y se sigue de a uno.
+ */
+void vaciar_salida(SOCKET sock) {
+    PlanMensaje *lote[UDP_MAX_SEGMENTOS];
+    int n;
+    while ((n = plan_juntar(&salida, lote, atomic_load(&usar_gso) ? UDP_MAX_SEGMENTOS : 1, UDP_MAX_LOTE)) > 0) {
+        if (n > 1) {
+            if (udp_enviar_lote(sock, lote, n) == 0) {
+                plan_enviados(&salida, lote, n);
+                continue;
+            }
+            if (red_reintentar()) return;
+            if (udp_gso_no_soportado() && atomic_exchange(&usar_gso, 0)) {
+                printf("[gso] Envío GSO rechazado: se envía un datagrama por llamada\n");
+            }
+        }
+        if (sendto(sock, lote[0]->datos, lote[0]->largo, 0, (struct sockaddr*)&lote[0]->destino,
+                   sizeof(lote[0]->destino)) < 0 && red_reintentar()) {
+            return;   // Buffer lleno: sigue cuando select() indique escritura
+        }
+        plan_enviado(&salida);
+    }
+}
+
+/**
+ * encolar_salida - Encola un paquete de publicación para destino
+ *
+ * Si la clase del tema está llena primero se envía lo que haya; si aun así
+ * no entra, el paquete se descarta (se avisa cada 100 descartes).
+ */
+void encolar_salida(SOCKET sock, const char *tema, const Paquete *pkt, int tam,
+                    const struct sockaddr_in *destino) {
+    int clase = plan_clase_tema(tema);
+    if (salida.cantidad[clase] == salida.capacidad) vaciar_salida(sock);
+    if (plan_encolar(&salida, clase, pkt, tam, destino) != 0 && salida.descartados[clase] % 100 == 1) {
+        printf("[prioridad] Cola de clase %d llena: %lu paquetes descartados\n",
+               clase, salida.descartados[clase]);
+    }
+}
+
+// ============================================================================
+// HILOS DE TRABAJO (--hilos N)
+// ============================================================================
+//
+// Por defecto todo corre en el hilo de main(). Con --hilos N ese hilo solo
+// recibe: mira el tema de cada paquete y lo pasa por un Anillo (cola de un
+// productor y un consumidor sin bloqueo, hilos.h) al hilo dueño del tema,
+// hash(tema) % N.
+//
+// El estado por tema (temas, secuencias, historial, suscripciones,
+// retenidos, reproducciones, lotes QoS 2 y cola de salida) es POR_HILO:
+// cada hilo tiene su copia y solo ve sus temas, así que no hay cerrojos y
+// dentro de un tema todo se procesa en orden de llegada. Cada hilo envía
+// por el mismo socket UDP.
+//
+//   'S', 'R', 'U', 'T' y créditos ('A') -> al dueño del tema
+//   'H' (latido)                        -> a todos (renuevan lo suyo)
+//   'P' (lote)                          -> si sus temas son de varios
+//       hilos se parte en sub-lotes; el último hilo que termina envía el
+//       ACK, y solo si todas las partes se publicaron (Reparto)
+//
+// Los alias se numeran alias_base + id * N + hilo: el número ya dice a qué
+// hilo va. Si la cola de un hilo está llena el paquete se descarta sin ACK
+// y el cliente lo reintenta. No se combina con --cluster ni con la
+// replicación, que necesitan ver el estado de todos los temas.
+// ============================================================================
+
+#define MAX_HILOS   64
+#define COLA_HILO   1024              // Paquetes esperando por hilo (potencia de 2)
+
+typedef struct {
+    atomic_int pendientes;            // Partes del lote sin procesar
+    atomic_int publicadas;
+    atomic_int fallidas;
+} Reparto;
+
+typedef struct {
+    Paquete pkt;
+    struct sockaddr_in cliente;
+    Reparto *reparto;                 // NULL si el paquete llegó entero
+} Trabajo;
+
+int num_hilos = 0;                    // 0 = todo en el hilo de main()
+Anillo colas_hilos[MAX_HILOS];        // Entrada de cada hilo de trabajo
+POR_HILO int hilo_propio = 0;         // Índice del hilo de trabajo actual
+
+// ============================================================================
+// ALIAS NUMÉRICOS DE TEMA
+// ============================================================================
+//
+// Cada publicación llevaba el nombre completo del tema en las dos
+// direcciones, y "Colombia vs Argentina" suele ser más largo que el evento.
+// Con un 'T' el cliente pide un alias para el tema y después escribe
+// "#id:contenido"; el broker resuelve el id con un acceso directo a la
+// tabla de temas en lugar de comparar el texto.
+//
+//   id = alias_base + id del tema internado en temas
+//        (con --hilos N: alias_base + id * N + hilo dueño del tema)
+//
+// alias_base se elige al azar al arrancar (y se replica al seguidor): si el
+// broker se reinicia, los ids viejos de un cliente caen casi seguro fuera de
+// rango en lugar de apuntar a otro tema. Un id desconocido no se publica ni
+// se confirma; el broker avisa con 'T' seq = 0 "#id" para que el cliente
+// olvide sus alias y reenvíe con el texto.
+//
+// En modo cluster los alias son del nodo que atiende al cliente: sirven para
+// cualquier tema al publicar, pero solo los temas propios del nodo llegan
+// con alias a los subscribers.
+// ============================================================================
+
+unsigned int alias_base = 1;
+
+/**
+ * alias_de - Id del tema (lo interna con seq 0 si es nuevo)
+ *
+ * Retorna 0 si el tema no es válido o no hay memoria.
+ */
+unsigned int alias_de(const char *tema) {
+    if (tema[0] == '\0' || tema[0] == ALIAS_PREFIJO || strchr(tema, ':') != NULL) return 0;
+    int nuevos = temas.cantidad;
+    int id = tema_id(tema);
+    if (id < 0) return 0;
+    if (temas.cantidad != nuevos) {
+        replica_registrar('Q', 0, tema, "", NULL);   // El seguidor mantiene los mismos ids
+    }
+    unsigned int paso = num_hilos > 0 ? (unsigned int)num_hilos : 1;
+    return alias_base + (unsigned int)id * paso + (unsigned int)hilo_propio;
+}
+
+/** tema_de_alias - Tema de "#id", o NULL si el id no existe */
+const char *tema_de_alias(const char *texto) {
+    char *fin;
+    unsigned long id = strtoul(texto + 1, &fin, 10);
+    unsigned long paso = num_hilos > 0 ? (unsigned long)num_hilos : 1;
+    if (*fin != '\0' || id < alias_base || (id - alias_base) % paso != (unsigned long)hilo_propio) return NULL;
+    id = (id - alias_base) / paso;
+    if (id >= (unsigned long)temas.cantidad) return NULL;
+    return tema_nombre(&temas, (int)id);
+}
+
+// ============================================================================
+// REANUDACIÓN - Suscripciones que retoman desde un seq
+// ============================================================================
+//
+// Un subscriber que se reinicia (o que perdió muchos paquetes por un corte
+// de red) envía 'S' con "tema:ultimo_seq". En lugar de que pida cada hueco
+// con un 'R' por mensaje, el broker:
+//   1. Confirma con "OK:<primer seq que va a reenviar>". Si el historial ya
+//      no tiene los más viejos, el subscriber sabe desde dónde sigue.
+//   2. Reenvía el rango faltante desde el historial en lotes de
+//      LOTE_REPRODUCCION cada PAUSA_REPRODUCCION_MS, sin saturar al
+//      subscriber ni a la red.
+//   3. Mientras tanto publicar() no le envía ese tema en vivo; cuando la
+//      reproducción alcanza el último seq del tema pasa a vivo. Como todo
+//      ocurre en el mismo hilo, no hay duplicados ni huecos en el cambio.
+// ============================================================================
+
+#define LOTE_REPRODUCCION      32
+#define PAUSA_REPRODUCCION_MS  2
+
+POR_HILO int reproducciones_activas = 0;      // Suscriptores con reproducir != 0
+POR_HILO unsigned long long ultima_reproduccion_ms = 0;
+
+/**
+ * iniciar_reproduccion - Prepara el reenvío de lo publicado después de desde
+ *
+ * Retorna el primer seq que recibirá el subscriber (el último del tema + 1
+ * si no hay nada que reproducir).
+ */
+unsigned int iniciar_reproduccion(int idx, unsigned int desde) {
+    const char *tema = sub_tema(idx);
+    unsigned int actual = COLUMNA(seq_tema, unsigned int, SUB_TEMA(idx));
+    unsigned int primero = desde < actual ? primer_seq_en_historial(tema, desde) : 0;
+
+    if (primero == 0) {
+        // Al día (o el historial ya no tiene nada de ese rango): en vivo
+        if (SUB_REPRODUCIR(idx) != 0) reproducciones_activas--;
+        SUB_REPRODUCIR(idx) = 0;
+        return actual + 1;
+    }
+    if (SUB_REPRODUCIR(idx) == 0) reproducciones_activas++;
+    SUB_REPRODUCIR(idx) = primero;
+    printf("[reanudar] Reenviando '%s' desde seq=%u hasta seq=%u\n", tema, primero, actual);
+    return primero;
+}
+
+/**
+ * avanzar_reproducciones - Envía el próximo lote a cada subscriber que se
+ * está poniendo al día (se llama en cada vuelta del bucle principal)
+ */
+void avanzar_reproducciones(SOCKET sock) {
+    if (reproducciones_activas == 0) return;
+    unsigned long long ahora = reloj_ms();
+    if (ahora - ultima_reproduccion_ms < PAUSA_REPRODUCCION_MS) return;
+    ultima_reproduccion_ms = ahora;
+
+    for (int i = 0; i < num_subs; i++) {
+        unsigned int *reproducir = &SUB_REPRODUCIR(i);
+        unsigned int *limite = &SUB_LIMITE(i);
+        if (*reproducir == 0) continue;
+
+        const char *tema = sub_tema(i);
+        char en_red[TABLA_MAX_TEMA];
+        const char *nombre = nombre_en_red(tema, en_red);
+        struct sockaddr_in addr = sub_addr(i);
+        unsigned int actual = COLUMNA(seq_tema, unsigned int, SUB_TEMA(i));
+        char msg[500];
+        Paquete pkt;
+        for (int enviados = 0; enviados < LOTE_REPRODUCCION && *reproducir <= actual &&
+                               (*limite == 0 || *reproducir <= *limite); ) {
+            if (!buscar_en_historial(*reproducir, tema, msg)) {
+                // Ya se sobrescribió: saltar al siguiente que siga guardado.
+                // Lo descartado no consume crédito (el subscriber nunca lo
+                // recibe y no podría ampliar el límite por encima del salto)
+                unsigned int siguiente = primer_seq_en_historial(tema, *reproducir);
+                if (siguiente == 0) siguiente = actual + 1;
+                if (*limite != 0) *limite += siguiente - *reproducir;
+                *reproducir = siguiente;
+                continue;
             }
+            pkt.seq = *reproducir;
+            pkt.tipo = 'P';
+            snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%.49s:%s", nombre, msg);
+            sendto(sock, (char*)&pkt, paquete_tam(&pkt), 0,
+                   (struct sockaddr*)&addr, sizeof(addr));
+            (*reproducir)++;
+            enviados++;
+        }
+
+        if (*reproducir > actual) {
+            *reproducir = 0;
+            reproducciones_activas--;
+            printf("[reanudar] Suscriptor de '%s' al día: pasa a vivo en seq=%u\n", tema, actual + 1);
         }
     }
+}
+
+// ============================================================================
+// CONTROL DE FLUJO POR CRÉDITOS
+// ============================================================================
+//
+// Una ráfaga que el subscriber no alcanza a leer la descarta el kernel en
+// silencio, y después cada mensaje perdido vuelve a pedirse con 'R'. Con
+// créditos el subscriber dice cuánto puede absorber:
+//
+//   - Cada ACK del subscriber lleva "tema:limite" (o "#id:limite"): el
+//     mayor seq del tema que acepta recibir. Es acumulativo, así que un ACK
+//     perdido o desordenado no descuenta crédito; el siguiente lo corrige.
+//   - Al confirmarse la suscripción envía un ACK con seq 0 que solo otorga
+//     crédito. Si pasa un rato sin recibir nada reanuda desde su último seq
+//     (por si el último ACK o el final de la ráfaga se perdieron).
+//   - Cuando publicar() llega a un seq > limite, el subscriber queda en
+//     pausa: se marca su reproducir en ese seq y no se le envía nada más en
+//     vivo. Lo pendiente queda en el historial, no en una cola propia.
+//   - avanzar_reproducciones() le envía desde el historial hasta su limite;
+//     al alcanzar el último seq del tema vuelve a vivo. Si el historial ya
+//     sobrescribió algo, se salta (el broker descarta en lugar de crecer).
+//
+// limite = 0 (subscriber sin créditos, o recién tomado por el seguidor de
+// réplica hasta su próximo ACK) mantiene el envío sin control.
+//
+// ACKs acumulados: el subscriber ya no confirma cada mensaje. Un 'A' trae
+// una línea por tema, "token:limite:acumulado[:mapa]", y también puede
+// venir dentro de un latido 'H'. acumulado es el último seq que recibió en
+// orden; el mapa (hexadecimal, bit k = recibió acumulado + 2 + k) solo va
+// cuando pide huecos, y reemplaza a los 'R' de esos seq: se retransmiten
+// acumulado + 1 y los bits en 0 antes del último bit en 1.
+// ============================================================================
+
+/**
+ * sin_credito - ¿Se agotó el crédito de la suscripción idx antes de seq?
+ *
+ * Si es así la deja en pausa: el seq y los siguientes saldrán en la
+ * reproducción cuando llegue más crédito.
+ */
+int sin_credito(int idx, unsigned int seq) {
+    unsigned int limite = SUB_LIMITE(idx);
+    if (limite == 0 || seq <= limite) return 0;
+    if (SUB_REPRODUCIR(idx) == 0) reproducciones_activas++;
+    SUB_REPRODUCIR(idx) = seq;
+    printf("[credito] Suscriptor de '%s' sin crédito (limite=%u): en pausa desde seq=%u\n",
+           sub_tema(idx), limite, seq);
+    return 1;
+}
+
+/**
+ * retransmitir - Reenvía el seq del tema desde el historial al subscriber
+ *
+ * Solo si sigue suscrito (mismo tema + misma IP + mismo puerto). Retorna 1
+ * si se envió, 0 si no está en el historial o no es un subscriber del tema.
+ * Para "$grupo/g/T" el historial es el del tema interno del miembro.
+ */
+int retransmitir(SOCKET sock, const char *tema, unsigned int seq, struct sockaddr_in cliente) {
+    char msg_retrans[500];
     
-    // Limpieza (código inalcanzable en operación normal)
-    closesocket(sock);
-    WSACleanup();
-    return 0;
+    // Buscar mensaje en historial por seq Y tema
+    // (evita enviar "Brasil:Gol" a subscriber de "Colombia": ambos
+    // temas tienen su propio seq=5)
+    int idx = buscar_suscripcion(tema, cliente);
+    if (idx < 0 || !buscar_en_historial(seq, sub_tema(idx), msg_retrans)) return 0;
+    Paquete retrans;
+    retrans.seq = seq;           // Mismo seq del mensaje original
+    retrans.tipo = 'P';          // Enviarlo como publicación normal
+    snprintf(retrans.mensaje, sizeof(retrans.mensaje), "%.49s:%s", tema, msg_retrans);
+    sendto(sock, (char*)&retrans, paquete_tam(&retrans), 0,
+           (struct sockaddr*)&cliente, sizeof(cliente));
+    printf("[->] RETRANSMITIDO seq=%u de tema '%s' a suscriptor\n", seq, tema);
+    return 1;
+}
+
+/**
+ * otorgar_credito - Una línea de ACK: "token:limite[:acumulado[:mapa]]"
+ *
+ * token es el tema o "#id". Amplía el crédito y retransmite los huecos
+ * del mapa. Un ACK viejo con "OK" (sin crédito) no cambia nada.
+ */
+void otorgar_credito(SOCKET sock, const char *texto, struct sockaddr_in cliente) {
+    char tema[60];
+    unsigned int limite, acumulado, mapa;
+    int campos = sscanf(texto, "%59[^:\n]:%u:%u:%x", tema, &limite, &acumulado, &mapa);
+    if (campos < 2) return;
+    const char *nombre = tema[0] == ALIAS_PREFIJO ? tema_de_alias(tema) : tema;
+    int idx = nombre != NULL ? buscar_suscripcion(nombre, cliente) : -1;
+    if (idx < 0) return;
+    if (limite > SUB_LIMITE(idx)) SUB_LIMITE(idx) = limite;
+    if (campos >= 3 && acumulado > SUB_CONFIRMADO(idx)) SUB_CONFIRMADO(idx) = acumulado;
+    if (campos < 4 || mapa == 0) return;
+
+    // Huecos: acumulado + 1 y cada bit en 0 antes del último en 1
+    retransmitir(sock, nombre, acumulado + 1, cliente);
+    for (unsigned int k = 0; k < 32 && (mapa >> k) != 0; k++) {
+        if (!(mapa & (1u << k))) retransmitir(sock, nombre, acumulado + 2 + k, cliente);
+    }
+}
+
+/** procesar_acks - Todas las líneas de ACK de un 'A' (o de un latido 'H') */
+void procesar_acks(SOCKET sock, const char *texto, struct sockaddr_in cliente) {
+    while (texto != NULL && *texto != '\0') {
+        otorgar_credito(sock, texto, cliente);
+        texto = strchr(texto, '\n');
+        if (texto != NULL) texto++;
+    }
+}
+
+// ============================================================================
+// CICLO DE VIDA DE SUSCRIPCIONES - Baja, latidos y expiración
+// ============================================================================
+//
+// Un subscriber que se cierra sin avisar seguía en la tabla subs para
+// siempre y cada publicación se le seguía enviando. Ahora:
+//   - 'U' (baja) con el tema quita la suscripción de inmediato.
+//   - 'H' (latido) renueva todas las suscripciones de esa dirección; la
+//     librería cliente_sub lo envía cada 10 s. Un 'S' también renueva.
+//   - Cada segundo se quitan las que no tuvieron noticias en
+//     EXPIRACION_SUB_MS.
+// La baja se refleja en todos los lugares que guardan al suscriptor: la
+// lista, el contador de reproducciones activas y el seguidor de réplica.
+// ============================================================================
+
+#define EXPIRACION_SUB_MS   30000     // 3 latidos perdidos
+#define REVISION_SUB_MS     1000
+
+POR_HILO unsigned long long ultima_revision_ms = 0;
+
+/** quitar_suscripcion - Elimina la suscripción idx (la última ocupa su lugar) */
+void quitar_suscripcion(int idx) {
+    struct sockaddr_in addr = sub_addr(idx);
+    int ultimo = num_subs - 1;
+    replica_registrar('U', 0, sub_tema(idx), "", &addr);
+    if (SUB_REPRODUCIR(idx) != 0) reproducciones_activas--;
+    if (es_miembro(sub_tema(idx))) salir_grupo(idx);
+    SUB_TEMA(idx) = SUB_TEMA(ultimo);
+    SUB_IP(idx) = SUB_IP(ultimo);
+    SUB_PUERTO(idx) = SUB_PUERTO(ultimo);
+    SUB_REPRODUCIR(idx) = SUB_REPRODUCIR(ultimo);
+    SUB_VISTO(idx) = SUB_VISTO(ultimo);
+    SUB_ALIAS(idx) = SUB_ALIAS(ultimo);
+    SUB_LIMITE(idx) = SUB_LIMITE(ultimo);
+    SUB_CONFIRMADO(idx) = SUB_CONFIRMADO(ultimo);
+    num_subs--;
+}
+
+/** renovar_suscripciones - Latido: todas las suscripciones de addr siguen vivas */
+void renovar_suscripciones(struct sockaddr_in addr) {
+    unsigned long long ahora = reloj_ms();
+    for (int i = 0; i < num_subs; i++) {
+        if (SUB_IP(i) == addr.sin_addr.s_addr && SUB_PUERTO(i) == addr.sin_port) SUB_VISTO(i) = ahora;
+    }
+}
+
+/** expirar_suscripciones - Quita las suscripciones sin latidos recientes */
+void expirar_suscripciones(void) {
+    unsigned long long ahora = reloj_ms();
+    if (ahora - ultima_revision_ms < REVISION_SUB_MS) return;
+    ultima_revision_ms = ahora;
+
+    for (int i = 0; i < num_subs; ) {
+        if (ahora - SUB_VISTO(i) > EXPIRACION_SUB_MS) {
+            printf("[-] Suscriptor de '%s' expirado (sin latidos)\n", sub_tema(i));
+            quitar_suscripcion(i);
+        } else {
+            i++;
+        }
+    }
 }
+
+// ============================================================================
+// GRUPOS DE CONSUMIDORES - Suscripciones compartidas (ver grupos.h)
+// ============================================================================
+//
+// Un subscriber suscrito a "$grupo/g/T" es miembro del grupo g del tema T:
+// cada publicación de T va a un solo miembro. Para que cada miembro vea una
+// secuencia sin huecos (y 'R', ACKs, créditos y reanudación sigan igual)
+// cada miembro tiene su propio tema interno "$grupo/g/T:n":
+//
+//   - publicar(T) elige un miembro por grupo y vuelve a publicar el mensaje
+//     en el tema de ese miembro, con su seq y su lugar en el historial.
+//   - Al subscriber le llega con el nombre "$grupo/g/T" (nombre_en_red), y
+//     lo que envía con ese nombre se busca entre los miembros por dirección
+//     (buscar_suscripcion). Un ':' no puede venir de la red: el tema de un
+//     miembro no choca con ningún tema real.
+//   - Los fragmentos de un mensaje van al mismo miembro (el elegido por el
+//     hash del id del mensaje), cualquiera sea la política.
+//   - Un miembro que se da de baja o expira sale del grupo; lo que tenía
+//     sin confirmar y sigue en el historial se reparte entre los demás
+//     (rebalancear_grupos). Puede llegar dos veces: al menos una vez.
+//   - Un miembro que reanuda con otra dirección es un miembro nuevo, pero
+//     su secuencia arranca donde dijo que quedó.
+//   - Réplica, foto e hilos ven temas comunes: los miembros se reconstruyen
+//     por nombre (unirse_grupo) y "$grupo/g/T" va al nodo y al hilo de T.
+// ============================================================================
+
+#define MAX_GRUPOS      64            // Grupos entre todos los temas
+#define MAX_MIEMBROS    64            // Miembros por grupo
+#define MAX_HUERFANOS   64            // Miembros que salieron con mensajes por repartir
+
+typedef struct {
+    unsigned int tema;                // Id del tema real
+    unsigned int nombre;              // Id de "$grupo/g/T"
+    int politica;                     // GRUPO_TURNOS, GRUPO_CARGA o GRUPO_CLAVE
+    unsigned int turno;
+    unsigned int siguiente;           // Número del próximo miembro (":n")
+    int num_miembros;
+    unsigned int miembros[MAX_MIEMBROS];   // Id del tema interno de cada miembro
+} Grupo;
+
+typedef struct {
+    unsigned int miembro;             // Tema interno del miembro que salió
+    int grupo;
+    unsigned int confirmado;          // Lo que sigue a este seq no lo confirmó
+} Huerfano;
+
+POR_HILO Grupo grupos[MAX_GRUPOS];
+POR_HILO int num_grupos = 0;
+POR_HILO Huerfano huerfanos[MAX_HUERFANOS];
+POR_HILO int num_huerfanos = 0;
+
+/** es_miembro - ¿Es el tema interno de un miembro ("$grupo/g/T:n")? */
+int es_miembro(const char *tema) {
+    return grupo_tema(tema) != NULL && strchr(tema, ':') != NULL;
+}
+
+/** nombre_en_red - Nombre con que el subscriber conoce el tema (sin el ":n" de un miembro) */
+const char *nombre_en_red(const char *tema, char *buf) {
+    if (!es_miembro(tema)) return tema;
+    size_t largo = (size_t)(strrchr(tema, ':') - tema);
+    memcpy(buf, tema, largo);
+    buf[largo] = '\0';
+    return buf;
+}
+
+/**
+ * grupo_de - Índice del grupo "$grupo/g/T" en grupos[]
+ *
+ * Con crear = 1 lo crea si no existe. Retorna -1 si no existe (o no hay
+ * lugar para otro grupo).
+ */
+int grupo_de(const char *nombre, int crear) {
+    int id = crear ? tema_id(nombre) : tema_buscar(&temas, nombre);
+    if (id < 0) return -1;
+    for (int g = 0; g < num_grupos; g++) {
+        if (grupos[g].nombre == (unsigned int)id) return g;
+    }
+    int tema = crear ? tema_id(grupo_tema(nombre)) : -1;
+    if (tema < 0 || num_grupos == MAX_GRUPOS) return -1;
+    Grupo *g = &grupos[num_grupos];
+    memset(g, 0, sizeof(*g));
+    g->tema = (unsigned int)tema;
+    g->nombre = (unsigned int)id;
+    g->politica = grupo_politica(nombre);
+    printf("[grupo] Nuevo grupo '%s' (%s)\n", nombre, grupo_politicas[g->politica]);
+    return num_grupos++;
+}
+
+/**
+ * nombre_miembro - Tema interno para una suscripción a un grupo
+ *
+ * "$grupo/g/T" da el de un miembro nuevo ("$grupo/g/T:n", escrito en buf);
+ * el de un miembro que llega por réplica queda igual. Retorna NULL si el
+ * grupo está lleno o el nombre no entra en TABLA_MAX_TEMA.
+ */
+const char *nombre_miembro(const char *tema, char *buf) {
+    char nombre[TABLA_MAX_TEMA];
+    int g = grupo_de(nombre_en_red(tema, nombre), 1);
+    if (g < 0 || grupos[g].num_miembros == MAX_MIEMBROS) return NULL;
+    if (es_miembro(tema)) return tema;
+    if (snprintf(buf, TABLA_MAX_TEMA, "%s:%u", tema, grupos[g].siguiente) >= TABLA_MAX_TEMA) return NULL;
+    return buf;
+}
+
+/** unirse_grupo - Suma el tema interno id ("$grupo/g/T:n") a los miembros de su grupo */
+void unirse_grupo(int id) {
+    const char *tema = tema_nombre(&temas, id);
+    char nombre[TABLA_MAX_TEMA];
+    int g = grupo_de(nombre_en_red(tema, nombre), 1);
+    if (g < 0 || grupos[g].num_miembros == MAX_MIEMBROS) return;
+    unsigned int n = (unsigned int)strtoul(strrchr(tema, ':') + 1, NULL, 10);
+    if (n >= grupos[g].siguiente) grupos[g].siguiente = n + 1;
+    grupos[g].miembros[grupos[g].num_miembros++] = (unsigned int)id;
+}
+
+/** buscar_miembro - Suscripción de addr entre los miembros de "$grupo/g/T", o -1 */
+int buscar_miembro(const char *nombre, struct sockaddr_in addr) {
+    int g = grupo_de(nombre, 0);
+    for (int k = 0; g >= 0 && k < grupos[g].num_miembros; k++) {
+        int i = columna_proximo(&subs.tema, num_subs, grupos[g].miembros[k], 0);
+        if (i >= 0 && SUB_IP(i) == addr.sin_addr.s_addr && SUB_PUERTO(i) == addr.sin_port) return i;
+    }
+    return -1;
+}
+
+/**
+ * seguir_miembro - Miembro nuevo que reanuda desde desde: su tema interno
+ * sigue en ese seq (si no, lo nuevo le parecería repetido)
+ */
+void seguir_miembro(int idx, unsigned int desde) {
+    unsigned int *seq = &COLUMNA(seq_tema, unsigned int, SUB_TEMA(idx));
+    if (desde <= *seq) return;
+    *seq = desde;
+    SUB_CONFIRMADO(idx) = desde;
+    replica_registrar('Q', desde, sub_tema(idx), "", NULL);
+}
+
+/** salir_grupo - Saca de su grupo al miembro de la suscripción idx y guarda lo que quedó sin confirmar */
+void salir_grupo(int idx) {
+    char nombre[TABLA_MAX_TEMA];
+    int g = grupo_de(nombre_en_red(sub_tema(idx), nombre), 0);
+    if (g < 0) return;
+    Grupo *gr = &grupos[g];
+    for (int k = 0; k < gr->num_miembros; k++) {
+        if (gr->miembros[k] == SUB_TEMA(idx)) {
+            gr->miembros[k] = gr->miembros[--gr->num_miembros];
+            break;
+        }
+    }
+    unsigned int actual = COLUMNA(seq_tema, unsigned int, SUB_TEMA(idx));
+    if (actual > SUB_CONFIRMADO(idx) && num_huerfanos < MAX_HUERFANOS) {
+        huerfanos[num_huerfanos].miembro = SUB_TEMA(idx);
+        huerfanos[num_huerfanos].grupo = g;
+        huerfanos[num_huerfanos].confirmado = SUB_CONFIRMADO(idx);
+        num_huerfanos++;
+    }
+}
+
+/**
+ * elegir_miembro - Tema interno del miembro que recibe el mensaje, o -1 si
+ * el grupo no tiene miembros
+ *
+ * turnos: el siguiente de la ronda. carga: el de menos mensajes sin
+ * confirmar (seq del tema interno - acumulado de su último ACK; empata la
+ * ronda). clave: el de mayor grupo_puntaje() para la clave del mensaje.
+ */
+int elegir_miembro(Grupo *g, const char *mensaje) {
+    if (g->num_miembros == 0) return -1;
+    unsigned int clave = 0;
+    int politica = g->politica;
+    if (mensaje[0] == FRAGMENTO_PREFIJO) {
+        clave = (unsigned int)strtoul(mensaje + 1, NULL, 16);   // Id del mensaje fragmentado
+        politica = GRUPO_CLAVE;
+    } else if (politica == GRUPO_CLAVE && !grupo_clave(mensaje, &clave)) {
+        politica = GRUPO_TURNOS;
+    }
+
+    int elegido = -1;
+    unsigned int mejor = 0;
+    for (int k = 0; k < g->num_miembros; k++) {
+        int m = (int)((g->turno + (unsigned int)k) % (unsigned int)g->num_miembros);
+        if (politica == GRUPO_TURNOS) {
+            elegido = m;
+            break;
+        }
+        int i = columna_proximo(&subs.tema, num_subs, g->miembros[m], 0);
+        if (i < 0) continue;
+        unsigned int valor = politica == GRUPO_CLAVE
+            ? grupo_puntaje(clave, SUB_IP(i), SUB_PUERTO(i))
+            : ~(COLUMNA(seq_tema, unsigned int, g->miembros[m]) - SUB_CONFIRMADO(i));
+        if (elegido < 0 || valor > mejor) {
+            elegido = m;
+            mejor = valor;
+        }
+    }
+    if (elegido < 0) return -1;
+    if (politica != GRUPO_CLAVE) g->turno = (unsigned int)elegido + 1;
+    return (int)g->miembros[elegido];
+}
+
+/**
+ * repartir_en_grupos - Entrega el mensaje del tema a un miembro de cada grupo
+ *
+ * Con garantías (QoS 1 y 2) se publica en el tema interno del miembro; sin
+ * garantías (QoS 0) se le envía un 'D' y nada más.
+ */
+void repartir_en_grupos(SOCKET sock, unsigned int tema, const char *mensaje, int garantias) {
+    for (int g = 0; g < num_grupos; g++) {
+        if (grupos[g].tema != tema) continue;
+        int miembro = elegir_miembro(&grupos[g], mensaje);
+        if (miembro < 0) continue;               // Sin miembros: como un tema sin subscribers
+        if (garantias) {
+            publicar(sock, (char *)tema_nombre(&temas, miembro), (char *)mensaje);
+            continue;
+        }
+        int i = columna_proximo(&subs.tema, num_subs, (unsigned int)miembro, 0);
+        Paquete pkt;
+        pkt.seq = 0;
+        pkt.tipo = PKT_DATAGRAMA;
+        snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%.49s:%s", tema_nombre(&temas, (int)grupos[g].nombre), mensaje);
+        struct sockaddr_in addr = sub_addr(i);
+        encolar_salida(sock, tema_nombre(&temas, (int)tema), &pkt, paquete_tam(&pkt), &addr);
+    }
+}
+
+/**
+ * rebalancear_grupos - Reparte entre los miembros que quedan lo que los que
+ * salieron no confirmaron (se llama en cada vuelta del bucle principal)
+ */
+void rebalancear_grupos(SOCKET sock) {
+    while (num_huerfanos > 0) {
+        Huerfano h = huerfanos[--num_huerfanos];
+        const char *tema = tema_nombre(&temas, (int)h.miembro);
+        unsigned int actual = COLUMNA(seq_tema, unsigned int, h.miembro);
+        char msg[500];
+        int repartidos = 0;
+        for (unsigned int s = primer_seq_en_historial(tema, h.confirmado); s != 0 && s <= actual; s++) {
+            if (!buscar_en_historial(s, tema, msg)) continue;
+            int miembro = elegir_miembro(&grupos[h.grupo], msg);
+            if (miembro < 0) break;
+            publicar(sock, (char *)tema_nombre(&temas, miembro), msg);
+            repartidos++;
+        }
+        if (repartidos > 0) {
+            printf("[grupo] %d mensaje(s) sin confirmar de '%s' repartidos entre los demás miembros\n",
+                   repartidos, tema);
+        }
+    }
+}
+
+// ============================================================================
+// ESTADO RETENIDO - Arranque de subscribers que llegan tarde
+// ============================================================================
+//
+// Un subscriber que se une a mitad del partido no recibía nada hasta el
+// próximo evento. Ahora el broker retiene por tema los últimos mensajes y
+// los envía en ráfaga junto con el ACK de la suscripción (paquetes 'V').
+//
+// Memoria compacta:
+//   Cada tema tiene un único arreglo de bytes con los registros uno detrás
+//   de otro, del más viejo al más nuevo: [seq 4][largo 2][texto]. No hay
+//   slots de 500 bytes por mensaje: un tema con mensajes cortos ocupa poco.
+//   Si no entra un mensaje nuevo (o ya hay RETENIDOS_POR_TEMA) se descartan
+//   los más viejos.
+//
+// Compactación por clave:
+//   Un mensaje de la forma "clave=valor" (ej: "marcador=2-1") reemplaza al
+//   retenido anterior con la misma clave, así el estado se mantiene como una
+//   foto por clave en lugar de acumular versiones viejas.
+//
+// Los fragmentos de un mensaje grande no se retienen: sueltos no sirven y
+// desplazarían el estado real del tema. Tampoco lo que se entrega a un
+// miembro de un grupo: es una parte del tema, no su estado.
+// ============================================================================
+
+#define RETENIDOS_POR_TEMA  16
+#define TAM_RETENIDO        2048     // Bytes de registros por tema
+#define CAB_RETENIDO        6        // seq + largo
+#define MAX_CLAVE           32
+
+typedef struct {
+    int num;                          // Registros guardados
+    int usados;                       // Bytes ocupados en datos
+    char datos[TAM_RETENIDO];
+} Retenido;
+
+/**
+ * retenido_de - Estado retenido del tema, o NULL
+ *
+ * Con crear lo reserva si falta: un tema que nunca retuvo nada ocupa solo
+ * su puntero en retenidos_tema.
+ */
+Retenido *retenido_de(const char *tema, int crear) {
+    int id = crear ? tema_id(tema) : tema_buscar(&temas, tema);
+    if (id < 0 || columna_asegurar(&retenidos_tema, id + 1) != 0) return NULL;
+    Retenido **r = columna_en(&retenidos_tema, id);
+    if (*r == NULL && crear) *r = calloc(1, sizeof(Retenido));
+    return *r;
+}
+
+/** largo_clave - Largo de "clave=" al inicio del mensaje, o 0 si no tiene clave */
+int largo_clave(const char *mensaje) {
+    int i = 0;
+    while (i < MAX_CLAVE && mensaje[i] != '\0' && mensaje[i] != '=' && mensaje[i] != ' ') i++;
+    return (i > 0 && mensaje[i] == '=') ? i + 1 : 0;
+}
+
+/** retenido_quitar - Elimina el registro que empieza en pos */
+void retenido_quitar(Retenido *r, int pos) {
+    unsigned short largo;
+    memcpy(&largo, r->datos + pos + 4, 2);
+    int tam = CAB_RETENIDO + largo;
+    memmove(r->datos + pos, r->datos + pos + tam, r->usados - pos - tam);
+    r->usados -= tam;
+    r->num--;
+}
+
+/**
+ * retener - Agrega un mensaje publicado al estado retenido de su tema
+ */
+void retener(const char *tema, unsigned int seq, const char *mensaje) {
+    if (mensaje[0] == FRAGMENTO_PREFIJO || es_miembro(tema)) return;
+    Retenido *r = retenido_de(tema, 1);
+    if (r == NULL) return;               // Tema inválido o sin memoria
+
+    unsigned short largo = (unsigned short)strlen(mensaje);
+    if (CAB_RETENIDO + largo > TAM_RETENIDO) return;
+
+    // Compactación: la versión anterior de la misma clave sobra
+    int clave = largo_clave(mensaje);
+    if (clave > 0) {
+        for (int pos = 0; pos < r->usados; ) {
+            unsigned short l;
+            memcpy(&l, r->datos + pos + 4, 2);
+            if (l >= clave && memcmp(r->datos + pos + CAB_RETENIDO, mensaje, clave) == 0) {
+                retenido_quitar(r, pos);
+                break;
+            }
+            pos += CAB_RETENIDO + l;
+        }
+    }
+
+    // Hacer lugar descartando los más viejos (siempre están al principio)
+    while (r->num > 0 && (r->num == RETENIDOS_POR_TEMA ||
+                          r->usados + CAB_RETENIDO + largo > TAM_RETENIDO)) {
+        retenido_quitar(r, 0);
+    }
+
+    char *p = r->datos + r->usados;
+    memcpy(p, &seq, 4);
+    memcpy(p + 4, &largo, 2);
+    memcpy(p + CAB_RETENIDO, mensaje, largo);
+    r->usados += CAB_RETENIDO + largo;
+    r->num++;
+}
+
+/**
+ * enviar_retenidos - Envía el estado retenido del tema a un subscriber nuevo
+ *
+ * Arma paquetes 'V' con tantos registros como quepan ("tema:seq texto\n...")
+ * para que la ráfaga completa sean muy pocos datagramas.
+ */
+void enviar_retenidos(SOCKET sock, const char *tema, struct sockaddr_in *cliente) {
+    Retenido *r = retenido_de(tema, 0);
+    if (r == NULL || r->num == 0) return;
+
+    Paquete pkt;
+    int prefijo = sprintf(pkt.mensaje, "%s:", tema);
+    int len = prefijo;
+    int enviados = 0;
+    unsigned int seq = 0;
+    pkt.tipo = PKT_RETENIDO;
+
+    for (int pos = 0; pos < r->usados; ) {
+        unsigned short largo;
+        char linea[QUIC_MAX_MENSAJE];
+        memcpy(&seq, r->datos + pos, 4);
+        memcpy(&largo, r->datos + pos + 4, 2);
+        int n = snprintf(linea, sizeof(linea), "%u %.*s\n", seq, (int)largo, r->datos + pos + CAB_RETENIDO);
+        pos += CAB_RETENIDO + largo;
+        if (n >= (int)sizeof(linea) || prefijo + n >= QUIC_MAX_MENSAJE) continue;   // No cabe ni solo
+
+        if (len + n >= QUIC_MAX_MENSAJE) {
+            sendto(sock, (char*)&pkt, paquete_tam(&pkt), 0, (struct sockaddr*)cliente, sizeof(*cliente));
+            len = prefijo;
+        }
+        memcpy(pkt.mensaje + len, linea, n + 1);
+        len += n;
+        pkt.seq = seq;
+        enviados++;
+    }
+    if (len > prefijo) {
+        sendto(sock, (char*)&pkt, paquete_tam(&pkt), 0, (struct sockaddr*)cliente, sizeof(*cliente));
+    }
+    printf("[->] Estado retenido de '%s': %d mensaje(s)\n", tema, enviados);
+}
+
+// ============================================================================
+// CLUSTER - Reparto de temas entre varios brokers
+// ============================================================================
+//
+// Con --cluster <archivo> --nodo <id> varios procesos broker_quic se reparten
+// los temas. El archivo de membresía es estático, una línea por nodo:
+//
+//     # id   ip          puerto_udp   puerto_enlace
+//     A      127.0.0.1   7000         7100
+//     B      127.0.0.1   7001         7101
+//
+// Dueño de un tema (hashing consistente):
+//   Cada nodo aporta VNODOS puntos a un anillo de hashes de 32 bits. El dueño
+//   de un tema es el primer punto del anillo en sentido horario desde
+//   hash(tema). Al agregar un nodo solo cambian de dueño los temas que caen
+//   en los arcos que toman sus puntos: ~1/N del total.
+//
+// Enlace entre brokers:
+//   Cada nodo mantiene una conexión TCP persistente de salida hacia cada par
+//   (reconecta con backoff si se cae) y acepta las de entrada en su
+//   puerto_enlace. Por el enlace viaja el paquete original junto con la
+//   dirección UDP del cliente que lo envió, así el dueño registra al
+//   subscriber real y le envía ACKs, publicaciones y retransmisiones
+//   directamente por UDP.
+//
+// Formato de cada trama del enlace:
+//   [largo: 4 bytes, orden de red][sockaddr_in del cliente][Paquete compacto]
+// ============================================================================
+
+#define MAX_NODOS        16
+#define VNODOS           64                  // Puntos por nodo en el anillo
+#define TAM_BUF_ENLACE   65536               // Buffer por enlace (entrada o salida)
+#define MAX_ENTRANTES    (MAX_NODOS * 2)
+#define REINTENTO_ENLACE_MS 500
+
+typedef struct {
+    char id[32];
+    struct sockaddr_in udp;              // Dónde lo contactan los clientes
+    struct sockaddr_in enlace;           // Puerto TCP del enlace entre brokers
+    SOCKET salida;                       // Enlace persistente hacia este nodo
+    int estado;                          // 0 = desconectado, 1 = conectando, 2 = conectado
+    unsigned long long proximo_intento_ms;
+    char buf[TAM_BUF_ENLACE];            // Tramas pendientes de escribir
+    int len;
+} Nodo;
+
+typedef struct {
+    unsigned int hash;
+    int nodo;
+} PuntoAnillo;
+
+typedef struct {
+    SOCKET s;
+    char buf[TAM_BUF_ENLACE];            // Bytes recibidos sin procesar
+    int len;
+} EnlaceEntrante;
+
+Nodo nodos[MAX_NODOS];
+int num_nodos = 0;
+int nodo_propio = -1;                    // -1 = broker independiente (sin cluster)
+
+PuntoAnillo anillo[MAX_NODOS * VNODOS];
+int num_puntos = 0;
+
+SOCKET escucha_enlace = INVALID_SOCKET;
+EnlaceEntrante entrantes[MAX_ENTRANTES];
+
+// Declarada más abajo: el enlace entrega los paquetes reenviados al mismo
+// manejador que los que llegan por UDP
+void procesar_paquete(SOCKET sock, Paquete *pkt, struct sockaddr_in cliente, int desde_enlace,
+                      Reparto *reparto);
+
+/** hash_fnv1a - Hash FNV-1a de 32 bits (rápido y con buena dispersión) */
+unsigned int hash_fnv1a(const char *texto) {
+    unsigned int h = 2166136261u;
+    while (*texto) {
+        h ^= (unsigned char)*texto++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int comparar_puntos(const void *a, const void *b) {
+    unsigned int x = ((const PuntoAnillo*)a)->hash, y = ((const PuntoAnillo*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * cargar_cluster - Lee el archivo de membresía y arma el anillo
+ *
+ * Retorna 0 si el archivo es válido y contiene al nodo propio.
+ */
+int cargar_cluster(const char *archivo, const char *id_propio) {
+    FILE *f = fopen(archivo, "r");
+    if (f == NULL) {
+        printf("[!] No se pudo abrir el archivo de cluster '%s'\n", archivo);
+        return -1;
+    }
+
+    char linea[200];
+    while (fgets(linea, sizeof(linea), f) != NULL && num_nodos < MAX_NODOS) {
+        char id[32], ip[64];
+        int puerto_udp, puerto_enlace;
+        if (linea[0] == '#') continue;
+        if (sscanf(linea, "%31s %63s %d %d", id, ip, &puerto_udp, &puerto_enlace) != 4) continue;
+
+        Nodo *n = &nodos[num_nodos];
+        memset(n, 0, sizeof(*n));
+        strcpy(n->id, id);
+        n->udp.sin_family = AF_INET;
+        n->udp.sin_addr.s_addr = inet_addr(ip);
+        n->udp.sin_port = htons((unsigned short)puerto_udp);
+        n->enlace = n->udp;
+        n->enlace.sin_port = htons((unsigned short)puerto_enlace);
+        n->salida = INVALID_SOCKET;
+        if (strcmp(id, id_propio) == 0) nodo_propio = num_nodos;
+
+        // Puntos virtuales: hash("id#0"), hash("id#1"), ...
+        for (int v = 0; v < VNODOS; v++) {
+            char clave[48];
+            sprintf(clave, "%s#%d", id, v);
+            anillo[num_puntos].hash = hash_fnv1a(clave);
+            anillo[num_puntos].nodo = num_nodos;
+            num_puntos++;
+        }
+        num_nodos++;
+    }
+    fclose(f);
+
+    if (nodo_propio < 0) {
+        printf("[!] El nodo '%s' no aparece en '%s'\n", id_propio, archivo);
+        return -1;
+    }
+    qsort(anillo, num_puntos, sizeof(PuntoAnillo), comparar_puntos);
+    for (int i = 0; i < MAX_ENTRANTES; i++) entrantes[i].s = INVALID_SOCKET;
+    return 0;
+}
+
+/**
+ * nodo_duenio - Índice del nodo dueño del tema, o -1 si es este broker
+ *
+ * Búsqueda binaria del primer punto con hash >= hash(tema); si no hay,
+ * se da la vuelta al anillo (punto 0). "$grupo/g/T" es del dueño de T.
+ */
+int nodo_duenio(const char *tema) {
+    if (nodo_propio < 0) return -1;
+
+    unsigned int h = hash_fnv1a(grupo_tema(tema) != NULL ? grupo_tema(tema) : tema);
+    int izq = 0, der = num_puntos;
+    while (izq < der) {
+        int medio = (izq + der) / 2;
+        if (anillo[medio].hash < h) izq = medio + 1;
+        else der = medio;
+    }
+    int nodo = anillo[izq == num_puntos ? 0 : izq].nodo;
+    return nodo == nodo_propio ? -1 : nodo;
+}
+
+void enlace_cerrar(Nodo *n) {
+    if (n->salida != INVALID_SOCKET) closesocket(n->salida);
+    n->salida = INVALID_SOCKET;
+    n->estado = 0;
+    n->len = 0;             // Lo no escrito se pierde; los clientes reintentan
+    n->proximo_intento_ms = reloj_ms() + REINTENTO_ENLACE_MS;
+}
+
+void enlace_conectar(Nodo *n) {
+    n->salida = socket(AF_INET, SOCK_STREAM, 0);
+    if (n->salida == INVALID_SOCKET) {
+        n->proximo_intento_ms = reloj_ms() + REINTENTO_ENLACE_MS;
+        return;
+    }
+    red_no_bloqueante(n->salida);
+    if (connect(n->salida, (struct sockaddr*)&n->enlace, sizeof(n->enlace)) == 0) {
+        n->estado = 2;
+    } else if (red_reintentar()) {
+        n->estado = 1;
+    } else {
+        enlace_cerrar(n);
+    }
+}
+
+void enlace_vaciar(Nodo *n) {
+    while (n->estado == 2 && n->len > 0) {
+        int r = send(n->salida, n->buf, n->len, MSG_NOSIGNAL);
+        if (r < 0) {
+            if (!red_reintentar()) {
+                printf("[cluster] Enlace con nodo %s caído\n", n->id);
+                enlace_cerrar(n);
+            }
+            return;
+        }
+        memmove(n->buf, n->buf + r, n->len - r);
+        n->len -= r;
+    }
+}
+
+/**
+ * reenviar_a_nodo - Encola un paquete hacia el nodo dueño por el enlace
+ *
+ * Retorna 0 si quedó encolado, -1 si el enlace no está disponible o su
+ * buffer está lleno (el cliente volverá a intentar).
+ */
+int reenviar_a_nodo(int idx, const Paquete *pkt, const struct sockaddr_in *cliente) {
+    Nodo *n = &nodos[idx];
+    int tam_pkt = paquete_tam(pkt);
+    unsigned int largo = (unsigned int)(sizeof(struct sockaddr_in) + tam_pkt);
+
+    if (n->estado == 0 || n->len + 4 + (int)largo > TAM_BUF_ENLACE) return -1;
+
+    unsigned int largo_red = htonl(largo);
+    memcpy(n->buf + n->len, &largo_red, 4);
+    memcpy(n->buf + n->len + 4, cliente, sizeof(struct sockaddr_in));
+    memcpy(n->buf + n->len + 4 + sizeof(struct sockaddr_in), pkt, tam_pkt);
+    n->len += 4 + (int)largo;
+    enlace_vaciar(n);
+    return 0;
+}
+
+/**
+ * enlace_leer - Procesa las tramas completas recibidas de otro nodo
+ */
+void enlace_leer(SOCKET sock, EnlaceEntrante *e) {
+    int r = recv(e->s, e->buf + e->len, TAM_BUF_ENLACE - e->len, 0);
+    if (r == 0 || (r < 0 && !red_reintentar())) {
+        closesocket(e->s);
+        e->s = INVALID_SOCKET;
+        e->len = 0;
+        return;
+    }
+    if (r < 0) return;
+    e->len += r;
+
+    int pos = 0;
+    while (e->len - pos >= 4) {
+        unsigned int largo_red;
+        memcpy(&largo_red, e->buf + pos, 4);
+        unsigned int largo = ntohl(largo_red);
+        if (largo < sizeof(struct sockaddr_in) + PAQUETE_CABECERA || largo > sizeof(struct sockaddr_in) + sizeof(Paquete)) {
+            printf("[cluster] Trama inválida, cerrando enlace entrante\n");
+            closesocket(e->s);
+            e->s = INVALID_SOCKET;
+            e->len = 0;
+            return;
+        }
+        if (e->len - pos < 4 + (int)largo) break;
+
+        struct sockaddr_in cliente;
+        Paquete pkt;
+        int tam_pkt = (int)largo - (int)sizeof(struct sockaddr_in);
+        memcpy(&cliente, e->buf + pos + 4, sizeof(cliente));
+        memcpy(&pkt, e->buf + pos + 4 + sizeof(cliente), tam_pkt);
+        if (paquete_terminar(&pkt, tam_pkt)) procesar_paquete(sock, &pkt, cliente, 1, NULL);
+        pos += 4 + (int)largo;
+    }
+    memmove(e->buf, e->buf + pos, e->len - pos);
+    e->len -= pos;
+}
+
+/**
+ * iniciar_cluster - Abre el puerto de enlace y arranca las conexiones
+ */
+int iniciar_cluster(void) {
+    escucha_enlace = socket(AF_INET, SOCK_STREAM, 0);
+    int si = 1;
+    setsockopt(escucha_enlace, SOL_SOCKET, SO_REUSEADDR, (char*)&si, sizeof(si));
+    struct sockaddr_in dir = nodos[nodo_propio].enlace;
+    dir.sin_addr.s_addr = INADDR_ANY;
+    if (bind(escucha_enlace, (struct sockaddr*)&dir, sizeof(dir)) != 0 || listen(escucha_enlace, MAX_NODOS) != 0) {
+        printf("[!] No se pudo abrir el puerto de enlace %d\n", ntohs(dir.sin_port));
+        return -1;
+    }
+    red_no_bloqueante(escucha_enlace);
+
+    for (int i = 0; i < num_nodos; i++) {
+        if (i != nodo_propio) enlace_conectar(&nodos[i]);
+    }
+    return 0;
+}
+
+/** cluster_preparar_select - Agrega los sockets del enlace a los fd_set */
+void cluster_preparar_select(fd_set *lectura, fd_set *escritura, SOCKET *mayor) {
+    if (nodo_propio < 0) return;
+
+    FD_SET(escucha_enlace, lectura);
+    if (escucha_enlace > *mayor) *mayor = escucha_enlace;
+    for (int i = 0; i < MAX_ENTRANTES; i++) {
+        if (entrantes[i].s == INVALID_SOCKET) continue;
+        FD_SET(entrantes[i].s, lectura);
+        if (entrantes[i].s > *mayor) *mayor = entrantes[i].s;
+    }
+    for (int i = 0; i < num_nodos; i++) {
+        Nodo *n = &nodos[i];
+        if (i == nodo_propio || n->estado == 0) continue;
+        if (n->estado == 1 || n->len > 0) {
+            FD_SET(n->salida, escritura);
+            if (n->salida > *mayor) *mayor = n->salida;
+        }
+    }
+}
+
+/** cluster_atender - Acepta enlaces, lee tramas, completa connect() y reconecta */
+void cluster_atender(SOCKET sock, fd_set *lectura, fd_set *escritura) {
+    if (nodo_propio < 0) return;
+
+    if (FD_ISSET(escucha_enlace, lectura)) {
+        SOCKET nuevo = accept(escucha_enlace, NULL, NULL);
+        if (nuevo != INVALID_SOCKET) {
+            int libre = -1;
+            for (int i = 0; i < MAX_ENTRANTES && libre < 0; i++) {
+                if (entrantes[i].s == INVALID_SOCKET) libre = i;
+            }
+            if (libre < 0) {
+                closesocket(nuevo);
+            } else {
+                red_no_bloqueante(nuevo);
+                entrantes[libre].s = nuevo;
+                entrantes[libre].len = 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_ENTRANTES; i++) {
+        if (entrantes[i].s != INVALID_SOCKET && FD_ISSET(entrantes[i].s, lectura)) {
+            enlace_leer(sock, &entrantes[i]);
+        }
+    }
+
+    unsigned long long ahora = reloj_ms();
+    for (int i = 0; i < num_nodos; i++) {
+        Nodo *n = &nodos[i];
+        if (i == nodo_propio) continue;
+
+        if (n->estado == 0) {
+            if (ahora >= n->proximo_intento_ms) enlace_conectar(n);
+        } else if (n->estado == 1 && FD_ISSET(n->salida, escritura)) {
+            int error = 0;
+            socklen_t tam = sizeof(error);
+            getsockopt(n->salida, SOL_SOCKET, SO_ERROR, (char*)&error, &tam);
+            if (error == 0) {
+                n->estado = 2;
+                printf("[cluster] Enlace con nodo %s establecido\n", n->id);
+            } else {
+                enlace_cerrar(n);
+            }
+        } else if (n->estado == 2 && FD_ISSET(n->salida, escritura)) {
+            enlace_vaciar(n);
+        }
+    }
+}
+
+// ============================================================================
+// REPLICACIÓN LÍDER-SEGUIDOR
+// ============================================================================
+//
+// Si el broker muere se pierden los contadores de secuencia y el historial,
+// y los subscribers ven las secuencias reiniciar en 1. Para evitarlo un
+// segundo proceso puede seguir al líder:
+//
+//     broker_quic.exe --replicacion 7200               (líder)
+//     broker_quic.exe --seguir 127.0.0.1:7200          (seguidor)
+//
+// Flujo:
+//   - Al conectarse el seguidor, el líder le envía una foto del estado
+//     (secuencias por tema, historial y suscripciones) y luego un registro
+//     por cada publicación ('P', con el seq ya asignado), suscripción ('S')
+//     y baja ('U').
+//   - Los registros se acumulan en un buffer y se escriben una vez por
+//     vuelta del bucle principal (por lotes) sin esperar confirmación
+//     (pipeline). El seguidor confirma cuántos registros aplicó.
+//   - Con la diferencia entre enviados y confirmados el líder calcula el
+//     retraso de replicación (registros y ms) y lo reporta periódicamente.
+//   - El líder envía un latido cada LATIDO_REPLICA_MS. Si el seguidor no
+//     recibe nada en TOMA_CONTROL_MS, o el enlace se cierra, asume como
+//     líder: abre el puerto UDP y sigue asignando secuencias donde quedaron.
+//
+// Formato de un registro (todo en orden de red):
+//   [largo 4][tipo 1][seq 4][ip 4][puerto 2][tema '\0'][mensaje '\0']
+// ============================================================================
+
+#define TAM_BUF_REPLICA     (1024 * 1024)    // Entra la foto con el historial lleno
+#define LATIDO_REPLICA_MS   100
+#define TOMA_CONTROL_MS     600
+#define REPORTE_REPLICA_MS  5000
+#define MAX_TIEMPOS_REPLICA 4096          // Marcas de tiempo para medir el retraso
+#define CAB_REGISTRO        15            // largo + tipo + seq + ip + puerto
+
+SOCKET escucha_replica = INVALID_SOCKET;  // Líder: puerto donde acepta al seguidor
+SOCKET seguidor = INVALID_SOCKET;         // Líder: conexión con el seguidor
+char buf_replica[TAM_BUF_REPLICA];        // Líder: registros por enviar / Seguidor: recibidos
+int len_replica = 0;
+unsigned int registros_enviados = 0;      // Líder: registros generados
+unsigned int registros_confirmados = 0;   // Líder: registros aplicados por el seguidor
+unsigned long long tiempos_replica[MAX_TIEMPOS_REPLICA];   // Cuándo se generó cada registro
+unsigned long long ultimo_latido_ms = 0;
+unsigned long long ultimo_reporte_ms = 0;
+
+/**
+ * replica_registrar - Agrega un registro al flujo hacia el seguidor
+ *
+ * No hace nada si no hay seguidor conectado. Si el buffer se llena (el
+ * seguidor no da abasto) se corta el enlace: al reconectarse recibe una
+ * foto completa del estado.
+ */
+void replica_registrar(char tipo, unsigned int seq, const char *tema, const char *mensaje,
+                       const struct sockaddr_in *addr) {
+    if (seguidor == INVALID_SOCKET) return;
+
+    int len_tema = (int)strlen(tema) + 1;
+    int len_msg = (int)strlen(mensaje) + 1;
+    int largo = CAB_REGISTRO + len_tema + len_msg;
+    if (len_replica + largo > TAM_BUF_REPLICA) {
+        printf("[replica] Seguidor atrasado: buffer lleno, cerrando enlace\n");
+        closesocket(seguidor);
+        seguidor = INVALID_SOCKET;
+        return;
+    }
+
+    char *p = buf_replica + len_replica;
+    unsigned int largo_red = htonl((unsigned int)largo), seq_red = htonl(seq);
+    unsigned int ip = addr ? addr->sin_addr.s_addr : 0;
+    unsigned short puerto = addr ? addr->sin_port : 0;
+    memcpy(p, &largo_red, 4);
+    p[4] = tipo;
+    memcpy(p + 5, &seq_red, 4);
+    memcpy(p + 9, &ip, 4);
+    memcpy(p + 13, &puerto, 2);
+    memcpy(p + CAB_REGISTRO, tema, len_tema);
+    memcpy(p + CAB_REGISTRO + len_tema, mensaje, len_msg);
+    len_replica += largo;
+
+    tiempos_replica[registros_enviados % MAX_TIEMPOS_REPLICA] = reloj_ms();
+    registros_enviados++;
+}
+
+/**
+ * replica_foto - Envía el estado completo a un seguidor recién conectado
+ *
+ * Primero la base de los alias ('B') y los contadores de secuencia ('Q')
+ * en el orden de los ids de tema (el id es el alias), luegoel historial en
+ * orden de antigüedad ('P') y por último las suscripciones ('S', con su
+ * alias en seq).
+ */
+void replica_foto(void) {
+    replica_registrar('B', alias_base, "", "", NULL);
+    for (int id = 0; id < temas.cantidad; id++) {
+        replica_registrar('Q', COLUMNA(seq_tema, unsigned int, id), tema_nombre(&temas, id), "", NULL);
+    }
+    for (int k = 0; k < MAX_HISTORIAL; k++) {
+        MensajeHistorial *h = &historial[(historial_index + k) % MAX_HISTORIAL];
+        if (h->seq != 0) replica_registrar('P', h->seq, h->tema, h->mensaje, NULL);
+    }
+    for (int i = 0; i < num_subs; i++) {
+        struct sockaddr_in addr = sub_addr(i);
+        replica_registrar('S', SUB_ALIAS(i), sub_tema(i), "", &addr);
+    }
+}
+
+/**
+ * replica_iniciar - Líder: abre el puerto TCP donde se conecta el seguidor
+ */
+int replica_iniciar(int puerto) {
+    struct sockaddr_in dir;
+    int si = 1;
+    escucha_replica = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(escucha_replica, SOL_SOCKET, SO_REUSEADDR, (char*)&si, sizeof(si));
+    memset(&dir, 0, sizeof(dir));
+    dir.sin_family = AF_INET;
+    dir.sin_addr.s_addr = INADDR_ANY;
+    dir.sin_port = htons((unsigned short)puerto);
+    if (bind(escucha_replica, (struct sockaddr*)&dir, sizeof(dir)) != 0 || listen(escucha_replica, 1) != 0) {
+        printf("[!] No se pudo abrir el puerto de replicación %d\n", puerto);
+        return -1;
+    }
+    red_no_bloqueante(escucha_replica);
+    return 0;
+}
+
+/** replica_preparar_select - Líder: agrega los sockets de replicación */
+void replica_preparar_select(fd_set *lectura, fd_set *escritura, SOCKET *mayor) {
+    if (escucha_replica == INVALID_SOCKET) return;
+    FD_SET(escucha_replica, lectura);
+    if (escucha_replica > *mayor) *mayor = escucha_replica;
+    if (seguidor != INVALID_SOCKET) {
+        FD_SET(seguidor, lectura);
+        if (len_replica > 0) FD_SET(seguidor, escritura);
+        if (seguidor > *mayor) *mayor = seguidor;
+    }
+}
+
+/**
+ * replica_atender - Líder: acepta al seguidor, lee confirmaciones, escribe
+ * el lote acumulado, envía latidos y reporta el retraso
+ */
+void replica_atender(fd_set *lectura) {
+    if (escucha_replica == INVALID_SOCKET) return;
+    unsigned long long ahora = reloj_ms();
+
+    if (FD_ISSET(escucha_replica, lectura)) {
+        SOCKET nuevo = accept(escucha_replica, NULL, NULL);
+        if (nuevo != INVALID_SOCKET) {
+            if (seguidor != INVALID_SOCKET) closesocket(seguidor);   // Solo un seguidor
+            red_no_bloqueante(nuevo);
+            seguidor = nuevo;
+            len_replica = 0;
+            registros_enviados = registros_confirmados = 0;
+            replica_foto();
+            printf("[replica] Seguidor conectado: %u registros de estado inicial\n", registros_enviados);
+        }
+    }
+    if (seguidor == INVALID_SOCKET) return;
+
+    // Confirmaciones: el seguidor envía el total de registros aplicados
+    if (FD_ISSET(seguidor, lectura)) {
+        unsigned int conf[64];
+        int r = recv(seguidor, (char*)conf, sizeof(conf), 0);
+        if (r == 0 || (r < 0 && !red_reintentar())) {
+            printf("[replica] Seguidor desconectado\n");
+            closesocket(seguidor);
+            seguidor = INVALID_SOCKET;
+            return;
+        }
+        if (r >= 4) registros_confirmados = ntohl(conf[r / 4 - 1]);
+    }
+
+    // Latido si no hubo registros recientes
+    if (len_replica == 0 && ahora - ultimo_latido_ms >= LATIDO_REPLICA_MS) {
+        replica_registrar('H', 0, "", "", NULL);
+    }
+
+    // Escribir todo el lote acumulado en esta vuelta del bucle
+    while (len_replica > 0) {
+        int r = send(seguidor, buf_replica, len_replica, MSG_NOSIGNAL);
+        if (r < 0) {
+            if (!red_reintentar()) {
+                closesocket(seguidor);
+                seguidor = INVALID_SOCKET;
+            }
+            break;
+        }
+        memmove(buf_replica, buf_replica + r, len_replica - r);
+        len_replica -= r;
+        ultimo_latido_ms = ahora;
+    }
+
+    if (ahora - ultimo_reporte_ms >= REPORTE_REPLICA_MS) {
+        unsigned int atraso = registros_enviados - registros_confirmados;
+        unsigned long long atraso_ms = 0;
+        if (atraso > 0) atraso_ms = ahora - tiempos_replica[registros_confirmados % MAX_TIEMPOS_REPLICA];
+        printf("[replica] lag=%u registros, %llu ms (enviados=%u confirmados=%u)\n",
+               atraso, atraso_ms, registros_enviados, registros_confirmados);
+        ultimo_reporte_ms = ahora;
+    }
+}
+
+/** fijar_seq - Seguidor: lleva el contador del tema al menos hasta seq */
+void fijar_seq(const char *tema, unsigned int seq) {
+    int id = tema_id(tema);
+    if (id >= 0 && seq > COLUMNA(seq_tema, unsigned int, id)) COLUMNA(seq_tema, unsigned int, id) = seq;
+}
+
+/** aplicar_registro - Seguidor: aplica un registro recibido del líder */
+void aplicar_registro(const char *p, int largo) {
+    char tipo = p[4];
+    unsigned int seq_red;
+    struct sockaddr_in addr;
+    memcpy(&seq_red, p + 5, 4);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    memcpy(&addr.sin_addr.s_addr, p + 9, 4);
+    memcpy(&addr.sin_port, p + 13, 2);
+
+    const char *tema = p + CAB_REGISTRO;
+    const char *mensaje = tema + strnlen(tema, largo - CAB_REGISTRO) + 1;
+    char tema_local[50], msg_local[500];
+    strncpy(tema_local, tema, sizeof(tema_local) - 1);
+    tema_local[sizeof(tema_local) - 1] = '\0';
+    strncpy(msg_local, mensaje, sizeof(msg_local) - 1);
+    msg_local[sizeof(msg_local) - 1] = '\0';
+
+    if (tipo == 'Q') {
+        fijar_seq(tema_local, ntohl(seq_red));
+    } else if (tipo == 'P') {
+        fijar_seq(tema_local, ntohl(seq_red));
+        guardar_historial(ntohl(seq_red), tema_local, msg_local);
+        retener(tema_local, ntohl(seq_red), msg_local);
+    } else if (tipo == 'S') {
+        // seq = alias de la suscripción ('S' repetido = cambió el alias)
+        int idx = buscar_suscripcion(tema_local, addr);
+        if (idx < 0) {
+            agregar_suscripcion(tema_local, addr);
+            idx = buscar_suscripcion(tema_local, addr);
+        }
+        if (idx >= 0) SUB_ALIAS(idx) = ntohl(seq_red);
+    } else if (tipo == 'B') {
+        alias_base = ntohl(seq_red);
+    } else if (tipo == 'U') {
+        int idx = buscar_suscripcion(tema_local, addr);
+        if (idx >= 0) quitar_suscripcion(idx);
+        num_huerfanos = 0;                   // El líder ya los repartió (llegan como 'P')
+    }
+}
+
+/**
+ * seguir_lider - Seguidor: aplica el flujo del líder hasta que este caiga
+ *
+ * Retorna cuando el líder deja de responder (o cierra el enlace) para que
+ * main() continúe como broker normal con el estado replicado.
+ */
+void seguir_lider(const char *destino) {
+    char ip[64];
+    int puerto = 0;
+    struct sockaddr_in lider;
+    if (sscanf(destino, "%63[^:]:%d", ip, &puerto) != 2) {
+        printf("[!] --seguir espera ip:puerto\n");
+        return;
+    }
+    memset(&lider, 0, sizeof(lider));
+    lider.sin_family = AF_INET;
+    lider.sin_addr.s_addr = inet_addr(ip);
+    lider.sin_port = htons((unsigned short)puerto);
+
+    // Esperar a que el líder acepte la conexión
+    SOCKET s = INVALID_SOCKET;
+    while (s == INVALID_SOCKET) {
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(s, (struct sockaddr*)&lider, sizeof(lider)) != 0) {
+            closesocket(s);
+            s = INVALID_SOCKET;
+            dormir_ms(500);
+        }
+    }
+    printf("[replica] Siguiendo al líder %s\n", destino);
+
+    unsigned int aplicados = 0;
+    unsigned long long ultimo_dato = reloj_ms();
+    len_replica = 0;
+    while (1) {
+        fd_set lectura;
+        struct timeval espera = {0, 50000};
+        FD_ZERO(&lectura);
+        FD_SET(s, &lectura);
+        select((int)s + 1, &lectura, NULL, NULL, &espera);
+
+        if (FD_ISSET(s, &lectura)) {
+            int r = recv(s, buf_replica + len_replica, TAM_BUF_REPLICA - len_replica, 0);
+            if (r <= 0) break;                     // El líder cerró: tomar el control ya
+            len_replica += r;
+            ultimo_dato = reloj_ms();
+
+            int pos = 0;
+            while (len_replica - pos >= CAB_REGISTRO) {
+                unsigned int largo_red;
+                memcpy(&largo_red, buf_replica + pos, 4);
+                int largo = (int)ntohl(largo_red);
+                if (largo < CAB_REGISTRO + 2 || largo > TAM_BUF_REPLICA) { pos = len_replica; break; }
+                if (len_replica - pos < largo) break;
+                aplicar_registro(buf_replica + pos, largo);
+                aplicados++;
+                pos += largo;
+            }
+            memmove(buf_replica, buf_replica + pos, len_replica - pos);
+            len_replica -= pos;
+
+            // Confirmar en lote todo lo aplicado en esta lectura
+            unsigned int conf = htonl(aplicados);
+            send(s, (char*)&conf, 4, MSG_NOSIGNAL);
+        } else if (reloj_ms() - ultimo_dato >= TOMA_CONTROL_MS) {
+            break;                                 // Sin latidos: el líder murió
+        }
+    }
+    closesocket(s);
+    len_replica = 0;
+    
+    // Los latidos le llegaban al líder: el plazo de expiración empieza ahora
+    for (int i = 0; i < num_subs; i++) SUB_VISTO(i) = reloj_ms();
+    printf("[replica] Líder caído: tomando el control (%d temas, %d suscriptores, %u registros aplicados)\n",
+           temas.cantidad, num_subs, aplicados);
+}
+
+// ============================================================================
+// FOTOS DEL ESTADO - Reinicio en caliente (--foto archivo)
+// ============================================================================
+//
+// Sin fotos, un broker que se reinicia arranca sin suscriptores y con las
+// secuencias en 1: todos los subscribers tienen que volver a suscribirse a
+// la vez y los que siguen vivos descartan los seq "viejos" como duplicados.
+// Con --foto el broker guarda cada FOTO_CADA_MS (foto.h):
+//
+//   - la base de los alias y los temas en orden de id, con su último seq
+//     (el id es el alias: el orden se conserva);
+//   - las suscripciones (tema, dirección, alias y crédito).
+//
+// La foto la escribe un proceso hijo (fork) desde su copia del estado, así
+// el bucle principal no se detiene mientras se escribe. Al recibir SIGINT
+// o SIGTERM el broker escribe una última foto "limpia" antes de salir.
+//
+// Al arrancar con una foto, las suscripciones vuelven con el plazo de
+// expiración recién empezado (los subscribers vivos siguen enviando
+// latidos) y cada tema sigue desde su seq. Si la foto no es limpia (el
+// broker murió), pudo haber publicaciones después de ella: las secuencias
+// saltan FOTO_SALTO_SEQ para no repetir un seq ya entregado; el subscriber
+// ve un hueco y lo da por perdido en lugar de descartar mensajes nuevos.
+// ============================================================================
+
+#define FOTO_CADA_MS    5000
+#define FOTO_SALTO_SEQ  1000
+
+const char *archivo_foto = NULL;
+int foto_cada_ms = FOTO_CADA_MS;
+unsigned long long ultima_foto_ms = 0;
+volatile sig_atomic_t detener = 0;    // SIGINT / SIGTERM con --foto: foto final y salir
+
+/** pedir_detener - Manejador de SIGINT / SIGTERM */
+void pedir_detener(int senal) {
+    (void)senal;
+    detener = 1;
+}
+
+/**
+ * guardar_foto - Escribe la foto del estado en archivo_foto
+ *
+ * limpia = 0: foto periódica, en un proceso hijo (se saltea si la anterior
+ * no terminó). limpia = 1: al cerrar, en este proceso.
+ */
+void guardar_foto(int limpia) {
+    FotoEscritura w;
+    if (foto_abrir(&w, archivo_foto, !limpia) != 1) return;
+
+    FotoCabecera cab = foto_cabecera(limpia, alias_base, temas.cantidad, num_subs, 0);
+    foto_escribir(&w, &cab, sizeof(cab));
+    for (int id = 0; id < temas.cantidad; id++) {
+        FotoTema t;
+        memset(&t, 0, sizeof(t));
+        strcpy(t.nombre, tema_nombre(&temas, id));
+        t.seq = COLUMNA(seq_tema, unsigned int, id);
+        foto_escribir(&w, &t, sizeof(t));
+    }
+    for (int i = 0; i < num_subs; i++) {
+        FotoSub s = {SUB_TEMA(i), SUB_IP(i), SUB_PUERTO(i), 0, SUB_ALIAS(i), SUB_LIMITE(i)};
+        foto_escribir(&w, &s, sizeof(s));
+    }
+    if (foto_cerrar(&w) != 0) printf("[!] No se pudo escribir la foto %s\n", archivo_foto);
+}
+
+/** fotos_periodicas - Lanza una foto si pasaron foto_cada_ms desde la anterior */
+void fotos_periodicas(void) {
+    if (archivo_foto == NULL || reloj_ms() - ultima_foto_ms < (unsigned long long)foto_cada_ms) return;
+    ultima_foto_ms = reloj_ms();
+    guardar_foto(0);
+}
+
+/**
+ * cargar_foto - Recupera suscripciones y secuencias de archivo_foto
+ *
+ * Se llama con las tablas vacías. Retorna 0 si se cargó, -1 si no hay
+ * foto válida (el broker arranca vacío, como siempre).
+ */
+int cargar_foto(void) {
+    unsigned long long inicio = reloj_ms();
+    size_t tam;
+    const FotoCabecera *cab = foto_cargar(archivo_foto, &tam);
+    if (cab == NULL) return -1;
+
+    const FotoTema *t = foto_temas(cab);
+    const FotoSub *s = foto_subs(cab);
+    unsigned int salto = cab->limpia ? 0 : FOTO_SALTO_SEQ;
+    int n = (int)cab->num_subs;
+    for (unsigned int k = 0; k < cab->num_temas; k++) {
+        if (tema_id(t[k].nombre) != (int)k) {          // Tema repetido o sin memoria
+            printf("[!] Foto %s inconsistente: se ignora\n", archivo_foto);
+            foto_liberar(cab, tam);
+            iniciar_tablas();
+            return -1;
+        }
+        COLUMNA(seq_tema, unsigned int, k) = t[k].seq + (t[k].seq != 0 ? salto : 0);
+    }
+    if (columna_asegurar(&subs.tema, n) != 0 || columna_asegurar(&subs.ip, n) != 0 ||
+        columna_asegurar(&subs.puerto, n) != 0 || columna_asegurar(&subs.reproducir, n) != 0 ||
+        columna_asegurar(&subs.visto_ms, n) != 0 || columna_asegurar(&subs.alias, n) != 0 ||
+        columna_asegurar(&subs.limite, n) != 0 || columna_asegurar(&subs.confirmado, n) != 0) {
+        printf("[!] Sin memoria para las suscripciones de la foto\n");
+        n = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        SUB_TEMA(i) = s[i].tema;
+        SUB_IP(i) = s[i].ip;
+        SUB_PUERTO(i) = s[i].puerto;
+        SUB_REPRODUCIR(i) = 0;
+        SUB_VISTO(i) = inicio;
+        SUB_ALIAS(i) = s[i].alias;
+        SUB_LIMITE(i) = s[i].limite;
+        SUB_CONFIRMADO(i) = COLUMNA(seq_tema, unsigned int, s[i].tema);
+        if (es_miembro(t[s[i].tema].nombre)) unirse_grupo((int)s[i].tema);
+    }
+    num_subs = n;
+    alias_base = cab->alias_base;
+
+    printf("[foto] %s: %u temas y %d suscripciones en %llu ms (de hace %lld s)\n", archivo_foto,
+           cab->num_temas, num_subs, reloj_ms() - inicio, (long long)time(NULL) - cab->creada);
+    if (salto) printf("[foto] Sin cierre limpio: las secuencias siguen %u más adelante\n", salto);
+    foto_liberar(cab, tam);
+    return 0;
+}
+
+// ============================================================================
+// TRANSPORTE LOCAL (MEMORIA COMPARTIDA)
+// ============================================================================
+//
+// Con --local N cada publicación, además de salir por la red, se copia UNA
+// vez en el anillo de su tema (memoria_local.h, N ranuras por tema). Los
+// subscribers de esta misma máquina lo leen de ahí (subscriber_quic --local)
+// sin sendto() ni recvfrom(): el costo del broker no crece con la cantidad
+// de lectores locales. Los subscribers por red no cambian.
+//
+//   - Zona "/pubsub-quic-<puerto>" (el timbre compartido) y un anillo
+//     "/pubsub-quic-<puerto>-<hash>" por tema, creado con la primera
+//     publicación del tema.
+//   - Un solo escritor por anillo: sin hilos es el hilo principal; con
+//     --hilos N, el hilo dueño del tema.
+//   - No hay ACKs ni retransmisión: un lector que se atrasa más de N
+//     mensajes pierde los más viejos (y lo ve en su contador).
+//   - Una ranura (LOCAL_MAX_DATOS) tiene lugar para el contenido de
+//     cualquier Paquete: el lector local recibe el mensaje entero.
+// ============================================================================
+
+#if LOCAL_MAX_DATOS < QUIC_MAX_MENSAJE
+#error "Una ranura de memoria_local.h tiene que tener lugar para el contenido de un Paquete"
+#endif
+
+unsigned int ranuras_local = 0;        // 0 = sin transporte local
+char prefijo_local[32];
+ZonaLocal *zona_local = NULL;
+
+/** iniciar_local - Crea la zona del broker. Retorna 0 si OK. */
+int iniciar_local(int puerto) {
+    snprintf(prefijo_local, sizeof(prefijo_local), "/pubsub-quic-%d", puerto);
+    zona_local = local_zona_crear(prefijo_local);
+    return zona_local != NULL ? 0 : -1;
+}
+
+/** publicar_local - Copia el mensaje en el anillo del tema (lo crea si es nuevo) */
+void publicar_local(const char *tema, unsigned int seq, const char *mensaje) {
+    if (zona_local == NULL) return;
+    int id = tema_id(tema);
+    if (id < 0 || columna_asegurar(&anillos_tema, id + 1) != 0) return;
+    AnilloTema *t = columna_en(&anillos_tema, id);
+    if (!t->intentado) {
+        t->intentado = 1;
+        t->anillo = local_anillo_crear(zona_local, prefijo_local, tema, ranuras_local);
+        if (t->anillo == NULL) printf("[!] Sin anillo local para '%s' (sigue solo por red)\n", tema);
+    }
+    if (t->anillo != NULL && local_publicar(zona_local, t->anillo, seq, mensaje, strlen(mensaje)) != 0) {
+        printf("[!] Mensaje de '%s' demasiado largo para el anillo local (seq %u)\n", tema, seq);
+    }
+}
+
+// ============================================================================
+// ADMISIÓN - Límites de tasa y sobrecarga
+// ============================================================================
+//
+// Cualquier cliente podía inundar el broker: cada 'P' se publicaba apenas
+// llegaba y un publisher descontrolado dejaba a los demás sin servicio.
+// Con estas opciones las publicaciones pasan por cubetas de fichas
+// (admision.h) antes de asignarles seq:
+//
+//   --limite-publicador N[:ráfaga]  por dirección (ip:puerto) del publisher
+//   --limite-tema N[:ráfaga]        por tema (lo aplica el dueño del tema)
+//   --admision N[:ráfaga]           total del broker, y además se rechaza
+//                                   mientras la salida tiene más de
+//                                   SOBRECARGA_SALIDA paquetes esperando
+//                                   (con --hilos: una cola de hilo casi llena)
+//
+// N son publicaciones por segundo (cada línea de un lote cuenta). Un lote
+// rechazado no se publica ni se confirma: el publisher lo reintenta con su
+// RTO, así que el rechazo difiere la publicación en lugar de perderla.
+// Solo se limitan los 'P': 'S', 'U', 'H', 'R', 'T' y los ACK de crédito
+// pasan siempre, y las respuestas de control salen con sendto() directo,
+// sin esperar en la cola de salida detrás de las publicaciones.
+//
+// Cada rechazo se cuenta por motivo y cada REPORTE_ADMISION_MS se informa
+// el total y el publisher con más rechazos.
+// ============================================================================
+
+#define TABLA_PUBLICADORES   4096     // Cubetas de publishers (se reciclan las más viejas)
+#define SOBRECARGA_SALIDA    (COLA_SALIDA * 3 / 4)
+#define REPORTE_ADMISION_MS  5000
+#define MAX_LINEAS_LOTE      128      // Un lote de 500 bytes tiene a lo sumo 125 ("t:m\n")
+
+LimiteTasa limite_publicador, limite_tema, limite_global;   // tasa 0 = sin límite
+TablaCubetas cubetas_publicadores;    // Solo las usa el hilo de main()
+Cubeta cubeta_global;
+atomic_ulong admitidas, rechazos_publicador, rechazos_tema, rechazos_sobrecarga;
+unsigned long long ultimo_reporte_admision_ms = 0;
+
+/** contar_lineas - Publicaciones en un lote "tema:msg\ntema:msg" */
+int contar_lineas(const char *lote) {
+    int n = *lote != '\0';
+    for (const char *p = strchr(lote, '\n'); p != NULL; p = strchr(p + 1, '\n')) {
+        if (p[1] != '\0') n++;
+    }
+    return n;
+}
+
+/** sobrecargado - ¿La salida (o la entrada de algún hilo) está casi llena? */
+int sobrecargado(void) {
+    if (num_hilos == 0) return plan_pendientes(&salida) > SOBRECARGA_SALIDA;
+    for (int h = 0; h < num_hilos; h++) {
+        if (anillo_libres(&colas_hilos[h]) < colas_hilos[h].capacidad / 4) return 1;
+    }
+    return 0;
+}
+
+/**
+ * admitir_publicacion - Hilo de main(): ¿entra este 'P' del publisher?
+ *
+ * Controla la sobrecarga, la cubeta del publisher y la global, en ese
+ * orden; si la global rechaza, el publisher recupera sus fichas.
+ */
+int admitir_publicacion(const Paquete *pkt, struct sockaddr_in cliente) {
+    if (limite_publicador.tasa <= 0 && limite_global.tasa <= 0) return 1;
+    unsigned long long ahora = reloj_ms();
+    int lineas = contar_lineas(pkt->mensaje);
+
+    if (limite_global.tasa > 0 && sobrecargado()) {
+        atomic_fetch_add(&rechazos_sobrecarga, 1);
+        return 0;
+    }
+    EntradaCubeta *e = NULL;
+    if (limite_publicador.tasa > 0) {
+        unsigned long long clave = (unsigned long long)cliente.sin_addr.s_addr << 16 | cliente.sin_port;
+        int admitida;
+        e = tabla_cubetas_tomar(&cubetas_publicadores, clave, &limite_publicador, lineas, ahora, &admitida);
+        if (!admitida) {
+            atomic_fetch_add(&rechazos_publicador, 1);
+            return 0;
+        }
+    }
+    if (limite_global.tasa > 0 && !cubeta_tomar(&cubeta_global, &limite_global, lineas, ahora)) {
+        if (e != NULL) cubeta_devolver(&e->cubeta, lineas);
+        atomic_fetch_add(&rechazos_sobrecarga, 1);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * admitir_temas - Dueño de los temas: ¿todos los temas del lote tienen
+ * fichas para sus líneas?
+ *
+ * Es todo o nada: si un tema está sobre su límite no se gasta nada y el
+ * lote entero espera al reintento del publisher.
+ */
+int admitir_temas(const char *lote, int desde_enlace) {
+    if (limite_tema.tasa <= 0) return 1;
+    int ids[MAX_LINEAS_LOTE], cuenta[MAX_LINEAS_LOTE], distintos = 0;
+    unsigned long long ahora = reloj_ms();
+
+    for (const char *linea = lote; linea != NULL && *linea != '\0'; ) {
+        const char *fin = strchr(linea, '\n');
+        const char *sep = strchr(linea, ':');
+        char tema[TABLA_MAX_TEMA];
+        if (sep != NULL && sep != linea && (fin == NULL || sep < fin) && sep - linea < TABLA_MAX_TEMA) {
+            memcpy(tema, linea, (size_t)(sep - linea));
+            tema[sep - linea] = '\0';
+            const char *nombre = tema[0] == ALIAS_PREFIJO ? tema_de_alias(tema) : tema;
+            int id = nombre != NULL && (desde_enlace || nodo_duenio(nombre) < 0) ? tema_id(nombre) : -1;
+            if (id >= 0 && columna_asegurar(&cubetas_tema, id + 1) == 0) {
+                int k = 0;
+                while (k < distintos && ids[k] != id) k++;
+                if (k == distintos) {
+                    ids[distintos] = id;
+                    cuenta[distintos++] = 0;
+                }
+                cuenta[k]++;
+            }
+        }
+        linea = fin != NULL ? fin + 1 : NULL;
+    }
+
+    for (int k = 0; k < distintos; k++) {
+        if (!cubeta_alcanza(&COLUMNA(cubetas_tema, Cubeta, ids[k]), &limite_tema, cuenta[k], ahora)) {
+            atomic_fetch_add(&rechazos_tema, 1);
+            return 0;
+        }
+    }
+    for (int k = 0; k < distintos; k++) {
+        cubeta_tomar(&COLUMNA(cubetas_tema, Cubeta, ids[k]), &limite_tema, cuenta[k], ahora);
+    }
+    return 1;
+}
+
+/** reportar_admision - Cada REPORTE_ADMISION_MS, si hubo rechazos */
+void reportar_admision(void) {
+    static unsigned long ya_reportados = 0;
+    unsigned long long ahora = reloj_ms();
+    if (ahora - ultimo_reporte_admision_ms < REPORTE_ADMISION_MS) return;
+    ultimo_reporte_admision_ms = ahora;
+
+    unsigned long pub = atomic_load(&rechazos_publicador), tema = atomic_load(&rechazos_tema);
+    unsigned long sobre = atomic_load(&rechazos_sobrecarga);
+    if (pub + tema + sobre == ya_reportados) return;
+    ya_reportados = pub + tema + sobre;
+    printf("[admision] Lotes admitidos=%lu rechazados: publicador=%lu tema=%lu sobrecarga=%lu\n",
+           atomic_load(&admitidas), pub, tema, sobre);
+    if (cubetas_publicadores.capacidad > 0) {
+        EntradaCubeta peor = tabla_cubetas_peor(&cubetas_publicadores);
+        if (peor.rechazos > 0) {
+            struct in_addr ip;
+            ip.s_addr = (unsigned int)(peor.clave >> 16);
+            printf("[admision] Más rechazado: %s:%u (%lu lotes)\n", inet_ntoa(ip),
+                   ntohs((unsigned short)(peor.clave & 0xFFFF)), peor.rechazos);
+        }
+    }
+}
+
+// ============================================================================
+// PROCESAMIENTO DE PAQUETES
+// ============================================================================
+
+/**
+ * procesar_paquete - Atiende un paquete según su tipo
+ * 
+ * Tipos de paquetes manejados:
+ *   
+ *   TIPO 'S' - SUSCRIPCIÓN:
+ *     Subscriber → Broker
+ *     pkt.mensaje = "Colombia vs Argentina" (o "Colombia vs Argentina:57"
+ *     para reanudar después del seq 57)
+ *     Acción: agregar_suscripcion(), enviar ACK y el estado retenido (o
+ *     iniciar la reproducción del rango faltante)
+ *   
+ *   TIPO 'P' - PUBLICACIÓN:
+ *     Publisher → Broker
+ *     pkt.mensaje = "Colombia vs Argentina:Gol"
+ *     Acción: publicar() a suscriptores y enviar ACK
+ *   
+ *   TIPO 'R' - RETRANSMISIÓN:
+ *     Subscriber → Broker
+ *     pkt.seq = 5 (mensaje perdido)
+ *     pkt.mensaje = "Colombia vs Argentina" (tema esperado)
+ *     Acción: buscar seq=5 del tema en historial y retransmitir
+ *   
+ *   TIPO 'U' - BAJA:
+ *     Subscriber → Broker
+ *     pkt.mensaje = "Colombia vs Argentina"
+ *     Acción: quitar la suscripción y enviar ACK
+ *   
+ *   TIPO 'H' - LATIDO:
+ *     Subscriber → Broker (cada 10 s)
+ *     Acción: renovar sus suscripciones (sin respuesta)
+ *   
+ *   TIPO 'T' - ALIAS:
+ *     Publisher/Subscriber → Broker
+ *     pkt.mensaje = "Colombia vs Argentina"
+ *     Acción: responder "id:tema"; las líneas "#id:contenido" de un 'P'
+ *     se resuelven por índice (ver ALIAS NUMÉRICOS DE TEMA)
+ *   
+ *   TIPO 'A' - ACK:
+ *     Subscriber → Broker (confirmación)
+ *     pkt.mensaje = "Colombia vs Argentina:120" (crédito hasta seq 120)
+ *     Acción: actualizar el crédito (no requiere respuesta)
+ * 
+ * En modo cluster, si el tema pertenece a otro nodo el paquete se reenvía
+ * por el enlace en lugar de atenderse aquí. desde_enlace = 1 indica que el
+ * paquete ya fue reenviado por otro nodo (se atiende siempre localmente y
+ * la publicación no se confirma: ya la confirmó el nodo que la recibió).
+ * 
+ * Parámetros:
+ *   @param sock: Socket UDP del broker
+ *   @param pkt: Paquete recibido (mensaje terminado en '\0')
+ *   @param cliente: Dirección UDP del cliente que originó el paquete
+ *   @param desde_enlace: 1 si llegó reenviado por otro broker del cluster
+ *   @param reparto: Lote 'P' partido entre hilos (ver HILOS DE TRABAJO), o NULL
+ */
+void procesar_paquete(SOCKET sock, Paquete *pkt, struct sockaddr_in cliente, int desde_enlace,
+                      Reparto *reparto) {
+    Paquete ack;
+    socklen_t tam_cliente = sizeof(cliente);
+    
+    printf("\n[RX] Tipo='%c' Seq=%u\n", pkt->tipo, pkt->seq);
+    
+    // ====================================================================
+    // CASO 1: SUSCRIPCIÓN (tipo 'S')
+    // ====================================================================
+    // Subscriber envía: pkt.mensaje = "Colombia vs Argentina"
+    // Acción: Agregar a lista de suscriptores y confirmar con ACK
+    if (pkt->tipo == 'S') {
+        // "tema:ultimo_seq" = reanudar después de ese seq (ver REANUDACIÓN)
+        char *reanudar = strchr(pkt->mensaje, ':');
+        unsigned int desde = 0;
+        if (reanudar != NULL) {
+            *reanudar = '\0';
+            desde = (unsigned int)strtoul(reanudar + 1, NULL, 10);
+        }
+        
+        int duenio = desde_enlace ? -1 : nodo_duenio(pkt->mensaje);
+        if (duenio >= 0) {
+            if (reanudar != NULL) *reanudar = ':';   // El dueño también reanuda
+            // El dueño registra la suscripción y confirma directo al subscriber
+            if (reenviar_a_nodo(duenio, pkt, &cliente) == 0) {
+                printf("[cluster] Suscripción a '%s' reenviada al nodo %s\n", pkt->mensaje, nodos[duenio].id);
+            }
+            return;
+        }
+        
+        printf("     Suscripción a: %s\n", pkt->mensaje);
+        
+        // Registrar suscriptor en la lista (una reanudación o un 'S'
+        // reenviado por el subscriber no lo duplican)
+        int idx = buscar_suscripcion(pkt->mensaje, cliente);
+        if (idx < 0) {
+            agregar_suscripcion(pkt->mensaje, cliente);
+            idx = buscar_suscripcion(pkt->mensaje, cliente);
+            // Miembro de un grupo que reanuda desde otra dirección
+            if (idx >= 0 && reanudar != NULL && es_miembro(sub_tema(idx))) seguir_miembro(idx, desde);
+        } else {
+            SUB_VISTO(idx) = reloj_ms();
+        }
+        
+        // Enviar ACK de confirmación
+        ack.seq = pkt->seq;  // Eco del seq recibido
+        ack.tipo = 'A';
+        strcpy(ack.mensaje, "OK");
+        if (reanudar != NULL && idx >= 0) {
+            // "OK:<primer seq>" = desde dónde le llega la reproducción
+            sprintf(ack.mensaje, "OK:%u", iniciar_reproduccion(idx, desde));
+        }
+        sendto(sock, (char*)&ack, sizeof(Paquete), 0,
+               (struct sockaddr*)&cliente, tam_cliente);
+        printf("[<-] ACK enviado\n");
+        
+        // Ráfaga con el estado actual del tema (paquetes 'V'); quien reanuda
+        // ya recibe todo lo que le faltó en la reproducción
+        if (reanudar == NULL) enviar_retenidos(sock, pkt->mensaje, &cliente);
+        
+    // ====================================================================
+    // CASO 2: PUBLICACIÓN (tipo 'P')
+    // ====================================================================
+    // Publisher envía: pkt.mensaje = "TEMA:contenido"
+    // Acción: Distribuir a suscriptores del tema y confirmar con ACK
+    } else if (pkt->tipo == 'P') {
+        // Un paquete puede traer un lote: una publicación por línea
+        // "TEMA:contenido\nTEMA:contenido". Un paquete sin '\n' es
+        // simplemente un lote de una sola publicación.
+        int publicadas = 0;
+        int fallidas = 0;
+        Paquete remotos[MAX_NODOS];       // Sub-lotes para temas de otros nodos
+        int hay_remotos = 0;
+        int repetido = -1;                // QoS 2: ¿lote ya publicado? (-1 = sin consultar)
+        char *alias_perdido = NULL;       // Primer "#id" desconocido del lote
+        
+        char *linea = pkt->mensaje;
+        if (!admitir_temas(pkt->mensaje, desde_enlace)) {
+            printf("[!] Lote rechazado: un tema superó su límite (--limite-tema)\n");
+            fallidas++;                   // Sin ACK: el publisher lo reintenta
+            linea = NULL;
+        } else {
+            atomic_fetch_add(&admitidas, 1);
+        }
+        while (linea != NULL && *linea != '\0') {
+            char *fin = strchr(linea, '\n');
+            if (fin != NULL) *fin = '\0';
+            
+            // Parsear línea: formato "TEMA:contenido"
+            char *sep = strchr(linea, ':');
+            if (sep != NULL && sep != linea && sep[1] != '\0') {
+                *sep = '\0';
+                char *tema = linea;      // Extraer tema
+                char *msg = sep + 1;     // Extraer contenido
+                
+                // "#id:contenido": el tema sale de la tabla por índice
+                if (tema[0] == ALIAS_PREFIJO) {
+                    const char *nombre = tema_de_alias(tema);
+                    if (nombre == NULL) {
+                        printf("[!] Alias desconocido: %s\n", tema);
+                        if (alias_perdido == NULL) alias_perdido = tema;
+                        fallidas++;
+                        linea = fin != NULL ? fin + 1 : NULL;
+                        continue;
+                    }
+                    // El publisher arma el lote midiendo los temas en texto:
+                    // si expandido no entra en un Paquete, el lote es inválido
+                    if (strlen(nombre) + 1 + strlen(msg) >= QUIC_MAX_MENSAJE) {
+                        printf("[!] Publicación con alias %s demasiado larga con el tema en texto\n", tema);
+                        fallidas++;       // Sin ACK
+                        linea = fin != NULL ? fin + 1 : NULL;
+                        continue;
+                    }
+                    tema = (char *)nombre;
+                }
+                
+                int duenio = desde_enlace ? -1 : nodo_duenio(tema);
+                if (duenio >= 0) {
+                    // Tema de otro nodo: agregar la línea a su sub-lote
+                    Paquete *r = &remotos[duenio];
+                    if (!(hay_remotos & (1 << duenio))) {
+                        r->seq = pkt->seq;
+                        r->tipo = 'P';
+                        r->mensaje[0] = '\0';
+                        hay_remotos |= 1 << duenio;
+                    }
+                    // Partir el sub-lote repetiría el seq del lote (QoS 2 lo
+                    // tomaría por duplicado en el dueño): si no entra, el
+                    // lote falla sin ACK
+                    size_t largo = strlen(r->mensaje);
+                    if (largo + (largo > 0) + strlen(tema) + 1 + strlen(msg) >= sizeof(r->mensaje)) {
+                        printf("[!] Sub-lote para el nodo %s lleno: lote sin ACK\n", nodos[duenio].id);
+                        fallidas++;
+                        linea = fin != NULL ? fin + 1 : NULL;
+                        continue;
+                    }
+                    if (largo > 0) strcat(r->mensaje, "\n");
+                    strcat(r->mensaje, tema);
+                    strcat(r->mensaje, ":");
+                    strcat(r->mensaje, msg);
+                } else {
+                    // El camino de distribución depende del QoS del tema
+                    int nivel = qos_de(tema);
+                    if (nivel == 2 && repetido < 0) repetido = lote_repetido(&cliente, pkt->seq);
+                    
+                    if (nivel == 0) {
+                        publicar_sin_garantias(sock, tema, msg);
+                    } else if (nivel == 2 && repetido) {
+                        printf("     Duplicado (QoS 2): tema='%s' ya publicado\n", tema);
+                    } else {
+                        printf("     Publicación: tema='%s' msg='%s'\n", tema, msg);
+                        
+                        // Distribuir mensaje a todos los suscriptores del tema
+                        publicar(sock, tema, msg);
+                    }
+                }
+                publicadas++;
+            } else {
+                printf("[!] ERROR: Formato incorrecto de publicación\n");
+            }
+            linea = fin != NULL ? fin + 1 : NULL;
+        }
+        
+        for (int n = 0; n < num_nodos; n++) {
+            if (!(hay_remotos & (1 << n))) continue;
+            if (reenviar_a_nodo(n, &remotos[n], &cliente) == 0) {
+                printf("[cluster] Publicaciones reenviadas al nodo %s\n", nodos[n].id);
+            } else {
+                fallidas++;
+            }
+        }
+        
+        // Alias desconocido: el publisher olvida sus alias y reenvía el
+        // lote con los temas en texto
+        if (alias_perdido != NULL && !desde_enlace) {
+            ack.seq = 0;
+            ack.tipo = PKT_ALIAS;
+            snprintf(ack.mensaje, sizeof(ack.mensaje), "%s", alias_perdido);
+            sendto(sock, (char*)&ack, paquete_tam(&ack), 0,
+                   (struct sockaddr*)&cliente, tam_cliente);
+        }
+        
+        // Lote partido entre hilos: confirma el último que termina, con el
+        // total de todas las partes
+        if (reparto != NULL) {
+            atomic_fetch_add(&reparto->publicadas, publicadas);
+            atomic_fetch_add(&reparto->fallidas, fallidas);
+            if (atomic_fetch_sub(&reparto->pendientes, 1) != 1) return;
+            publicadas = atomic_load(&reparto->publicadas);
+            fallidas = atomic_load(&reparto->fallidas);
+            free(reparto);
+        }
+        
+        // Sin ACK si algún reenvío falló: el publisher reintenta el lote
+        if (publicadas > 0 && fallidas == 0 && !desde_enlace) {
+            // Enviar UN ACK por paquete (lote) para confirmar recepción
+            ack.seq = pkt->seq;  // Eco del seq del publisher
+            ack.tipo = 'A';
+            strcpy(ack.mensaje, "OK");
+            sendto(sock, (char*)&ack, sizeof(Paquete), 0,
+                   (struct sockaddr*)&cliente, tam_cliente);
+            printf("[<-] ACK enviado (%d publicación(es))\n", publicadas);
+        }
+        
+    // ====================================================================
+    // CASO 3: RETRANSMISIÓN (tipo 'R')
+    // ====================================================================
+    // Subscriber envía:
+    //   pkt.seq = 5 (mensaje perdido)
+    //   pkt.mensaje = "Colombia vs Argentina" (tema esperado)
+    // Acción: Buscar seq=5 del tema en historial y retransmitir
+    } else if (pkt->tipo == 'R') {
+        unsigned int seq_solicitado = pkt->seq;
+        char tema_solicitado[50];
+        strncpy(tema_solicitado, pkt->mensaje, sizeof(tema_solicitado) - 1);  // Tema esperado por subscriber
+        tema_solicitado[sizeof(tema_solicitado) - 1] = '\0';
+        
+        int duenio = desde_enlace ? -1 : nodo_duenio(tema_solicitado);
+        if (duenio >= 0) {
+            reenviar_a_nodo(duenio, pkt, &cliente);   // El dueño tiene el historial
+            return;
+        }
+        
+        printf("     Solicitud de retransmisión: seq=%u tema='%s'\n", 
+               seq_solicitado, tema_solicitado);
+        
+        if (!retransmitir(sock, tema_solicitado, seq_solicitado, cliente)) {
+            // Mensaje no encontrado en historial (muy antiguo o nunca existió)
+            printf("[!] Mensaje seq=%u de '%s' no encontrado en historial\n",
+                   seq_solicitado, tema_solicitado);
+        }
+        
+    // ====================================================================
+    // CASO 4: BAJA (tipo 'U')
+    // ====================================================================
+    // Subscriber envía: pkt.mensaje = "Colombia vs Argentina"
+    // Acción: quitar la suscripción y confirmar con ACK (eco del seq)
+    } else if (pkt->tipo == PKT_BAJA) {
+        int duenio = desde_enlace ? -1 : nodo_duenio(pkt->mensaje);
+        if (duenio >= 0) {
+            reenviar_a_nodo(duenio, pkt, &cliente);   // El dueño tiene la suscripción
+            return;
+        }
+        
+        int idx = buscar_suscripcion(pkt->mensaje, cliente);
+        if (idx >= 0) {
+            quitar_suscripcion(idx);
+            printf("[-] Baja del tema: %s\n", pkt->mensaje);
+        }
+        // ACK aunque ya no estuviera: el subscriber reintenta hasta recibirlo
+        ack.seq = pkt->seq;
+        ack.tipo = 'A';
+        strcpy(ack.mensaje, "OK");
+        sendto(sock, (char*)&ack, paquete_tam(&ack), 0,
+               (struct sockaddr*)&cliente, tam_cliente);
+        
+    // ====================================================================
+    // CASO 5: LATIDO (tipo 'H')
+    // ====================================================================
+    // Subscriber envía periódicamente un 'H' (sin tema) para no expirar
+    } else if (pkt->tipo == PKT_LATIDO) {
+        renovar_suscripciones(cliente);
+        procesar_acks(sock, pkt->mensaje, cliente);   // ACKs que viajan en el latido
+        
+        // En el cluster sus temas pueden ser de cualquier nodo: avisar a todos
+        if (!desde_enlace) {
+            for (int n = 0; n < num_nodos; n++) {
+                if (n != nodo_propio) reenviar_a_nodo(n, pkt, &cliente);
+            }
+        }
+        
+    // ====================================================================
+    // CASO 6: ALIAS (tipo 'T')
+    // ====================================================================
+    // Cliente envía: pkt.mensaje = "Colombia vs Argentina"
+    // Acción: responder "id:tema" (eco del seq). Si es un subscriber del
+    // tema, sus publicaciones pasan a llegar como "#id:contenido".
+    } else if (pkt->tipo == PKT_ALIAS) {
+        unsigned int id = alias_de(pkt->mensaje);
+        int idx = id != 0 ? buscar_suscripcion(pkt->mensaje, cliente) : -1;
+        if (idx >= 0 && SUB_ALIAS(idx) != id) {
+            SUB_ALIAS(idx) = id;
+            replica_registrar('S', id, sub_tema(idx), "", &cliente);
+        }
+        printf("     Alias de '%s': %u\n", pkt->mensaje, id);
+        
+        ack.seq = pkt->seq;
+        ack.tipo = PKT_ALIAS;
+        snprintf(ack.mensaje, sizeof(ack.mensaje), "%u:%.49s", id, pkt->mensaje);
+        sendto(sock, (char*)&ack, paquete_tam(&ack), 0,
+               (struct sockaddr*)&cliente, tam_cliente);
+        
+    // ====================================================================
+    // CASO 7: ACK (tipo 'A')
+    // ====================================================================
+    // Subscriber envía: una línea "tema:limite:acumulado[:mapa]" por tema
+    // Acción: ampliar su crédito (la reproducción retoma si estaba en
+    // pausa) y retransmitir los huecos que marque el mapa
+    } else if (pkt->tipo == 'A') {
+        procesar_acks(sock, pkt->mensaje, cliente);
+    }
+}
+
+// ============================================================================
+// HILOS DE TRABAJO - Reparto por tema y bucle de cada hilo
+// ============================================================================
+
+typedef struct {
+    SOCKET sock;
+    int indice;
+} ArgHilo;
+
+/**
+ * hilo_de_tema - Hilo dueño del tema con que empieza texto (hasta ':')
+ *
+ * Así "tema", "tema:ultimo_seq", "tema:limite" y "tema:contenido" van al
+ * mismo hilo. "#id" va al hilo que asignó el alias y "$grupo/g/T" al de T
+ * (el grupo se reparte en el hilo que publica T).
+ */
+int hilo_de_tema(const char *texto) {
+    if (texto[0] == ALIAS_PREFIJO) {
+        unsigned long id = strtoul(texto + 1, NULL, 10);
+        return id < alias_base ? 0 : (int)((id - alias_base) % (unsigned long)num_hilos);
+    }
+    char tema[QUIC_MAX_TEMA];
+    size_t largo = strcspn(texto, ":");
+    if (largo >= sizeof(tema)) largo = sizeof(tema) - 1;
+    memcpy(tema, texto, largo);
+    tema[largo] = '\0';
+    const char *real = grupo_tema(tema);
+    return (int)(tabla_hash(real != NULL ? real : tema) % (unsigned int)num_hilos);
+}
+
+/** descarte_hilo - Cuenta un paquete que no entró en la cola del hilo h */
+void descarte_hilo(int h) {
+    if (colas_hilos[h].descartados % 100 == 1) {
+        printf("[hilos] Cola del hilo %d llena: %lu paquetes descartados\n",
+               h, colas_hilos[h].descartados);
+    }
+}
+
+/**
+ * repartir_paquete - Pasa un paquete recibido al hilo dueño de su tema
+ *
+ * Un lote 'P' con temas de varios hilos se parte en un sub-lote por hilo
+ * (mismo seq), y un 'A' con ACKs de varios temas en una parte por hilo.
+ * Antes de encolar se comprueba que todas las colas tengan lugar: el lote
+ * entra completo o no entra, y sin ACK el publisher lo reenvía entero.
+ */
+void repartir_paquete(Paquete *pkt, struct sockaddr_in cliente) {
+    static Trabajo partes[MAX_HILOS];
+    int largos[MAX_HILOS];
+    unsigned long long usados = 0;     // Bit h: el lote tiene temas del hilo h
+    int num_partes = 0;
+    Trabajo t;
+
+    t.cliente = cliente;
+    t.reparto = NULL;
+    if (pkt->tipo == PKT_LATIDO) {
+        t.pkt = *pkt;
+        for (int h = 0; h < num_hilos; h++) {
+            if (anillo_poner(&colas_hilos[h], &t) != 0) descarte_hilo(h);
+        }
+        return;
+    }
+    if ((pkt->tipo != 'P' && pkt->tipo != 'A') || pkt->mensaje[0] == '\0') {
+        int h = hilo_de_tema(pkt->mensaje);
+        t.pkt = *pkt;
+        if (anillo_poner(&colas_hilos[h], &t) != 0) descarte_hilo(h);
+        return;
+    }
+
+    char *linea = pkt->mensaje;
+    while (linea != NULL && *linea != '\0') {
+        char *fin = strchr(linea, '\n');
+        if (fin != NULL) *fin = '\0';
+        int h = hilo_de_tema(linea);
+        Paquete *p = &partes[h].pkt;
+        if (!(usados & (1ULL << h))) {
+            usados |= 1ULL << h;
+            num_partes++;
+            p->seq = pkt->seq;
+            p->tipo = pkt->tipo;
+            largos[h] = 0;
+        } else {
+            p->mensaje[largos[h]++] = '\n';
+        }
+        size_t n = strlen(linea);          // Las partes suman menos que el lote: entran
+        memcpy(p->mensaje + largos[h], linea, n + 1);
+        largos[h] += (int)n;
+        linea = fin != NULL ? fin + 1 : NULL;
+    }
+
+    for (int h = 0; h < num_hilos; h++) {
+        if ((usados & (1ULL << h)) && anillo_libres(&colas_hilos[h]) == 0) {
+            colas_hilos[h].descartados++;
+            descarte_hilo(h);
+            return;
+        }
+    }
+    Reparto *r = NULL;
+    if (num_partes > 1 && pkt->tipo == 'P') {
+        r = malloc(sizeof(Reparto));
+        if (r == NULL) return;
+        atomic_init(&r->pendientes, num_partes);
+        atomic_init(&r->publicadas, 0);
+        atomic_init(&r->fallidas, 0);
+    }
+    for (int h = 0; h < num_hilos; h++) {
+        if (!(usados & (1ULL << h))) continue;
+        partes[h].cliente = cliente;
+        partes[h].reparto = r;
+        anillo_poner(&colas_hilos[h], &partes[h]);
+    }
+}
+
+/**
+ * hilo_trabajo - Bucle de un hilo de trabajo
+ *
+ * Como el bucle de main() sin hilos, pero con sus propios temas: procesa
+ * lo que llega por su cola y después envía su cola de salida, avanza sus
+ * reproducciones y expira sus suscripciones. Sin nada que hacer duerme en
+ * la cola (anillo_esperar).
+ */
+void hilo_trabajo(void *arg) {
+    ArgHilo *a = arg;
+    SOCKET sock = a->sock;
+    Anillo *cola = &colas_hilos[a->indice];
+    Trabajo t;
+
+    hilo_propio = a->indice;
+    free(a);
+    iniciar_tablas();
+    plan_iniciar(&salida, COLA_SALIDA);
+    while (1) {
+        int procesados = 0;
+        while (procesados < COLA_HILO && anillo_sacar(cola, &t)) {
+            procesar_paquete(sock, &t.pkt, t.cliente, 0, t.reparto);
+            procesados++;
+        }
+        vaciar_salida(sock);
+        avanzar_reproducciones(sock);
+        expirar_suscripciones();
+        rebalancear_grupos(sock);
+        if (procesados == 0) {
+            // Con envíos pendientes (socket lleno) o reproducciones se vuelve pronto
+            int pendiente = plan_pendientes(&salida) > 0 || reproducciones_activas > 0;
+            anillo_esperar(cola, pendiente ? PAUSA_REPRODUCCION_MS : 200);
+        }
+    }
+}
+
+/** iniciar_hilos - Crea las colas y los num_hilos hilos de trabajo. Retorna 0 si OK. */
+int iniciar_hilos(SOCKET sock) {
+    for (int h = 0; h < num_hilos; h++) {
+        Hilo hilo;
+        ArgHilo *a = malloc(sizeof(ArgHilo));
+        if (a == NULL || anillo_iniciar(&colas_hilos[h], COLA_HILO, sizeof(Trabajo)) != 0) return -1;
+        a->sock = sock;
+        a->indice = h;
+        if (hilo_crear(&hilo, hilo_trabajo, a) != 0) return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// FUNCIÓN PRINCIPAL
+// ============================================================================
+
+/**
+ * main - Punto de entrada del broker QUIC
+ * 
+ * Uso:
+ *   broker_quic.exe                               (broker independiente, puerto 7000)
+ *   broker_quic.exe --cluster cluster.txt --nodo A   (nodo de un cluster)
+ *   broker_quic.exe --replicacion 7200            (líder: acepta un seguidor)
+ *   broker_quic.exe --seguir 127.0.0.1:7200       (seguidor del líder)
+ *   broker_quic.exe --qos 0:Telemetria --qos 2:Goles  (QoS por tema)
+ *   broker_quic.exe --prioridad 0:Goles --prioridad 2:Telemetria  (prioridad de salida)
+ *   broker_quic.exe --gso 0                        (sin GSO/GRO aunque el kernel los soporte)
+ *   broker_quic.exe --puerto 7001                  (otro puerto, ej: detrás de simulador_red)
+ *   broker_quic.exe --hilos 4                      (temas repartidos en 4 hilos de trabajo)
+ *   broker_quic.exe --local 1024                   (anillos de 1024 mensajes por tema para
+ *                                                   los subscribers de esta máquina; POSIX)
+ *   broker_quic.exe --foto broker.foto [--foto-cada 5000]  (foto del estado cada 5 s;
+ *                                                   al arrancar se recupera)
+ *   broker_quic.exe --limite-publicador 200 --limite-tema 1000:2000 --admision 5000
+ *                                                  (publicaciones por segundo; ver ADMISIÓN)
+ *   broker_quic.exe --grupo clave:estadisticas     (política de un grupo de consumidores;
+ *                                                   ver GRUPOS DE CONSUMIDORES)
+ * 
+ * Ciclo principal del broker:
+ *   0. Cargar la foto si hay; si es seguidor, replicar al líder hasta que
+ *      este caiga
+ *   1. Inicializar socket UDP (puerto 7000, o el del nodo en el cluster)
+ *   2. Esperar actividad con select(): datagramas de clientes y, en modo
+ *      cluster, tramas de los enlaces con los otros brokers
+ *   3. Procesar cada paquete con procesar_paquete() (con --hilos N,
+ *      pasarlo al hilo dueño de su tema con repartir_paquete())
+ * 
+ * Retorna:
+ *   0 al detenerse con --foto (sin --foto nunca sale del bucle while)
+ */
+int main(int argc, char *argv[]) {
+    // Variables locales
+    SOCKET sock;                    // Socket UDP del broker
+    struct sockaddr_in servidor, cliente;  // Direcciones de red
+    Paquete pkt;                   // Paquete de entrada
+    const char *archivo_cluster = NULL;
+    const char *id_nodo = NULL;
+    const char *lider = NULL;
+    int puerto_replica = 0;
+    int puerto = PUERTO;
+    int pedir_gso = 1;
+    static char entrada[UDP_MAX_LOTE];   // Recepción (con GRO, varios datagramas juntos)
+    int segmento;
+    
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--cluster") == 0) archivo_cluster = argv[i + 1];
+        else if (strcmp(argv[i], "--nodo") == 0) id_nodo = argv[i + 1];
+        else if (strcmp(argv[i], "--replicacion") == 0) puerto_replica = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seguir") == 0) lider = argv[i + 1];
+        else if (strcmp(argv[i], "--qos") == 0 && fijar_qos(argv[i + 1]) != 0) {
+            printf("--qos espera nivel:tema (nivel 0, 1 o 2)\n");
+            return 1;
+        } else if (strcmp(argv[i], "--prioridad") == 0 && plan_fijar_clase(argv[i + 1]) != 0) {
+            printf("--prioridad espera clase:tema (clase 0, 1 o 2)\n");
+            return 1;
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            pedir_gso = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--puerto") == 0) {
+            puerto = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--hilos") == 0) {
+            num_hilos = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--limite-publicador") == 0 && limite_parsear(&limite_publicador, argv[i + 1]) != 0) {
+            printf("--limite-publicador espera publicaciones por segundo[:ráfaga]\n");
+            return 1;
+        } else if (strcmp(argv[i], "--limite-tema") == 0 && limite_parsear(&limite_tema, argv[i + 1]) != 0) {
+            printf("--limite-tema espera publicaciones por segundo[:ráfaga]\n");
+            return 1;
+        } else if (strcmp(argv[i], "--admision") == 0 && limite_parsear(&limite_global, argv[i + 1]) != 0) {
+            printf("--admision espera publicaciones por segundo[:ráfaga]\n");
+            return 1;
+        } else if (strcmp(argv[i], "--grupo") == 0 && grupo_fijar_politica(argv[i + 1]) != 0) {
+            printf("--grupo espera politica:grupo (turnos, carga o clave)\n");
+            return 1;
+        } else if (strcmp(argv[i], "--foto") == 0) {
+            archivo_foto = argv[i + 1];
+        } else if (strcmp(argv[i], "--foto-cada") == 0) {
+            foto_cada_ms = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--local") == 0) {
+            ranuras_local = (unsigned int)atoi(argv[i + 1]);
+            if (ranuras_local == 0 || (ranuras_local & (ranuras_local - 1)) != 0) {
+                printf("--local espera la cantidad de ranuras por tema (potencia de 2)\n");
+                return 1;
+            }
+        }
+    }
+    if (num_hilos < 0 || num_hilos > MAX_HILOS) {
+        printf("--hilos espera de 0 a %d\n", MAX_HILOS);
+        return 1;
+    }
+    if (num_hilos > 0 && (archivo_cluster != NULL || id_nodo != NULL || lider != NULL || puerto_replica > 0 ||
+                          archivo_foto != NULL)) {
+        printf("--hilos no se combina con --cluster, --replicacion, --seguir ni --foto\n");
+        return 1;
+    }
+    if (foto_cada_ms <= 0) {
+        printf("--foto-cada espera milisegundos\n");
+        return 1;
+    }
+    if (limite_publicador.tasa > 0 && tabla_cubetas_iniciar(&cubetas_publicadores, TABLA_PUBLICADORES) != 0) {
+        printf("[!] Sin memoria para las cubetas de --limite-publicador\n");
+        return 1;
+    }
+
+    // Inicializar Winsock (requerido en Windows para sockets)
+    red_iniciar();
+    iniciar_tablas();
+
+    if (archivo_cluster != NULL || id_nodo != NULL) {
+        if (archivo_cluster == NULL || id_nodo == NULL ||
+            cargar_cluster(archivo_cluster, id_nodo) != 0 || iniciar_cluster() != 0) {
+            printf("Uso: broker_quic.exe --cluster <archivo> --nodo <id>\n");
+            return 1;
+        }
+        puerto = ntohs(nodos[nodo_propio].udp.sin_port);
+    }
+    
+    // Base de los alias de esta ejecución (el seguidor adopta la del líder)
+    srand((unsigned int)reloj_ms());
+    alias_base = (unsigned int)(rand() % 900 + 100) * 100;
+    
+    // Reinicio en caliente: suscripciones, secuencias y alias de la foto
+    if (archivo_foto != NULL) {
+        if (cargar_foto() != 0) printf("[foto] Sin foto válida en %s: arranque vacío\n", archivo_foto);
+        ultima_foto_ms = reloj_ms();
+        signal(SIGINT, pedir_detener);
+        signal(SIGTERM, pedir_detener);
+    }
+    
+    // Seguidor: no atiende clientes mientras el líder esté vivo
+    if (lider != NULL) seguir_lider(lider);
+    if (puerto_replica > 0 && replica_iniciar(puerto_replica) != 0) return 1;
+    
+    // Crear socket UDP (SOCK_DGRAM)
+    // QUIC trabaja sobre UDP para evitar el handshake de TCP
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    
+    // Configurar dirección del servidor
+    servidor.sin_family = AF_INET;
+    servidor.sin_addr.s_addr = INADDR_ANY;  // Escuchar en todas las interfaces
+    servidor.sin_port = htons(puerto);       // Puerto 7000 por defecto
+    
+    // Enlazar socket al puerto
+    if (bind(sock, (struct sockaddr*)&servidor, sizeof(servidor)) != 0) {
+        printf("[!] No se pudo enlazar el puerto %d\n", puerto);
+        return 1;
+    }
+    red_no_bloqueante(sock);
+    plan_iniciar(&salida, COLA_SALIDA);
+    if (ranuras_local > 0 && iniciar_local(puerto) != 0) {
+        printf("[!] No se pudo crear la memoria compartida de --local (solo POSIX)\n");
+        return 1;
+    }
+    int con_gro = 0;
+    if (pedir_gso) {
+        atomic_store(&usar_gso, udp_gso_probar(sock));
+        con_gro = udp_gro_activar(sock);
+    }
+    
+    printf("=== BROKER QUIC ===\n");
+    printf("Puerto: %d (UDP)\n", puerto);
+    if (nodo_propio >= 0) {
+        printf("Cluster: nodo %s de %d (enlace TCP %d)\n", nodos[nodo_propio].id, num_nodos,
+               ntohs(nodos[nodo_propio].enlace.sin_port));
+    }
+    if (puerto_replica > 0) printf("Replicación: aceptando seguidor en TCP %d\n", puerto_replica);
+    printf("GSO: %s, GRO: %s\n", atomic_load(&usar_gso) ? "sí" : "no", con_gro ? "sí" : "no");
+    if (num_hilos > 0) {
+        if (iniciar_hilos(sock) != 0) {
+            printf("[!] No se pudieron crear los hilos de trabajo\n");
+            return 1;
+        }
+        printf("Hilos de trabajo: %d (temas repartidos por hash)\n", num_hilos);
+    }
+    if (zona_local != NULL) printf("Transporte local: %s (%u mensajes por tema)\n", prefijo_local, ranuras_local);
+    if (archivo_foto != NULL) printf("Foto: %s cada %d ms\n", archivo_foto, foto_cada_ms);
+    if (limite_publicador.tasa > 0 || limite_tema.tasa > 0 || limite_global.tasa > 0) {
+        printf("Admisión (publicaciones/s): publicador %.0f, tema %.0f, total %.0f (0 = sin límite)\n",
+               limite_publicador.tasa, limite_tema.tasa, limite_global.tasa);
+    }
+    for (int g = 0; g < grupo_num_configurados; g++) {
+        printf("Grupo '%s': %s\n", grupo_configurados[g].grupo, grupo_politicas[grupo_configurados[g].politica]);
+    }
+    printf("Esperando mensajes...\n\n");
+    
+    // ========================================================================
+    // BUCLE PRINCIPAL - Procesar mensajes hasta SIGINT / SIGTERM (con --foto)
+    // ========================================================================
+    while (!detener) {
+        fd_set lectura, escritura;
+        SOCKET mayor = sock;
+        struct timeval espera = {0, 200000};   // Despertar para reintentar enlaces
+        if (reproducciones_activas > 0) espera.tv_usec = PAUSA_REPRODUCCION_MS * 1000;
+        
+        FD_ZERO(&lectura);
+        FD_ZERO(&escritura);
+        FD_SET(sock, &lectura);
+        if (plan_pendientes(&salida) > 0) FD_SET(sock, &escritura);
+        cluster_preparar_select(&lectura, &escritura, &mayor);
+        replica_preparar_select(&lectura, &escritura, &mayor);
+        
+        if (select((int)mayor + 1, &lectura, &escritura, NULL, &espera) < 0) continue;
+        
+        if (FD_ISSET(sock, &lectura)) {
+            // Drenar los datagramas disponibles (socket no bloqueante). Con
+            // GRO una lectura puede traer varios datagramas del mismo cliente
+            // pegados, cada uno de "segmento" bytes
+            for (int n = 0; n < 1024; n++) {
+                int bytes = udp_recibir(sock, entrada, sizeof(entrada), &cliente, &segmento);
+                if (bytes < 0) {
+                    if (red_reintentar()) break;
+                    continue;   // Ej: WSAECONNRESET por un ICMP anterior
+                }
+                
+                for (int desde = 0; desde < bytes && segmento > 0; desde += segmento) {
+                    int tam = bytes - desde < segmento ? bytes - desde : segmento;
+                    memcpy(&pkt, entrada + desde, tam < (int)sizeof(Paquete) ? (size_t)tam : sizeof(Paquete));
+                    // Los clientes pueden enviar paquetes compactos (sin relleno):
+                    // asegurar el '\0' final antes de tratar mensaje como string
+                    if (!paquete_terminar(&pkt, tam)) continue;
+                    // Solo las publicaciones pasan por la admisión; el control, siempre
+                    if (pkt.tipo == 'P' && !admitir_publicacion(&pkt, cliente)) continue;
+                    if (num_hilos > 0) {
+                        repartir_paquete(&pkt, cliente);   // Lo procesa el hilo dueño del tema
+                    } else {
+                        procesar_paquete(sock, &pkt, cliente, 0, NULL);
+                    }
+                }
+            }
+        }
+        
+        cluster_atender(sock, &lectura, &escritura);
+        vaciar_salida(sock);   // Lo publicado en esta vuelta, por prioridad
+        replica_atender(&lectura);
+        avanzar_reproducciones(sock);
+        expirar_suscripciones();
+        rebalancear_grupos(sock);
+        fotos_periodicas();
+        reportar_admision();
+    }
+    
+    // Limpieza (solo se llega con --foto, al recibir SIGINT / SIGTERM)
+    if (archivo_foto != NULL) {
+        vaciar_salida(sock);
+        guardar_foto(1);
+        printf("[foto] Foto final en %s: %d temas, %d suscripciones\n", archivo_foto, temas.cantidad, num_subs);
+    }
+    closesocket(sock);
+    red_finalizar();
+    return 0;
 }
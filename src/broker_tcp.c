@@ -1,38 +1,206 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <winsock2.h>
+#include "plataforma.h"
+#include "planificador.h"
+#include "tablas.h"
 
 #define PUERTO 6000
 #define MAX_CONEXIONES 50
-#define MAX_TEMAS 10
 #define TAM 512
+#define COLA_SALIDA 256      // Eventos por clase de prioridad esperando a un subscriber lento
+#define BUFFER_ENVIO 65536   // SO_SNDBUF por conexión: lo que el kernel encola sin prioridad
 
 // Estructura que guarda la información de cada conexión (cliente)
 typedef struct {
     SOCKET canal;                   // Descriptor del socket del cliente
     int activo;                     // Indica si el cliente está activo
     int tipo;                       // 0: publisher, 1: subscriber
-    char temas[MAX_TEMAS][40];      // Lista de temas a los que está suscrito
-    int cantidad;                   // Cantidad de temas
+    char pendiente[TAM];            // Línea incompleta recibida (mensajes en lote)
+    int len_pendiente;              // Bytes válidos en pendiente
+    int con_lineas;                 // Ya envió un '\n': desde entonces se espera cada línea entera
+    Planificador salida;            // Eventos por enviar, por prioridad del tema
 } Conexion;
 
+// Suscripciones (conexión, tema) en columnas separadas (ver tablas.h): una
+// conexión puede tener cualquier cantidad de temas y el fan-out recorre
+// enteros en vez de "char temas[10][40]" por conexión.
+typedef struct {
+    Columna conexion;               // int: posición en la lista de conexiones
+    Columna tema;                   // unsigned int: id del tema internado
+    int cantidad;
+} Suscripciones;
+
+static Suscripciones subs;
+static TablaTemas temas;
+static Columna subs_por_tema;       // int por id de tema: suscripciones que lo usan
+static unsigned int marca[MAX_CONEXIONES];   // Última publicación que ya eligió a la conexión
+static unsigned int generacion;
+
+#define SUB_CONEXION(i) COLUMNA(subs.conexion, int, i)
+#define SUB_TEMA(i)     COLUMNA(subs.tema, unsigned int, i)
+#define USOS_TEMA(t)    COLUMNA(subs_por_tema, int, t)
+
 // Función auxiliar que revisa si un mensaje contiene un tema específico
 int coincide(char *mensaje, char *tema) {
     return strstr(mensaje, tema) != NULL;
 }
 
-int main() {
-    WSADATA datos;
+// Borra la suscripción s (la última ocupa su lugar)
+void borrar_suscripcion(int s) {
+    int ultima = --subs.cantidad;
+    USOS_TEMA(SUB_TEMA(s))--;
+    SUB_CONEXION(s) = SUB_CONEXION(ultima);
+    SUB_TEMA(s) = SUB_TEMA(ultima);
+}
+
+// Suscribe la conexión i a un tema (si ya lo estaba no hace nada).
+// Retorna -1 si el tema es demasiado largo o no hay memoria.
+int agregar_tema(int i, const char *tema) {
+    int t = tema_internar(&temas, tema);
+    if (t < 0 || columna_asegurar(&subs_por_tema, temas.cantidad) != 0) return -1;
+    for (int s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, 0); s >= 0;
+         s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, s + 1)) {
+        if (SUB_CONEXION(s) == i) return 0;
+    }
+    if (columna_asegurar(&subs.conexion, subs.cantidad + 1) != 0 ||
+        columna_asegurar(&subs.tema, subs.cantidad + 1) != 0) return -1;
+    SUB_CONEXION(subs.cantidad) = i;
+    SUB_TEMA(subs.cantidad) = (unsigned int)t;
+    subs.cantidad++;
+    USOS_TEMA(t)++;
+    return 0;
+}
+
+// Quita un tema de la lista de un subscriber
+void quitar_tema(int i, const char *tema) {
+    int t = tema_buscar(&temas, tema);
+    if (t < 0) return;
+    for (int s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, 0); s >= 0;
+         s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, s + 1)) {
+        if (SUB_CONEXION(s) == i) {
+            borrar_suscripcion(s);
+            return;
+        }
+    }
+}
+
+// Quita todos los temas de la conexión i
+void quitar_temas(int i) {
+    for (int s = 0; s < subs.cantidad; ) {
+        if (SUB_CONEXION(s) == i) borrar_suscripcion(s);   // En s quedó otra: se revisa
+        else s++;
+    }
+}
+
+// Cierra la conexión y libera su lugar en la lista. Antes un socket cerrado
+// quedaba activo: select() lo marcaba legible para siempre (recv() = 0) y el
+// bucle giraba sin parar, y cada evento se le seguía enviando.
+void cerrar_conexion(Conexion lista[], int i) {
+    printf("Desconectado cliente %d (%s)\n", i, lista[i].tipo == 1 ? "subscriber" : "publisher");
+    closesocket(lista[i].canal);
+    lista[i].activo = 0;
+    quitar_temas(i);
+    lista[i].len_pendiente = 0;
+    lista[i].con_lineas = 0;
+    plan_liberar(&lista[i].salida);
+}
+
+// Envía lo que el socket acepte de la cola de salida, en orden de prioridad.
+// Los sockets son no bloqueantes: un subscriber lento ya no frena al broker,
+// sus eventos esperan en la cola y un gol se adelanta a lo que esté esperando.
+// Retorna -1 si la conexión murió (y ya se cerró).
+int vaciar_salida(Conexion lista[], int i) {
+    Planificador *p = &lista[i].salida;
+    PlanMensaje *m;
+    while ((m = plan_siguiente(p)) != NULL) {
+        int n = send(lista[i].canal, m->datos + p->enviado, m->largo - p->enviado, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (red_reintentar()) return 0;   // Buffer lleno: se sigue cuando select() lo indique
+            cerrar_conexion(lista, i);
+            return -1;
+        }
+        p->enviado += n;
+        if (p->enviado == m->largo) plan_enviado(p);
+    }
+    return 0;
+}
+
+// Procesa un mensaje completo (una suscripción o un evento publicado)
+void procesar_mensaje(Conexion lista[], int i, char *mensaje) {
+    // Si el cliente envía una suscripción
+    if (strncmp(mensaje, "SUB ", 4) == 0) {
+        lista[i].tipo = 1; // Marca como subscriber
+        quitar_temas(i);
+        char *token = strtok(mensaje + 4, " ");
+        while (token) {
+            if (agregar_tema(i, token) != 0) {
+                printf("Tema ignorado (demasiado largo o sin memoria): %s\n", token);
+            }
+            token = strtok(NULL, " ");
+        }
+        send(lista[i].canal, "Suscripcion exitosa\n", 21, 0);
+    } else if (strncmp(mensaje, "UNSUB ", 6) == 0) {
+        // Baja de uno o más temas; sin temas restantes deja de recibir
+        char *token = strtok(mensaje + 6, " ");
+        while (token) {
+            quitar_tema(i, token);
+            token = strtok(NULL, " ");
+        }
+        send(lista[i].canal, "Baja exitosa\n", 13, MSG_NOSIGNAL);
+    } else if (strcmp(mensaje, "PING") == 0) {
+        // Latido de la aplicación: el cliente comprueba que el broker sigue vivo
+        send(lista[i].canal, "PONG\n", 5, MSG_NOSIGNAL);
+    } else {
+        // Si es un publisher, reenvía el mensaje a los suscriptores correspondientes
+        // (pasa por la cola de salida de cada uno; si el socket tiene lugar sale ya)
+        // strstr() una sola vez por tema distinto; después se marcan las
+        // conexiones suscritas a cada tema que coincide (una vez cada una)
+        int clase = plan_clase_texto(mensaje);
+        generacion++;
+        for (int t = 0; t < temas.cantidad; t++) {
+            if (USOS_TEMA(t) == 0 || !coincide(mensaje, (char*)tema_nombre(&temas, t))) continue;
+            for (int s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, 0); s >= 0;
+                 s = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)t, s + 1)) {
+                marca[SUB_CONEXION(s)] = generacion;
+            }
+        }
+        // El envío va aparte: vaciar_salida() puede cerrar una conexión y
+        // borrar suscripciones en medio del recorrido
+        for (int k = 0; k < MAX_CONEXIONES; k++) {
+            if (marca[k] != generacion || !lista[k].activo || lista[k].tipo != 1) continue;
+            if (plan_encolar(&lista[k].salida, clase, mensaje, (int)strlen(mensaje), NULL) != 0 &&
+                lista[k].salida.descartados[clase] % 100 == 1) {
+                printf("Cola de salida llena (clase %d) para cliente %d: %lu eventos descartados\n",
+                       clase, k, lista[k].salida.descartados[clase]);
+            }
+            vaciar_salida(lista, k);   // Si la conexión murió se quita
+        }
+    }
+}
+
+// Uso: broker.exe [--prioridad clase:tema ...]   (clase 0 = alta, 1 = normal, 2 = baja)
+int main(int argc, char *argv[]) {
     SOCKET servidor, cliente;
     struct sockaddr_in dir_servidor, dir_cliente;
     Conexion lista[MAX_CONEXIONES];
-    fd_set lista_lectura;
+    fd_set lista_lectura, lista_escritura;
     char mensaje[TAM];
-    int tam_dir = sizeof(dir_cliente);
+    socklen_t tam_dir = sizeof(dir_cliente);
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--prioridad") == 0 && plan_fijar_clase(argv[i + 1]) != 0) {
+            printf("--prioridad espera clase:tema (clase 0, 1 o 2)\n");
+            return 1;
+        }
+    }
 
     // Inicializa la librería Winsock versión 2.2
-    WSAStartup(MAKEWORD(2,2), &datos);
+    red_iniciar();
+    temas_iniciar(&temas);
+    columna_iniciar(&subs.conexion, sizeof(int));
+    columna_iniciar(&subs.tema, sizeof(unsigned int));
+    columna_iniciar(&subs_por_tema, sizeof(int));
 
     // Crea un socket TCP (SOCK_STREAM)
     servidor = socket(AF_INET, SOCK_STREAM, 0);
@@ -49,41 +217,72 @@ int main() {
     listen(servidor, 10);
 
     // Inicializa la lista de conexiones como inactivas
-    for (int i = 0; i < MAX_CONEXIONES; i++) lista[i].activo = 0;
+    for (int i = 0; i < MAX_CONEXIONES; i++) {
+        lista[i].activo = 0;
+        plan_iniciar(&lista[i].salida, COLA_SALIDA);
+    }
 
     printf("Broker activo en puerto %d\n", PUERTO);
 
     // Bucle principal del servidor
     while (1) {
         FD_ZERO(&lista_lectura);
+        FD_ZERO(&lista_escritura);
         FD_SET(servidor, &lista_lectura);
         SOCKET mayor = servidor;
 
-        // Añade todos los sockets activos a la lista de lectura
+        // Añade todos los sockets activos a la lista de lectura, y a la de
+        // escritura los que tienen eventos esperando en su cola de salida
         for (int i = 0; i < MAX_CONEXIONES; i++) {
             if (lista[i].activo) {
                 FD_SET(lista[i].canal, &lista_lectura);
+                if (plan_pendientes(&lista[i].salida) > 0) FD_SET(lista[i].canal, &lista_escritura);
                 if (lista[i].canal > mayor) mayor = lista[i].canal;
             }
         }
 
         // Espera actividad en cualquiera de los sockets
-        select(0, &lista_lectura, NULL, NULL, NULL);
+        // (Winsock ignora el primer argumento; POSIX necesita mayor + 1)
+        select((int)mayor + 1, &lista_lectura, &lista_escritura, NULL, NULL);
+
+        // Subscribers con lugar en el socket: seguir con su cola de salida
+        for (int i = 0; i < MAX_CONEXIONES; i++) {
+            if (lista[i].activo && FD_ISSET(lista[i].canal, &lista_escritura)) {
+                if (vaciar_salida(lista, i) != 0) FD_CLR(lista[i].canal, &lista_lectura);
+            }
+        }
 
         // Si hay una nueva conexión entrante
         if (FD_ISSET(servidor, &lista_lectura)) {
             cliente = accept(servidor, (struct sockaddr*)&dir_cliente, &tam_dir);
+            // Keepalive de TCP: si el otro extremo desaparece sin cerrar
+            // (cable, corte de red) el kernel lo detecta y recv() falla
+            int si = 1;
+            setsockopt(cliente, SOL_SOCKET, SO_KEEPALIVE, (char*)&si, sizeof(si));
+            // Los envíos a un subscriber lento esperan en su cola de salida, no
+            // en el buffer del kernel (que es FIFO y escondería la prioridad)
+            int envio = BUFFER_ENVIO;
+            setsockopt(cliente, SOL_SOCKET, SO_SNDBUF, (char*)&envio, sizeof(envio));
+            red_no_bloqueante(cliente);
+            int posicion = -1;
             // Busca una posición libre en la lista
             for (int j = 0; j < MAX_CONEXIONES; j++) {
                 if (!lista[j].activo) {
+                    posicion = j;
                     lista[j].canal = cliente;
                     lista[j].activo = 1;
                     lista[j].tipo = 0;     // Por defecto es publisher
-                    lista[j].cantidad = 0;
+                    lista[j].len_pendiente = 0;
+                    lista[j].con_lineas = 0;
                     break;
                 }
             }
-            printf("Conectado %s\n", inet_ntoa(dir_cliente.sin_addr));
+            if (posicion < 0) {
+                printf("Lista llena: rechazando %s\n", inet_ntoa(dir_cliente.sin_addr));
+                closesocket(cliente);
+            } else {
+                printf("Conectado %s\n", inet_ntoa(dir_cliente.sin_addr));
+            }
         }
 
         // Revisión de mensajes recibidos
@@ -91,37 +290,50 @@ int main() {
             if (!lista[i].activo) continue;
             if (!FD_ISSET(lista[i].canal, &lista_lectura)) continue;
 
-            int recibidos = recv(lista[i].canal, mensaje, TAM - 1, 0);
-            if (recibidos <= 0) continue;
-            mensaje[recibidos] = '\0';
-
-            // Si el cliente envía una suscripción
-            if (strncmp(mensaje, "SUB ", 4) == 0) {
-                lista[i].tipo = 1; // Marca como subscriber
-                lista[i].cantidad = 0;
-                char *token = strtok(mensaje + 4, " ");
-                while (token && lista[i].cantidad < MAX_TEMAS) {
-                    strcpy(lista[i].temas[lista[i].cantidad++], token);
-                    token = strtok(NULL, " ");
-                }
-                send(lista[i].canal, "Suscripcion exitosa\n", 21, 0);
-            } else {
-                // Si es un publisher, reenvía el mensaje a los suscriptores correspondientes
-                for (int k = 0; k < MAX_CONEXIONES; k++) {
-                    if (!lista[k].activo || lista[k].tipo != 1) continue;
-                    for (int t = 0; t < lista[k].cantidad; t++) {
-                        if (coincide(mensaje, lista[k].temas[t])) {
-                            send(lista[k].canal, mensaje, strlen(mensaje), 0);
-                            break;
-                        }
-                    }
-                }
+            int libre = TAM - 1 - lista[i].len_pendiente;
+            int recibidos = recv(lista[i].canal, lista[i].pendiente + lista[i].len_pendiente, libre, 0);
+            if (recibidos == 0 || (recibidos < 0 && !red_reintentar())) {
+                cerrar_conexion(lista, i);   // El cliente cerró o la conexión murió
+                continue;
+            }
+            if (recibidos < 0) continue;
+            lista[i].len_pendiente += recibidos;
+            lista[i].pendiente[lista[i].len_pendiente] = '\0';
+
+            // Los publishers que envían en lote terminan cada evento con '\n'.
+            // Se procesan las líneas completas y se guarda el resto para el
+            // próximo recv(). El modo se decide por conexión: una vez que
+            // llegó un '\n' siempre se espera la línea entera, aunque un
+            // recv() traiga justo el final de una y el principio de otra.
+            // Mientras no llegue ninguno (cliente clásico que manda un evento
+            // por send()), cada bloque es un mensaje completo.
+            char *inicio = lista[i].pendiente;
+            char *fin = strchr(inicio, '\n');
+            if (fin != NULL) lista[i].con_lineas = 1;
+            if (fin == NULL && lista[i].con_lineas && lista[i].len_pendiente < TAM - 1) {
+                continue;  // Línea en lote sin terminar: esperar el '\n'
+            }
+            if (fin == NULL) {
+                strcpy(mensaje, inicio);
+                lista[i].len_pendiente = 0;
+                procesar_mensaje(lista, i, mensaje);
+                continue;
+            }
+            while (fin != NULL) {
+                *fin = '\0';
+                if (fin > inicio && fin[-1] == '\r') fin[-1] = '\0';
+                strcpy(mensaje, inicio);
+                if (mensaje[0] != '\0') procesar_mensaje(lista, i, mensaje);
+                inicio = fin + 1;
+                fin = strchr(inicio, '\n');
             }
+            lista[i].len_pendiente = (int)strlen(inicio);
+            memmove(lista[i].pendiente, inicio, lista[i].len_pendiente + 1);
         }
     }
 
     // Cierre del socket y limpieza de Winsock
     closesocket(servidor);
-    WSACleanup();
+    red_finalizar();
     return 0;
 }
@@ -6,56 +6,686 @@
 // arpa/inet.h sirve para inet_addr() y htons(), que convierten direcciones y puertos
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <signal.h>
+#include "planificador.h" // Cola de salida con prioridades
+#include "udp_lotes.h" // Envío GSO y recepción GRO (Linux)
+#include "tablas.h" // Columnas en slabs y temas internados
+#include "foto.h" // Fotos binarias del estado (reinicio en caliente)
+#include "admision.h" // Cubetas de fichas para limitar publicaciones
+#include "grupos.h" // Suscripciones compartidas (grupos de consumidores)
 
 #define PORT 8080 // Puerto donde escucha el broker
-#define MAX_SUBS 100 // Máximo número de suscriptores
 #define MAX_TOPIC 50 // Máximo tamaño del tema
 #define MAX_MSG 512 // Máximo tamaño del mensaje
+#define RETAINED_PER_TOPIC 8 // Últimos mensajes retenidos por tema
+#define RETAINED_BYTES 480 // Cabe entero en un datagrama de MAX_MSG
+#define MAX_KEY 32 // Largo máximo de la clave en "clave=valor"
+#define SUB_TIMEOUT 30 // Segundos sin noticias (PING o SUBSCRIBE) antes de dar de baja
+#define MCAST_PORT 9100 // Puerto de los grupos multicast
+#define MCAST_THRESHOLD 2 // Suscriptores a partir de los cuales un tema usa multicast
+#define MCAST_HISTORY 64 // Mensajes por tema multicast guardados para NACK
+#define OUTBOX_SIZE 256 // Envíos por clase de prioridad esperando en la cola de salida
+#define RECV_BATCH 256 // Datagramas leídos por vuelta antes de vaciar la cola
+#define SNAPSHOT_EVERY_MS 5000 // Cada cuánto se guarda la foto con --foto
+#define PUBLISHER_BUCKETS 4096 // Cubetas de publishers con --limite-publicador
+#define OVERLOAD_PENDING (OUTBOX_SIZE * 3 / 4) // Envíos esperando a partir de los cuales se descarta
+#define ADMISSION_REPORT_SECS 5 // Cada cuánto se informan los rechazos
 
+// Suscripciones en columnas separadas (ver tablas.h): el reenvío recorre
+// solo los ids de tema, sin límite de suscriptores
 typedef struct {
-    char topic[MAX_TOPIC];
-    struct sockaddr_in addr;
-} Subscription; // Estructura para almacenar suscripciones
+    Columna topic; // unsigned int: id del tema internado
+    Columna addr; // struct sockaddr_in
+    Columna last_seen; // time_t: último SUBSCRIBE o PING de esta dirección
+    int count;
+} Subscriptions;
+
+#define SUB_TOPIC(i) COLUMNA(subs.topic, unsigned int, i)
+#define SUB_ADDR(i) COLUMNA(subs.addr, struct sockaddr_in, i)
+#define SUB_SEEN(i) COLUMNA(subs.last_seen, time_t, i)
+
+// Estado retenido de un tema: los últimos mensajes uno detrás de otro,
+// terminados en '\n', del más viejo al más nuevo. El buffer ya tiene el
+// formato de un lote, así que se envía tal cual en un solo datagrama.
+typedef struct {
+    int count; // Mensajes retenidos
+    int used; // Bytes ocupados en data
+    char data[RETAINED_BYTES];
+} Retained;
 
 // Para saber el número de suscriptores actuales
-Subscription subs[MAX_SUBS];
-int sub_count = 0;
+Subscriptions subs;
+TablaTemas topics; // Nombres de tema internados (ids densos)
+Columna retained; // Retained por id de tema (count 0: nada retenido)
+
+// Próxima suscripción al tema id desde la posición from, o -1
+int next_sub(int id, int from) {
+    return id < 0 ? -1 : columna_proximo(&subs.topic, subs.count, (unsigned int)id, from);
+}
+
+// Busca el estado retenido de un tema (create = 1 interna el tema si no
+// existe; un tema de MAX_TOPIC o más caracteres no tiene estado retenido)
+Retained *find_retained(const char *topic, int create) {
+    int id = create ? tema_internar(&topics, topic) : tema_buscar(&topics, topic);
+    if (id < 0 || columna_asegurar(&retained, id + 1) != 0) return NULL;
+    return columna_en(&retained, id);
+}
+
+// Quita el mensaje que empieza en pos (hasta su '\n' inclusive)
+void drop_retained(Retained *r, int pos) {
+    char *end = memchr(r->data + pos, '\n', r->used - pos);
+    int size = (int)(end - (r->data + pos)) + 1;
+    memmove(r->data + pos, r->data + pos + size, r->used - pos - size);
+    r->used -= size;
+    r->count--;
+}
+
+// Guarda un mensaje en el estado retenido de su tema. Un mensaje
+// "clave=valor" reemplaza al anterior con la misma clave (compactación).
+void retain_message(const char *topic, const char *msg) {
+    Retained *r = find_retained(topic, 1);
+    int len = (int)strlen(msg);
+    if (r == NULL || len + 1 > RETAINED_BYTES || strchr(msg, '\n') != NULL) return;
+
+    int key = 0;
+    while (key < MAX_KEY && msg[key] != '\0' && msg[key] != '=' && msg[key] != ' ') key++;
+    if (key > 0 && msg[key] == '=') {
+        key++; // Incluir el '='
+        for (int pos = 0; pos < r->used; ) {
+            char *end = memchr(r->data + pos, '\n', r->used - pos);
+            if (end - (r->data + pos) >= key && memcmp(r->data + pos, msg, key) == 0) {
+                drop_retained(r, pos);
+                break;
+            }
+            pos = (int)(end - r->data) + 1;
+        }
+    }
+
+    // Hacer lugar descartando los más viejos
+    while (r->count > 0 && (r->count == RETAINED_PER_TOPIC || r->used + len + 1 > RETAINED_BYTES)) {
+        drop_retained(r, 0);
+    }
+    memcpy(r->data + r->used, msg, len);
+    r->data[r->used + len] = '\n';
+    r->used += len + 1;
+    r->count++;
+}
+
+// Envía al nuevo suscriptor todo el estado retenido en un solo datagrama
+void send_retained(int sock, const char *topic, struct sockaddr_in addr) {
+    Retained *r = find_retained(topic, 0);
+    if (r == NULL || r->count == 0) return;
+    sendto(sock, r->data, r->used, 0, (struct sockaddr *)&addr, sizeof(addr));
+    printf("Estado retenido de '%s' enviado (%d mensajes)\n", topic, r->count);
+}
+
+// Alias numéricos: "ALIAS:tema" responde "ALIAS:id:tema" y desde entonces el
+// publisher puede enviar "PUBLISH:#id:mensaje". El id es alias_base + el id
+// del tema internado, así que se resuelve por índice. La base cambia en cada
+// ejecución (de a ALIAS_SPAN): si el broker se reinicia, un id viejo queda
+// fuera de rango y se responde "UNALIAS:#id" para que el publisher vuelva al
+// texto.
+#define ALIAS_SPAN 100000 // Separación entre bases: con menos temas, un id viejo no cae en rango
+unsigned int alias_base = 1;
+
+// Alias del tema (0 si el tema no es válido o no hay memoria)
+unsigned int topic_alias(const char *topic) {
+    if (topic[0] == '\0' || topic[0] == '#') return 0;
+    int id = tema_internar(&topics, topic);
+    return id >= 0 ? alias_base + (unsigned int)id : 0;
+}
+
+// Tema de "#id", o NULL si el id no existe
+const char *alias_topic(const char *text) {
+    char *end;
+    unsigned long id = strtoul(text + 1, &end, 10);
+    if (*end != '\0' || id < alias_base || id - alias_base >= (unsigned long)topics.cantidad) return NULL;
+    return tema_nombre(&topics, (int)(id - alias_base));
+}
+
+// Compara dos direcciones UDP (IP y puerto)
+int same_addr(struct sockaddr_in a, struct sockaddr_in b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// Cola de salida: las publicaciones no se envían apenas se procesan sino que
+// se encolan con la clase de su tema y se envían al terminar de leer lo que
+// llegó en esa vuelta (o cuando una clase se llena). Así un mensaje de un
+// tema de prioridad alta sale antes que la ráfaga de telemetría que entró
+// primero. Es una sola cola para el socket: en UDP el único lugar donde los
+// envíos se acumulan es el buffer de envío, compartido por todos.
+Planificador outbox;
+int use_gso = 0; // Envío GSO disponible y habilitado (--gso 0 lo apaga)
+
+// Envía lo encolado en orden de prioridad hasta vaciar la cola o llenar el
+// buffer del socket (lo que queda sale cuando select() lo indique). Con GSO
+// los mensajes de igual tamaño para un mismo destino (por ejemplo una ráfaga
+// a un grupo multicast) salen en un solo sendmsg(); si el kernel lo rechaza
+// se sigue de a uno.
+void flush_outbox(int sock) {
+    PlanMensaje *batch[UDP_MAX_SEGMENTOS];
+    int n;
+    while ((n = plan_juntar(&outbox, batch, use_gso ? UDP_MAX_SEGMENTOS : 1, UDP_MAX_LOTE)) > 0) {
+        if (n > 1) {
+            if (udp_enviar_lote(sock, batch, n) == 0) {
+                plan_enviados(&outbox, batch, n);
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (udp_gso_no_soportado()) {
+                use_gso = 0;
+                printf("Envío GSO rechazado: se envía un datagrama por llamada\n");
+            }
+        }
+        if (sendto(sock, batch[0]->datos, batch[0]->largo, 0,
+                   (struct sockaddr *)&batch[0]->destino, sizeof(batch[0]->destino)) < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        plan_enviado(&outbox); // Otros errores (ej: ICMP) no reintentan
+    }
+}
+
+// Encola un envío de publicación; si su clase está llena se envía lo que
+// haya para hacer lugar, y si tampoco alcanza se descarta
+void queue_send(int sock, const char *topic, const char *data, int len, struct sockaddr_in *addr) {
+    int prio = plan_clase_tema(topic);
+    if (outbox.cantidad[prio] == outbox.capacidad) flush_outbox(sock);
+    if (plan_encolar(&outbox, prio, data, len, addr) != 0 && outbox.descartados[prio] % 100 == 1) {
+        printf("Cola de salida llena (clase %d): %lu envíos descartados\n", prio, outbox.descartados[prio]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Grupos de consumidores (SUBSCRIBE:$grupo/g/tema, ver grupos.h)
+//
+// Los miembros del grupo g del tema T son las suscripciones a "$grupo/g/T":
+// cada mensaje de T va a UNO de ellos (además de a los suscriptores de T).
+// Como los miembros son filas comunes de subs, una baja o una expiración
+// ya reparte el resto entre los que quedan. Sin ACKs este broker no sabe
+// qué le falta a cada miembro: lo que se envió a un miembro que se cayó se
+// pierde, y la política "carga" se comporta como "turnos".
+// ---------------------------------------------------------------------------
+typedef struct {
+    int topic; // Id del tema real
+    int name; // Id de "$grupo/g/T" (el de las suscripciones de los miembros)
+    int policy; // GRUPO_TURNOS, GRUPO_CARGA o GRUPO_CLAVE
+    unsigned int turn;
+} Group;
+
+Columna groups; // Group, uno por cada "$grupo/g/T" con miembros
+int group_count = 0;
+
+#define GROUP(g) COLUMNA(groups, Group, g)
+
+// Crea el grupo de "$grupo/g/T" si no existe (no hace nada sin memoria)
+void add_group(const char *name) {
+    int id = tema_internar(&topics, name);
+    for (int g = 0; g < group_count; g++) {
+        if (GROUP(g).name == id) return;
+    }
+    int topic = tema_internar(&topics, grupo_tema(name));
+    if (id < 0 || topic < 0 || columna_asegurar(&groups, group_count + 1) != 0) return;
+    GROUP(group_count).topic = topic;
+    GROUP(group_count).name = id;
+    GROUP(group_count).policy = grupo_politica(name);
+    GROUP(group_count).turn = 0;
+    group_count++;
+    printf("Nuevo grupo '%s' (%s)\n", name, grupo_politicas[grupo_politica(name)]);
+}
+
+// Suscripción del miembro que recibe msg, o -1 si el grupo no tiene miembros
+int pick_member(Group *g, const char *msg) {
+    unsigned int key, best = 0;
+    int chosen = -1, count = 0;
+    if (g->policy == GRUPO_CLAVE && grupo_clave(msg, &key)) {
+        for (int i = next_sub(g->name, 0); i >= 0; i = next_sub(g->name, i + 1)) {
+            unsigned int score = grupo_puntaje(key, SUB_ADDR(i).sin_addr.s_addr, SUB_ADDR(i).sin_port);
+            if (chosen < 0 || score > best) {
+                chosen = i;
+                best = score;
+            }
+        }
+        return chosen;
+    }
+    for (int i = next_sub(g->name, 0); i >= 0; i = next_sub(g->name, i + 1)) count++;
+    if (count == 0) return -1;
+    int turn = (int)(g->turn++ % (unsigned int)count);
+    for (chosen = next_sub(g->name, 0); turn > 0; turn--) chosen = next_sub(g->name, chosen + 1);
+    return chosen;
+}
+
+// Entrega el mensaje del tema a un miembro de cada uno de sus grupos
+void publish_groups(int sock, const char *topic, const char *msg) {
+    int id = tema_buscar(&topics, topic);
+    for (int g = 0; id >= 0 && g < group_count; g++) {
+        if (GROUP(g).topic != id) continue;
+        int i = pick_member(&GROUP(g), msg);
+        if (i >= 0) queue_send(sock, topic, msg, (int)strlen(msg), &SUB_ADDR(i));
+    }
+}
 
 // Función para agregar una suscripción
 void add_subscription(char *topic, struct sockaddr_in addr) {
-    for (int i = 0; i < sub_count; i++) {
-        if (strcmp(subs[i].topic, topic) == 0 &&
-            subs[i].addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
-            subs[i].addr.sin_port == addr.sin_port) {
+    int id = tema_internar(&topics, topic);
+    for (int i = next_sub(id, 0); i >= 0; i = next_sub(id, i + 1)) {
+        if (same_addr(SUB_ADDR(i), addr)) {
+            SUB_SEEN(i) = time(NULL);
             return; // ya suscrito
         }
     }
-    // Agregar nueva suscripción
-    if (sub_count < MAX_SUBS) {
-        strcpy(subs[sub_count].topic, topic);
-        subs[sub_count].addr = addr;
-        sub_count++;
+    // Agregar nueva suscripción (tema demasiado largo o sin memoria: se ignora)
+    if (id >= 0 && columna_asegurar(&subs.topic, subs.count + 1) == 0 &&
+        columna_asegurar(&subs.addr, subs.count + 1) == 0 &&
+        columna_asegurar(&subs.last_seen, subs.count + 1) == 0) {
+        SUB_TOPIC(subs.count) = (unsigned int)id;
+        SUB_ADDR(subs.count) = addr;
+        SUB_SEEN(subs.count) = time(NULL);
+        subs.count++;
         printf("Nuevo suscriptor para el tema: '%s'\n", topic);
+        if (grupo_tema(topic) != NULL) add_group(topic);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Modo multicast (./broker_udp --multicast 239.1.1.1)
+//
+// Un tema con MCAST_THRESHOLD o más suscriptores pasa a un grupo multicast
+// propio (grupo base + índice del tema, todos en MCAST_PORT). El broker
+// avisa a los suscriptores con "MULTICAST:grupo:puerto" y desde entonces
+// envía cada mensaje UNA vez al grupo en lugar de un sendto por suscriptor.
+//
+// Multicast no es confiable, así que esos mensajes llevan número de
+// secuencia: "SEQ:n:mensaje". El suscriptor que detecta un salto pide lo
+// que falta con "NACK:tema:n" y el broker se lo reenvía por unicast desde
+// un historial corto del tema (como el 'R' del broker QUIC).
+// ---------------------------------------------------------------------------
+typedef struct {
+    char topic[MAX_TOPIC];
+    struct sockaddr_in group;
+    unsigned int seq; // Último seq enviado al grupo
+    char history[MCAST_HISTORY][MAX_MSG]; // Mensaje con seq s en history[s % MCAST_HISTORY]
+} McastTopic;
+
+int mcast_enabled = 0;
+struct in_addr mcast_base; // Primer grupo (los temas usan base, base + 1, ...)
+int mcast_threshold = MCAST_THRESHOLD;
+Columna mcast_by_topic; // McastTopic * por id de tema (NULL: unicast)
+int mcast_count = 0; // Temas multicast (el próximo usa base + mcast_count)
+
+// Busca el grupo de un tema, o NULL si el tema se envía por unicast
+McastTopic *find_mcast(const char *topic) {
+    int id = tema_buscar(&topics, topic);
+    if (id < 0 || id >= mcast_by_topic.num_slabs * TABLA_SLAB) return NULL;
+    return COLUMNA(mcast_by_topic, McastTopic *, id);
+}
+
+// Le indica a un suscriptor a qué grupo unirse
+void send_mcast_notice(int sock, McastTopic *m, struct sockaddr_in addr) {
+    char notice[64];
+    snprintf(notice, sizeof(notice), "MULTICAST:%s:%d",
+             inet_ntoa(m->group.sin_addr), ntohs(m->group.sin_port));
+    sendto(sock, notice, strlen(notice), 0, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+// Después de una suscripción: si el tema ya es multicast se avisa al nuevo
+// suscriptor; si acaba de llegar al umbral se le asigna un grupo y se
+// avisa a todos sus suscriptores
+void check_mcast(int sock, char *topic, struct sockaddr_in addr) {
+    if (!mcast_enabled || grupo_tema(topic) != NULL) return; // Un grupo no se envía a todos
+    McastTopic *m = find_mcast(topic);
+    if (m != NULL) {
+        send_mcast_notice(sock, m, addr);
+        return;
+    }
+
+    int id = tema_buscar(&topics, topic), count = 0;
+    for (int i = next_sub(id, 0); i >= 0; i = next_sub(id, i + 1)) count++;
+    if (count < mcast_threshold || columna_asegurar(&mcast_by_topic, id + 1) != 0) return;
+    m = calloc(1, sizeof(McastTopic));
+    if (m == NULL) return;
+    COLUMNA(mcast_by_topic, McastTopic *, id) = m;
+    strcpy(m->topic, topic);
+    m->group.sin_family = AF_INET;
+    m->group.sin_addr.s_addr = htonl(ntohl(mcast_base.s_addr) + mcast_count);
+    m->group.sin_port = htons(MCAST_PORT);
+    mcast_count++;
+    printf("Tema '%s' pasa a multicast %s:%d (%d suscriptores)\n",
+           topic, inet_ntoa(m->group.sin_addr), MCAST_PORT, count);
+    for (int i = next_sub(id, 0); i >= 0; i = next_sub(id, i + 1)) {
+        send_mcast_notice(sock, m, SUB_ADDR(i));
+    }
+}
+
+// Publica en el grupo: un solo envío para todos los suscriptores
+void publish_mcast(int sock, McastTopic *m, char *msg) {
+    char packet[MAX_MSG + 24];
+    m->seq++;
+    snprintf(m->history[m->seq % MCAST_HISTORY], MAX_MSG, "%s", msg);
+    int len = snprintf(packet, sizeof(packet), "SEQ:%u:%s", m->seq, msg);
+    if (len >= (int)sizeof(packet)) len = (int)sizeof(packet) - 1;
+    queue_send(sock, m->topic, packet, len, &m->group);
+}
+
+// "NACK:tema:n": reenvía por unicast un mensaje que no llegó por el grupo
+void resend_mcast(int sock, char *topic, unsigned int seq, struct sockaddr_in addr) {
+    McastTopic *m = find_mcast(topic);
+    if (m == NULL || seq == 0 || seq > m->seq || m->seq - seq >= MCAST_HISTORY) return;
+    char packet[MAX_MSG + 24];
+    int len = snprintf(packet, sizeof(packet), "SEQ:%u:%s", seq, m->history[seq % MCAST_HISTORY]);
+    sendto(sock, packet, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+// Prepara las tablas vacías
+void init_tables(void) {
+    temas_iniciar(&topics);
+    columna_iniciar(&subs.topic, sizeof(unsigned int));
+    columna_iniciar(&subs.addr, sizeof(struct sockaddr_in));
+    columna_iniciar(&subs.last_seen, sizeof(time_t));
+    columna_iniciar(&retained, sizeof(Retained));
+    columna_iniciar(&mcast_by_topic, sizeof(void *));
+    columna_iniciar(&groups, sizeof(Group));
+    group_count = 0;
+}
+
+// Quita la suscripción i (la última ocupa su lugar)
+void remove_subscription(int i) {
+    int last = --subs.count;
+    SUB_TOPIC(i) = SUB_TOPIC(last);
+    SUB_ADDR(i) = SUB_ADDR(last);
+    SUB_SEEN(i) = SUB_SEEN(last);
+}
+
+// Baja explícita: "UNSUBSCRIBE:tema"
+void unsubscribe(char *topic, struct sockaddr_in addr) {
+    int id = tema_buscar(&topics, topic);
+    for (int i = next_sub(id, 0); i >= 0; i = next_sub(id, i + 1)) {
+        if (same_addr(SUB_ADDR(i), addr)) {
+            remove_subscription(i);
+            printf("Baja del tema: '%s'\n", topic);
+            return;
+        }
+    }
+}
+
+// Latido: renueva todas las suscripciones de esa dirección
+void heartbeat(struct sockaddr_in addr) {
+    time_t now = time(NULL);
+    for (int i = 0; i < subs.count; i++) {
+        if (same_addr(SUB_ADDR(i), addr)) SUB_SEEN(i) = now;
+    }
+}
+
+// Da de baja a los suscriptores que no enviaron nada en SUB_TIMEOUT
+// segundos (se cerraron sin UNSUBSCRIBE): así no se les sigue enviando
+void expire_subscriptions(void) {
+    time_t now = time(NULL);
+    for (int i = 0; i < subs.count; ) {
+        if (now - SUB_SEEN(i) > SUB_TIMEOUT) {
+            printf("Suscriptor de '%s' expirado (sin latidos)\n", tema_nombre(&topics, (int)SUB_TOPIC(i)));
+            remove_subscription(i);
+        } else {
+            i++;
+        }
     }
 }
 
 // Función para reenviar mensajes a suscriptores
 void publish_message(int sock, char *topic, char *msg) {
-    for (int i = 0; i < sub_count; i++) {
-        // Enviar mensaje a todos los suscriptores del tema
-        if (strcmp(subs[i].topic, topic) == 0) {
-            sendto(sock, msg, strlen(msg), 0,
-                   (struct sockaddr *)&subs[i].addr, sizeof(subs[i].addr));
-        }
+    retain_message(topic, msg);
+    publish_groups(sock, topic, msg);
+    McastTopic *m = find_mcast(topic);
+    if (m != NULL) {
+        publish_mcast(sock, m, msg);
+        printf("Mensaje enviado al grupo de '%s' (seq %u): %s\n", topic, m->seq, msg);
+        return;
+    }
+    // Enviar mensaje a todos los suscriptores del tema
+    int id = tema_buscar(&topics, topic);
+    for (int i = next_sub(id, 0); i >= 0; i = next_sub(id, i + 1)) {
+        queue_send(sock, topic, msg, (int)strlen(msg), &SUB_ADDR(i));
     }
     printf("Mensaje reenviado a tema '%s': %s\n", topic, msg);
 }
 
-int main() {
+// ---------------------------------------------------------------------------
+// Fotos del estado (./broker_udp --foto broker_udp.foto)
+//
+// Cada SNAPSHOT_EVERY_MS un proceso hijo (fork, ver foto.h) guarda los
+// temas, las suscripciones, la base de los alias y el estado retenido
+// (como bloque extra: un Retained por id de tema, hasta el último que
+// retuvo algo). Los ids de los temas se conservan, y con ellos los alias.
+// Al arrancar se recuperan: los suscriptores siguen recibiendo sin volver a
+// enviar SUBSCRIBE y los alias de los publishers siguen valiendo. Con
+// SIGINT o SIGTERM se guarda una última foto antes de salir.
+//
+// Los grupos multicast no se guardan: un tema vuelve a unicast hasta el
+// próximo SUBSCRIBE que supere el umbral.
+// ---------------------------------------------------------------------------
+const char *snapshot_file = NULL;
+int snapshot_every_ms = SNAPSHOT_EVERY_MS;
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Escribe la foto (clean = 1: al cerrar, en este proceso; 0: en un hijo)
+void save_snapshot(int clean) {
+    FotoEscritura w;
+    if (foto_abrir(&w, snapshot_file, !clean) != 1) return;
+
+    int retained_topics = 0; // Ids con estado retenido: 0 .. retained_topics - 1
+    for (int id = 0; id < topics.cantidad && id < retained.num_slabs * TABLA_SLAB; id++) {
+        if (COLUMNA(retained, Retained, id).count > 0) retained_topics = id + 1;
+    }
+    FotoCabecera header = foto_cabecera(clean, alias_base, topics.cantidad, subs.count,
+                                        sizeof(Retained) * (size_t)retained_topics);
+    foto_escribir(&w, &header, sizeof(header));
+    for (int id = 0; id < topics.cantidad; id++) {
+        FotoTema t;
+        memset(&t, 0, sizeof(t));
+        strcpy(t.nombre, tema_nombre(&topics, id));
+        foto_escribir(&w, &t, sizeof(t));
+    }
+    for (int i = 0; i < subs.count; i++) {
+        FotoSub s = {SUB_TOPIC(i), SUB_ADDR(i).sin_addr.s_addr, SUB_ADDR(i).sin_port, 0, 0, 0};
+        foto_escribir(&w, &s, sizeof(s));
+    }
+    for (int id = 0; id < retained_topics; id++) {
+        foto_escribir(&w, columna_en(&retained, id), sizeof(Retained));
+    }
+    if (foto_cerrar(&w) != 0) printf("No se pudo escribir la foto %s\n", snapshot_file);
+}
+
+// Recupera la foto con las tablas vacías. Retorna 0 si se cargó.
+int load_snapshot(void) {
+    unsigned long long start = reloj_ms();
+    size_t size;
+    const FotoCabecera *header = foto_cargar(snapshot_file, &size);
+    if (header == NULL) return -1;
+
+    const Retained *saved = foto_extra(header);
+    int saved_count = (int)(header->tam_extra / sizeof(Retained));
+    int ok = header->tam_extra % sizeof(Retained) == 0 && saved_count <= (int)header->num_temas;
+    for (int i = 0; ok && i < saved_count; i++) {
+        ok = saved[i].used >= 0 && saved[i].used <= RETAINED_BYTES && saved[i].count >= 0 &&
+             (saved[i].used == 0 || saved[i].data[saved[i].used - 1] == '\n');
+    }
+    for (unsigned int k = 0; ok && k < header->num_temas; k++) {
+        ok = tema_internar(&topics, foto_temas(header)[k].nombre) == (int)k;
+    }
+    int n = (int)header->num_subs;
+    if (!ok || columna_asegurar(&subs.topic, n) != 0 || columna_asegurar(&subs.addr, n) != 0 ||
+        columna_asegurar(&subs.last_seen, n) != 0 || columna_asegurar(&retained, saved_count) != 0) {
+        printf("Foto %s inconsistente o sin memoria: se ignora\n", snapshot_file);
+        foto_liberar(header, size);
+        init_tables();
+        return -1;
+    }
+    time_t now = time(NULL);
+    for (int i = 0; i < n; i++) {
+        const FotoSub *s = &foto_subs(header)[i];
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = s->ip;
+        addr.sin_port = s->puerto;
+        SUB_TOPIC(i) = s->tema;
+        SUB_ADDR(i) = addr;
+        SUB_SEEN(i) = now; // El plazo de expiración empieza de nuevo
+        const char *name = tema_nombre(&topics, (int)s->tema);
+        if (grupo_tema(name) != NULL) add_group(name);
+    }
+    subs.count = n;
+    int retained_topics = 0;
+    for (int id = 0; id < saved_count; id++) {
+        COLUMNA(retained, Retained, id) = saved[id];
+        if (saved[id].count > 0) retained_topics++;
+    }
+    alias_base = header->alias_base;
+
+    printf("Foto %s: %d temas, %d suscripciones y %d temas retenidos en %llu ms (de hace %lld s)\n",
+           snapshot_file, topics.cantidad, subs.count, retained_topics, reloj_ms() - start,
+           (long long)now - header->creada);
+    foto_liberar(header, size);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Admisión (--limite-publicador, --limite-tema, --admision; ver admision.h)
+//
+// Cada PUBLISH gasta una ficha de la cubeta de su publisher (ip:puerto), de
+// la de su tema y de la global. Con --admision además se descarta mientras
+// la cola de salida tiene más de OVERLOAD_PENDING envíos esperando. Este
+// protocolo no tiene ACK: lo rechazado se descarta (y se cuenta). Los
+// demás comandos (SUBSCRIBE, UNSUBSCRIBE, PING, NACK, ALIAS) no se limitan.
+// ---------------------------------------------------------------------------
+LimiteTasa publisher_limit, topic_limit, global_limit; // tasa 0 = sin límite
+TablaCubetas publisher_buckets;
+Columna topic_buckets; // Cubeta por id de tema
+Cubeta global_bucket;
+unsigned long admitted, rejected_publisher, rejected_topic, rejected_overload;
+
+// ¿Entra esta publicación? Si un control posterior la rechaza, los
+// anteriores recuperan su ficha
+int admit_publish(const char *topic, struct sockaddr_in addr) {
+    if (publisher_limit.tasa <= 0 && topic_limit.tasa <= 0 && global_limit.tasa <= 0) return 1;
+    unsigned long long now = reloj_ms();
+    if (global_limit.tasa > 0 && plan_pendientes(&outbox) > OVERLOAD_PENDING) {
+        rejected_overload++;
+        return 0;
+    }
+    EntradaCubeta *pub = NULL;
+    Cubeta *top = NULL;
+    int ok;
+    if (publisher_limit.tasa > 0) {
+        unsigned long long key = (unsigned long long)addr.sin_addr.s_addr << 16 | addr.sin_port;
+        pub = tabla_cubetas_tomar(&publisher_buckets, key, &publisher_limit, 1, now, &ok);
+        if (!ok) {
+            rejected_publisher++;
+            return 0;
+        }
+    }
+    if (topic_limit.tasa > 0) {
+        int id = tema_internar(&topics, topic);
+        if (id >= 0 && columna_asegurar(&topic_buckets, id + 1) == 0) {
+            top = &COLUMNA(topic_buckets, Cubeta, id);
+            if (!cubeta_tomar(top, &topic_limit, 1, now)) {
+                if (pub != NULL) cubeta_devolver(&pub->cubeta, 1);
+                rejected_topic++;
+                return 0;
+            }
+        }
+    }
+    if (global_limit.tasa > 0 && !cubeta_tomar(&global_bucket, &global_limit, 1, now)) {
+        if (pub != NULL) cubeta_devolver(&pub->cubeta, 1);
+        if (top != NULL) cubeta_devolver(top, 1);
+        rejected_overload++;
+        return 0;
+    }
+    admitted++;
+    return 1;
+}
+
+// Informa los rechazos (si hubo nuevos) y el publisher con más rechazos
+void report_admission(void) {
+    static unsigned long reported = 0;
+    unsigned long total = rejected_publisher + rejected_topic + rejected_overload;
+    if (total == reported) return;
+    reported = total;
+    printf("Admisión: %lu publicaciones admitidas, rechazadas: publicador=%lu tema=%lu sobrecarga=%lu\n",
+           admitted, rejected_publisher, rejected_topic, rejected_overload);
+    if (publisher_buckets.capacidad > 0) {
+        EntradaCubeta worst = tabla_cubetas_peor(&publisher_buckets);
+        if (worst.rechazos > 0) {
+            struct in_addr ip;
+            ip.s_addr = (unsigned int)(worst.clave >> 16);
+            printf("Publisher más rechazado: %s:%u (%lu)\n", inet_ntoa(ip),
+                   ntohs((unsigned short)(worst.clave & 0xFFFF)), worst.rechazos);
+        }
+    }
+}
+
+// Función para procesar un comando "SUBSCRIBE:tema", "UNSUBSCRIBE:tema",
+// "PING", "NACK:tema:seq", "ALIAS:tema" o "PUBLISH:tema:mensaje" (el tema
+// puede ser "#id")
+void process_command(int sock, char *line, struct sockaddr_in client_addr) {
+    if (strncmp(line, "SUBSCRIBE:", 10) == 0) {
+        char *topic = line + 10;
+        add_subscription(topic, client_addr);
+        send_retained(sock, topic, client_addr);
+        check_mcast(sock, topic, client_addr);
+    } else if (strncmp(line, "UNSUBSCRIBE:", 12) == 0) {
+        unsubscribe(line + 12, client_addr);
+    } else if (strcmp(line, "PING") == 0) {
+        heartbeat(client_addr);
+    } else if (strncmp(line, "NACK:", 5) == 0) { // Recuperación de multicast
+        char *topic = strtok(line + 5, ":");
+        char *seq = strtok(NULL, "");
+        if (topic && seq)
+            resend_mcast(sock, topic, (unsigned int)strtoul(seq, NULL, 10), client_addr);
+    } else if (strncmp(line, "ALIAS:", 6) == 0) { // Pedido de alias numérico
+        char reply[MAX_TOPIC + 24];
+        int len = snprintf(reply, sizeof(reply), "ALIAS:%u:%s", topic_alias(line + 6), line + 6);
+        sendto(sock, reply, len, 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
+    } else if (strncmp(line, "PUBLISH:", 8) == 0) { // Mensaje de publicación
+        char *topic = strtok(line + 8, ":");
+        char *msg = strtok(NULL, "");
+        if (topic && msg && topic[0] == '#') {
+            const char *name = alias_topic(topic);
+            if (name == NULL) {
+                char reply[32];
+                int len = snprintf(reply, sizeof(reply), "UNALIAS:%s", topic);
+                sendto(sock, reply, len, 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
+                return;
+            }
+            topic = (char *)name;
+        }
+        if (topic && msg && admit_publish(topic, client_addr))
+            publish_message(sock, topic, msg);
+    }
+}
+
+// Uso: ./broker_udp [--multicast grupo_base] [--umbral N] [--interfaz ip]
+//                   [--prioridad clase:tema ...]   (clase 0 = alta, 1 = normal, 2 = baja)
+//                   [--gso 0]   (sin GSO/GRO aunque el kernel los soporte)
+//                   [--foto archivo] [--foto-cada ms]   (reinicio en caliente)
+//                   [--limite-publicador N[:ráfaga]] [--limite-tema N[:ráfaga]]
+//                   [--admision N[:ráfaga]]   (publicaciones por segundo)
+//                   [--grupo politica:grupo ...]   (turnos, carga o clave; ver grupos.h)
+int main(int argc, char *argv[]) {
     int sock;
     struct sockaddr_in broker_addr, client_addr;
     char buffer[MAX_MSG];
-    socklen_t addr_len = sizeof(client_addr);
+    static char input[UDP_MAX_LOTE]; // Con GRO, varios datagramas del mismo cliente pegados
+    int segment, want_gso = 1;
+
+    init_tables();
 
     // Crear socket UDP
     sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -76,27 +706,135 @@ int main() {
         exit(1);
     }
 
-    printf("Broker escuchando en puerto %d...\n", PORT);
-
-    while (1) {
-        // Esperar mensajes de suscripción o publicación
-        int bytes = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
-                             (struct sockaddr *)&client_addr, &addr_len);
-        if (bytes < 0) continue;
-        buffer[bytes] = '\0';
-
-        // Procesar mensaje recibido
-        if (strncmp(buffer, "SUBSCRIBE:", 10) == 0) {
-            char *topic = buffer + 10;
-            add_subscription(topic, client_addr);
-        } else if (strncmp(buffer, "PUBLISH:", 8) == 0) { // Mensaje de publicación
-            char *topic = strtok(buffer + 8, ":");
-            char *msg = strtok(NULL, "");
-            if (topic && msg)
-                publish_message(sock, topic, msg);
+    // Modo multicast (opcional)
+    struct in_addr mcast_if;
+    mcast_if.s_addr = INADDR_ANY;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--multicast") == 0) {
+            mcast_enabled = inet_pton(AF_INET, argv[i + 1], &mcast_base) == 1;
+        } else if (strcmp(argv[i], "--umbral") == 0) {
+            mcast_threshold = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--interfaz") == 0) {
+            inet_pton(AF_INET, argv[i + 1], &mcast_if);
+        } else if (strcmp(argv[i], "--prioridad") == 0 && plan_fijar_clase(argv[i + 1]) != 0) {
+            printf("--prioridad espera clase:tema (clase 0, 1 o 2)\n");
+            exit(1);
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            want_gso = atoi(argv[i + 1]);
+        } else if ((strcmp(argv[i], "--limite-publicador") == 0 && limite_parsear(&publisher_limit, argv[i + 1]) != 0) ||
+                   (strcmp(argv[i], "--limite-tema") == 0 && limite_parsear(&topic_limit, argv[i + 1]) != 0) ||
+                   (strcmp(argv[i], "--admision") == 0 && limite_parsear(&global_limit, argv[i + 1]) != 0)) {
+            printf("%s espera publicaciones por segundo[:ráfaga]\n", argv[i]);
+            exit(1);
+        } else if (strcmp(argv[i], "--grupo") == 0 && grupo_fijar_politica(argv[i + 1]) != 0) {
+            printf("--grupo espera politica:grupo (turnos, carga o clave)\n");
+            exit(1);
+        } else if (strcmp(argv[i], "--foto") == 0) {
+            snapshot_file = argv[i + 1];
+        } else if (strcmp(argv[i], "--foto-cada") == 0) {
+            snapshot_every_ms = atoi(argv[i + 1]);
+        }
+    }
+    if (snapshot_every_ms <= 0) {
+        printf("--foto-cada espera milisegundos\n");
+        exit(1);
+    }
+    columna_iniciar(&topic_buckets, sizeof(Cubeta));
+    if (publisher_limit.tasa > 0 && tabla_cubetas_iniciar(&publisher_buckets, PUBLISHER_BUCKETS) != 0) {
+        printf("Sin memoria para las cubetas de --limite-publicador\n");
+        exit(1);
+    }
+    if (mcast_enabled) {
+        // TTL 1: los grupos no salen del segmento de la red local. LOOP
+        // permite probarlo con broker y suscriptores en la misma máquina.
+        unsigned char ttl = 1, loop = 1;
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &mcast_if, sizeof(mcast_if));
+        printf("Multicast activo: temas con %d o más suscriptores usan %s:%d en adelante\n",
+               mcast_threshold, inet_ntoa(mcast_base), MCAST_PORT);
+    }
+
+    // Base de los alias de esta ejecución
+    srand((unsigned int)time(NULL));
+    alias_base = (unsigned int)(rand() % 900 + 100) * ALIAS_SPAN;
+
+    // Reinicio en caliente: suscripciones, alias y retenidos de la foto
+    unsigned long long last_snapshot = reloj_ms();
+    if (snapshot_file != NULL) {
+        if (load_snapshot() != 0) printf("Sin foto válida en %s: arranque vacío\n", snapshot_file);
+        signal(SIGINT, request_stop);
+        signal(SIGTERM, request_stop);
+    }
+
+    plan_iniciar(&outbox, OUTBOX_SIZE);
+    red_no_bloqueante(sock);
+    int gro = 0;
+    if (want_gso) {
+        use_gso = udp_gso_probar(sock);
+        gro = udp_gro_activar(sock);
+    }
+
+    printf("Broker escuchando en puerto %d (GSO: %s, GRO: %s)...\n", PORT,
+           use_gso ? "sí" : "no", gro ? "sí" : "no");
+
+    time_t last_check = time(NULL);
+    while (!stop_requested) {
+        if (time(NULL) != last_check) {
+            expire_subscriptions();
+            if (time(NULL) % ADMISSION_REPORT_SECS == 0) report_admission();
+            last_check = time(NULL);
+        }
+        if (snapshot_file != NULL && reloj_ms() - last_snapshot >= (unsigned long long)snapshot_every_ms) {
+            save_snapshot(0);
+            last_snapshot = reloj_ms();
+        }
+
+        // select() despierta al menos una vez por segundo para revisar
+        // expiraciones, y también cuando hay lugar para lo que quedó encolado
+        fd_set readable, writable;
+        struct timeval timeout = {1, 0};
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        FD_SET(sock, &readable);
+        if (plan_pendientes(&outbox) > 0) FD_SET(sock, &writable);
+        if (select(sock + 1, &readable, &writable, NULL, &timeout) <= 0) continue;
+
+        // Leer lo que haya llegado (hasta RECV_BATCH datagramas) antes de
+        // enviar, así la cola de salida puede ordenar la vuelta por prioridad
+        for (int n = 0; n < RECV_BATCH && FD_ISSET(sock, &readable); n++) {
+            int bytes = udp_recibir(sock, input, sizeof(input), &client_addr, &segment);
+            if (bytes < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                continue;
+            }
+
+            // Con GRO la lectura puede traer varios datagramas de "segment"
+            // bytes; cada uno se procesa como si hubiera llegado solo
+            for (int from = 0; from < bytes && segment > 0; from += segment) {
+                int size = bytes - from < segment ? bytes - from : segment;
+                if (size > (int)sizeof(buffer) - 1) size = (int)sizeof(buffer) - 1;
+                memcpy(buffer, input + from, size);
+                buffer[size] = '\0';
+
+                // Un datagrama puede traer varios comandos, uno por línea
+                // (los publishers que agrupan mensajes en lotes los separan con '\n')
+                char *line = buffer;
+                while (line != NULL && *line != '\0') {
+                    char *end = strchr(line, '\n');
+                    if (end != NULL) *end = '\0';
+                    process_command(sock, line, client_addr);
+                    line = end != NULL ? end + 1 : NULL;
+                }
+            }
         }
+        flush_outbox(sock);
     }
 
+    // Solo se llega con --foto, al recibir SIGINT o SIGTERM
+    flush_outbox(sock);
+    save_snapshot(1);
+    printf("Foto final en %s: %d suscripciones\n", snapshot_file, subs.count);
     close(sock);
     return 0;
 }
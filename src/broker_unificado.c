@@ -0,0 +1,963 @@
+/*
+ * ============================================================================
+ * BROKER UNIFICADO - TCP, UDP y QUIC en un solo proceso
+ * ============================================================================
+ *
+ * Descripción:
+ * Hasta ahora había tres brokers separados (broker_tcp en 6000, broker_udp
+ * en 8080 y broker_quic en 7000), cada uno con sus propias tablas de temas:
+ * un publisher TCP no podía llegar a un subscriber UDP y había que operar
+ * tres procesos. Este broker atiende los tres formatos de cable con un solo
+ * bucle de eventos (select) y un solo núcleo de ruteo.
+ *
+ * Alcance: es un cuarto broker, no un núcleo que compartan los otros tres.
+ * broker_tcp, broker_udp y broker_quic no cambian y conservan sus propias
+ * tablas; el núcleo de abajo (tablas.h y planificador.h, los mismos que
+ * usan ellos) solo lo usan los frentes de este archivo. Los frentes
+ * reimplementan el formato de cable, no las funciones de cada broker.
+ *
+ * Arquitectura:
+ *   1. Cada frente (TCP, UDP, QUIC) lee su formato de cable y lo traduce a
+ *      operaciones del núcleo: suscribir, dar de baja, renovar y publicar.
+ *   2. El núcleo tiene UNA tabla de temas (tablas.h), una tabla de
+ *      suscripciones en columnas y una secuencia por tema. Una publicación
+ *      se interpreta una sola vez (Publicacion: tema, contenido, seq) sin
+ *      importar por qué frente entró.
+ *   3. El fan-out recorre la columna de temas y, para cada suscripción que
+ *      coincide, le pide al frente de esa suscripción que la entregue en su
+ *      propio formato (tabla frentes[], indexada por transporte).
+ *
+ * Formatos de cable (los mismos de cada broker):
+ *   - TCP (6000): "SUB t1 t2", "UNSUB t1", "PING" y cualquier otra línea es
+ *     una publicación "tema contenido" (el tema es la primera palabra). Se
+ *     entrega como "tema contenido\n" por la cola de salida de la conexión.
+ *   - UDP (8080): "SUBSCRIBE:tema", "UNSUBSCRIBE:tema", "PING" y
+ *     "PUBLISH:tema:mensaje", varios por datagrama (uno por línea). Se
+ *     entrega el mensaje solo, como broker_udp.
+ *   - QUIC (7000): paquetes 'S' (con reanudación "tema:seq"), 'P' (lotes,
+ *     un ACK por lote), 'R', 'U', 'H' y los ACK acumulados 'A' (solo su
+ *     mapa de huecos) de protocolo_quic.h. Se entrega un
+ *     'P' con el seq del tema y "tema:contenido".
+ *
+ * Todas las publicaciones numeran la secuencia del tema y quedan en el
+ * historial, vengan de donde vengan: un subscriber QUIC recupera con 'R'
+ * también lo que publicó un cliente TCP.
+ *
+ * Limitaciones (para eso siguen los brokers por protocolo):
+ *   - Un tema con espacios ("Colombia vs Argentina") no se puede nombrar
+ *     desde TCP, y un subscriber TCP recibe solo su tema exacto (broker_tcp
+ *     buscaba el tema como subcadena de cada evento).
+ *   - Sin estado retenido, multicast ni alias en UDP; sin QoS, alias,
+ *     créditos, cluster, réplica, hilos, fotos ni límites de tasa en QUIC.
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plataforma.h"
+#include "protocolo_quic.h"
+#include "planificador.h"
+#include "tablas.h"
+
+// ============================================================================
+// CONSTANTES DE CONFIGURACIÓN
+// ============================================================================
+
+#define PUERTO_TCP        6000
+#define PUERTO_UDP        8080
+#define PUERTO_QUIC       QUIC_PUERTO
+
+#define MAX_CONEXIONES    50             // Conexiones TCP simultáneas
+#define TAM_LINEA         512            // Línea TCP o UDP (incluye '\0')
+#define COLA_SALIDA       256            // Envíos por clase de prioridad en cada cola
+#define BUFFER_ENVIO      65536          // SO_SNDBUF por conexión TCP
+#define LECTURAS_POR_VUELTA 256          // Datagramas leídos por socket antes de enviar
+#define MAX_LINEAS        (TAM_LINEA / 2)  // Líneas no vacías que entran en un bloque
+#define MAX_HISTORIAL     1024           // Publicaciones guardadas para 'R' (como broker_quic)
+#define EXPIRACION_SUB_MS 30000          // UDP y QUIC: sin latidos en este plazo, baja
+#define REVISION_SUB_MS   1000
+
+#define TRANSPORTE_TCP    0
+#define TRANSPORTE_UDP    1
+#define TRANSPORTE_QUIC   2
+#define NUM_TRANSPORTES   3
+
+// ============================================================================
+// NÚCLEO DE RUTEO
+// ============================================================================
+
+/**
+ * Suscripciones - Una fila por (tema, destino), una columna por campo
+ *
+ *   - tema: Id del tema internado (lo único que lee el fan-out por fila)
+ *   - transporte: TRANSPORTE_* del frente que la creó y que la entrega
+ *   - conexion: Posición en conexiones[] (solo TCP)
+ *   - ip, puerto: Dirección del subscriber, orden de red (UDP y QUIC)
+ *   - visto_ms: Último SUBSCRIBE/'S' o latido (TCP no expira: se quita al
+ *     cerrar la conexión)
+ */
+typedef struct {
+    Columna tema;                        // unsigned int
+    Columna transporte;                  // unsigned char
+    Columna conexion;                    // int
+    Columna ip;                          // unsigned int
+    Columna puerto;                      // unsigned short
+    Columna visto_ms;                    // unsigned long long
+    int cantidad;
+} Suscripciones;
+
+#define SUB_TEMA(i)       COLUMNA(subs.tema, unsigned int, i)
+#define SUB_TRANSPORTE(i) COLUMNA(subs.transporte, unsigned char, i)
+#define SUB_CONEXION(i)   COLUMNA(subs.conexion, int, i)
+#define SUB_IP(i)         COLUMNA(subs.ip, unsigned int, i)
+#define SUB_PUERTO(i)     COLUMNA(subs.puerto, unsigned short, i)
+#define SUB_VISTO(i)      COLUMNA(subs.visto_ms, unsigned long long, i)
+
+/**
+ * Publicacion - Una publicación ya interpretada por su frente
+ *
+ * El núcleo la arma una vez y todos los frentes la leen para entregarla en
+ * su formato: ninguno vuelve a parsear el texto del publisher.
+ */
+typedef struct {
+    int id;                              // Id del tema
+    const char *tema;
+    const char *contenido;
+    unsigned int seq;                    // Secuencia del tema (1, 2, 3...)
+    int clase;                           // PRIO_* del tema (planificador.h)
+} Publicacion;
+
+/**
+ * Frente - Lo que el núcleo necesita de cada protocolo
+ *
+ *   - entregar: Encola la publicación para la suscripción i en el formato
+ *     del frente. No puede quitar suscripciones (el fan-out sigue
+ *     recorriendo la tabla); los envíos salen después en vaciar.
+ *   - vaciar: Envía lo encolado que el socket acepte.
+ */
+typedef struct {
+    const char *nombre;
+    void (*entregar)(int i, const Publicacion *pub);
+    void (*vaciar)(void);
+} Frente;
+
+typedef struct {
+    unsigned int seq;
+    int id;                              // -1: lugar libre
+    char contenido[QUIC_MAX_MENSAJE];
+} MensajeHistorial;
+
+static Suscripciones subs;
+static TablaTemas temas;
+static Columna seq_tema;                 // unsigned int por id de tema
+static MensajeHistorial historial[MAX_HISTORIAL];
+static int historial_index = 0;
+static unsigned long publicadas[NUM_TRANSPORTES];   // Por frente de origen
+static unsigned long entregadas[NUM_TRANSPORTES];   // Por frente de destino
+
+static const Frente frentes[NUM_TRANSPORTES];       // Definida al final de los frentes
+
+/** nucleo_iniciar - Tablas vacías */
+static void nucleo_iniciar(void) {
+    temas_iniciar(&temas);
+    columna_iniciar(&seq_tema, sizeof(unsigned int));
+    columna_iniciar(&subs.tema, sizeof(unsigned int));
+    columna_iniciar(&subs.transporte, sizeof(unsigned char));
+    columna_iniciar(&subs.conexion, sizeof(int));
+    columna_iniciar(&subs.ip, sizeof(unsigned int));
+    columna_iniciar(&subs.puerto, sizeof(unsigned short));
+    columna_iniciar(&subs.visto_ms, sizeof(unsigned long long));
+    for (int i = 0; i < MAX_HISTORIAL; i++) historial[i].id = -1;
+}
+
+/** nucleo_tema - Id del tema, internándolo si es nuevo; -1 si no es válido */
+static int nucleo_tema(const char *tema) {
+    if (tema[0] == '\0' || tema[0] == ALIAS_PREFIJO) return -1;
+    int id = tema_internar(&temas, tema);
+    if (id >= 0 && columna_asegurar(&seq_tema, id + 1) != 0) return -1;
+    return id;
+}
+
+/** mismo_destino - ¿La suscripción i es de ese transporte y destino? */
+static int mismo_destino(int i, int transporte, int conexion, const struct sockaddr_in *addr) {
+    if (SUB_TRANSPORTE(i) != transporte) return 0;
+    if (transporte == TRANSPORTE_TCP) return SUB_CONEXION(i) == conexion;
+    return SUB_IP(i) == addr->sin_addr.s_addr && SUB_PUERTO(i) == addr->sin_port;
+}
+
+/** nucleo_buscar - Índice de la suscripción o -1 */
+static int nucleo_buscar(const char *tema, int transporte, int conexion, const struct sockaddr_in *addr) {
+    int id = tema_buscar(&temas, tema);
+    if (id < 0) return -1;
+    for (int i = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)id, 0); i >= 0;
+         i = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)id, i + 1)) {
+        if (mismo_destino(i, transporte, conexion, addr)) return i;
+    }
+    return -1;
+}
+
+/**
+ * nucleo_suscribir - Suscribe el destino al tema (si ya estaba, lo renueva)
+ *
+ * conexion es la posición TCP (TRANSPORTE_TCP) y addr la dirección (UDP y
+ * QUIC); el otro se ignora. Retorna el índice o -1 si el tema no es válido
+ * o no hay memoria.
+ */
+static int nucleo_suscribir(const char *tema, int transporte, int conexion, const struct sockaddr_in *addr) {
+    int i = nucleo_buscar(tema, transporte, conexion, addr);
+    if (i >= 0) {
+        SUB_VISTO(i) = reloj_ms();
+        return i;
+    }
+    int id = nucleo_tema(tema);
+    i = subs.cantidad;
+    if (id < 0 || columna_asegurar(&subs.tema, i + 1) != 0 || columna_asegurar(&subs.transporte, i + 1) != 0 ||
+        columna_asegurar(&subs.conexion, i + 1) != 0 || columna_asegurar(&subs.ip, i + 1) != 0 ||
+        columna_asegurar(&subs.puerto, i + 1) != 0 || columna_asegurar(&subs.visto_ms, i + 1) != 0) {
+        printf("[!] Suscripción ignorada (tema inválido o sin memoria): %.49s\n", tema);
+        return -1;
+    }
+    SUB_TEMA(i) = (unsigned int)id;
+    SUB_TRANSPORTE(i) = (unsigned char)transporte;
+    SUB_CONEXION(i) = conexion;
+    SUB_IP(i) = addr != NULL ? addr->sin_addr.s_addr : 0;
+    SUB_PUERTO(i) = addr != NULL ? addr->sin_port : 0;
+    SUB_VISTO(i) = reloj_ms();
+    subs.cantidad++;
+    printf("[+] Suscriptor %s para tema: %s\n", frentes[transporte].nombre, tema);
+    return i;
+}
+
+/** nucleo_quitar - Borra la suscripción i (la última ocupa su lugar) */
+static void nucleo_quitar(int i) {
+    int ultima = --subs.cantidad;
+    SUB_TEMA(i) = SUB_TEMA(ultima);
+    SUB_TRANSPORTE(i) = SUB_TRANSPORTE(ultima);
+    SUB_CONEXION(i) = SUB_CONEXION(ultima);
+    SUB_IP(i) = SUB_IP(ultima);
+    SUB_PUERTO(i) = SUB_PUERTO(ultima);
+    SUB_VISTO(i) = SUB_VISTO(ultima);
+}
+
+/** nucleo_baja - Quita la suscripción al tema; retorna 1 si existía */
+static int nucleo_baja(const char *tema, int transporte, int conexion, const struct sockaddr_in *addr) {
+    int i = nucleo_buscar(tema, transporte, conexion, addr);
+    if (i < 0) return 0;
+    nucleo_quitar(i);
+    printf("[-] Baja %s del tema: %s\n", frentes[transporte].nombre, tema);
+    return 1;
+}
+
+/** nucleo_quitar_destino - Quita todas las suscripciones del destino */
+static void nucleo_quitar_destino(int transporte, int conexion, const struct sockaddr_in *addr) {
+    for (int i = 0; i < subs.cantidad; ) {
+        if (mismo_destino(i, transporte, conexion, addr)) nucleo_quitar(i);   // En i quedó otra
+        else i++;
+    }
+}
+
+/** nucleo_renovar - Latido: renueva todas las suscripciones del destino */
+static void nucleo_renovar(int transporte, const struct sockaddr_in *addr) {
+    unsigned long long ahora = reloj_ms();
+    for (int i = 0; i < subs.cantidad; i++) {
+        if (mismo_destino(i, transporte, -1, addr)) SUB_VISTO(i) = ahora;
+    }
+}
+
+/** nucleo_expirar - Da de baja a los subscribers UDP y QUIC sin latidos */
+static void nucleo_expirar(void) {
+    static unsigned long long ultima_revision = 0;
+    unsigned long long ahora = reloj_ms();
+    if (ahora - ultima_revision < REVISION_SUB_MS) return;
+    ultima_revision = ahora;
+    for (int i = 0; i < subs.cantidad; ) {
+        if (SUB_TRANSPORTE(i) != TRANSPORTE_TCP && ahora - SUB_VISTO(i) > EXPIRACION_SUB_MS) {
+            printf("[-] Suscriptor %s de '%s' expirado (sin latidos)\n", frentes[SUB_TRANSPORTE(i)].nombre,
+                   tema_nombre(&temas, (int)SUB_TEMA(i)));
+            nucleo_quitar(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+/** seq_del_tema - Último seq del tema (0 si nunca se publicó) */
+static unsigned int seq_del_tema(int id) {
+    return id >= 0 ? COLUMNA(seq_tema, unsigned int, id) : 0;
+}
+
+/** buscar_en_historial - Contenido del seq del tema, o NULL */
+static const char *buscar_en_historial(int id, unsigned int seq) {
+    for (int i = 0; i < MAX_HISTORIAL; i++) {
+        if (historial[i].id == id && historial[i].seq == seq) return historial[i].contenido;
+    }
+    return NULL;
+}
+
+/**
+ * nucleo_publicable - ¿Entra la publicación en un 'P' "tema:contenido"?
+ *
+ * El tema se mide por su largo porque los frentes validan un lote entero
+ * antes de cortar sus líneas: si una falla no se publica ninguna, así el
+ * reintento del publisher no duplica las que ya habían salido.
+ */
+static int nucleo_publicable(const char *tema, size_t largo_tema, size_t largo_contenido) {
+    return largo_tema > 0 && largo_tema < TABLA_MAX_TEMA && tema[0] != ALIAS_PREFIJO &&
+           largo_tema + 1 + largo_contenido < QUIC_MAX_MENSAJE;
+}
+
+/**
+ * nucleo_publicar - Numera, guarda y distribuye una publicación
+ *
+ * Es el único camino de publicación de los tres frentes: el seq del tema y
+ * el historial son los mismos para todos. Retorna el seq asignado, o 0 si
+ * el tema no es válido o "tema:contenido" no entra en un paquete QUIC.
+ */
+static unsigned int nucleo_publicar(const char *tema, const char *contenido, int origen) {
+    if (!nucleo_publicable(tema, strlen(tema), strlen(contenido))) return 0;
+    int id = nucleo_tema(tema);
+    if (id < 0) return 0;
+
+    Publicacion pub;
+    pub.id = id;
+    pub.tema = tema_nombre(&temas, id);
+    pub.contenido = contenido;
+    pub.seq = ++COLUMNA(seq_tema, unsigned int, id);
+    pub.clase = plan_clase_tema(pub.tema);
+    publicadas[origen]++;
+
+    historial[historial_index].seq = pub.seq;
+    historial[historial_index].id = id;
+    strcpy(historial[historial_index].contenido, contenido);
+    historial_index = (historial_index + 1) % MAX_HISTORIAL;
+
+    for (int i = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)id, 0); i >= 0;
+         i = columna_proximo(&subs.tema, subs.cantidad, (unsigned int)id, i + 1)) {
+        frentes[SUB_TRANSPORTE(i)].entregar(i, &pub);
+        entregadas[SUB_TRANSPORTE(i)]++;
+    }
+    return pub.seq;
+}
+
+// ============================================================================
+// COLAS DE SALIDA DE DATAGRAMAS (UDP y QUIC)
+// ============================================================================
+
+// Una cola por socket, como la de broker_udp: las entregas de una vuelta
+// del bucle se ordenan por la prioridad de su tema antes de salir.
+
+typedef struct {
+    SOCKET sock;                         // INVALID_SOCKET: frente apagado
+    Planificador plan;
+} SalidaDatagramas;
+
+/** salida_vaciar - Envía lo encolado hasta vaciarlo o llenar el socket */
+static void salida_vaciar(SalidaDatagramas *s) {
+    PlanMensaje *m;
+    while ((m = plan_siguiente(&s->plan)) != NULL) {
+        if (sendto(s->sock, m->datos, m->largo, 0, (struct sockaddr *)&m->destino, sizeof(m->destino)) < 0 &&
+            red_reintentar()) {
+            return;                      // Sigue cuando select() indique lugar
+        }
+        plan_enviado(&s->plan);          // Otros errores (ej: ICMP) no reintentan
+    }
+}
+
+/** salida_encolar - Encola un envío; si la clase está llena envía primero */
+static void salida_encolar(SalidaDatagramas *s, int clase, const void *datos, int largo,
+                           const struct sockaddr_in *destino) {
+    if (s->plan.cantidad[clase] == s->plan.capacidad) salida_vaciar(s);
+    if (plan_encolar(&s->plan, clase, datos, largo, destino) != 0 && s->plan.descartados[clase] % 100 == 1) {
+        printf("Cola de salida llena (clase %d): %lu envíos descartados\n", clase, s->plan.descartados[clase]);
+    }
+}
+
+/**
+ * partir_lineas - Corta el bloque en líneas no vacías (sin "\r\n")
+ *
+ * Con completa == 0 la última línea todavía no terminó (TCP): no se cuenta
+ * y *resto queda apuntándola; si no, *resto apunta al '\0' final. Retorna
+ * cuántas líneas guardó en lineas[].
+ */
+static int partir_lineas(char *bloque, int completa, char *lineas[MAX_LINEAS], char **resto) {
+    int n = 0;
+    char *inicio = bloque;
+    char *fin;
+    while ((fin = strchr(inicio, '\n')) != NULL || (completa && *inicio != '\0')) {
+        if (fin == NULL) fin = inicio + strlen(inicio);
+        int ultima = *fin == '\0';
+        *fin = '\0';
+        if (fin > inicio && fin[-1] == '\r') fin[-1] = '\0';
+        if (inicio[0] != '\0' && n < MAX_LINEAS) lineas[n++] = inicio;
+        inicio = ultima ? fin : fin + 1;
+    }
+    *resto = inicio;
+    return n;
+}
+
+/** direccion_sub - Dirección UDP/QUIC de la suscripción i */
+static struct sockaddr_in direccion_sub(int i) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = SUB_IP(i);
+    addr.sin_port = SUB_PUERTO(i);
+    return addr;
+}
+
+/** abrir_datagramas - Socket UDP no bloqueante en el puerto, o INVALID_SOCKET */
+static SOCKET abrir_datagramas(int puerto) {
+    struct sockaddr_in dir;
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s == INVALID_SOCKET) return INVALID_SOCKET;
+    memset(&dir, 0, sizeof(dir));
+    dir.sin_family = AF_INET;
+    dir.sin_addr.s_addr = INADDR_ANY;
+    dir.sin_port = htons((unsigned short)puerto);
+    if (bind(s, (struct sockaddr *)&dir, sizeof(dir)) != 0) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    red_no_bloqueante(s);
+    return s;
+}
+
+// ============================================================================
+// FRENTE TCP
+// ============================================================================
+
+typedef struct {
+    SOCKET canal;
+    int activo;
+    char pendiente[TAM_LINEA];           // Línea incompleta recibida
+    int len_pendiente;
+    int con_lineas;                      // Ya envió un '\n': se espera cada línea entera
+    Planificador salida;                 // Entregas por enviar, por prioridad del tema
+} Conexion;
+
+static SOCKET servidor_tcp = INVALID_SOCKET;
+static Conexion conexiones[MAX_CONEXIONES];
+
+/** tcp_cerrar - Cierra la conexión y quita sus suscripciones */
+static void tcp_cerrar(int c) {
+    printf("[tcp] Desconectado cliente %d\n", c);
+    closesocket(conexiones[c].canal);
+    conexiones[c].activo = 0;
+    conexiones[c].len_pendiente = 0;
+    conexiones[c].con_lineas = 0;
+    nucleo_quitar_destino(TRANSPORTE_TCP, c, NULL);
+    plan_liberar(&conexiones[c].salida);
+}
+
+/** tcp_vaciar_conexion - Envía lo que el socket acepte; -1 si la conexión murió */
+static int tcp_vaciar_conexion(int c) {
+    Planificador *p = &conexiones[c].salida;
+    PlanMensaje *m;
+    while ((m = plan_siguiente(p)) != NULL) {
+        int n = send(conexiones[c].canal, m->datos + p->enviado, m->largo - p->enviado, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (red_reintentar()) return 0;
+            tcp_cerrar(c);
+            return -1;
+        }
+        p->enviado += n;
+        if (p->enviado == m->largo) plan_enviado(p);
+    }
+    return 0;
+}
+
+static void tcp_vaciar(void) {
+    for (int c = 0; c < MAX_CONEXIONES; c++) {
+        if (conexiones[c].activo && plan_pendientes(&conexiones[c].salida) > 0) tcp_vaciar_conexion(c);
+    }
+}
+
+/** tcp_entregar - "tema contenido\n" a la cola de la conexión */
+static void tcp_entregar(int i, const Publicacion *pub) {
+    Conexion *c = &conexiones[SUB_CONEXION(i)];
+    char linea[PLAN_MAX_MENSAJE];
+    int largo = snprintf(linea, sizeof(linea), "%s %s\n", pub->tema, pub->contenido);
+    if (largo >= (int)sizeof(linea)) largo = (int)sizeof(linea) - 1;
+    if (plan_encolar(&c->salida, pub->clase, linea, largo, NULL) != 0 &&
+        c->salida.descartados[pub->clase] % 100 == 1) {
+        printf("Cola de salida llena (clase %d) para cliente %d: %lu eventos descartados\n", pub->clase,
+               SUB_CONEXION(i), c->salida.descartados[pub->clase]);
+    }
+}
+
+/** tcp_responder - Respuesta de control (no espera detrás de las publicaciones) */
+static void tcp_responder(int c, const char *texto) {
+    send(conexiones[c].canal, texto, (int)strlen(texto), MSG_NOSIGNAL);
+}
+
+/** tcp_publicable - ¿La línea, si es una publicación, entra en el núcleo? */
+static int tcp_publicable(const char *linea) {
+    if (strncmp(linea, "SUB ", 4) == 0 || strncmp(linea, "UNSUB ", 6) == 0) return 1;
+    const char *espacio = strchr(linea, ' ');
+    if (espacio == NULL || espacio == linea || espacio[1] == '\0') return 1;   // No es publicación
+    return nucleo_publicable(linea, (size_t)(espacio - linea), strlen(espacio + 1));
+}
+
+/**
+ * tcp_linea - Atiende una línea completa de la conexión c
+ *
+ * Con publicar == 0 (el lote tenía una publicación que no entra) solo se
+ * atienden los comandos.
+ */
+static void tcp_linea(int c, char *linea, int publicar) {
+    if (strncmp(linea, "SUB ", 4) == 0) {
+        // Como broker_tcp: "SUB" reemplaza la lista de temas de la conexión
+        nucleo_quitar_destino(TRANSPORTE_TCP, c, NULL);
+        for (char *tema = strtok(linea + 4, " "); tema != NULL; tema = strtok(NULL, " ")) {
+            nucleo_suscribir(tema, TRANSPORTE_TCP, c, NULL);
+        }
+        tcp_responder(c, "Suscripcion exitosa\n");
+    } else if (strncmp(linea, "UNSUB ", 6) == 0) {
+        for (char *tema = strtok(linea + 6, " "); tema != NULL; tema = strtok(NULL, " ")) {
+            nucleo_baja(tema, TRANSPORTE_TCP, c, NULL);
+        }
+        tcp_responder(c, "Baja exitosa\n");
+    } else if (strcmp(linea, "PING") == 0) {
+        tcp_responder(c, "PONG\n");
+    } else {
+        // Publicación "tema contenido": el tema es la primera palabra
+        char *espacio = strchr(linea, ' ');
+        if (!publicar || espacio == NULL || espacio == linea || espacio[1] == '\0') return;
+        *espacio = '\0';
+        nucleo_publicar(linea, espacio + 1, TRANSPORTE_TCP);
+    }
+}
+
+/** tcp_aceptar - Nueva conexión en el primer lugar libre */
+static void tcp_aceptar(void) {
+    struct sockaddr_in dir;
+    socklen_t tam = sizeof(dir);
+    SOCKET cliente = accept(servidor_tcp, (struct sockaddr *)&dir, &tam);
+    if (cliente == INVALID_SOCKET) return;
+    int si = 1, envio = BUFFER_ENVIO;
+    setsockopt(cliente, SOL_SOCKET, SO_KEEPALIVE, (char *)&si, sizeof(si));
+    setsockopt(cliente, SOL_SOCKET, SO_SNDBUF, (char *)&envio, sizeof(envio));
+    red_no_bloqueante(cliente);
+    for (int c = 0; c < MAX_CONEXIONES; c++) {
+        if (!conexiones[c].activo) {
+            conexiones[c].canal = cliente;
+            conexiones[c].activo = 1;
+            conexiones[c].len_pendiente = 0;
+            conexiones[c].con_lineas = 0;
+            printf("[tcp] Conectado %s (cliente %d)\n", inet_ntoa(dir.sin_addr), c);
+            return;
+        }
+    }
+    printf("[tcp] Lista llena: rechazando %s\n", inet_ntoa(dir.sin_addr));
+    closesocket(cliente);
+}
+
+/**
+ * tcp_leer - Lee de la conexión y procesa las líneas completas
+ *
+ * Misma regla que broker_tcp: los lotes terminan cada evento con '\n' y el
+ * resto se guarda para el próximo recv(). Desde el primer '\n' de la
+ * conexión siempre se espera la línea entera; antes (cliente que manda un
+ * evento por send()) cada bloque sin '\n' es un mensaje completo.
+ */
+static void tcp_leer(int c) {
+    Conexion *con = &conexiones[c];
+    int recibidos = recv(con->canal, con->pendiente + con->len_pendiente, TAM_LINEA - 1 - con->len_pendiente, 0);
+    if (recibidos == 0 || (recibidos < 0 && !red_reintentar())) {
+        tcp_cerrar(c);
+        return;
+    }
+    if (recibidos < 0) return;
+    con->len_pendiente += recibidos;
+    con->pendiente[con->len_pendiente] = '\0';
+
+    char *lineas[MAX_LINEAS];
+    char *resto;
+    int completo = strchr(con->pendiente, '\n') == NULL;
+    if (!completo) con->con_lineas = 1;
+    if (completo && con->con_lineas && con->len_pendiente < TAM_LINEA - 1) return;
+    int n = partir_lineas(con->pendiente, completo, lineas, &resto);
+
+    // Se valida todo lo recibido antes de publicar la primera línea
+    int publicar = 1;
+    for (int k = 0; k < n; k++) {
+        if (!tcp_publicable(lineas[k])) publicar = 0;
+    }
+    if (!publicar) printf("[tcp] Lote del cliente %d rechazado: una publicación no entra en un paquete\n", c);
+    for (int k = 0; k < n; k++) tcp_linea(c, lineas[k], publicar);
+    con->len_pendiente = (int)strlen(resto);
+    memmove(con->pendiente, resto, (size_t)con->len_pendiente + 1);
+}
+
+/** tcp_abrir - Socket de escucha del frente TCP; -1 si falló */
+static int tcp_abrir(int puerto) {
+    struct sockaddr_in dir;
+    int si = 1;
+    for (int c = 0; c < MAX_CONEXIONES; c++) {
+        conexiones[c].activo = 0;
+        plan_iniciar(&conexiones[c].salida, COLA_SALIDA);
+    }
+    servidor_tcp = socket(AF_INET, SOCK_STREAM, 0);
+    if (servidor_tcp == INVALID_SOCKET) return -1;
+    setsockopt(servidor_tcp, SOL_SOCKET, SO_REUSEADDR, (char *)&si, sizeof(si));
+    memset(&dir, 0, sizeof(dir));
+    dir.sin_family = AF_INET;
+    dir.sin_addr.s_addr = INADDR_ANY;
+    dir.sin_port = htons((unsigned short)puerto);
+    if (bind(servidor_tcp, (struct sockaddr *)&dir, sizeof(dir)) != 0 || listen(servidor_tcp, 10) != 0) {
+        closesocket(servidor_tcp);
+        servidor_tcp = INVALID_SOCKET;
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// FRENTE UDP
+// ============================================================================
+
+static SalidaDatagramas salida_udp;
+
+/** udp_entregar - El mensaje solo, como broker_udp */
+static void udp_entregar(int i, const Publicacion *pub) {
+    struct sockaddr_in addr = direccion_sub(i);
+    salida_encolar(&salida_udp, pub->clase, pub->contenido, (int)strlen(pub->contenido), &addr);
+}
+
+static void udp_vaciar(void) {
+    if (salida_udp.sock != INVALID_SOCKET) salida_vaciar(&salida_udp);
+}
+
+/** udp_publicable - ¿La línea, si es un PUBLISH, entra en el núcleo? */
+static int udp_publicable(const char *linea) {
+    if (strncmp(linea, "PUBLISH:", 8) != 0) return 1;
+    const char *tema = linea + 8;
+    const char *sep = strchr(tema, ':');
+    if (sep == NULL || sep == tema) return 1;                // Mal formado: se ignora
+    return nucleo_publicable(tema, (size_t)(sep - tema), strlen(sep + 1));
+}
+
+/** udp_comando - Atiende una línea de un datagrama UDP (publicar: como tcp_linea) */
+static void udp_comando(char *linea, int publicar, const struct sockaddr_in *cliente) {
+    if (strncmp(linea, "SUBSCRIBE:", 10) == 0) {
+        nucleo_suscribir(linea + 10, TRANSPORTE_UDP, -1, cliente);
+    } else if (strncmp(linea, "UNSUBSCRIBE:", 12) == 0) {
+        nucleo_baja(linea + 12, TRANSPORTE_UDP, -1, cliente);
+    } else if (strcmp(linea, "PING") == 0) {
+        nucleo_renovar(TRANSPORTE_UDP, cliente);
+    } else if (publicar && strncmp(linea, "PUBLISH:", 8) == 0) {
+        char *tema = linea + 8;
+        char *sep = strchr(tema, ':');
+        if (sep == NULL || sep == tema) return;
+        *sep = '\0';
+        nucleo_publicar(tema, sep + 1, TRANSPORTE_UDP);
+    }
+}
+
+/** udp_leer - Hasta LECTURAS_POR_VUELTA datagramas, línea por línea */
+static void udp_leer(void) {
+    char buffer[TAM_LINEA];
+    char *lineas[MAX_LINEAS];
+    char *resto;
+    struct sockaddr_in cliente;
+    for (int n = 0; n < LECTURAS_POR_VUELTA; n++) {
+        socklen_t tam = sizeof(cliente);
+        int bytes = recvfrom(salida_udp.sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *)&cliente, &tam);
+        if (bytes < 0) {
+            if (red_reintentar()) return;
+            continue;
+        }
+        buffer[bytes] = '\0';
+        int cantidad = partir_lineas(buffer, 1, lineas, &resto), publicar = 1;
+        for (int k = 0; k < cantidad; k++) {
+            if (!udp_publicable(lineas[k])) publicar = 0;
+        }
+        if (!publicar) printf("[udp] Datagrama de %s rechazado: una publicación no entra en un paquete\n",
+                              inet_ntoa(cliente.sin_addr));
+        for (int k = 0; k < cantidad; k++) udp_comando(lineas[k], publicar, &cliente);
+    }
+}
+
+// ============================================================================
+// FRENTE QUIC
+// ============================================================================
+
+static SalidaDatagramas salida_quic;
+
+/** quic_entregar - 'P' con el seq del tema y "tema:contenido" */
+static void quic_entregar(int i, const Publicacion *pub) {
+    Paquete pkt;
+    struct sockaddr_in addr = direccion_sub(i);
+    pkt.seq = pub->seq;
+    pkt.tipo = PKT_PUBLICACION;
+    snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%s:%s", pub->tema, pub->contenido);
+    salida_encolar(&salida_quic, pub->clase, &pkt, paquete_tam(&pkt), &addr);
+}
+
+static void quic_vaciar(void) {
+    if (salida_quic.sock != INVALID_SOCKET) salida_vaciar(&salida_quic);
+}
+
+/** quic_responder - Paquete de control directo al cliente (ACK, retransmisión) */
+static void quic_responder(char tipo, unsigned int seq, const char *texto, const struct sockaddr_in *cliente) {
+    Paquete pkt;
+    pkt.seq = seq;
+    pkt.tipo = tipo;
+    snprintf(pkt.mensaje, sizeof(pkt.mensaje), "%s", texto);
+    sendto(salida_quic.sock, (char *)&pkt, paquete_tam(&pkt), 0, (const struct sockaddr *)cliente,
+           sizeof(*cliente));
+}
+
+/**
+ * quic_reanudar - Reenvía lo que el subscriber no vio después de desde
+ *
+ * Retorna el primer seq que recibirá (lo anterior ya no está en el
+ * historial), para el "OK:<primer seq>" del ACK. A diferencia de
+ * broker_quic se reenvía todo de una vez, sin control de flujo: lo que no
+ * entre en la cola de salida se recupera con los ACK 'A' o con 'R'.
+ */
+static unsigned int quic_reanudar(int i, unsigned int desde) {
+    int id = (int)SUB_TEMA(i);
+    unsigned int ultimo = seq_del_tema(id), primero = 0;
+    Publicacion pub;
+    pub.id = id;
+    pub.tema = tema_nombre(&temas, id);
+    pub.clase = plan_clase_tema(pub.tema);
+    for (unsigned int seq = desde + 1; seq != 0 && seq <= ultimo; seq++) {
+        const char *contenido = buscar_en_historial(id, seq);
+        if (contenido == NULL) continue;
+        if (primero == 0) primero = seq;
+        pub.seq = seq;
+        pub.contenido = contenido;
+        quic_entregar(i, &pub);
+    }
+    return primero != 0 ? primero : ultimo + 1;
+}
+
+/** quic_retransmitir - Reenvía el seq del tema si sigue en el historial */
+static void quic_retransmitir(const char *tema, unsigned int seq, const struct sockaddr_in *cliente) {
+    char texto[QUIC_MAX_MENSAJE];
+    int id = tema_buscar(&temas, tema);
+    const char *contenido = id >= 0 ? buscar_en_historial(id, seq) : NULL;
+    if (contenido != NULL && nucleo_buscar(tema, TRANSPORTE_QUIC, -1, cliente) >= 0) {
+        snprintf(texto, sizeof(texto), "%.49s:%s", tema, contenido);
+        quic_responder(PKT_PUBLICACION, seq, texto, cliente);
+    }
+}
+
+/**
+ * quic_acks - Líneas de ACK "tema:limite:acumulado[:mapa]" de un 'A' o 'H'
+ *
+ * Sin control de flujo el límite no se usa; el mapa (bit k = recibió
+ * acumulado + 2 + k) pide los huecos, como en broker_quic.
+ */
+static void quic_acks(const char *texto, const struct sockaddr_in *cliente) {
+    while (texto != NULL && *texto != '\0') {
+        char tema[QUIC_MAX_TEMA + 10];
+        unsigned int limite, acumulado, mapa;
+        if (sscanf(texto, "%59[^:\n]:%u:%u:%x", tema, &limite, &acumulado, &mapa) == 4 && mapa != 0) {
+            quic_retransmitir(tema, acumulado + 1, cliente);
+            for (unsigned int k = 0; k < 32 && (mapa >> k) != 0; k++) {
+                if (!(mapa & (1u << k))) quic_retransmitir(tema, acumulado + 2 + k, cliente);
+            }
+        }
+        texto = strchr(texto, '\n');
+        if (texto != NULL) texto++;
+    }
+}
+
+/** quic_publicable - ¿La línea "tema:contenido" de un lote entra en el núcleo? */
+static int quic_publicable(const char *linea) {
+    const char *sep = strchr(linea, ':');
+    if (sep == NULL || sep == linea || sep[1] == '\0') return 1;   // Mal formada: se ignora
+    return nucleo_publicable(linea, (size_t)(sep - linea), strlen(sep + 1));
+}
+
+/** quic_paquete - Atiende un paquete QUIC (ver protocolo_quic.h) */
+static void quic_paquete(Paquete *pkt, const struct sockaddr_in *cliente) {
+    char texto[QUIC_MAX_MENSAJE];
+
+    if (pkt->tipo == PKT_SUSCRIPCION) {
+        // "tema:ultimo_seq" = reanudar después de ese seq
+        char *reanudar = strchr(pkt->mensaje, ':');
+        if (reanudar != NULL) *reanudar = '\0';
+        int i = nucleo_suscribir(pkt->mensaje, TRANSPORTE_QUIC, -1, cliente);
+        if (i < 0) return;                // Sin ACK: el cliente ve el error por su timeout
+        if (reanudar != NULL) {
+            snprintf(texto, sizeof(texto), "OK:%u", quic_reanudar(i, (unsigned int)strtoul(reanudar + 1, NULL, 10)));
+            quic_responder(PKT_ACK, pkt->seq, texto, cliente);
+        } else {
+            quic_responder(PKT_ACK, pkt->seq, "OK", cliente);
+        }
+    } else if (pkt->tipo == PKT_PUBLICACION) {
+        // Lote "tema:contenido\ntema:contenido": un solo ACK si salió todo.
+        // Se valida entero antes de publicar: si una línea no entra no sale
+        // ninguna, y el reintento del publisher no duplica las demás
+        int publicadas_lote = 0, fallidas = 0;
+        char *lineas[MAX_LINEAS];
+        char *resto;
+        int cantidad = partir_lineas(pkt->mensaje, 1, lineas, &resto);
+        for (int k = 0; k < cantidad; k++) {
+            if (!quic_publicable(lineas[k])) fallidas++;
+        }
+        if (fallidas > 0) printf("[quic] Lote rechazado: una publicación no entra en un paquete\n");
+        for (int k = 0; k < cantidad && fallidas == 0; k++) {
+            char *sep = strchr(lineas[k], ':');
+            if (sep != NULL && sep != lineas[k] && sep[1] != '\0') {
+                *sep = '\0';
+                if (nucleo_publicar(lineas[k], sep + 1, TRANSPORTE_QUIC) != 0) publicadas_lote++;
+                else fallidas++;
+            }
+        }
+        if (publicadas_lote > 0 && fallidas == 0) quic_responder(PKT_ACK, pkt->seq, "OK", cliente);
+    } else if (pkt->tipo == PKT_RETRANSMISION) {
+        quic_retransmitir(pkt->mensaje, pkt->seq, cliente);
+    } else if (pkt->tipo == PKT_BAJA) {
+        nucleo_baja(pkt->mensaje, TRANSPORTE_QUIC, -1, cliente);
+        quic_responder(PKT_ACK, pkt->seq, "OK", cliente);   // Aunque ya no estuviera
+    } else if (pkt->tipo == PKT_LATIDO) {
+        nucleo_renovar(TRANSPORTE_QUIC, cliente);
+        quic_acks(pkt->mensaje, cliente);      // ACKs que viajan en el latido
+    } else if (pkt->tipo == PKT_ACK) {
+        quic_acks(pkt->mensaje, cliente);
+    }
+}
+
+/** quic_leer - Hasta LECTURAS_POR_VUELTA paquetes */
+static void quic_leer(void) {
+    Paquete pkt;
+    struct sockaddr_in cliente;
+    for (int n = 0; n < LECTURAS_POR_VUELTA; n++) {
+        socklen_t tam = sizeof(cliente);
+        int bytes = recvfrom(salida_quic.sock, (char *)&pkt, sizeof(pkt), 0, (struct sockaddr *)&cliente, &tam);
+        if (bytes < 0) {
+            if (red_reintentar()) return;
+            continue;
+        }
+        if (paquete_terminar(&pkt, bytes)) quic_paquete(&pkt, &cliente);
+    }
+}
+
+// ============================================================================
+// FRENTES REGISTRADOS
+// ============================================================================
+
+// Índice = TRANSPORTE_*: el fan-out del núcleo llama a frentes[t].entregar
+static const Frente frentes[NUM_TRANSPORTES] = {
+    {"tcp", tcp_entregar, tcp_vaciar},
+    {"udp", udp_entregar, udp_vaciar},
+    {"quic", quic_entregar, quic_vaciar},
+};
+
+/** reportar - Cada 10 s, publicaciones por origen y entregas por destino */
+static void reportar(void) {
+    static unsigned long long ultimo = 0;
+    static unsigned long total_anterior = 0;
+    unsigned long long ahora = reloj_ms();
+    if (ahora - ultimo < 10000) return;
+    ultimo = ahora;
+    unsigned long total = publicadas[0] + publicadas[1] + publicadas[2];
+    if (total == total_anterior) return;
+    total_anterior = total;
+    printf("[stats] Publicadas tcp=%lu udp=%lu quic=%lu | entregadas tcp=%lu udp=%lu quic=%lu | %d suscripciones\n",
+           publicadas[0], publicadas[1], publicadas[2], entregadas[0], entregadas[1], entregadas[2],
+           subs.cantidad);
+}
+
+// ============================================================================
+// FUNCIÓN PRINCIPAL
+// ============================================================================
+
+/**
+ * main - Un solo bucle select() para los tres frentes
+ *
+ * Uso: broker_unificado [--tcp puerto] [--udp puerto] [--quic puerto]
+ *                       [--prioridad clase:tema ...]
+ *   Puerto 0 apaga ese frente. Por defecto 6000, 8080 y 7000 (los de
+ *   broker_tcp, broker_udp y broker_quic: sus clientes no cambian).
+ *
+ * Cada vuelta lee lo que llegó por todos los sockets y recién después
+ * vacía las colas de salida, así las entregas de la vuelta salen por
+ * prioridad del tema.
+ */
+int main(int argc, char *argv[]) {
+    int puerto_tcp = PUERTO_TCP, puerto_udp = PUERTO_UDP, puerto_quic = PUERTO_QUIC;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--tcp") == 0) {
+            puerto_tcp = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--udp") == 0) {
+            puerto_udp = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--quic") == 0) {
+            puerto_quic = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--prioridad") == 0 && plan_fijar_clase(argv[i + 1]) != 0) {
+            printf("--prioridad espera clase:tema (clase 0, 1 o 2)\n");
+            return 1;
+        }
+    }
+
+    red_iniciar();
+    nucleo_iniciar();
+    salida_udp.sock = salida_quic.sock = INVALID_SOCKET;
+    plan_iniciar(&salida_udp.plan, COLA_SALIDA);
+    plan_iniciar(&salida_quic.plan, COLA_SALIDA);
+
+    if (puerto_tcp > 0 && tcp_abrir(puerto_tcp) != 0) {
+        printf("[!] No se pudo escuchar TCP en el puerto %d\n", puerto_tcp);
+        return 1;
+    }
+    if (puerto_udp > 0 && (salida_udp.sock = abrir_datagramas(puerto_udp)) == INVALID_SOCKET) {
+        printf("[!] No se pudo enlazar UDP al puerto %d\n", puerto_udp);
+        return 1;
+    }
+    if (puerto_quic > 0 && (salida_quic.sock = abrir_datagramas(puerto_quic)) == INVALID_SOCKET) {
+        printf("[!] No se pudo enlazar QUIC al puerto %d\n", puerto_quic);
+        return 1;
+    }
+    printf("Broker unificado: tcp=%d udp=%d quic=%d (0 = apagado)\n", puerto_tcp, puerto_udp, puerto_quic);
+
+    while (1) {
+        fd_set lectura, escritura;
+        SOCKET mayor = 0;
+        FD_ZERO(&lectura);
+        FD_ZERO(&escritura);
+
+        if (servidor_tcp != INVALID_SOCKET) {
+            FD_SET(servidor_tcp, &lectura);
+            mayor = servidor_tcp;
+        }
+        for (int c = 0; c < MAX_CONEXIONES; c++) {
+            if (!conexiones[c].activo) continue;
+            FD_SET(conexiones[c].canal, &lectura);
+            if (plan_pendientes(&conexiones[c].salida) > 0) FD_SET(conexiones[c].canal, &escritura);
+            if (conexiones[c].canal > mayor) mayor = conexiones[c].canal;
+        }
+        SalidaDatagramas *datagramas[2] = {&salida_udp, &salida_quic};
+        for (int k = 0; k < 2; k++) {
+            if (datagramas[k]->sock == INVALID_SOCKET) continue;
+            FD_SET(datagramas[k]->sock, &lectura);
+            if (plan_pendientes(&datagramas[k]->plan) > 0) FD_SET(datagramas[k]->sock, &escritura);
+            if (datagramas[k]->sock > mayor) mayor = datagramas[k]->sock;
+        }
+
+        // Despierta al menos cada segundo para expirar subscribers sin latidos
+        struct timeval espera = {1, 0};
+        int listos = select((int)mayor + 1, &lectura, &escritura, NULL, &espera);
+        nucleo_expirar();
+        reportar();
+        if (listos <= 0) continue;
+
+        if (servidor_tcp != INVALID_SOCKET && FD_ISSET(servidor_tcp, &lectura)) tcp_aceptar();
+        for (int c = 0; c < MAX_CONEXIONES; c++) {
+            if (conexiones[c].activo && FD_ISSET(conexiones[c].canal, &lectura)) tcp_leer(c);
+        }
+        if (salida_udp.sock != INVALID_SOCKET && FD_ISSET(salida_udp.sock, &lectura)) udp_leer();
+        if (salida_quic.sock != INVALID_SOCKET && FD_ISSET(salida_quic.sock, &lectura)) quic_leer();
+
+        for (int t = 0; t < NUM_TRANSPORTES; t++) frentes[t].vaciar();
+    }
+
+    red_finalizar();
+    return 0;
+}
@@ -0,0 +1,816 @@
+/*
+ * ============================================================================
+ * CLIENTE PUB - Implementación (ver cliente_pub.h para la API)
+ * ============================================================================
+ *
+ * Estructura interna:
+ *
+ *   cola[]   Buffer circular de mensajes ya formateados para el protocolo
+ *            (una línea por mensaje) que todavía no salieron.
+ *
+ *   lote     Mensajes consecutivos de la cola unidos con '\n' en un solo
+ *            send()/sendto(). Los ids de un lote son siempre consecutivos,
+ *            así que basta con guardar (primer_id, cantidad).
+ *
+ *   vuelo[]  Solo QUIC: lotes enviados esperando ACK. El broker hace eco del
+ *            seq del paquete, que identifica el lote. Si no llega el ACK en
+ *            rto_ms se retransmite el mismo paquete (mismo seq).
+ *
+ * Alias de tema (UDP/QUIC, cfg.usar_alias):
+ *   La primera vez que un tema entra en un lote se pide su alias al broker
+ *   ('T' en QUIC, "ALIAS:tema" en UDP) y el mensaje sale con el texto.
+ *   Cuando llega el id, las líneas de ese tema salen como "#id:contenido".
+ *   La cola guarda siempre el texto completo y el tamaño del lote se mide
+ *   con él: así un lote en vuelo se puede volver a escribir con los temas
+ *   en texto si el broker dice que no conoce un id (o al reconectar).
+ *
+ * Mensajes fragmentados (QUIC):
+ *   Un payload que no cabe en una línea se encola como varias líneas
+ *   "tema:\x1e<id>.<k>/<n>:<trozo>", una por fragmento, con ids de cola
+ *   consecutivos. Desde ahí son mensajes comunes: entran en lotes, ocupan la
+ *   ventana y se retransmiten por timeout. fragmentados[] recuerda el rango
+ *   de ids de cada mensaje para llamar a al_completar una sola vez, cuando
+ *   se completó el último fragmento (los lotes se confirman en cualquier
+ *   orden). El <id> arranca al azar para que dos publishers del mismo tema
+ *   no lo repitan.
+ *
+ * Reconexión:
+ *   - TCP: si send()/recv() fallan o el broker cierra, se cierra el socket
+ *     y se reintenta connect() con backoff exponencial (100 ms .. 5 s). El
+ *     lote que estaba a medio escribir se reenvía completo.
+ *   - UDP/QUIC: no hay conexión, pero si un paquete agota max_reintentos se
+ *     recrea el socket (nuevo puerto local) y se retransmite todo lo que
+ *     estaba en vuelo.
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cliente_pub.h"
+#include "protocolo_quic.h"
+
+#define PUB_COLA         1024   // Mensajes encolados sin enviar
+#define PUB_MAX_VENTANA  256    // Tope de cfg.ventana
+#define PUB_MAX_LINEA    512    // Línea formateada más larga (MAX_MSG/TAM de los brokers)
+#define PUB_MAX_LOTE     4096   // Tope de cfg.max_lote (solo TCP llega a usarlo)
+#define BACKOFF_MIN_MS   100
+#define BACKOFF_MAX_MS   5000
+#define PUB_MAX_ALIAS    64     // Temas con alias por cliente
+#define PUB_MAX_FRAGMENTADOS 16 // Mensajes fragmentados sin confirmar
+
+typedef struct {
+    unsigned long long id;
+    unsigned long long encolado_ms;
+    int len;
+    int largo_tema;                  // 0 = la línea no admite alias
+    char linea[PUB_MAX_LINEA];
+} MsgCola;
+
+typedef struct {
+    int usado;
+    unsigned int seq;
+    unsigned long long primer_id;
+    int cantidad;
+    unsigned long long enviado_ms;
+    int reintentos;
+    int tam;
+    Paquete pkt;
+} EnVuelo;
+
+typedef struct {
+    char tema[QUIC_MAX_TEMA];
+    unsigned int id;                 // 0 = pedido sin respuesta (o sin alias)
+    int intentos;
+    unsigned long long pedido_ms;
+} AliasPub;
+
+typedef struct {
+    unsigned long long primer_id;    // Id del primer fragmento y del mensaje (0 = libre)
+    int cantidad;                    // Fragmentos (ids primer_id .. primer_id + cantidad - 1)
+    int restantes;                   // Sin completar
+    int estado;                      // PUB_DESCARTADO si se descartó alguno
+} Fragmentado;
+
+typedef enum {
+    DESCONECTADO,
+    CONECTANDO,      // Solo TCP: connect() no bloqueante en curso
+    CONECTADO
+} EstadoConexion;
+
+struct ClientePub {
+    ConfigPub cfg;
+    struct sockaddr_in broker;
+    SOCKET sock;
+    EstadoConexion estado;
+    unsigned long long proximo_intento_ms;
+    unsigned int backoff_ms;
+
+    MsgCola *cola;
+    int cabeza;
+    int cantidad;
+    int bytes_cola;
+    unsigned long long siguiente_id;
+
+    char lote[PUB_MAX_LOTE + 1];     // Lote TCP/UDP pendiente de escribir (+ su '\0')
+    int len_lote;
+    int enviado_lote;
+    unsigned long long lote_primer_id;
+    int lote_cantidad;
+
+    EnVuelo *vuelo;                  // Lotes QUIC sin ACK
+    int en_vuelo;
+    unsigned int siguiente_seq;
+
+    AliasPub alias[PUB_MAX_ALIAS];   // Índice + 1 = seq del 'T' (eco en la respuesta)
+    int num_alias;
+
+    Fragmentado fragmentados[PUB_MAX_FRAGMENTADOS];
+    int num_fragmentados;
+    unsigned int siguiente_fragmentado;   // <id> del próximo mensaje fragmentado
+
+    int completados;                 // Contador de la llamada actual a pub_procesar
+};
+
+// ============================================================================
+// FUNCIONES AUXILIARES
+// ============================================================================
+
+static int max_linea(ProtocoloPub p) {
+    switch (p) {
+        case PUB_QUIC: return QUIC_MAX_MENSAJE - 1;  // Cabe en Paquete.mensaje
+        case PUB_UDP:  return PUB_MAX_LINEA - 1;     // buffer[MAX_MSG] de broker_udp
+        default:       return PUB_MAX_LINEA - 2;     // + '\n' en recv(TAM - 1) de broker_tcp
+    }
+}
+
+static int limite_lote(const ClientePub *c) {
+    int tope = c->cfg.protocolo == PUB_TCP ? PUB_MAX_LOTE : max_linea(c->cfg.protocolo);
+    if (c->cfg.max_lote > 0 && c->cfg.max_lote < tope) tope = c->cfg.max_lote;
+    return tope;
+}
+
+/** fragmentado_de - Mensaje fragmentado al que pertenece el id, o NULL */
+static Fragmentado *fragmentado_de(ClientePub *c, unsigned long long id) {
+    for (int i = 0; i < PUB_MAX_FRAGMENTADOS && c->num_fragmentados > 0; i++) {
+        Fragmentado *f = &c->fragmentados[i];
+        if (f->primer_id != 0 && id >= f->primer_id && id < f->primer_id + (unsigned long long)f->cantidad) return f;
+    }
+    return NULL;
+}
+
+static void completar(ClientePub *c, unsigned long long primer_id, int cantidad, int estado) {
+    for (int i = 0; i < cantidad; i++) {
+        unsigned long long id = primer_id + i;
+        int final = estado;
+        Fragmentado *f = fragmentado_de(c, id);
+        if (f != NULL) {
+            // Un fragmento: el mensaje se completa con el último
+            if (estado != PUB_CONFIRMADO) f->estado = estado;
+            if (--f->restantes > 0) continue;
+            id = f->primer_id;
+            final = f->estado;
+            f->primer_id = 0;
+            c->num_fragmentados--;
+        }
+        if (c->cfg.al_completar) c->cfg.al_completar(c->cfg.ctx, id, final);
+        c->completados++;
+    }
+}
+
+// Bytes antes del tema en una línea de la cola ("PUBLISH:" en UDP)
+static int prefijo_tema(const ClientePub *c) {
+    return c->cfg.protocolo == PUB_UDP ? 8 : 0;
+}
+
+static void pedir_alias(ClientePub *c, int i, unsigned long long ahora) {
+    AliasPub *a = &c->alias[i];
+    if (c->cfg.protocolo == PUB_QUIC) {
+        Paquete pkt;
+        pkt.seq = (unsigned int)i + 1;
+        pkt.tipo = PKT_ALIAS;
+        strcpy(pkt.mensaje, a->tema);
+        sendto(c->sock, (char*)&pkt, paquete_tam(&pkt), 0,
+               (struct sockaddr*)&c->broker, sizeof(c->broker));
+    } else {
+        char pedido[QUIC_MAX_TEMA + 8];
+        int n = snprintf(pedido, sizeof(pedido), "ALIAS:%s", a->tema);
+        sendto(c->sock, pedido, n, 0, (struct sockaddr*)&c->broker, sizeof(c->broker));
+    }
+    a->pedido_ms = ahora;
+    a->intentos++;
+}
+
+/**
+ * alias_para - Id del tema, o 0 si todavía no hay (y lo pide la primera vez)
+ */
+static unsigned int alias_para(ClientePub *c, const char *tema, int largo, unsigned long long ahora) {
+    for (int i = 0; i < c->num_alias; i++) {
+        if (strncmp(c->alias[i].tema, tema, largo) == 0 && c->alias[i].tema[largo] == '\0') {
+            return c->alias[i].id;
+        }
+    }
+    if (c->num_alias == PUB_MAX_ALIAS || largo >= QUIC_MAX_TEMA) return 0;
+    AliasPub *a = &c->alias[c->num_alias++];
+    memcpy(a->tema, tema, largo);
+    a->tema[largo] = '\0';
+    a->id = 0;
+    a->intentos = 0;
+    pedir_alias(c, c->num_alias - 1, ahora);
+    return 0;
+}
+
+/** revisar_alias - Reintenta los pedidos sin respuesta */
+static void revisar_alias(ClientePub *c, unsigned long long ahora) {
+    for (int i = 0; i < c->num_alias; i++) {
+        AliasPub *a = &c->alias[i];
+        if (a->id == 0 && a->intentos < c->cfg.max_reintentos && ahora - a->pedido_ms >= c->cfg.rto_ms) {
+            pedir_alias(c, i, ahora);
+        }
+    }
+}
+
+/** fijar_alias - Respuesta del broker: "id:tema" */
+static void fijar_alias(ClientePub *c, const char *respuesta) {
+    char *fin;
+    unsigned long id = strtoul(respuesta, &fin, 10);
+    if (*fin != ':') return;
+    for (int i = 0; i < c->num_alias; i++) {
+        if (strcmp(c->alias[i].tema, fin + 1) == 0) {
+            c->alias[i].id = (unsigned int)id;
+            c->alias[i].intentos = c->cfg.max_reintentos;   // id = 0: sin alias, no insistir
+            return;
+        }
+    }
+}
+
+/**
+ * copiar_linea - Escribe la línea en destino, con "#id" en lugar del tema
+ * si hay alias y es más corto. Retorna los bytes escritos.
+ */
+static int copiar_linea(ClientePub *c, const MsgCola *m, char *destino, unsigned long long ahora) {
+    int prefijo = prefijo_tema(c);
+    unsigned int id = m->largo_tema > 0 ? alias_para(c, m->linea + prefijo, m->largo_tema, ahora) : 0;
+    char num[16];
+    int n = id != 0 ? snprintf(num, sizeof(num), "%c%u", ALIAS_PREFIJO, id) : 0;
+    if (n == 0 || n >= m->largo_tema) {
+        memcpy(destino, m->linea, m->len);
+        return m->len;
+    }
+    int resto = m->len - prefijo - m->largo_tema;
+    memcpy(destino, m->linea, prefijo);
+    memcpy(destino + prefijo, num, n);
+    memcpy(destino + prefijo + n, m->linea + prefijo + m->largo_tema, resto);
+    return prefijo + n + resto;
+}
+
+/**
+ * expandir_alias - Vuelve a escribir un lote QUIC en vuelo con los temas en
+ * texto. Siempre cabe: el lote se armó midiendo las líneas completas.
+ */
+static void expandir_alias(ClientePub *c, EnVuelo *v) {
+    char texto[QUIC_MAX_MENSAJE];
+    int len = 0;
+    char *linea = v->pkt.mensaje;
+    while (linea != NULL && *linea != '\0') {
+        char *fin = strchr(linea, '\n');
+        if (fin != NULL) *fin = '\0';
+        const char *resto = linea;
+        if (linea[0] == ALIAS_PREFIJO) {
+            char *sep;
+            unsigned long id = strtoul(linea + 1, &sep, 10);
+            for (int i = 0; i < c->num_alias; i++) {
+                if (c->alias[i].id != 0 && c->alias[i].id == id) {
+                    len += snprintf(texto + len, sizeof(texto) - len, "%s", c->alias[i].tema);
+                    resto = sep;
+                    break;
+                }
+            }
+        }
+        len += snprintf(texto + len, sizeof(texto) - len, "%s%s", resto, fin != NULL ? "\n" : "");
+        linea = fin != NULL ? fin + 1 : NULL;
+    }
+    memcpy(v->pkt.mensaje, texto, len + 1);
+    v->tam = paquete_tam(&v->pkt);
+}
+
+/**
+ * olvidar_alias - El broker ya no reconoce los ids (o se recrea el socket):
+ * los lotes en vuelo vuelven al texto y los alias se negocian de nuevo
+ */
+static void olvidar_alias(ClientePub *c) {
+    if (c->num_alias == 0) return;
+    for (int i = 0; i < c->cfg.ventana && c->cfg.protocolo == PUB_QUIC; i++) {
+        if (c->vuelo[i].usado) expandir_alias(c, &c->vuelo[i]);
+    }
+    c->num_alias = 0;
+}
+
+/**
+ * conectar - Crea el socket (y en TCP inicia connect() no bloqueante)
+ */
+static void conectar(ClientePub *c) {
+    int tipo = c->cfg.protocolo == PUB_TCP ? SOCK_STREAM : SOCK_DGRAM;
+    c->sock = socket(AF_INET, tipo, 0);
+    if (c->sock == INVALID_SOCKET) {
+        c->estado = DESCONECTADO;
+        c->proximo_intento_ms = reloj_ms() + c->backoff_ms;
+        return;
+    }
+    red_no_bloqueante(c->sock);
+
+    if (c->cfg.protocolo != PUB_TCP) {
+        c->estado = CONECTADO;
+        return;
+    }
+
+    if (connect(c->sock, (struct sockaddr*)&c->broker, sizeof(c->broker)) == 0) {
+        c->estado = CONECTADO;
+        c->backoff_ms = BACKOFF_MIN_MS;
+    } else if (red_reintentar()) {
+        c->estado = CONECTANDO;
+    } else {
+        closesocket(c->sock);
+        c->sock = INVALID_SOCKET;
+        c->estado = DESCONECTADO;
+        c->proximo_intento_ms = reloj_ms() + c->backoff_ms;
+    }
+}
+
+/**
+ * desconectar - Cierra el socket y programa la reconexión con backoff
+ *
+ * Lo que estaba a medio enviar se conserva para reenviarlo completo.
+ */
+static void desconectar(ClientePub *c) {
+    if (c->sock != INVALID_SOCKET) closesocket(c->sock);
+    c->sock = INVALID_SOCKET;
+    c->estado = DESCONECTADO;
+    c->proximo_intento_ms = reloj_ms() + c->backoff_ms;
+    c->backoff_ms = c->backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : c->backoff_ms * 2;
+    c->enviado_lote = 0;
+    olvidar_alias(c);
+
+    for (int i = 0; i < c->cfg.ventana; i++) {
+        if (c->vuelo[i].usado) {
+            c->vuelo[i].enviado_ms = 0;    // Retransmitir apenas haya socket
+            c->vuelo[i].reintentos = 0;
+        }
+    }
+}
+
+/**
+ * armar_lote - Une mensajes de la cabeza de la cola en destino
+ *
+ * Con forzar = 0 respeta espera_lote_ms: si lo encolado no llena un lote y
+ * el mensaje más viejo aún puede esperar, no arma nada.
+ *
+ * Retorna la cantidad de mensajes tomados (0 si no hay lote listo).
+ */
+static int armar_lote(ClientePub *c, char *destino, int *len_out,
+                      unsigned long long *primer_id, unsigned long long ahora) {
+    if (c->cantidad == 0) return 0;
+
+    int limite = limite_lote(c);
+    MsgCola *primero = &c->cola[c->cabeza];
+    if (c->bytes_cola < limite && ahora - primero->encolado_ms < c->cfg.espera_lote_ms) {
+        return 0;
+    }
+
+    int tcp = c->cfg.protocolo == PUB_TCP;
+    int len = 0, tomados = 0;
+    int largo = 0;                            // Tamaño con los temas en texto (el que se limita)
+    *primer_id = primero->id;
+    while (c->cantidad > 0) {
+        MsgCola *m = &c->cola[c->cabeza];
+        int sep = (tcp || tomados > 0) ? 1 : 0;
+        if (tomados > 0 && largo + m->len + sep > limite) break;
+        if (!tcp && tomados > 0) {
+            destino[len++] = '\n';
+            largo++;
+        }
+        len += copiar_linea(c, m, destino + len, ahora);
+        largo += m->len;
+        if (tcp) {
+            destino[len++] = '\n';            // TCP: cada evento termina en '\n'
+            largo++;
+        }
+
+        c->bytes_cola -= m->len + 1;
+        c->cabeza = (c->cabeza + 1) % PUB_COLA;
+        c->cantidad--;
+        tomados++;
+    }
+    destino[len] = '\0';
+    *len_out = len;
+    return tomados;
+}
+
+// ============================================================================
+// TCP / UDP
+// ============================================================================
+
+static void verificar_conexion_tcp(ClientePub *c) {
+    fd_set escritura;
+    struct timeval cero = {0, 0};
+    FD_ZERO(&escritura);
+    FD_SET(c->sock, &escritura);
+    if (select((int)c->sock + 1, NULL, &escritura, NULL, &cero) <= 0) return;
+
+    int error = 0;
+    socklen_t tam = sizeof(error);
+    getsockopt(c->sock, SOL_SOCKET, SO_ERROR, (char*)&error, &tam);
+    if (error == 0) {
+        c->estado = CONECTADO;
+        c->backoff_ms = BACKOFF_MIN_MS;
+    } else {
+        desconectar(c);
+    }
+}
+
+/** leer_alias_udp - Respuestas "ALIAS:id:tema" / "UNALIAS:#id" de broker_udp */
+static void leer_alias_udp(ClientePub *c) {
+    char respuesta[QUIC_MAX_TEMA + 32];
+    while (1) {
+        int bytes = recvfrom(c->sock, respuesta, sizeof(respuesta) - 1, 0, NULL, NULL);
+        if (bytes < 0) {
+            if (red_reintentar()) return;
+            continue;
+        }
+        respuesta[bytes] = '\0';
+        if (strncmp(respuesta, "ALIAS:", 6) == 0) {
+            fijar_alias(c, respuesta + 6);
+        } else if (strncmp(respuesta, "UNALIAS:", 8) == 0) {
+            olvidar_alias(c);   // Sin ACK en UDP: lo ya enviado con ese id se perdió
+        }
+    }
+}
+
+static void vaciar_tcp_udp(ClientePub *c, unsigned long long ahora) {
+    // El broker TCP no le escribe a los publishers: si recv() devuelve algo
+    // que no sea "sin datos" es que cerró la conexión.
+    if (c->cfg.protocolo == PUB_TCP) {
+        char basura[64];
+        int r = recv(c->sock, basura, sizeof(basura), 0);
+        if (r == 0 || (r < 0 && !red_reintentar())) {
+            desconectar(c);
+            return;
+        }
+    } else if (c->num_alias > 0) {
+        leer_alias_udp(c);
+    }
+
+    while (1) {
+        if (c->len_lote == 0) {
+            c->lote_cantidad = armar_lote(c, c->lote, &c->len_lote, &c->lote_primer_id, ahora);
+            c->enviado_lote = 0;
+            if (c->lote_cantidad == 0) return;
+        }
+
+        int r;
+        if (c->cfg.protocolo == PUB_TCP) {
+            r = send(c->sock, c->lote + c->enviado_lote, c->len_lote - c->enviado_lote, MSG_NOSIGNAL);
+        } else {
+            r = sendto(c->sock, c->lote, c->len_lote, 0,
+                       (struct sockaddr*)&c->broker, sizeof(c->broker));
+        }
+
+        if (r < 0) {
+            if (!red_reintentar()) desconectar(c);
+            return;  // Buffer del kernel lleno: seguir en el próximo pub_procesar
+        }
+        c->enviado_lote += r;
+        if (c->enviado_lote < c->len_lote) return;
+
+        completar(c, c->lote_primer_id, c->lote_cantidad, PUB_CONFIRMADO);
+        c->len_lote = 0;
+    }
+}
+
+// ============================================================================
+// QUIC
+// ============================================================================
+
+static void enviar_vuelo(ClientePub *c, EnVuelo *v, unsigned long long ahora) {
+    sendto(c->sock, (char*)&v->pkt, v->tam, 0,
+           (struct sockaddr*)&c->broker, sizeof(c->broker));
+    v->enviado_ms = ahora;
+}
+
+static void leer_acks_quic(ClientePub *c) {
+    Paquete ack;
+    while (1) {
+        struct sockaddr_in origen;
+        socklen_t tam = sizeof(origen);
+        int bytes = recvfrom(c->sock, (char*)&ack, sizeof(ack), 0,
+                             (struct sockaddr*)&origen, &tam);
+        if (bytes < 0) {
+            if (red_reintentar()) return;
+            continue;  // Ej: WSAECONNRESET por un ICMP anterior; el socket sigue usable
+        }
+        if (!paquete_terminar(&ack, bytes)) continue;
+        if (ack.tipo == PKT_ALIAS) {
+            if (ack.seq != 0) {
+                fijar_alias(c, ack.mensaje);
+                continue;
+            }
+            // "#id" desconocido: reenviar ya los lotes en vuelo con el texto
+            olvidar_alias(c);
+            for (int i = 0; i < c->cfg.ventana; i++) {
+                c->vuelo[i].enviado_ms = 0;
+                c->vuelo[i].reintentos = 0;
+            }
+            continue;
+        }
+        if (ack.tipo != PKT_ACK) continue;
+
+        for (int i = 0; i < c->cfg.ventana; i++) {
+            EnVuelo *v = &c->vuelo[i];
+            if (v->usado && v->seq == ack.seq) {
+                completar(c, v->primer_id, v->cantidad, PUB_CONFIRMADO);
+                v->usado = 0;
+                c->en_vuelo--;
+                c->backoff_ms = BACKOFF_MIN_MS;
+                break;
+            }
+        }
+    }
+}
+
+static void vaciar_quic(ClientePub *c, unsigned long long ahora) {
+    leer_acks_quic(c);
+
+    // Retransmitir lotes sin ACK; el timeout se duplica en cada intento
+    for (int i = 0; i < c->cfg.ventana; i++) {
+        EnVuelo *v = &c->vuelo[i];
+        if (!v->usado) continue;
+        unsigned long long rto = (unsigned long long)c->cfg.rto_ms << (v->reintentos < 4 ? v->reintentos : 4);
+        if (v->enviado_ms != 0 && ahora - v->enviado_ms < rto) continue;
+
+        if (v->enviado_ms != 0 && ++v->reintentos > c->cfg.max_reintentos) {
+            desconectar(c);       // Recrear socket y retransmitir todo
+            return;
+        }
+        enviar_vuelo(c, v, ahora);
+    }
+
+    // Llenar la ventana con lotes nuevos
+    while (c->en_vuelo < c->cfg.ventana && c->cantidad > 0) {
+        EnVuelo *v = NULL;
+        for (int i = 0; i < c->cfg.ventana; i++) {
+            if (!c->vuelo[i].usado) { v = &c->vuelo[i]; break; }
+        }
+        if (v == NULL) return;
+
+        int len;
+        int n = armar_lote(c, v->pkt.mensaje, &len, &v->primer_id, ahora);
+        if (n == 0) return;
+
+        v->usado = 1;
+        v->cantidad = n;
+        v->reintentos = 0;
+        v->seq = c->siguiente_seq++;
+        v->pkt.seq = v->seq;
+        v->pkt.tipo = PKT_PUBLICACION;
+        v->tam = paquete_tam(&v->pkt);
+        c->en_vuelo++;
+        enviar_vuelo(c, v, ahora);
+    }
+}
+
+/**
+ * proximo_evento_ms - Milisegundos hasta el próximo timer interno
+ *
+ * Sirve para no dormir en select() más de lo necesario.
+ */
+static unsigned int proximo_evento_ms(const ClientePub *c, unsigned long long ahora, unsigned int tope) {
+    unsigned long long limite = ahora + tope;
+
+    if (c->estado == DESCONECTADO && c->proximo_intento_ms < limite) limite = c->proximo_intento_ms;
+    if (c->cantidad > 0) {
+        unsigned long long lote = c->cola[c->cabeza].encolado_ms + c->cfg.espera_lote_ms;
+        if (lote < limite) limite = lote;
+    }
+    for (int i = 0; i < c->cfg.ventana && c->cfg.protocolo == PUB_QUIC; i++) {
+        const EnVuelo *v = &c->vuelo[i];
+        if (!v->usado) continue;
+        unsigned long long rto = (unsigned long long)c->cfg.rto_ms << (v->reintentos < 4 ? v->reintentos : 4);
+        if (v->enviado_ms + rto < limite) limite = v->enviado_ms + rto;
+    }
+    return limite > ahora ? (unsigned int)(limite - ahora) : 0;
+}
+
+// ============================================================================
+// API PÚBLICA
+// ============================================================================
+
+void pub_config_defecto(ConfigPub *cfg, ProtocoloPub protocolo, const char *ip) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->protocolo = protocolo;
+    cfg->ip = ip;
+    cfg->ventana = 32;
+    cfg->max_lote = 0;            // Lo que quepa en un paquete / 4 KB en TCP
+    cfg->espera_lote_ms = 2;
+    cfg->rto_ms = 200;
+    cfg->max_reintentos = 5;
+    cfg->usar_alias = 1;
+}
+
+ClientePub *pub_crear(const ConfigPub *cfg) {
+    if (cfg == NULL || cfg->ip == NULL) return NULL;
+    if (red_iniciar() != 0) return NULL;
+
+    ClientePub *c = calloc(1, sizeof(ClientePub));
+    if (c == NULL) return NULL;
+    c->cfg = *cfg;
+    if (c->cfg.ventana <= 0) c->cfg.ventana = 32;
+    if (c->cfg.ventana > PUB_MAX_VENTANA) c->cfg.ventana = PUB_MAX_VENTANA;
+    if (c->cfg.rto_ms == 0) c->cfg.rto_ms = 200;
+    if (c->cfg.max_reintentos <= 0) c->cfg.max_reintentos = 5;
+    if (c->cfg.puerto == 0) {
+        c->cfg.puerto = cfg->protocolo == PUB_TCP ? 6000 : cfg->protocolo == PUB_UDP ? 8080 : QUIC_PUERTO;
+    }
+
+    c->cola = malloc(sizeof(MsgCola) * PUB_COLA);
+    c->vuelo = calloc(c->cfg.ventana, sizeof(EnVuelo));
+    if (c->cola == NULL || c->vuelo == NULL) {
+        free(c->cola);
+        free(c->vuelo);
+        free(c);
+        return NULL;
+    }
+
+    memset(&c->broker, 0, sizeof(c->broker));
+    c->broker.sin_family = AF_INET;
+    c->broker.sin_addr.s_addr = inet_addr(c->cfg.ip);
+    c->broker.sin_port = htons(c->cfg.puerto);
+
+    c->siguiente_id = 1;
+    c->siguiente_seq = 1;
+    c->siguiente_fragmentado = (unsigned int)(reloj_ms() * 2654435761ULL) ^ (unsigned int)(size_t)c;
+    c->backoff_ms = BACKOFF_MIN_MS;
+    c->sock = INVALID_SOCKET;
+    conectar(c);
+    return c;
+}
+
+/**
+ * publicar_fragmentado - Encola el payload partido en fragmentos (QUIC)
+ *
+ * Cada fragmento lleva lo que quepa del payload escapado en una línea. Se
+ * cuentan antes de encolar: entran todos en la cola o no entra ninguno.
+ */
+static long long publicar_fragmentado(ClientePub *c, const char *tema, const char *payload, size_t len) {
+    int largo_tema = (int)strlen(tema);
+    int espacio = max_linea(c->cfg.protocolo) - largo_tema - 1 - FRAGMENTO_CABECERA;
+    int escritos;
+    Fragmentado *f = NULL;
+    for (int i = 0; i < PUB_MAX_FRAGMENTADOS && f == NULL; i++) {
+        if (c->fragmentados[i].primer_id == 0) f = &c->fragmentados[i];
+    }
+    if (f == NULL || espacio < 2) return -1;
+
+    int total = 0;
+    for (size_t hecho = 0; hecho < len && total <= QUIC_MAX_FRAGMENTOS; total++) {
+        hecho += fragmento_escapar(payload + hecho, len - hecho, NULL, espacio, &escritos);
+    }
+    if (total > QUIC_MAX_FRAGMENTOS) return -1;
+    if (c->cantidad + total > PUB_COLA) {
+        pub_procesar(c, 0);                 // Intentar hacer lugar sin bloquear
+        if (c->cantidad + total > PUB_COLA) return -1;
+    }
+
+    unsigned int id_mensaje = c->siguiente_fragmentado++;
+    unsigned long long ahora = reloj_ms();
+    f->primer_id = c->siguiente_id;
+    f->cantidad = f->restantes = total;
+    f->estado = PUB_CONFIRMADO;
+    c->num_fragmentados++;
+    size_t hecho = 0;
+    for (int k = 0; k < total; k++) {
+        MsgCola *m = &c->cola[(c->cabeza + c->cantidad) % PUB_COLA];
+        int n = snprintf(m->linea, sizeof(m->linea), "%s:%c%x.%d/%d:", tema, FRAGMENTO_PREFIJO,
+                         id_mensaje, k, total);
+        hecho += fragmento_escapar(payload + hecho, len - hecho, m->linea + n, espacio, &escritos);
+        m->len = n + escritos;
+        m->linea[m->len] = '\0';
+        m->largo_tema = c->cfg.usar_alias ? largo_tema : 0;
+        m->id = c->siguiente_id++;
+        m->encolado_ms = ahora;
+        c->cantidad++;
+        c->bytes_cola += m->len + 1;
+    }
+
+    if (c->bytes_cola >= limite_lote(c)) pub_procesar(c, 0);
+    return (long long)f->primer_id;
+}
+
+long long pub_publicar(ClientePub *c, const char *tema, const char *payload, size_t len) {
+    if (c == NULL || tema == NULL || payload == NULL) return -1;
+    if (tema[0] == '\0' || strpbrk(tema, ":\n") != NULL) return -1;
+    if (c->cfg.protocolo != PUB_TCP && tema[0] == ALIAS_PREFIJO) return -1;
+    if (c->cfg.protocolo == PUB_QUIC &&
+        (strlen(tema) + 1 + len > (size_t)max_linea(c->cfg.protocolo) ||
+         memchr(payload, '\n', len) != NULL || memchr(payload, '\0', len) != NULL)) {
+        return publicar_fragmentado(c, tema, payload, len);
+    }
+    if (memchr(payload, '\n', len) != NULL) return -1;
+
+    if (c->cantidad == PUB_COLA) {
+        pub_procesar(c, 0);                 // Intentar hacer lugar sin bloquear
+        if (c->cantidad == PUB_COLA) return -1;
+    }
+
+    // Formatear la línea según el protocolo del broker
+    MsgCola *m = &c->cola[(c->cabeza + c->cantidad) % PUB_COLA];
+    int n;
+    switch (c->cfg.protocolo) {
+        case PUB_TCP:  n = snprintf(m->linea, sizeof(m->linea), "%s ", tema); break;
+        case PUB_UDP:  n = snprintf(m->linea, sizeof(m->linea), "PUBLISH:%s:", tema); break;
+        default:       n = snprintf(m->linea, sizeof(m->linea), "%s:", tema); break;
+    }
+    if (n < 0 || (size_t)n + len > (size_t)max_linea(c->cfg.protocolo)) return -1;
+    memcpy(m->linea + n, payload, len);
+    m->len = n + (int)len;
+    m->linea[m->len] = '\0';
+    m->largo_tema = c->cfg.usar_alias && c->cfg.protocolo != PUB_TCP ? (int)strlen(tema) : 0;
+    m->id = c->siguiente_id++;
+    m->encolado_ms = reloj_ms();
+
+    c->cantidad++;
+    c->bytes_cola += m->len + 1;
+
+    // Con un lote completo no hay motivo para esperar a pub_procesar
+    if (c->bytes_cola >= limite_lote(c)) pub_procesar(c, 0);
+    return (long long)m->id;
+}
+
+int pub_procesar(ClientePub *c, unsigned int espera_ms) {
+    if (c == NULL) return 0;
+    c->completados = 0;
+
+    unsigned long long ahora = reloj_ms();
+    if (c->estado == DESCONECTADO && ahora >= c->proximo_intento_ms) conectar(c);
+
+    if (espera_ms > 0) {
+        unsigned int espera = proximo_evento_ms(c, ahora, espera_ms);
+        if (c->sock == INVALID_SOCKET) {
+            dormir_ms(espera);
+        } else if (espera > 0) {
+            fd_set lectura, escritura;
+            struct timeval tv;
+            FD_ZERO(&lectura);
+            FD_ZERO(&escritura);
+            FD_SET(c->sock, &lectura);
+            if (c->estado == CONECTANDO || c->len_lote > 0) FD_SET(c->sock, &escritura);
+            tv.tv_sec = espera / 1000;
+            tv.tv_usec = (espera % 1000) * 1000;
+            select((int)c->sock + 1, &lectura, &escritura, NULL, &tv);
+        }
+        ahora = reloj_ms();
+    }
+
+    if (c->estado == CONECTANDO) verificar_conexion_tcp(c);
+    if (c->estado != CONECTADO) return c->completados;
+
+    if (c->num_alias > 0) revisar_alias(c, ahora);
+    if (c->cfg.protocolo == PUB_QUIC) {
+        vaciar_quic(c, ahora);
+    } else {
+        vaciar_tcp_udp(c, ahora);
+    }
+    return c->completados;
+}
+
+SOCKET pub_socket(const ClientePub *c) {
+    return c ? c->sock : INVALID_SOCKET;
+}
+
+int pub_pendientes(const ClientePub *c) {
+    if (c == NULL) return 0;
+    int pendientes = c->cantidad + (c->len_lote > 0 ? c->lote_cantidad : 0);
+    for (int i = 0; i < c->cfg.ventana; i++) {
+        if (c->vuelo[i].usado) pendientes += c->vuelo[i].cantidad;
+    }
+    return pendientes;
+}
+
+void pub_destruir(ClientePub *c) {
+    if (c == NULL) return;
+
+    for (int i = 0; i < c->cfg.ventana; i++) {
+        if (c->vuelo[i].usado) completar(c, c->vuelo[i].primer_id, c->vuelo[i].cantidad, PUB_DESCARTADO);
+    }
+    if (c->len_lote > 0) completar(c, c->lote_primer_id, c->lote_cantidad, PUB_DESCARTADO);
+    while (c->cantidad > 0) {
+        completar(c, c->cola[c->cabeza].id, 1, PUB_DESCARTADO);
+        c->cabeza = (c->cabeza + 1) % PUB_COLA;
+        c->cantidad--;
+    }
+
+    if (c->sock != INVALID_SOCKET) closesocket(c->sock);
+    free(c->cola);
+    free(c->vuelo);
+    free(c);
+    red_finalizar();
+}
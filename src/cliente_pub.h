@@ -0,0 +1,116 @@
+/*
+ * ============================================================================
+ * CLIENTE PUB - Librería embebible para publicar sin bloquear
+ * ============================================================================
+ *
+ * Envuelve los tres protocolos del laboratorio detrás de una sola API:
+ *   - PUB_TCP:  broker_tcp  (puerto 6000), "PARTIDO evento\n" por línea
+ *   - PUB_UDP:  broker_udp  (puerto 8080), "PUBLISH:tema:mensaje" por línea
+ *   - PUB_QUIC: broker_quic (puerto 7000), Paquete 'P' con "tema:contenido"
+ *
+ * A diferencia de publisher_*.c (un main() que lee una línea, envía y
+ * espera), la librería está pensada para correr dentro del event loop de
+ * otro servicio:
+ *
+ *   - pub_publicar() solo encola el mensaje y retorna de inmediato.
+ *   - pub_procesar() hace el trabajo de red pendiente: arma lotes (varios
+ *     mensajes por paquete/send), respeta la ventana de paquetes en vuelo,
+ *     lee ACKs, retransmite por timeout y reconecta si el broker se cae.
+ *   - Cada mensaje tiene un id; el callback al_completar avisa cuando quedó
+ *     confirmado (ACK en QUIC, escrito al socket en TCP/UDP).
+ *
+ * Ejemplo mínimo:
+ *
+ *   ConfigPub cfg;
+ *   pub_config_defecto(&cfg, PUB_QUIC, "127.0.0.1");
+ *   cfg.al_completar = mi_callback;
+ *   ClientePub *c = pub_crear(&cfg);
+ *   pub_publicar(c, "Colombia vs Argentina", "Gol al minuto 45", 16);
+ *   while (pub_pendientes(c) > 0) pub_procesar(c, 10);
+ *   pub_destruir(c);
+ *
+ * Compilación: agregar src/cliente_pub.c al programa que la usa
+ *   gcc mi_servicio.c src/cliente_pub.c -o mi_servicio.exe -lws2_32
+ * ============================================================================
+ */
+
+#ifndef CLIENTE_PUB_H
+#define CLIENTE_PUB_H
+
+#include <stddef.h>
+#include "plataforma.h"
+
+typedef enum {
+    PUB_TCP,
+    PUB_UDP,
+    PUB_QUIC
+} ProtocoloPub;
+
+// Estados reportados a al_completar
+#define PUB_CONFIRMADO  0   // ACK del broker (QUIC) o entregado al socket (TCP/UDP)
+#define PUB_DESCARTADO -1   // El cliente se destruyó antes de confirmar el mensaje
+
+typedef void (*PubAlCompletar)(void *ctx, unsigned long long id, int estado);
+
+typedef struct {
+    ProtocoloPub protocolo;
+    const char *ip;               // IP del broker
+    unsigned short puerto;        // 0 = puerto por defecto del protocolo
+    int ventana;                  // Paquetes QUIC en vuelo sin ACK
+    int max_lote;                 // Bytes máximos por lote (paquete o send)
+    unsigned int espera_lote_ms;  // Cuánto puede esperar un mensaje a que se llene su lote
+    unsigned int rto_ms;          // Espera de ACK antes de retransmitir (QUIC)
+    int max_reintentos;           // Retransmisiones seguidas antes de reconectar
+    int usar_alias;               // UDP/QUIC: negociar ids numéricos para no enviar el tema
+    PubAlCompletar al_completar;  // Opcional
+    void *ctx;                    // Se pasa tal cual a al_completar
+} ConfigPub;
+
+typedef struct ClientePub ClientePub;
+
+/** pub_config_defecto - Llena cfg con valores razonables para el protocolo */
+void pub_config_defecto(ConfigPub *cfg, ProtocoloPub protocolo, const char *ip);
+
+/** pub_crear - Crea el cliente e inicia la conexión. NULL si falla. */
+ClientePub *pub_crear(const ConfigPub *cfg);
+
+/**
+ * pub_publicar - Encola una publicación (no bloquea)
+ *
+ * El tema no puede contener ':' ni '\n' (son los separadores del formato
+ * de texto de los brokers). En UDP y QUIC tampoco puede empezar con '#'
+ * (marca los alias numéricos). En TCP y UDP el payload no puede contener
+ * '\n' y debe caber en una línea.
+ *
+ * En QUIC un payload que no cabe en un paquete, o que tiene '\n' o '\0', se
+ * parte en fragmentos (hasta QUIC_MAX_FRAGMENTOS, unos 470 KB) que ocupan
+ * un lugar de la cola cada uno y salen en lotes como cualquier mensaje; el
+ * broker los confirma y retransmite uno por uno. al_completar se llama una
+ * sola vez, con el id retornado, cuando se confirmó el último.
+ *
+ * Retorna el id (> 0) asignado al mensaje, o -1 si es inválido, no cabe en
+ * un paquete (o en QUIC_MAX_FRAGMENTOS) o la cola está llena (el llamador
+ * debe reintentar luego de pub_procesar).
+ */
+long long pub_publicar(ClientePub *c, const char *tema, const char *payload, size_t len);
+
+/**
+ * pub_procesar - Avanza el trabajo de red del cliente
+ *
+ * Si espera_ms > 0 espera actividad en el socket hasta ese tiempo (útil
+ * cuando el llamador no tiene su propio select/poll). Con 0 nunca bloquea.
+ *
+ * Retorna cuántos mensajes se completaron en esta llamada.
+ */
+int pub_procesar(ClientePub *c, unsigned int espera_ms);
+
+/** pub_socket - Socket actual (cambia al reconectar), para el poll del llamador */
+SOCKET pub_socket(const ClientePub *c);
+
+/** pub_pendientes - Mensajes (o fragmentos) encolados o en vuelo todavía sin confirmar */
+int pub_pendientes(const ClientePub *c);
+
+/** pub_destruir - Cierra el socket; los pendientes se reportan como PUB_DESCARTADO */
+void pub_destruir(ClientePub *c);
+
+#endif /* CLIENTE_PUB_H */
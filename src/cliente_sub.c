@@ -0,0 +1,904 @@
+/*
+ * ============================================================================
+ * CLIENTE SUB - Implementación (ver cliente_sub.h para la API)
+ * ============================================================================
+ *
+ * Estado por tema (TemaSub):
+ *   - ultimo_seq: último seq entregado EN ORDEN para el tema (o el seq
+ *                 desde el que se reanudó con sub_suscribir_desde)
+ *   - reorden:    ventana acotada de SUB_VENTANA paquetes que llegaron antes
+ *                 de tiempo (seq > ultimo_seq + 1), indexada por seq % ventana
+ *
+ * Reordenamiento:
+ *   En loopback/LAN es común que dos datagramas lleguen invertidos. Tratar
+ *   eso como pérdida genera 'R' innecesarios y entrega fuera de orden. Por
+ *   eso un paquete adelantado se guarda en la ventana y:
+ *     - cuando llega el que faltaba se entrega y se liberan de una vez todos
+ *       los guardados contiguos;
+ *     - solo si el hueco sigue abierto después de reorden_ms se piden los
+ *       faltantes con 'R' (y se reintenta cada rto_ms);
+ *     - un hueco grande se pide con una reanudación ('S' con "tema:seq") y
+ *       el broker reenvía el rango en lotes; un seq fuera de la ventana
+ *       también dispara una reanudación;
+ *     - si se agotan los reintentos, los faltantes se dan por perdidos y se
+ *       entrega lo guardado en orden.
+ *
+ * Alias de tema:
+ *   Confirmada la suscripción se pide el alias del tema con 'T'. Desde que
+ *   el broker responde, las publicaciones llegan como "#id:contenido" y el
+ *   tema se busca por id; el callback recibe siempre el nombre completo.
+ *
+ * ACKs acumulados y diferidos:
+ *   Ya no sale un ACK por mensaje. Cada tema anota cuántos recibió sin
+ *   confirmar y los confirma juntos con una línea "token:limite:acumulado"
+ *   (acumulado = último seq entregado en orden) después de cfg.ack_cada
+ *   mensajes o cfg.ack_ms desde el primero, lo que pase antes. Cuando sale
+ *   el ACK de un tema se agregan en el mismo paquete 'A' las líneas
+ *   pendientes de los otros temas del mismo broker, y el latido 'H' lleva
+ *   las que haya. Si el crédito anunciado se está por agotar el ACK sale ya.
+ *   Un hueco chico se pide con UN ACK que agrega el mapa de huecos
+ *   (":mapa" en hexadecimal, bit k = llegó acumulado + 2 + k) en lugar de
+ *   un 'R' por seq: el broker retransmite los que faltan.
+ *
+ * Control de flujo:
+ *   Cada línea de ACK lleva el limite (token = alias si el paquete llegó con
+ *   alias): el broker puede enviar hasta el seq limite = último entregado en orden +
+ *   cfg.credito (desde el primer mensaje, que fija la línea base). Si hay un
+ *   hueco sin cerrar el límite no avanza y el broker pausa el tema en lugar
+ *   de seguir llenando el socket. Al confirmarse la suscripción se envía un
+ *   ACK con seq 0 que solo otorga crédito. Si el tema pasa rto_ms sin recibir
+ *   nada se reanuda desde ultimo_seq (una vez por silencio y por latido):
+ *   recupera un ACK de crédito perdido y el final perdido de una ráfaga.
+ *   Mientras el tema está en pausa lo pendiente vive solo en el historial del
+ *   broker (MAX_HISTORIAL mensajes entre todos los temas): si se sobrescribe
+ *   antes de que llegue crédito, el broker salta lo perdido. Por eso el
+ *   crédito conviene bastante menor al historial, y es 0 por defecto.
+ *
+ * Mensajes fragmentados:
+ *   Un contenido que empieza con FRAGMENTO_PREFIJO es un fragmento (ver
+ *   protocolo_quic.h). Llega por el mismo camino que cualquier publicación
+ *   (orden, huecos y ACK por seq) y al entregarlo, en lugar de llamar al
+ *   callback, se copia desescapado en el lugar k de un Rearmado del tema y
+ *   el id. Con el último se compacta y se entrega el mensaje entero, con el
+ *   seq de ese último fragmento. La memoria está acotada: hasta
+ *   SUB_MAX_REARMADOS mensajes a medias y cfg.max_rearmado bytes entre
+ *   todos (un fragmento ocupa QUIC_MAX_MENSAJE). Si no hay lugar se
+ *   descarta el más viejo, y uno que pasa SUB_REARMADO_MS sin fragmentos
+ *   nuevos (uno se perdió para siempre) se libera.
+ *   Con QoS 1 el publisher reenvía un lote entero si se perdió el ACK, y el
+ *   broker lo publica otra vez con seq nuevos: llegan fragmentos sueltos de
+ *   un mensaje ya entregado. Los últimos SUB_RECORDADOS mensajes rearmados
+ *   se recuerdan para descartarlos (si no, ocuparían un Rearmado hasta
+ *   vencer y harían descartar mensajes a medias de verdad).
+ *
+ * Recepción sin copias:
+ *   El broker envía "tema:contenido" en Paquete.mensaje (o varias líneas
+ *   "seq contenido" tras el tema en los paquetes de estado retenido 'V'). En lugar de copiar
+ *   tema y contenido a buffers propios, se reemplaza el ':' por '\0' dentro
+ *   del mismo buffer de recepción y se pasan los dos punteros al callback.
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cliente_sub.h"
+#include "protocolo_quic.h"
+
+#define SUB_MAX_TEMAS   64     // Suscripciones por socket
+#define SUB_MAX_NACKS   5      // Reintentos de 'R' antes de dar un seq por perdido
+#define SUB_VENTANA     64     // Paquetes adelantados que se guardan por tema
+#define SUB_MAX_R_SUELTOS 8    // Huecos más grandes se piden con una reanudación
+#define SUB_MAPA_ACK    32     // Seq cubiertos por el mapa de huecos de un ACK
+#define SUB_MAX_REARMADOS 16   // Mensajes fragmentados a medias por socket
+#define SUB_RECORDADOS  64     // Mensajes ya rearmados que se recuerdan (repetidos)
+#define SUB_REARMADO_MS 10000  // Sin fragmentos nuevos en este plazo, se descarta
+#define SIN_FRAGMENTO   0xFFFF // Largo de un fragmento que todavía no llegó
+
+// Paquete recibido antes de tiempo (copia: el buffer de recepción se reutiliza)
+typedef struct {
+    unsigned int seq;                // 0 = libre
+    int len;
+    char datos[QUIC_MAX_MENSAJE];
+} Adelantado;
+
+typedef struct {
+    char tema[QUIC_MAX_TEMA];
+    int confirmado;                  // Llegó el ACK de la suscripción
+    int reanudar;                    // El 'S' lleva "tema:ultimo_seq"
+    int baja;                        // 0 = activo, 1 = 'U' sin confirmar, 2 = dado de baja
+    unsigned long long enviado_ms;   // Último envío de 'S'
+    unsigned int ultimo_seq;
+    struct sockaddr_in origen;       // Quién envía el tema (destino de los 'R')
+
+    Adelantado *reorden;             // SUB_VENTANA slots, se reserva al primer hueco
+    int guardados;                   // Slots ocupados
+    unsigned int max_guardado;       // Mayor seq guardado
+    unsigned long long hueco_ms;     // Cuándo se abrió el hueco actual
+    unsigned long long nack_ms;      // Último envío de 'R' (0 = aún no se pidió)
+    int intentos_nack;
+    unsigned long long reanudar_ms;  // Reanudación pedida por un salto fuera de la ventana (0 = no)
+    int intentos_reanudar;
+    unsigned int alias;              // Id negociado con 'T' (0 = aún no)
+    unsigned long long alias_ms;     // Último 'T' enviado (0 = ninguno)
+    int intentos_alias;
+    unsigned long long rx_ms;        // Último paquete del tema (o último crédito otorgado)
+    int credito_renovado;            // Ya se repitió el crédito en esta pausa
+    int sin_ack;                     // Paquetes recibidos desde el último ACK
+    unsigned long long ack_ms;       // Cuándo llegó el primero de ellos
+    int ack_alias;                   // El último llegó con "#id": el ACK usa el alias
+    int ack_mapa;                    // El próximo ACK lleva el mapa de huecos (los pide)
+    unsigned int limite_enviado;     // Último límite de crédito anunciado
+} TemaSub;
+
+// Mensaje fragmentado a medias: el fragmento k va en datos + k * QUIC_MAX_MENSAJE
+typedef struct {
+    int tema;                        // Índice en temas (-1 = libre)
+    unsigned int id;                 // <id> elegido por el publisher
+    int total;
+    int recibidos;
+    unsigned long long rx_ms;        // Último fragmento recibido
+    unsigned short *largos;          // total largos (SIN_FRAGMENTO = falta)
+    char *datos;
+} Rearmado;
+
+// Mensaje fragmentado ya entregado (para descartar sus fragmentos repetidos)
+typedef struct {
+    int tema;                        // -1 = libre
+    unsigned int id;
+} Recordado;
+
+struct ClienteSub {
+    ConfigSub cfg;
+    struct sockaddr_in broker;
+    SOCKET sock;
+    TemaSub temas[SUB_MAX_TEMAS];
+    int num_temas;
+    unsigned long long latido_ms;    // Último 'H' enviado
+    Rearmado rearmados[SUB_MAX_REARMADOS];
+    size_t bytes_rearmado;           // Reservado entre todos los rearmados
+    Recordado recordados[SUB_RECORDADOS];   // Circular: los últimos rearmados
+    int siguiente_recordado;
+};
+
+// ============================================================================
+// FUNCIONES AUXILIARES
+// ============================================================================
+
+static void enviar(ClienteSub *c, char tipo, unsigned int seq, const char *texto,
+                   const struct sockaddr_in *destino) {
+    Paquete pkt;
+    pkt.seq = seq;
+    pkt.tipo = tipo;
+    strncpy(pkt.mensaje, texto, QUIC_MAX_MENSAJE - 1);
+    pkt.mensaje[QUIC_MAX_MENSAJE - 1] = '\0';
+    sendto(c->sock, (char*)&pkt, paquete_tam(&pkt), 0,
+           (const struct sockaddr*)destino, sizeof(*destino));
+}
+
+static int buscar_tema(const ClienteSub *c, const char *tema) {
+    if (tema[0] == ALIAS_PREFIJO) {
+        // "#id": se compara un entero en lugar del nombre del tema
+        unsigned long id = strtoul(tema + 1, NULL, 10);
+        for (int i = 0; i < c->num_temas; i++) {
+            if (c->temas[i].alias != 0 && c->temas[i].alias == id) return i;
+        }
+        return -1;
+    }
+    for (int i = 0; i < c->num_temas; i++) {
+        if (strcmp(c->temas[i].tema, tema) == 0) return i;
+    }
+    return -1;
+}
+
+static int misma_direccion(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/**
+ * linea_ack - Escribe "token:limite:acumulado[:mapa]" del tema
+ *
+ * token es el tema o "#id", el mismo que usó el último paquete (el broker
+ * que envió el alias es el que sabe resolverlo). limite = 0 no otorga
+ * crédito (sin control de flujo, o sin línea base todavía). El mapa solo
+ * va cuando se piden huecos. Retorna el largo escrito.
+ */
+static int linea_ack(ClienteSub *c, TemaSub *t, char *texto, size_t tam) {
+    char token[QUIC_MAX_TEMA];
+    unsigned int limite = c->cfg.credito > 0 && t->ultimo_seq > 0 ? t->ultimo_seq + c->cfg.credito : 0;
+    if (t->ack_alias && t->alias != 0) snprintf(token, sizeof(token), "%c%u", ALIAS_PREFIJO, t->alias);
+    else strcpy(token, t->tema);
+    if (limite > t->limite_enviado) t->limite_enviado = limite;
+    if (!t->ack_mapa || t->guardados == 0) return snprintf(texto, tam, "%s:%u:%u", token, limite, t->ultimo_seq);
+
+    unsigned int mapa = 0;
+    for (unsigned int k = 0; k < SUB_MAPA_ACK; k++) {
+        unsigned int s = t->ultimo_seq + 2 + k;
+        if (t->reorden[s % SUB_VENTANA].seq == s) mapa |= 1u << k;
+    }
+    return snprintf(texto, tam, "%s:%u:%u:%x", token, limite, t->ultimo_seq, mapa);
+}
+
+/**
+ * juntar_acks - Líneas de ACK de todos los temas pendientes de destino
+ *
+ * Escribe en texto tantas líneas como quepan y las da por enviadas; los
+ * temas que no entraron quedan para el próximo paquete. Retorna el largo.
+ */
+static int juntar_acks(ClienteSub *c, const struct sockaddr_in *destino, char *texto, size_t tam) {
+    int largo = 0;
+    for (int i = 0; i < c->num_temas; i++) {
+        TemaSub *t = &c->temas[i];
+        char linea[QUIC_MAX_MENSAJE];
+        if ((t->sin_ack == 0 && !t->ack_mapa) || t->baja || !misma_direccion(&t->origen, destino)) continue;
+        int n = linea_ack(c, t, linea, sizeof(linea));
+        if (largo + n + 2 > (int)tam) continue;
+        if (largo > 0) texto[largo++] = '\n';
+        memcpy(texto + largo, linea, (size_t)n + 1);
+        largo += n;
+        t->sin_ack = 0;
+        t->ack_mapa = 0;
+    }
+    return largo;
+}
+
+/** enviar_acks - Uno o más 'A' con todo lo pendiente para destino */
+static void enviar_acks(ClienteSub *c, const struct sockaddr_in *destino) {
+    char texto[QUIC_MAX_MENSAJE];
+    while (juntar_acks(c, destino, texto, sizeof(texto)) > 0) {
+        enviar(c, PKT_ACK, 0, texto, destino);
+    }
+}
+
+/**
+ * anotar_ack - Cuenta un paquete del tema y envía el ACK si corresponde
+ *
+ * Sale ya si se juntaron cfg.ack_cada paquetes o si al broker le queda
+ * menos de la mitad del crédito anunciado (así no pausa el tema mientras
+ * el ACK espera). Si no, lo envía revisar_timers() a los cfg.ack_ms.
+ */
+static void anotar_ack(ClienteSub *c, TemaSub *t, int con_alias) {
+    if (t->sin_ack++ == 0) t->ack_ms = reloj_ms();
+    t->ack_alias = con_alias;
+    int credito_corto = c->cfg.credito > 0 && t->ultimo_seq > 0 &&
+                        t->limite_enviado < t->ultimo_seq + c->cfg.credito / 2 + 1;
+    if (t->sin_ack >= (int)c->cfg.ack_cada || credito_corto) enviar_acks(c, &t->origen);
+}
+
+/** pedir_alias - Envía el 'T' del tema (seq = índice + 1, como el 'S') */
+static void pedir_alias(ClienteSub *c, int idx, unsigned long long ahora) {
+    TemaSub *t = &c->temas[idx];
+    enviar(c, PKT_ALIAS, (unsigned int)idx + 1, t->tema, &c->broker);
+    t->alias_ms = ahora;
+    t->intentos_alias++;
+}
+
+/**
+ * enviar_suscripcion - Envía el 'S' del tema
+ *
+ * seq = índice + 1: el ACK del broker hace eco y así se sabe qué tema
+ * confirmó. Con reanudar el mensaje es "tema:ultimo_seq" y el broker
+ * reenvía todo lo posterior desde su historial antes de pasar a vivo.
+ */
+static void enviar_suscripcion(ClienteSub *c, int idx, int reanudar, const struct sockaddr_in *destino) {
+    TemaSub *t = &c->temas[idx];
+    char texto[QUIC_MAX_MENSAJE];
+    if (reanudar) {
+        sprintf(texto, "%s:%u", t->tema, t->ultimo_seq);
+    } else {
+        strcpy(texto, t->tema);
+    }
+    enviar(c, PKT_SUSCRIPCION, (unsigned int)idx + 1, texto, destino);
+}
+
+/**
+ * pedir_faltantes - Pide los seq del hueco que no están guardados
+ *
+ * Un hueco chico se pide con un 'R' por seq. Uno grande (ej: después de un
+ * corte de red) se pide con UNA reanudación: el broker reenvía el rango en
+ * lotes en lugar de recibir decenas de 'R' de cada subscriber a la vez.
+ */
+static void pedir_faltantes(ClienteSub *c, TemaSub *t, unsigned long long ahora) {
+    int faltantes = 0;
+    for (unsigned int s = t->ultimo_seq + 1; s < t->max_guardado; s++) {
+        if (t->reorden[s % SUB_VENTANA].seq == s) continue;
+        if (t->nack_ms == 0 && c->cfg.al_perdida) c->cfg.al_perdida(c->cfg.ctx, t->tema, s);
+        faltantes++;
+    }
+    if (faltantes > SUB_MAX_R_SUELTOS) {
+        enviar_suscripcion(c, (int)(t - c->temas), 1, &t->origen);
+    } else if (t->max_guardado - t->ultimo_seq - 2 < SUB_MAPA_ACK) {
+        t->ack_mapa = 1;             // Un ACK con el mapa pide todos los huecos
+        enviar_acks(c, &t->origen);
+    } else {
+        for (unsigned int s = t->ultimo_seq + 1; s < t->max_guardado; s++) {
+            if (t->reorden[s % SUB_VENTANA].seq != s) enviar(c, PKT_RETRANSMISION, s, t->tema, &t->origen);
+        }
+    }
+    t->nack_ms = ahora;
+}
+
+/** liberar_rearmado - Devuelve la memoria de un rearmado y deja su lugar libre */
+static void liberar_rearmado(ClienteSub *c, Rearmado *r) {
+    c->bytes_rearmado -= (size_t)r->total * QUIC_MAX_MENSAJE;
+    free(r->largos);
+    memset(r, 0, sizeof(*r));
+    r->tema = -1;
+}
+
+/**
+ * buscar_rearmado - Rearmado del mensaje (tema, id), o uno nuevo
+ *
+ * Para hacer lugar descarta los más viejos. Retorna NULL si el mensaje
+ * solo no entra en cfg.max_rearmado o no hay memoria.
+ */
+static Rearmado *buscar_rearmado(ClienteSub *c, int tema, unsigned int id, int total) {
+    size_t tam = (size_t)total * QUIC_MAX_MENSAJE;
+    for (int i = 0; i < SUB_MAX_REARMADOS; i++) {
+        Rearmado *r = &c->rearmados[i];
+        if (r->tema == tema && r->id == id && r->total == total) return r;
+    }
+    if (tam > c->cfg.max_rearmado) return NULL;
+
+    Rearmado *libre = NULL;
+    while (libre == NULL || c->bytes_rearmado + tam > c->cfg.max_rearmado) {
+        Rearmado *viejo = NULL;
+        libre = NULL;
+        for (int i = 0; i < SUB_MAX_REARMADOS; i++) {
+            Rearmado *r = &c->rearmados[i];
+            if (r->tema < 0 && libre == NULL) libre = r;
+            if (r->tema >= 0 && (viejo == NULL || r->rx_ms < viejo->rx_ms)) viejo = r;
+        }
+        if (libre != NULL && c->bytes_rearmado + tam <= c->cfg.max_rearmado) break;
+        if (viejo == NULL) return NULL;
+        liberar_rearmado(c, viejo);
+    }
+
+    libre->largos = malloc(sizeof(unsigned short) * (size_t)total + tam + 1);
+    if (libre->largos == NULL) return NULL;
+    libre->datos = (char *)(libre->largos + total);
+    for (int k = 0; k < total; k++) libre->largos[k] = SIN_FRAGMENTO;
+    libre->tema = tema;
+    libre->id = id;
+    libre->total = total;
+    libre->recibidos = 0;
+    c->bytes_rearmado += tam;
+    return libre;
+}
+
+/** ya_rearmado - ¿El mensaje (tema, id) se entregó hace poco? */
+static int ya_rearmado(const ClienteSub *c, int tema, unsigned int id) {
+    for (int i = 0; i < SUB_RECORDADOS; i++) {
+        if (c->recordados[i].tema == tema && c->recordados[i].id == id) return 1;
+    }
+    return 0;
+}
+
+/**
+ * rearmar - Guarda un fragmento "\x1e<id>.<k>/<n>:<trozo>" y, si era el que
+ * faltaba, entrega el mensaje entero
+ */
+static void rearmar(ClienteSub *c, TemaSub *t, unsigned int seq, const char *datos) {
+    char *fin;
+    unsigned long id = strtoul(datos + 1, &fin, 16);
+    if (*fin != '.') return;
+    unsigned long k = strtoul(fin + 1, &fin, 10);
+    if (*fin != '/') return;
+    unsigned long total = strtoul(fin + 1, &fin, 10);
+    if (*fin != ':' || total == 0 || total > QUIC_MAX_FRAGMENTOS || k >= total) return;
+
+    int tema = (int)(t - c->temas);
+    if (ya_rearmado(c, tema, (unsigned int)id)) return;       // Lote reenviado
+    Rearmado *r = buscar_rearmado(c, tema, (unsigned int)id, (int)total);
+    if (r == NULL || r->largos[k] != SIN_FRAGMENTO) return;   // Sin lugar, o repetido
+    r->largos[k] = (unsigned short)fragmento_desescapar(fin + 1, r->datos + k * QUIC_MAX_MENSAJE);
+    r->rx_ms = reloj_ms();
+    if (++r->recibidos < r->total) return;
+
+    // Completo: juntar los trozos al principio (cada uno va hacia atrás)
+    size_t len = 0;
+    for (int j = 0; j < r->total; j++) {
+        memmove(r->datos + len, r->datos + (size_t)j * QUIC_MAX_MENSAJE, r->largos[j]);
+        len += r->largos[j];
+    }
+    r->datos[len] = '\0';
+    c->cfg.al_recibir(c->cfg.ctx, t->tema, seq, r->datos, len);
+    Recordado *hecho = &c->recordados[c->siguiente_recordado];
+    c->siguiente_recordado = (c->siguiente_recordado + 1) % SUB_RECORDADOS;
+    hecho->tema = tema;
+    hecho->id = r->id;
+    liberar_rearmado(c, r);
+}
+
+/** al_usuario - Pasa un mensaje al callback (los fragmentos, ya rearmados) */
+static void al_usuario(ClienteSub *c, TemaSub *t, unsigned int seq, const char *datos, size_t len) {
+    if (datos[0] == FRAGMENTO_PREFIJO) rearmar(c, t, seq, datos);
+    else c->cfg.al_recibir(c->cfg.ctx, t->tema, seq, datos, len);
+}
+
+/** entregar - Llama al callback del usuario */
+static void entregar(ClienteSub *c, TemaSub *t, unsigned int seq, const char *datos, size_t len) {
+    t->ultimo_seq = seq;
+    al_usuario(c, t, seq, datos, len);
+}
+
+/**
+ * liberar_contiguos - Entrega los guardados que siguen a ultimo_seq
+ *
+ * Retorna cuántos entregó. Si el hueco se cerró por completo reinicia los
+ * timers de reordenamiento.
+ */
+static int liberar_contiguos(ClienteSub *c, TemaSub *t) {
+    int n = 0;
+    while (t->guardados > 0) {
+        Adelantado *a = &t->reorden[(t->ultimo_seq + 1) % SUB_VENTANA];
+        if (a->seq != t->ultimo_seq + 1) break;
+        a->seq = 0;
+        t->guardados--;
+        entregar(c, t, t->ultimo_seq + 1, a->datos, (size_t)a->len);
+        n++;
+    }
+    // Hueco nuevo (o ninguno): los timers arrancan de cero
+    t->hueco_ms = reloj_ms();
+    t->nack_ms = 0;
+    t->intentos_nack = 0;
+    return n;
+}
+
+/**
+ * saltar_hueco - Da por perdidos los faltantes hasta el próximo guardado
+ *
+ * Se usa cuando el broker ya no puede retransmitir (reintentos agotados) o
+ * cuando llega un seq tan adelantado que no cabe en la ventana.
+ */
+static int saltar_hueco(ClienteSub *c, TemaSub *t) {
+    unsigned int s = t->ultimo_seq + 1;
+    while (s <= t->max_guardado && t->reorden[s % SUB_VENTANA].seq != s) s++;
+    t->ultimo_seq = s - 1;
+    return liberar_contiguos(c, t);
+}
+
+/**
+ * avanzar_base - El broker indicó que lo anterior a base + 1 ya no existe
+ *
+ * Descarta los guardados que quedaron atrás y entrega los que ahora son
+ * contiguos.
+ */
+static int avanzar_base(ClienteSub *c, TemaSub *t, unsigned int base) {
+    t->ultimo_seq = base;
+    if (t->guardados == 0) return 0;
+    for (int k = 0; k < SUB_VENTANA; k++) {
+        if (t->reorden[k].seq != 0 && t->reorden[k].seq <= base) {
+            t->reorden[k].seq = 0;
+            t->guardados--;
+        }
+    }
+    return liberar_contiguos(c, t);
+}
+
+/**
+ * recibir_seq - Decide qué hacer con una publicación según su seq
+ *
+ * Retorna la cantidad de mensajes entregados (el recibido más los que
+ * estaban guardados detrás de él).
+ */
+static int recibir_seq(ClienteSub *c, TemaSub *t, unsigned int seq, char *datos) {
+    size_t len = strlen(datos);
+
+    // Primer mensaje del tema: define la línea base
+    if (t->ultimo_seq == 0) {
+        entregar(c, t, seq, datos, len);
+        return 1;
+    }
+    if (seq <= t->ultimo_seq) return 0;               // Duplicado
+
+    if (seq == t->ultimo_seq + 1) {
+        // En orden: se entrega directo desde el buffer de recepción
+        entregar(c, t, seq, datos, len);
+        return 1 + (t->guardados > 0 ? liberar_contiguos(c, t) : 0);
+    }
+
+    int n = 0;
+    if (seq - t->ultimo_seq > SUB_VENTANA) {
+        // No cabe en la ventana (ej: un corte de red largo). Se pide UNA
+        // reanudación desde ultimo_seq: el broker reenvía el rango en lotes
+        // y este paquete vuelve a llegar dentro de la reproducción.
+        if (t->intentos_reanudar < SUB_MAX_NACKS) {
+            if (t->reanudar_ms == 0) {
+                enviar_suscripcion(c, (int)(t - c->temas), 1, &t->origen);
+                t->reanudar_ms = reloj_ms();
+            }
+            return 0;
+        }
+        // El broker no respondió: lo guardado sale en orden y se salta al nuevo
+        t->intentos_reanudar = 0;
+        if (t->guardados > 0) {
+            unsigned int desde = t->ultimo_seq + 1;
+            t->ultimo_seq = t->max_guardado;          // Los huecos intermedios se pierden
+            for (unsigned int s = desde; s <= t->max_guardado; s++) {
+                Adelantado *a = &t->reorden[s % SUB_VENTANA];
+                if (a->seq != s) continue;
+                a->seq = 0;
+                t->guardados--;
+                al_usuario(c, t, s, a->datos, (size_t)a->len);
+                n++;
+            }
+        }
+        entregar(c, t, seq, datos, len);
+        t->guardados = 0;
+        t->nack_ms = 0;
+        t->intentos_nack = 0;
+        return n + 1;
+    }
+
+    // Adelantado dentro de la ventana: guardar copia y esperar el hueco
+    if (t->reorden == NULL) {
+        t->reorden = calloc(SUB_VENTANA, sizeof(Adelantado));
+        if (t->reorden == NULL) {
+            entregar(c, t, seq, datos, len);          // Sin memoria: entregar como antes
+            return 1;
+        }
+    }
+    Adelantado *a = &t->reorden[seq % SUB_VENTANA];
+    if (a->seq == seq) return 0;                      // Ya estaba guardado
+    if (t->guardados == 0) {
+        t->hueco_ms = reloj_ms();
+        t->nack_ms = 0;
+        t->intentos_nack = 0;
+        t->max_guardado = seq;
+    }
+    a->seq = seq;
+    a->len = (int)len;
+    memcpy(a->datos, datos, len + 1);
+    t->guardados++;
+    if (seq > t->max_guardado) t->max_guardado = seq;
+    return 0;
+}
+
+/**
+ * recibir_retenidos - Entrega el estado retenido que llega con la suscripción
+ *
+ * Cada línea es "seq contenido". Solo se entregan las más nuevas que lo ya
+ * recibido en vivo, y la línea base queda en el último seq retenido: la
+ * primera publicación en vivo llega en orden y no se piden con 'R' los seq
+ * que el broker compactó.
+ */
+static int recibir_retenidos(ClienteSub *c, TemaSub *t, char *lineas) {
+    int n = 0;
+    while (lineas != NULL && *lineas != '\0') {
+        char *fin = strchr(lineas, '\n');
+        if (fin != NULL) *fin = '\0';
+        char *datos;
+        unsigned long seq = strtoul(lineas, &datos, 10);
+        if (*datos == ' ') datos++;
+        if (seq > t->ultimo_seq && t->guardados == 0) {
+            entregar(c, t, (unsigned int)seq, datos, strlen(datos));
+            n++;
+        }
+        lineas = fin != NULL ? fin + 1 : NULL;
+    }
+    return n;
+}
+
+/** procesar_paquete - Maneja un datagrama ya terminado en '\0' */
+static int procesar_paquete(ClienteSub *c, Paquete *pkt, const struct sockaddr_in *origen) {
+    if (pkt->tipo == PKT_ACK) {
+        // Confirmación de suscripción: el broker hace eco del seq (índice + 1)
+        if (pkt->seq >= 1 && pkt->seq <= (unsigned int)c->num_temas) {
+            TemaSub *t = &c->temas[pkt->seq - 1];
+            if (t->baja) {
+                t->baja = 2;                   // Confirmación de la baja
+                return 0;
+            }
+            t->confirmado = 1;
+            t->reanudar_ms = 0;
+            t->intentos_reanudar = 0;
+            t->origen = *origen;               // En el cluster confirma el dueño del tema
+            if (t->alias == 0 && t->alias_ms == 0) pedir_alias(c, (int)(pkt->seq - 1), reloj_ms());
+            // Reanudación: "OK:<primer seq>"; lo anterior ya no está en el historial
+            unsigned long primero = strncmp(pkt->mensaje, "OK:", 3) == 0 ? strtoul(pkt->mensaje + 3, NULL, 10) : 0;
+            int n = primero > (unsigned long)t->ultimo_seq + 1 ? avanzar_base(c, t, (unsigned int)primero - 1) : 0;
+            if (c->cfg.credito > 0 && t->ultimo_seq > 0) {
+                t->limite_enviado = 0;         // Crédito inicial: sale ya
+                anotar_ack(c, t, 0);
+            }
+            t->rx_ms = reloj_ms();
+            t->credito_renovado = 0;
+            return n;
+        }
+        return 0;
+    }
+    if (pkt->tipo == PKT_ALIAS) {
+        // "id:tema" con eco del seq; id = 0: el broker no asigna alias
+        if (pkt->seq >= 1 && pkt->seq <= (unsigned int)c->num_temas) {
+            TemaSub *t = &c->temas[pkt->seq - 1];
+            char *fin;
+            unsigned long id = strtoul(pkt->mensaje, &fin, 10);
+            if (*fin == ':' && strcmp(fin + 1, t->tema) == 0) {
+                t->alias = (unsigned int)id;
+                t->intentos_alias = SUB_MAX_NACKS;   // No volver a pedirlo
+            }
+        }
+        return 0;
+    }
+    if (pkt->tipo != PKT_PUBLICACION && pkt->tipo != PKT_RETENIDO && pkt->tipo != PKT_DATAGRAMA) return 0;
+
+    char *sep = strchr(pkt->mensaje, ':');
+    if (sep == NULL) return 0;
+    *sep = '\0';                               // Corta "tema:contenido" en el lugar
+    int idx = buscar_tema(c, pkt->mensaje);
+    if (idx < 0 || c->temas[idx].baja) return 0;   // No suscritos: ignorar
+
+    TemaSub *t = &c->temas[idx];
+    t->origen = *origen;
+    t->rx_ms = reloj_ms();
+    t->credito_renovado = 0;
+    if (pkt->tipo == PKT_RETENIDO) return recibir_retenidos(c, t, sep + 1);   // No lleva ACK
+    if (pkt->tipo == PKT_DATAGRAMA) {
+        // QoS 0: se entrega tal cual, sin ACK, orden ni huecos
+        al_usuario(c, t, 0, sep + 1, strlen(sep + 1));
+        return 1;
+    }
+
+    // Se anota también un duplicado (el ACK acumulado lo cubre), después de
+    // entregar: así el crédito que lleve ya cuenta este mensaje
+    int n = recibir_seq(c, t, pkt->seq, sep + 1);
+    anotar_ack(c, t, pkt->mensaje[0] == ALIAS_PREFIJO);
+    return n;
+}
+
+/** revisar_timers - Reenvía 'S' sin confirmar y pide huecos que no se cerraron */
+static int revisar_timers(ClienteSub *c, unsigned long long ahora) {
+    int entregados = 0;
+    int activos = 0;
+    for (int i = 0; i < c->num_temas; i++) {
+        TemaSub *t = &c->temas[i];
+        if (t->baja) {
+            // Reenviar la baja hasta que el broker la confirme (o se agoten)
+            if (t->baja == 1 && ahora - t->enviado_ms >= c->cfg.rto_ms) {
+                if (++t->intentos_nack > SUB_MAX_NACKS) {
+                    t->baja = 2;               // La expiración del broker la completa
+                } else {
+                    enviar(c, PKT_BAJA, (unsigned int)i + 1, t->tema, &c->broker);
+                    t->enviado_ms = ahora;
+                }
+            }
+            continue;
+        }
+        activos++;
+        if (t->sin_ack > 0 && ahora - t->ack_ms >= c->cfg.ack_ms) {
+            enviar_acks(c, &t->origen);   // Lleva también los de otros temas
+        }
+        if (!t->confirmado && ahora - t->enviado_ms >= c->cfg.rto_ms) {
+            enviar_suscripcion(c, i, t->reanudar, &c->broker);
+            t->enviado_ms = ahora;
+        }
+        if (t->confirmado && c->cfg.credito > 0 && t->ultimo_seq > 0 && !t->credito_renovado &&
+            ahora - t->rx_ms >= c->cfg.rto_ms) {
+            // Silencio con crédito abierto: el broker puede estar en pausa por
+            // un ACK perdido, o el kernel descartó el final de una ráfaga y no
+            // hay hueco visible. Una reanudación desde ultimo_seq cubre los dos
+            // casos: se reenvía lo que falte y su confirmación renueva el crédito
+            enviar_suscripcion(c, i, 1, &t->origen);
+            t->credito_renovado = 1;
+        }
+        if (t->confirmado && t->alias_ms != 0 && t->intentos_alias < SUB_MAX_NACKS &&
+            ahora - t->alias_ms >= c->cfg.rto_ms) {
+            pedir_alias(c, i, ahora);   // Sin respuesta al 'T': sin alias se recibe igual
+        }
+        if (t->reanudar_ms != 0 && ahora - t->reanudar_ms >= c->cfg.rto_ms) {
+            // Sin respuesta: reintentar, o dejar que el próximo salto se acepte
+            if (++t->intentos_reanudar < SUB_MAX_NACKS) {
+                enviar_suscripcion(c, i, 1, &t->origen);
+                t->reanudar_ms = ahora;
+            } else {
+                t->reanudar_ms = 0;
+            }
+        }
+        if (t->guardados == 0) continue;
+
+        if (t->nack_ms == 0) {
+            // Todavía en período de gracia: puede ser solo reordenamiento
+            if (ahora - t->hueco_ms >= c->cfg.reorden_ms) pedir_faltantes(c, t, ahora);
+        } else if (ahora - t->nack_ms >= c->cfg.rto_ms) {
+            if (++t->intentos_nack > SUB_MAX_NACKS) {
+                entregados += saltar_hueco(c, t);   // Ya no están en el historial
+            } else {
+                pedir_faltantes(c, t, ahora);
+            }
+        }
+    }
+
+    // Mensajes a medias que ya no van a completarse (un fragmento se perdió)
+    for (int i = 0; i < SUB_MAX_REARMADOS; i++) {
+        Rearmado *r = &c->rearmados[i];
+        if (r->tema >= 0 && ahora - r->rx_ms >= SUB_REARMADO_MS) liberar_rearmado(c, r);
+    }
+
+    // Latido: mientras haya suscripciones, el broker no las expira. Lleva
+    // los ACK pendientes para el broker (uno menos que enviar aparte)
+    if (activos > 0 && ahora - c->latido_ms >= c->cfg.latido_ms) {
+        char acks[QUIC_MAX_MENSAJE];
+        acks[0] = '\0';
+        juntar_acks(c, &c->broker, acks, sizeof(acks));
+        enviar(c, PKT_LATIDO, 0, acks, &c->broker);
+        c->latido_ms = ahora;
+        for (int i = 0; i < c->num_temas; i++) c->temas[i].credito_renovado = 0;
+    }
+    return entregados;
+}
+
+/** proxima_espera - Acota la espera de select() al timer de reorden más cercano */
+static unsigned int proxima_espera(const ClienteSub *c, unsigned int espera_ms) {
+    if (c->cfg.latido_ms < espera_ms) espera_ms = c->cfg.latido_ms;
+    for (int i = 0; i < c->num_temas; i++) {
+        if (c->temas[i].baja == 1 && c->cfg.rto_ms < espera_ms) espera_ms = c->cfg.rto_ms;
+        if (c->temas[i].baja) continue;
+        if (c->temas[i].guardados > 0 && c->cfg.reorden_ms < espera_ms) espera_ms = c->cfg.reorden_ms;
+        if (c->temas[i].sin_ack > 0 && c->cfg.ack_ms < espera_ms) espera_ms = c->cfg.ack_ms;
+        int alias_pendiente = c->temas[i].alias_ms != 0 && c->temas[i].intentos_alias < SUB_MAX_NACKS;
+        if ((!c->temas[i].confirmado || c->temas[i].reanudar_ms != 0 || alias_pendiente) &&
+            c->cfg.rto_ms < espera_ms) {
+            espera_ms = c->cfg.rto_ms;
+        }
+    }
+    return espera_ms;
+}
+
+// ============================================================================
+// API PÚBLICA
+// ============================================================================
+
+void sub_config_defecto(ConfigSub *cfg, const char *ip) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->ip = ip;
+    cfg->puerto = QUIC_PUERTO;
+    cfg->rto_ms = 500;
+    cfg->reorden_ms = 20;
+    cfg->latido_ms = 10000;
+    cfg->ack_cada = 16;
+    cfg->ack_ms = 25;
+    cfg->credito = 0;               // Opt-in: con un crédito mayor al historial del broker una pausa pierde mensajes
+    cfg->buffer_socket = 1 << 20;   // 1 MB: absorbe ráfagas sin que el kernel descarte
+    cfg->max_rearmado = 1 << 20;
+}
+
+ClienteSub *sub_crear(const ConfigSub *cfg) {
+    if (cfg == NULL || cfg->ip == NULL || cfg->al_recibir == NULL) return NULL;
+    if (red_iniciar() != 0) return NULL;
+
+    ClienteSub *c = calloc(1, sizeof(ClienteSub));
+    if (c == NULL) return NULL;
+    c->cfg = *cfg;
+    if (c->cfg.puerto == 0) c->cfg.puerto = QUIC_PUERTO;
+    if (c->cfg.rto_ms == 0) c->cfg.rto_ms = 500;
+    if (c->cfg.reorden_ms == 0) c->cfg.reorden_ms = 20;
+    if (c->cfg.latido_ms == 0) c->cfg.latido_ms = 10000;
+    if (c->cfg.ack_cada == 0) c->cfg.ack_cada = 16;
+    if (c->cfg.ack_ms == 0) c->cfg.ack_ms = 25;
+    if (c->cfg.max_rearmado == 0) c->cfg.max_rearmado = 1 << 20;
+    for (int i = 0; i < SUB_MAX_REARMADOS; i++) c->rearmados[i].tema = -1;
+    for (int i = 0; i < SUB_RECORDADOS; i++) c->recordados[i].tema = -1;
+
+    c->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (c->sock == INVALID_SOCKET) {
+        free(c);
+        return NULL;
+    }
+    if (c->cfg.buffer_socket > 0) {
+        setsockopt(c->sock, SOL_SOCKET, SO_RCVBUF, (char*)&c->cfg.buffer_socket,
+                   sizeof(c->cfg.buffer_socket));
+    }
+    red_no_bloqueante(c->sock);
+
+    memset(&c->broker, 0, sizeof(c->broker));
+    c->broker.sin_family = AF_INET;
+    c->broker.sin_addr.s_addr = inet_addr(c->cfg.ip);
+    c->broker.sin_port = htons(c->cfg.puerto);
+    return c;
+}
+
+int sub_suscribir(ClienteSub *c, const char *tema) {
+    return sub_suscribir_desde(c, tema, 0);
+}
+
+int sub_suscribir_desde(ClienteSub *c, const char *tema, unsigned int ultimo_seq) {
+    if (c == NULL || tema == NULL || tema[0] == '\0') return -1;
+    if (strlen(tema) >= QUIC_MAX_TEMA || strpbrk(tema, ":\n") != NULL || tema[0] == ALIAS_PREFIJO) return -1;
+    int idx = buscar_tema(c, tema);
+    if (idx >= 0 && !c->temas[idx].baja) return 0;
+    if (idx < 0 && c->num_temas == SUB_MAX_TEMAS) return -1;
+
+    // Un tema dado de baja reutiliza su lugar (su índice es el eco del ACK)
+    if (idx < 0) idx = c->num_temas++;
+    for (int i = 0; i < SUB_MAX_REARMADOS; i++) {
+        if (c->rearmados[i].tema == idx) liberar_rearmado(c, &c->rearmados[i]);
+    }
+    for (int i = 0; i < SUB_RECORDADOS; i++) {
+        if (c->recordados[i].tema == idx) c->recordados[i].tema = -1;
+    }
+    TemaSub *t = &c->temas[idx];
+    free(t->reorden);
+    memset(t, 0, sizeof(*t));
+    strcpy(t->tema, tema);
+    t->origen = c->broker;
+    t->enviado_ms = reloj_ms();
+    t->ultimo_seq = ultimo_seq;      // Línea base: lo que siga llega en orden
+    t->reanudar = ultimo_seq > 0;
+
+    enviar_suscripcion(c, idx, t->reanudar, &c->broker);
+    return 0;
+}
+
+int sub_desuscribir(ClienteSub *c, const char *tema) {
+    int idx = c != NULL && tema != NULL ? buscar_tema(c, tema) : -1;
+    if (idx < 0 || c->temas[idx].baja) return -1;
+
+    TemaSub *t = &c->temas[idx];
+    t->baja = 1;
+    t->confirmado = 0;
+    t->intentos_nack = 0;
+    t->reanudar_ms = 0;
+    t->enviado_ms = reloj_ms();
+    enviar(c, PKT_BAJA, (unsigned int)idx + 1, tema, &c->broker);
+    return 0;
+}
+
+int sub_procesar(ClienteSub *c, unsigned int espera_ms) {
+    if (c == NULL) return 0;
+
+    espera_ms = proxima_espera(c, espera_ms);
+    if (espera_ms > 0) {
+        fd_set lectura;
+        struct timeval tv;
+        FD_ZERO(&lectura);
+        FD_SET(c->sock, &lectura);
+        tv.tv_sec = espera_ms / 1000;
+        tv.tv_usec = (espera_ms % 1000) * 1000;
+        select((int)c->sock + 1, &lectura, NULL, NULL, &tv);
+    }
+
+    int entregados = 0;
+    Paquete pkt;   // Buffer de recepción: los callbacks apuntan aquí
+
+    // Drenar todo lo que haya en el socket antes de volver
+    while (1) {
+        struct sockaddr_in origen;
+        socklen_t tam = sizeof(origen);
+        int bytes = recvfrom(c->sock, (char*)&pkt, sizeof(pkt), 0,
+                             (struct sockaddr*)&origen, &tam);
+        if (bytes < 0) {
+            if (red_reintentar()) break;
+            continue;   // Ej: WSAECONNRESET por un ICMP anterior
+        }
+        if (!paquete_terminar(&pkt, bytes)) continue;
+        entregados += procesar_paquete(c, &pkt, &origen);
+    }
+
+    entregados += revisar_timers(c, reloj_ms());
+    return entregados;
+}
+
+int sub_confirmados(const ClienteSub *c) {
+    int n = 0;
+    for (int i = 0; c != NULL && i < c->num_temas; i++) n += c->temas[i].confirmado && !c->temas[i].baja;
+    return n;
+}
+
+SOCKET sub_socket(const ClienteSub *c) {
+    return c ? c->sock : INVALID_SOCKET;
+}
+
+void sub_destruir(ClienteSub *c) {
+    if (c == NULL) return;
+    // Baja de lo que siga activo (sin esperar confirmación: si se pierde,
+    // la suscripción expira sola en el broker)
+    for (int i = 0; i < c->num_temas; i++) {
+        if (!c->temas[i].baja) enviar(c, PKT_BAJA, (unsigned int)i + 1, c->temas[i].tema, &c->broker);
+    }
+    closesocket(c->sock);
+    for (int i = 0; i < c->num_temas; i++) free(c->temas[i].reorden);
+    for (int i = 0; i < SUB_MAX_REARMADOS; i++) free(c->rearmados[i].largos);
+    free(c);
+    red_finalizar();
+}
@@ -0,0 +1,143 @@
+/*
+ * ============================================================================
+ * CLIENTE SUB - Librería de suscripción QUIC guiada por callbacks
+ * ============================================================================
+ *
+ * Reemplaza el bucle de subscriber_quic.c (recvfrom + strcpy + Sleep(50) por
+ * mensaje) por un receptor orientado a eventos:
+ *
+ *   - sub_procesar() drena TODOS los datagramas disponibles del socket en
+ *     cada llamada, así que una ráfaga se entrega completa sin pausas.
+ *   - El callback al_recibir(tema, seq, datos, len) recibe punteros que
+ *     apuntan directo al buffer de recepción (sin copias). Solo son válidos
+ *     durante el callback.
+ *   - Un mismo socket puede tener varias suscripciones (sub_suscribir una
+ *     vez por tema).
+ *   - Los ACK y las solicitudes de retransmisión ante un salto de secuencia
+ *     se manejan internamente, sin bloquear. Los ACK son acumulados por
+ *     tema y diferidos (uno cada ack_cada mensajes o ack_ms), y viajan
+ *     juntos en un mismo paquete o dentro del latido.
+ *   - La entrega es EN ORDEN por tema: los paquetes adelantados se guardan
+ *     en una ventana acotada hasta que llega el que falta (o se da por
+ *     perdido), y los 'R' solo salen si el hueco dura más de reorden_ms.
+ *   - Al confirmarse una suscripción el broker envía el estado retenido del
+ *     tema (últimos mensajes); llega por al_recibir como cualquier otro.
+ *   - sub_suscribir_desde() retoma después de un seq ya procesado, y un hueco
+ *     grande se pide con una sola reanudación en lugar de un 'R' por seq.
+ *   - Cada tema confirmado negocia un alias numérico ('T'): el broker deja
+ *     de enviar el nombre del tema en cada publicación.
+ *   - Control de flujo: los ACK le indican al broker hasta qué seq puede
+ *     enviar (credito mensajes más allá del último entregado); ante una
+ *     ráfaga el broker pausa el tema en lugar de desbordar el socket.
+ *     Desactivado por defecto (credito = 0).
+ *   - Los mensajes fragmentados (más grandes que un paquete) se rearman con
+ *     memoria acotada (max_rearmado) y llegan enteros a al_recibir.
+ *   - Mientras haya suscripciones se envía un latido 'H' cada latido_ms; el
+ *     broker expira a quien deja de enviarlos. sub_desuscribir() y
+ *     sub_destruir() envían la baja 'U'.
+ *
+ * Ejemplo mínimo:
+ *
+ *   ConfigSub cfg;
+ *   sub_config_defecto(&cfg, "127.0.0.1");
+ *   cfg.al_recibir = mostrar;
+ *   ClienteSub *c = sub_crear(&cfg);
+ *   sub_suscribir(c, "Colombia vs Argentina");
+ *   sub_suscribir(c, "Brasil vs Uruguay");
+ *   while (1) sub_procesar(c, 100);
+ *
+ * Compilación: agregar src/cliente_sub.c al programa que la usa
+ *   gcc mi_consumidor.c src/cliente_sub.c -o mi_consumidor.exe -lws2_32
+ * ============================================================================
+ */
+
+#ifndef CLIENTE_SUB_H
+#define CLIENTE_SUB_H
+
+#include <stddef.h>
+#include "plataforma.h"
+
+/**
+ * SubAlRecibir - Entrega de un mensaje
+ *
+ * tema y datos apuntan al buffer de recepción de la librería (terminados
+ * en '\0'); no deben guardarse después de retornar. seq = 0 en los temas
+ * QoS 0 (sin garantías: no hay secuencia). Un mensaje fragmentado llega
+ * entero, con el seq de su último fragmento, y puede contener '\n' o '\0'
+ * (usar len).
+ */
+typedef void (*SubAlRecibir)(void *ctx, const char *tema, unsigned int seq,
+                             const char *datos, size_t len);
+
+/** SubAlPerdida - Aviso opcional: se detectó un seq faltante y se pidió con 'R' */
+typedef void (*SubAlPerdida)(void *ctx, const char *tema, unsigned int seq);
+
+typedef struct {
+    const char *ip;               // IP del broker
+    unsigned short puerto;        // 0 = QUIC_PUERTO
+    unsigned int rto_ms;          // Reintento de 'S' y de 'R' sin respuesta
+    unsigned int reorden_ms;      // Gracia antes de pedir un hueco con 'R' (reordenamiento)
+    int buffer_socket;            // SO_RCVBUF en bytes (0 = no cambiar)
+    unsigned int latido_ms;       // Cada cuánto se envía 'H' para no expirar en el broker
+    unsigned int ack_cada;        // Mensajes por tema que confirma un ACK (1 = uno por mensaje)
+    unsigned int ack_ms;          // Espera máxima de un ACK diferido
+    unsigned int credito;         // Mensajes por tema en camino sin entregar (0 = sin control de flujo)
+    size_t max_rearmado;          // Bytes para rearmar mensajes fragmentados (0 = 1 MB)
+    SubAlRecibir al_recibir;
+    SubAlPerdida al_perdida;      // Opcional
+    void *ctx;                    // Se pasa tal cual a los callbacks
+} ConfigSub;
+
+typedef struct ClienteSub ClienteSub;
+
+/** sub_config_defecto - Llena cfg con valores razonables */
+void sub_config_defecto(ConfigSub *cfg, const char *ip);
+
+/** sub_crear - Crea el socket del suscriptor. NULL si falla. */
+ClienteSub *sub_crear(const ConfigSub *cfg);
+
+/**
+ * sub_suscribir - Agrega un tema y envía la suscripción 'S'
+ *
+ * La confirmación del broker se procesa en sub_procesar(); si no llega se
+ * reenvía la suscripción. Retorna 0 si OK, -1 si el tema es inválido (vacío,
+ * con ':' o '\n', o empieza con '#') o no quedan lugares.
+ */
+int sub_suscribir(ClienteSub *c, const char *tema);
+
+/**
+ * sub_suscribir_desde - Como sub_suscribir, pero reanuda después de ultimo_seq
+ *
+ * Para un consumidor que se reinicia y guardó el último seq que procesó: el
+ * broker reenvía lo publicado después (lo que siga en su historial) y luego
+ * pasa a vivo, sin duplicados ni huecos. Con ultimo_seq = 0 equivale a
+ * sub_suscribir (recibe el estado retenido y lo nuevo).
+ */
+int sub_suscribir_desde(ClienteSub *c, const char *tema, unsigned int ultimo_seq);
+
+/**
+ * sub_desuscribir - Envía la baja 'U' del tema y deja de entregarlo
+ *
+ * La baja se reintenta hasta que el broker la confirma. Retorna 0 si OK,
+ * -1 si el tema no estaba suscrito.
+ */
+int sub_desuscribir(ClienteSub *c, const char *tema);
+
+/**
+ * sub_procesar - Recibe y entrega todo lo disponible
+ *
+ * Con espera_ms > 0 espera hasta ese tiempo a que llegue algo. Retorna la
+ * cantidad de mensajes entregados al callback.
+ */
+int sub_procesar(ClienteSub *c, unsigned int espera_ms);
+
+/** sub_confirmados - Cuántas suscripciones ya fueron confirmadas por el broker */
+int sub_confirmados(const ClienteSub *c);
+
+/** sub_socket - Socket del suscriptor, para integrarlo en el poll del llamador */
+SOCKET sub_socket(const ClienteSub *c);
+
+/** sub_destruir - Envía la baja de los temas activos, cierra el socket y libera memoria */
+void sub_destruir(ClienteSub *c);
+
+#endif /* CLIENTE_SUB_H */
@@ -0,0 +1,256 @@
+/*
+ * ============================================================================
+ * FOTO - Fotos binarias del estado de un broker (reinicio en caliente)
+ * ============================================================================
+ *
+ * Al reiniciarse, un broker olvidaba a todos sus suscriptores y los
+ * contadores de secuencia: miles de clientes tenían que volver a suscribirse
+ * a la vez. Con una foto periódica el broker arranca con la tabla de
+ * suscripciones y las secuencias donde quedaron.
+ *
+ *   - Formato: cabecera fija, los temas en orden de id (FotoTema), las
+ *     suscripciones (FotoSub) y un bloque libre del broker ("extra"). Todo
+ *     de tamaño fijo y en el orden de bytes de la máquina: se mapea con
+ *     mmap y se lee sin decodificar (la foto es para reiniciar en el mismo
+ *     host, no para copiarla a otro).
+ *   - Escritura copy-on-write: en POSIX foto_abrir() hace fork() y el hijo
+ *     escribe la foto desde su copia del estado mientras el broker sigue
+ *     atendiendo; las páginas se copian solo si el broker las modifica
+ *     mientras tanto. Se escribe a "archivo.tmp" y se renombra: la foto
+ *     anterior vale hasta que la nueva está completa en disco.
+ *   - En Windows (sin fork) la foto se escribe en el momento.
+ *
+ * Uso (escribir):
+ *   FotoEscritura w;
+ *   if (foto_abrir(&w, "broker.foto", 1) == 1) {    // 1: la escribe este proceso
+ *       FotoCabecera c = foto_cabecera(0, alias_base, num_temas, num_subs, 0);
+ *       foto_escribir(&w, &c, sizeof(c)); ... temas ... suscripciones ...
+ *       foto_cerrar(&w);                              // En el hijo no retorna
+ *   }
+ * Uso (cargar):
+ *   size_t tam;
+ *   const FotoCabecera *c = foto_cargar("broker.foto", &tam);
+ *   foto_temas(c)[0..num_temas), foto_subs(c)[0..num_subs), foto_extra(c)
+ *   foto_liberar(c, tam);
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef FOTO_H
+#define FOTO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "plataforma.h"
+#include "tablas.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+#define FOTO_MAGIA      "PSFOTO1"
+#define FOTO_VERSION    1
+#define FOTO_MAX_RUTA   512
+
+typedef struct {
+    char magia[8];                   // FOTO_MAGIA
+    unsigned int version;
+    unsigned int limpia;             // 1: escrita al cerrar el broker (nada quedó afuera)
+    unsigned int alias_base;
+    unsigned int num_temas;
+    unsigned int num_subs;
+    unsigned int tam_extra;          // Bytes del bloque propio del broker, al final
+    long long creada;                // time(NULL) al escribirla (para informar su antigüedad)
+} FotoCabecera;
+
+typedef struct {
+    char nombre[TABLA_MAX_TEMA];     // Terminado en '\0'; el índice es el id del tema
+    unsigned int seq;                // Último seq asignado (0 si el broker no numera)
+} FotoTema;
+
+typedef struct {
+    unsigned int tema;               // Id del tema (índice en los FotoTema)
+    unsigned int ip;                 // Orden de red
+    unsigned short puerto;           // Orden de red
+    unsigned short reservado;
+    unsigned int alias;              // 0 si no negoció alias
+    unsigned int limite;             // Crédito (0 = sin control de flujo)
+} FotoSub;
+
+typedef struct {
+    FILE *f;
+    char tmp[FOTO_MAX_RUTA];
+    const char *archivo;
+    int hijo;                        // Se escribe en el proceso hijo (fork)
+    int error;
+} FotoEscritura;
+
+#ifndef _WIN32
+static pid_t foto_pid = 0;           // Hijo escribiendo la foto anterior (0 = ninguno)
+#endif
+
+/** foto_cabecera - Cabecera lista para escribir */
+static inline FotoCabecera foto_cabecera(int limpia, unsigned int alias_base, int num_temas,
+                                         int num_subs, size_t tam_extra) {
+    FotoCabecera c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magia, FOTO_MAGIA, sizeof(c.magia));
+    c.version = FOTO_VERSION;
+    c.limpia = (unsigned int)limpia;
+    c.alias_base = alias_base;
+    c.num_temas = (unsigned int)num_temas;
+    c.num_subs = (unsigned int)num_subs;
+    c.tam_extra = (unsigned int)tam_extra;
+    c.creada = (long long)time(NULL);
+    return c;
+}
+
+/**
+ * foto_abrir - Empieza una foto de archivo
+ *
+ * Con copia = 1 (POSIX) la foto la escribe un proceso hijo: el broker
+ * recibe 0 y sigue, el hijo recibe 1. Si la foto anterior todavía se está
+ * escribiendo, retorna 0 y esta se saltea. Con copia = 0 se escribe en
+ * este proceso (retorna 1), esperando antes a un hijo que siga escribiendo.
+ * Retorna -1 si no se pudo crear el archivo temporal.
+ */
+static inline int foto_abrir(FotoEscritura *w, const char *archivo, int copia) {
+    memset(w, 0, sizeof(*w));
+    w->archivo = archivo;
+    snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", archivo);
+#ifndef _WIN32
+    if (foto_pid > 0 && waitpid(foto_pid, NULL, copia ? WNOHANG : 0) == 0) return 0;
+    foto_pid = 0;
+    if (copia) {
+        pid_t pid = fork();
+        if (pid > 0) {
+            foto_pid = pid;
+            return 0;
+        }
+        w->hijo = pid == 0;           // Sin fork (pid < 0): escribirla acá
+    }
+#else
+    (void)copia;
+#endif
+    w->f = fopen(w->tmp, "wb");
+    if (w->f == NULL) {
+#ifndef _WIN32
+        if (w->hijo) _exit(1);
+#endif
+        return -1;
+    }
+    return 1;
+}
+
+/** foto_escribir - Agrega tam bytes a la foto (los errores se ven en foto_cerrar) */
+static inline void foto_escribir(FotoEscritura *w, const void *datos, size_t tam) {
+    if (tam > 0 && fwrite(datos, tam, 1, w->f) != 1) w->error = 1;
+}
+
+/**
+ * foto_cerrar - Baja la foto a disco y reemplaza la anterior
+ *
+ * En el proceso hijo termina el proceso. Retorna 0 si la foto quedó
+ * escrita; si falló, la anterior sigue intacta.
+ */
+static inline int foto_cerrar(FotoEscritura *w) {
+    if (fflush(w->f) != 0) w->error = 1;
+#ifndef _WIN32
+    if (!w->error && fsync(fileno(w->f)) != 0) w->error = 1;
+#endif
+    if (fclose(w->f) != 0) w->error = 1;
+#ifdef _WIN32
+    if (!w->error) remove(w->archivo);   // rename no reemplaza en Windows
+#endif
+    if (w->error || rename(w->tmp, w->archivo) != 0) {
+        remove(w->tmp);
+        w->error = 1;
+    }
+#ifndef _WIN32
+    if (w->hijo) _exit(w->error);
+#endif
+    return w->error ? -1 : 0;
+}
+
+static inline const FotoTema *foto_temas(const FotoCabecera *c) {
+    return (const FotoTema *)(c + 1);
+}
+
+static inline const FotoSub *foto_subs(const FotoCabecera *c) {
+    return (const FotoSub *)(foto_temas(c) + c->num_temas);
+}
+
+static inline const void *foto_extra(const FotoCabecera *c) {
+    return foto_subs(c) + c->num_subs;
+}
+
+/** foto_liberar - Desmapea (o libera) una foto cargada */
+static inline void foto_liberar(const FotoCabecera *c, size_t tam) {
+#ifdef _WIN32
+    (void)tam;
+    free((void *)c);
+#else
+    munmap((void *)c, tam);
+#endif
+}
+
+/**
+ * foto_cargar - Mapea la foto de archivo en memoria (solo lectura)
+ *
+ * Retorna NULL si no existe o no es una foto válida (otra versión,
+ * truncada, temas sin terminar o suscripciones con un tema inexistente).
+ */
+static inline const FotoCabecera *foto_cargar(const char *archivo, size_t *tam) {
+    const FotoCabecera *c;
+#ifdef _WIN32
+    FILE *f = fopen(archivo, "rb");
+    if (f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    long largo = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *datos = largo > 0 ? malloc((size_t)largo) : NULL;
+    if (datos == NULL || fread(datos, (size_t)largo, 1, f) != 1) {
+        free(datos);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    c = (const FotoCabecera *)datos;
+    *tam = (size_t)largo;
+#else
+    struct stat st;
+    int fd = open(archivo, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    *tam = (size_t)st.st_size;
+    void *m = mmap(NULL, *tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return NULL;
+    c = m;
+#endif
+    int valida = *tam >= sizeof(FotoCabecera) && memcmp(c->magia, FOTO_MAGIA, sizeof(c->magia)) == 0 &&
+                 c->version == FOTO_VERSION &&
+                 *tam == sizeof(FotoCabecera) + (size_t)c->num_temas * sizeof(FotoTema) +
+                         (size_t)c->num_subs * sizeof(FotoSub) + c->tam_extra;
+    for (unsigned int i = 0; valida && i < c->num_temas; i++) {
+        valida = memchr(foto_temas(c)[i].nombre, '\0', TABLA_MAX_TEMA) != NULL;
+    }
+    for (unsigned int i = 0; valida && i < c->num_subs; i++) {
+        valida = foto_subs(c)[i].tema < c->num_temas;
+    }
+    if (!valida) {
+        foto_liberar(c, *tam);
+        return NULL;
+    }
+    return c;
+}
+
+#endif /* FOTO_H */
@@ -0,0 +1,135 @@
+/*
+ * ============================================================================
+ * GRUPOS - Suscripciones compartidas (grupos de consumidores)
+ * ============================================================================
+ *
+ * Todos los subscribers de un tema recibían todos sus mensajes: un
+ * consumidor lento (ej: el cálculo de estadísticas) no se podía repartir
+ * entre varios procesos. Con un grupo, cada mensaje del tema va a UNO solo
+ * de sus miembros:
+ *
+ *   - Un subscriber se une al grupo "g" del tema T suscribiéndose a
+ *     "$grupo/g/T" (GRUPO_PREFIJO). Para los clientes es un tema más.
+ *   - Un tema puede tener varios grupos (cada grupo recibe todo) y además
+ *     subscribers comunes.
+ *   - El broker elige el miembro de cada mensaje con la política del grupo
+ *     ("--grupo politica:g", por defecto turnos):
+ *       turnos - ronda entre los miembros.
+ *       carga  - el miembro con menos mensajes sin confirmar (necesita ACKs:
+ *                en broker_udp es igual a turnos).
+ *       clave  - por "clave=valor" al inicio del mensaje, con hashing de
+ *                rendezvous: una clave va siempre al mismo miembro y si uno
+ *                se va solo se mueven sus claves. Sin clave, turnos.
+ *
+ * Uso:
+ *   grupo_fijar_politica("clave:estadisticas");
+ *   grupo_tema("$grupo/estadisticas/Colombia vs Argentina")  → "Colombia vs Argentina"
+ *   grupo_politica("$grupo/estadisticas/Colombia vs Argentina") → GRUPO_CLAVE
+ *   if (grupo_clave(mensaje, &clave)) el miembro de mayor
+ *       grupo_puntaje(clave, ip, puerto) se lleva el mensaje
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef GRUPOS_H
+#define GRUPOS_H
+
+#include <string.h>
+
+#define GRUPO_PREFIJO        "$grupo/"
+#define GRUPO_LARGO_PREFIJO  7
+#define GRUPO_MAX_POLITICAS  50
+#define GRUPO_MAX_CLAVE      32         // Como la compactación del estado retenido
+
+#define GRUPO_TURNOS  0
+#define GRUPO_CARGA   1
+#define GRUPO_CLAVE   2
+
+static const char *const grupo_politicas[] = {"turnos", "carga", "clave"};
+
+// Política configurada por grupo ("--grupo clave:estadisticas")
+typedef struct {
+    char grupo[50];
+    int politica;
+} GrupoPolitica;
+
+static GrupoPolitica grupo_configurados[GRUPO_MAX_POLITICAS];
+static int grupo_num_configurados = 0;
+
+/**
+ * grupo_tema - Tema real de "$grupo/g/T" (apunta dentro de nombre), o NULL
+ * si nombre no es de un grupo
+ */
+static inline const char *grupo_tema(const char *nombre) {
+    if (strncmp(nombre, GRUPO_PREFIJO, GRUPO_LARGO_PREFIJO) != 0) return NULL;
+    const char *barra = strchr(nombre + GRUPO_LARGO_PREFIJO, '/');
+    if (barra == NULL || barra == nombre + GRUPO_LARGO_PREFIJO || barra[1] == '\0') return NULL;
+    return barra + 1;
+}
+
+/** grupo_fijar_politica - "politica:grupo" (turnos, carga o clave). Retorna 0 si OK. */
+static inline int grupo_fijar_politica(const char *arg) {
+    const char *sep = strchr(arg, ':');
+    if (sep == NULL || sep[1] == '\0' || strchr(sep + 1, '/') != NULL ||
+        grupo_num_configurados == GRUPO_MAX_POLITICAS) return -1;
+    for (int p = 0; p < 3; p++) {
+        if (strlen(grupo_politicas[p]) != (size_t)(sep - arg) ||
+            strncmp(arg, grupo_politicas[p], (size_t)(sep - arg)) != 0) continue;
+        GrupoPolitica *c = &grupo_configurados[grupo_num_configurados++];
+        strncpy(c->grupo, sep + 1, sizeof(c->grupo) - 1);
+        c->politica = p;
+        return 0;
+    }
+    return -1;
+}
+
+/** grupo_politica - Política del grupo de "$grupo/g/T" (GRUPO_TURNOS si no se configuró) */
+static inline int grupo_politica(const char *nombre) {
+    const char *g = nombre + GRUPO_LARGO_PREFIJO;
+    const char *t = grupo_tema(nombre);
+    if (t == NULL) return GRUPO_TURNOS;
+    for (int i = 0; i < grupo_num_configurados; i++) {
+        const char *c = grupo_configurados[i].grupo;
+        if (strlen(c) == (size_t)(t - 1 - g) && strncmp(c, g, (size_t)(t - 1 - g)) == 0) {
+            return grupo_configurados[i].politica;
+        }
+    }
+    return GRUPO_TURNOS;
+}
+
+/**
+ * grupo_clave - Hash (FNV-1a) de la clave de "clave=valor resto" al inicio
+ * del mensaje (hasta el primer espacio, GRUPO_MAX_CLAVE caracteres como
+ * mucho). Retorna 0 si el mensaje no tiene clave.
+ */
+static inline int grupo_clave(const char *mensaje, unsigned int *clave) {
+    unsigned int h = 2166136261u;
+    int i = 0;
+    if (strncmp(mensaje, "clave=", 6) != 0) return 0;
+    mensaje += 6;
+    while (i < GRUPO_MAX_CLAVE && mensaje[i] != '\0' && mensaje[i] != ' ') {
+        h = (h ^ (unsigned char)mensaje[i++]) * 16777619u;
+    }
+    *clave = h;
+    return i > 0;
+}
+
+/**
+ * grupo_puntaje - Puntaje de un miembro (ip y puerto) para una clave
+ *
+ * Hashing de rendezvous: la clave va al miembro de mayor puntaje. Que un
+ * miembro entre o salga solo cambia el dueño de las claves que ganaba (o
+ * que gana) ese miembro.
+ */
+static inline unsigned int grupo_puntaje(unsigned int clave, unsigned int ip, unsigned short puerto) {
+    unsigned int h = clave ^ (ip * 0x9E3779B1u) ^ ((unsigned int)puerto * 0x85EBCA77u);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+#endif /* GRUPOS_H */
@@ -0,0 +1,193 @@
+/*
+ * ============================================================================
+ * HILOS - Hilos, variables por hilo y colas sin bloqueo (Windows / POSIX)
+ * ============================================================================
+ *
+ * Lo mínimo para repartir trabajo entre hilos sin compartir estado:
+ *
+ *   - POR_HILO: cada hilo tiene su propia copia de la variable global
+ *     (_Thread_local). El estado que se marca así no necesita cerrojos.
+ *   - hilo_crear(): CreateThread en Windows, pthread_create en POSIX.
+ *   - Anillo: cola acotada de un productor y un consumidor (SPSC). Poner y
+ *     sacar son solo lecturas y escrituras atómicas de dos índices, cada uno
+ *     en su propia línea de caché. El cerrojo y la variable de condición se
+ *     usan únicamente para dormir al consumidor cuando la cola está vacía
+ *     (anillo_esperar) y despertarlo al llegar algo.
+ *
+ * Uso:
+ *   anillo_iniciar(&a, 1024, sizeof(Trabajo));
+ *   productor:  if (anillo_poner(&a, &t) != 0) ... (lleno: descartar)
+ *   consumidor: while (anillo_sacar(&a, &t)) ...; anillo_esperar(&a, 200);
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * En POSIX hay que enlazar con -pthread.
+ * ============================================================================
+ */
+
+#ifndef HILOS_H
+#define HILOS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "plataforma.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define POR_HILO  _Thread_local
+#define LINEA_CACHE 64
+
+#ifdef _WIN32
+typedef HANDLE Hilo;
+typedef CRITICAL_SECTION Cerrojo;
+typedef CONDITION_VARIABLE Aviso;
+#else
+typedef pthread_t Hilo;
+typedef pthread_mutex_t Cerrojo;
+typedef pthread_cond_t Aviso;
+#endif
+
+typedef void (*FuncionHilo)(void *arg);
+
+typedef struct {
+    FuncionHilo funcion;
+    void *arg;
+} InicioHilo;
+
+#ifdef _WIN32
+static inline DWORD WINAPI hilo_arrancar(LPVOID p) {
+#else
+static inline void *hilo_arrancar(void *p) {
+#endif
+    InicioHilo inicio = *(InicioHilo *)p;
+    free(p);
+    inicio.funcion(inicio.arg);
+    return 0;
+}
+
+/** hilo_crear - Lanza funcion(arg) en un hilo nuevo. Retorna 0 si OK. */
+static inline int hilo_crear(Hilo *h, FuncionHilo funcion, void *arg) {
+    InicioHilo *inicio = malloc(sizeof(InicioHilo));
+    if (inicio == NULL) return -1;
+    inicio->funcion = funcion;
+    inicio->arg = arg;
+#ifdef _WIN32
+    *h = CreateThread(NULL, 0, hilo_arrancar, inicio, 0, NULL);
+    if (*h != NULL) return 0;
+#else
+    if (pthread_create(h, NULL, hilo_arrancar, inicio) == 0) return 0;
+#endif
+    free(inicio);
+    return -1;
+}
+
+// ============================================================================
+// ANILLO - Cola SPSC acotada
+// ============================================================================
+
+typedef struct {
+    _Alignas(LINEA_CACHE) atomic_uint cabeza;   // Próxima a sacar (solo la escribe el consumidor)
+    _Alignas(LINEA_CACHE) atomic_uint cola;     // Próxima a poner (solo la escribe el productor)
+    _Alignas(LINEA_CACHE) atomic_int durmiendo; // El consumidor espera en aviso
+    char *ranuras;
+    size_t tam;                                  // Bytes por elemento
+    unsigned int capacidad;                      // Potencia de 2
+    unsigned long descartados;                   // Puestas rechazadas por cola llena (productor)
+    Cerrojo cerrojo;
+    Aviso aviso;
+} Anillo;
+
+/** anillo_iniciar - Cola vacía de capacidad (potencia de 2) elementos de tam bytes */
+static inline int anillo_iniciar(Anillo *a, unsigned int capacidad, size_t tam) {
+    memset(a, 0, sizeof(*a));
+    a->ranuras = malloc(tam * capacidad);
+    if (a->ranuras == NULL) return -1;
+    a->tam = tam;
+    a->capacidad = capacidad;
+#ifdef _WIN32
+    InitializeCriticalSection(&a->cerrojo);
+    InitializeConditionVariable(&a->aviso);
+#else
+    pthread_mutex_init(&a->cerrojo, NULL);
+    pthread_cond_init(&a->aviso, NULL);
+#endif
+    return 0;
+}
+
+/** anillo_libres - Lugares libres (exacto para el productor) */
+static inline unsigned int anillo_libres(Anillo *a) {
+    return a->capacidad - (atomic_load_explicit(&a->cola, memory_order_relaxed) -
+                           atomic_load_explicit(&a->cabeza, memory_order_acquire));
+}
+
+/**
+ * anillo_poner - Copia dato al final (solo el productor)
+ *
+ * Retorna 0 si entró, -1 si la cola está llena (el dato se descarta).
+ */
+static inline int anillo_poner(Anillo *a, const void *dato) {
+    unsigned int cola = atomic_load_explicit(&a->cola, memory_order_relaxed);
+    if (cola - atomic_load_explicit(&a->cabeza, memory_order_acquire) == a->capacidad) {
+        a->descartados++;
+        return -1;
+    }
+    memcpy(a->ranuras + (size_t)(cola & (a->capacidad - 1)) * a->tam, dato, a->tam);
+    atomic_store(&a->cola, cola + 1);
+    // Publicar cola y después mirar durmiendo (los dos seq_cst): si el
+    // consumidor no vio el dato nuevo, este hilo sí lo ve durmiendo
+    if (atomic_load(&a->durmiendo)) {
+#ifdef _WIN32
+        EnterCriticalSection(&a->cerrojo);
+        WakeConditionVariable(&a->aviso);
+        LeaveCriticalSection(&a->cerrojo);
+#else
+        pthread_mutex_lock(&a->cerrojo);
+        pthread_cond_signal(&a->aviso);
+        pthread_mutex_unlock(&a->cerrojo);
+#endif
+    }
+    return 0;
+}
+
+/** anillo_sacar - Copia el primero en dato y lo quita (solo el consumidor). Retorna 1 si había. */
+static inline int anillo_sacar(Anillo *a, void *dato) {
+    unsigned int cabeza = atomic_load_explicit(&a->cabeza, memory_order_relaxed);
+    if (cabeza == atomic_load_explicit(&a->cola, memory_order_acquire)) return 0;
+    memcpy(dato, a->ranuras + (size_t)(cabeza & (a->capacidad - 1)) * a->tam, a->tam);
+    atomic_store_explicit(&a->cabeza, cabeza + 1, memory_order_release);
+    return 1;
+}
+
+/** anillo_esperar - Duerme al consumidor hasta que llegue algo o pasen ms */
+static inline void anillo_esperar(Anillo *a, int ms) {
+#ifdef _WIN32
+    EnterCriticalSection(&a->cerrojo);
+    atomic_store(&a->durmiendo, 1);
+    if (atomic_load(&a->cabeza) == atomic_load(&a->cola)) {
+        SleepConditionVariableCS(&a->aviso, &a->cerrojo, (DWORD)ms);
+    }
+    atomic_store(&a->durmiendo, 0);
+    LeaveCriticalSection(&a->cerrojo);
+#else
+    struct timespec limite;
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_sec += ms / 1000;
+    limite.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (limite.tv_nsec >= 1000000000L) {
+        limite.tv_sec++;
+        limite.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&a->cerrojo);
+    atomic_store(&a->durmiendo, 1);
+    if (atomic_load(&a->cabeza) == atomic_load(&a->cola)) {
+        pthread_cond_timedwait(&a->aviso, &a->cerrojo, &limite);
+    }
+    atomic_store(&a->durmiendo, 0);
+    pthread_mutex_unlock(&a->cerrojo);
+#endif
+}
+
+#endif /* HILOS_H */
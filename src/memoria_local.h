@@ -0,0 +1,399 @@
+/*
+ * ============================================================================
+ * MEMORIA LOCAL - Anillos por tema en memoria compartida (mismo host)
+ * ============================================================================
+ *
+ * Muchos publishers y subscribers corren en la misma máquina que el broker,
+ * y aun así cada mensaje hace el viaje por loopback: un sendto() del broker
+ * por suscriptor y un recvfrom() de cada uno. Con este transporte el
+ * escritor (el broker, o un publicador que sea dueño de sus temas) copia
+ * cada mensaje UNA vez en un anillo del tema mapeado en memoria, y todos
+ * los lectores locales lo leen de ahí sin syscalls.
+ *
+ *   - Zona ("/prefijo"): un segmento chico con el timbre. Todos los anillos
+ *     de un escritor comparten el timbre, así un lector con varios temas
+ *     espera en un solo lugar (futex en Linux; en otros sistemas, sondeo
+ *     con pausas cortas).
+ *   - Anillo ("/prefijo-<hash del tema>"): un escritor, muchos lectores.
+ *     El escritor nunca espera: si un lector se atrasa más que el anillo,
+ *     pierde los más viejos (local_leer los cuenta en cursor->perdidos).
+ *     Cada ranura lleva una versión (seqlock): 2n+1 mientras se escribe el
+ *     mensaje n, 2n+2 cuando está listo. El lector copia y vuelve a mirar
+ *     la versión; si cambió, el escritor le pasó por encima.
+ *
+ * Los lectores mapean los anillos solo para lectura: no pueden romperle el
+ * estado a nadie. La zona sí es de lectura y escritura (cuentan cuántos
+ * duermen para que el escritor solo despierte si hace falta).
+ *
+ * Si el escritor se reinicia, marca "reemplazado" en los segmentos viejos y
+ * crea otros con el mismo nombre: local_leer() retorna -1 y el lector vuelve
+ * a abrir.
+ *
+ * Uso (escritor):
+ *   ZonaLocal *z = local_zona_crear("/pubsub-quic-7000");
+ *   AnilloLocal *a = local_anillo_crear(z, "/pubsub-quic-7000", "Colombia vs Argentina", 1024);
+ *   local_publicar(z, a, seq, datos, len);
+ * Uso (lector):
+ *   ZonaLocal *z = local_zona_abrir("/pubsub-quic-7000");
+ *   CursorLocal c;  local_cursor_abrir(&c, z, "/pubsub-quic-7000", "Colombia vs Argentina", 0);
+ *   unsigned int aviso = local_aviso(z);
+ *   while ((n = local_leer(&c, &seq, buf, sizeof(buf))) > 0) ...;
+ *   if (n == 0) local_dormir(z, aviso, 1000);
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * Solo POSIX; en Windows las funciones fallan y el broker sigue solo con red.
+ * ============================================================================
+ */
+
+#ifndef MEMORIA_LOCAL_H
+#define MEMORIA_LOCAL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define LOCAL_MAGIA       0x324C4F43u   // "COL2" (ranuras de 576 bytes; "COL1" eran de 512)
+#define LOCAL_MAX_TEMA    64
+#define LOCAL_MAX_DATOS   560           // Ranura de 576 bytes (9 líneas): entra cualquier 'P' de QUIC
+#define LOCAL_MAX_NOMBRE  96
+#define LOCAL_LINEA_CACHE 64
+
+typedef struct {
+    unsigned int magia;
+    unsigned int generacion;        // Distinta en cada arranque del escritor
+    atomic_int reemplazado;
+    _Alignas(LOCAL_LINEA_CACHE) atomic_uint aviso;      // Futex: cambia con cada publicación
+    atomic_uint durmiendo;                              // Lectores en local_dormir
+} ZonaLocal;
+
+typedef struct {
+    atomic_ullong version;          // 2n+1 escribiendo el mensaje n, 2n+2 listo
+    unsigned int seq;               // Seq del tema en el broker (0 = sin garantías)
+    unsigned int largo;
+    char datos[LOCAL_MAX_DATOS];
+} RanuraLocal;
+
+typedef struct {
+    unsigned int magia;
+    unsigned int ranuras;           // Potencia de 2
+    unsigned int generacion;        // La de la zona que lo creó
+    char tema[LOCAL_MAX_TEMA];
+    atomic_int reemplazado;
+    _Alignas(LOCAL_LINEA_CACHE) atomic_ullong escritos;   // Mensajes desde que se creó
+    _Alignas(LOCAL_LINEA_CACHE) RanuraLocal ranura[];
+} AnilloLocal;
+
+typedef struct {
+    const AnilloLocal *anillo;
+    size_t tam;                     // Bytes mapeados
+    unsigned long long proximo;     // Próximo mensaje a leer
+    unsigned long long perdidos;    // Sobrescritos antes de que se leyeran
+} CursorLocal;
+
+/** local_nombre_anillo - "/prefijo-xxxxxxxx" con el FNV-1a del tema */
+static inline void local_nombre_anillo(char *nombre, const char *prefijo, const char *tema) {
+    unsigned int h = 2166136261u;
+    for (const char *s = tema; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    snprintf(nombre, LOCAL_MAX_NOMBRE, "%.*s-%08x", LOCAL_MAX_NOMBRE - 10, prefijo, h);
+}
+
+static inline size_t local_tam_anillo(unsigned int ranuras) {
+    return sizeof(AnilloLocal) + (size_t)ranuras * sizeof(RanuraLocal);
+}
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * local_mapear_nuevo - Crea el segmento nombre de tam bytes (en cero)
+ *
+ * Si ya existe (el escritor anterior no lo borró) se marca como reemplazado
+ * para que sus lectores se enteren, y se crea otro.
+ */
+static inline void *local_mapear_nuevo(const char *nombre, size_t tam, size_t offset_reemplazado,
+                                       unsigned int generacion) {
+    int fd = shm_open(nombre, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        int viejo = shm_open(nombre, O_RDWR, 0600);
+        if (viejo >= 0) {
+            struct stat st;
+            if (fstat(viejo, &st) == 0 && (size_t)st.st_size >= offset_reemplazado + sizeof(atomic_int)) {
+                char *m = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, viejo, 0);
+                if (m != MAP_FAILED) {
+                    // Anillo de este mismo arranque (otro tema con el mismo hash): no se toca
+                    int vivo = generacion != 0 && ((AnilloLocal *)m)->magia == LOCAL_MAGIA &&
+                               ((AnilloLocal *)m)->generacion == generacion;
+                    if (!vivo) atomic_store((atomic_int *)(m + offset_reemplazado), 1);
+                    munmap(m, (size_t)st.st_size);
+                    if (vivo) {
+                        close(viejo);
+                        return NULL;
+                    }
+                }
+            }
+            close(viejo);
+        }
+        shm_unlink(nombre);
+        fd = shm_open(nombre, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) return NULL;
+    }
+    if (ftruncate(fd, (off_t)tam) != 0) {
+        close(fd);
+        shm_unlink(nombre);
+        return NULL;
+    }
+    void *m = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return m == MAP_FAILED ? NULL : m;
+}
+
+/** local_mapear - Abre un segmento existente; tam recibe su tamaño */
+static inline void *local_mapear(const char *nombre, int escribir, size_t *tam) {
+    struct stat st;
+    int fd = shm_open(nombre, escribir ? O_RDWR : O_RDONLY, 0600);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, escribir ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    *tam = (size_t)st.st_size;
+    return m == MAP_FAILED ? NULL : m;
+}
+
+// ============================================================================
+// ESCRITOR
+// ============================================================================
+
+/** local_zona_crear - Crea (o reemplaza) la zona del prefijo. NULL si falla. */
+static inline ZonaLocal *local_zona_crear(const char *prefijo) {
+    ZonaLocal *z = local_mapear_nuevo(prefijo, sizeof(ZonaLocal), offsetof(ZonaLocal, reemplazado), 0);
+    if (z == NULL) return NULL;
+    z->generacion = ((unsigned int)time(NULL) ^ (unsigned int)getpid() << 16) | 1;
+    z->magia = LOCAL_MAGIA;
+    return z;
+}
+
+/**
+ * local_anillo_crear - Anillo del tema con ranuras (potencia de 2) lugares
+ *
+ * Dos temas con el mismo hash no pueden tener anillo a la vez: el segundo
+ * recibe NULL y sigue solo por red.
+ */
+static inline AnilloLocal *local_anillo_crear(ZonaLocal *z, const char *prefijo, const char *tema,
+                                              unsigned int ranuras) {
+    char nombre[LOCAL_MAX_NOMBRE];
+    if (strlen(tema) >= LOCAL_MAX_TEMA || ranuras == 0 || (ranuras & (ranuras - 1)) != 0) return NULL;
+    local_nombre_anillo(nombre, prefijo, tema);
+    AnilloLocal *a = local_mapear_nuevo(nombre, local_tam_anillo(ranuras), offsetof(AnilloLocal, reemplazado),
+                                        z->generacion);
+    if (a == NULL) return NULL;
+    a->ranuras = ranuras;
+    a->generacion = z->generacion;
+    strcpy(a->tema, tema);
+    atomic_store(&a->escritos, 0);
+    atomic_thread_fence(memory_order_release);
+    a->magia = LOCAL_MAGIA;                 // Último: recién ahora lo aceptan los lectores
+    return a;
+}
+
+/**
+ * local_publicar - Copia el mensaje en la próxima ranura y despierta a los
+ * lectores que duermen (solo el único escritor del anillo)
+ *
+ * Retorna 0, o -1 si el mensaje no entra en LOCAL_MAX_DATOS: no se escribe
+ * nada (cortado sería otro mensaje) y el escritor decide qué hacer con él.
+ */
+static inline int local_publicar(ZonaLocal *z, AnilloLocal *a, unsigned int seq,
+                                 const char *datos, size_t largo) {
+    if (largo > LOCAL_MAX_DATOS) return -1;
+    unsigned long long n = atomic_load_explicit(&a->escritos, memory_order_relaxed);
+    RanuraLocal *r = &a->ranura[n & (a->ranuras - 1)];
+
+    atomic_store_explicit(&r->version, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    r->seq = seq;
+    r->largo = (unsigned int)largo;
+    memcpy(r->datos, datos, largo);
+    atomic_store_explicit(&r->version, 2 * n + 2, memory_order_release);
+
+    // Publicar escritos y después mirar durmiendo (los dos seq_cst): si un
+    // lector no vio el mensaje, este hilo sí lo ve durmiendo
+    atomic_store(&a->escritos, n + 1);
+    atomic_fetch_add(&z->aviso, 1);
+    if (atomic_load(&z->durmiendo) != 0) {
+#ifdef __linux__
+        syscall(SYS_futex, &z->aviso, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+    }
+    return 0;
+}
+
+// ============================================================================
+// LECTOR
+// ============================================================================
+
+/** local_zona_abrir - Zona de un escritor ya iniciado. NULL si no existe. */
+static inline ZonaLocal *local_zona_abrir(const char *prefijo) {
+    size_t tam;
+    ZonaLocal *z = local_mapear(prefijo, 1, &tam);
+    if (z == NULL) return NULL;
+    if (tam < sizeof(ZonaLocal) || z->magia != LOCAL_MAGIA) {
+        munmap(z, tam);
+        return NULL;
+    }
+    return z;
+}
+
+/** local_zona_cerrar - Desmapea la zona (lector o escritor) */
+static inline void local_zona_cerrar(ZonaLocal *z) {
+    if (z != NULL) munmap(z, sizeof(ZonaLocal));
+}
+
+/**
+ * local_cursor_abrir - Empieza a leer el anillo del tema
+ *
+ * Con desde_el_principio = 0 se lee desde el próximo mensaje; con 1, desde
+ * el más viejo que siga en el anillo (para un lector que ya esperaba antes
+ * de que el anillo existiera: todo lo que tiene es posterior). Retorna -1 si
+ * el escritor (el de la zona z) todavía no lo creó: un anillo que quedó de
+ * un arranque anterior no cuenta. Reintentar luego.
+ */
+static inline int local_cursor_abrir(CursorLocal *c, const ZonaLocal *z, const char *prefijo,
+                                     const char *tema, int desde_el_principio) {
+    char nombre[LOCAL_MAX_NOMBRE];
+    memset(c, 0, sizeof(*c));
+    local_nombre_anillo(nombre, prefijo, tema);
+    const AnilloLocal *a = local_mapear(nombre, 0, &c->tam);
+    if (a == NULL) return -1;
+    if (c->tam < sizeof(AnilloLocal) || a->magia != LOCAL_MAGIA || c->tam < local_tam_anillo(a->ranuras) ||
+        strncmp(a->tema, tema, LOCAL_MAX_TEMA) != 0 || a->generacion != z->generacion) {
+        munmap((void *)a, c->tam);
+        return -1;
+    }
+    c->anillo = a;
+    c->proximo = atomic_load(&((AnilloLocal *)a)->escritos);
+    if (desde_el_principio) c->proximo = c->proximo > a->ranuras ? c->proximo - a->ranuras : 0;
+    return 0;
+}
+
+/** local_cursor_cerrar - Desmapea el anillo */
+static inline void local_cursor_cerrar(CursorLocal *c) {
+    if (c->anillo != NULL) munmap((void *)c->anillo, c->tam);
+    c->anillo = NULL;
+}
+
+/**
+ * local_leer - Copia el próximo mensaje en datos (hasta cap bytes)
+ *
+ * Retorna el largo copiado, 0 si no hay nada nuevo o -1 si el escritor
+ * reemplazó el anillo (cerrar y volver a abrir). Un mensaje vacío se
+ * entrega como un '\0' de largo 1 para no confundirlo con "nada nuevo".
+ */
+static inline int local_leer(CursorLocal *c, unsigned int *seq, char *datos, size_t cap) {
+    AnilloLocal *a = (AnilloLocal *)c->anillo;
+    while (1) {
+        if (atomic_load_explicit(&a->reemplazado, memory_order_relaxed)) return -1;
+        unsigned long long escritos = atomic_load_explicit(&a->escritos, memory_order_acquire);
+        if (c->proximo >= escritos) return 0;
+        if (escritos - c->proximo > a->ranuras) {           // Sobrescritos: saltar
+            c->perdidos += escritos - a->ranuras - c->proximo;
+            c->proximo = escritos - a->ranuras;
+        }
+        const RanuraLocal *r = &a->ranura[c->proximo & (a->ranuras - 1)];
+        unsigned long long v1 = atomic_load_explicit(&((RanuraLocal *)r)->version, memory_order_acquire);
+        if (v1 == 2 * c->proximo + 2) {
+            unsigned int largo = r->largo;
+            if (largo > LOCAL_MAX_DATOS) largo = LOCAL_MAX_DATOS;
+            if (largo > cap) largo = (unsigned int)cap;
+            *seq = r->seq;
+            memcpy(datos, r->datos, largo);
+            atomic_thread_fence(memory_order_acquire);
+            unsigned long long v2 = atomic_load_explicit(&((RanuraLocal *)r)->version, memory_order_relaxed);
+            if (v2 == v1) {
+                c->proximo++;
+                if (largo == 0 && cap > 0) {
+                    datos[0] = '\0';
+                    return 1;
+                }
+                return (int)largo;
+            }
+        }
+        // La ranura ya es de un mensaje posterior: se perdió este
+        c->perdidos++;
+        c->proximo++;
+    }
+}
+
+/** local_aviso - Valor del timbre; leerlo ANTES de revisar los cursores */
+static inline unsigned int local_aviso(ZonaLocal *z) {
+    return atomic_load(&z->aviso);
+}
+
+/**
+ * local_dormir - Espera hasta ms a que el timbre cambie respecto de aviso
+ *
+ * Si el escritor publicó entre local_aviso() y esta llamada, retorna enseguida.
+ */
+static inline void local_dormir(ZonaLocal *z, unsigned int aviso, int ms) {
+    atomic_fetch_add(&z->durmiendo, 1);
+#ifdef __linux__
+    struct timespec t = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    if (atomic_load(&z->aviso) == aviso) {
+        syscall(SYS_futex, &z->aviso, FUTEX_WAIT, aviso, &t, NULL, 0);
+    }
+#else
+    // Sin futex compartido entre procesos: sondeo cada 50 µs
+    struct timespec pausa = {0, 50000};
+    for (long esperado = 0; esperado < (long)ms * 1000 && atomic_load(&z->aviso) == aviso; esperado += 50) {
+        nanosleep(&pausa, NULL);
+    }
+#endif
+    atomic_fetch_sub(&z->durmiendo, 1);
+}
+
+/** local_zona_reemplazada - 1 si el escritor de la zona se reinició */
+static inline int local_zona_reemplazada(ZonaLocal *z) {
+    return atomic_load(&z->reemplazado) != 0;
+}
+
+#else /* _WIN32: sin transporte local */
+
+static inline ZonaLocal *local_zona_crear(const char *prefijo) { (void)prefijo; return NULL; }
+static inline AnilloLocal *local_anillo_crear(ZonaLocal *z, const char *prefijo, const char *tema,
+                                              unsigned int ranuras) {
+    (void)z; (void)prefijo;(void)tema; (void)ranuras; return NULL;
+}
+static inline int local_publicar(ZonaLocal *z, AnilloLocal *a, unsigned int seq, const char *datos, size_t largo) {
+    (void)z; (void)a; (void)seq; (void)datos; (void)largo; return -1;
+}
+static inline ZonaLocal *local_zona_abrir(const char *prefijo) { (void)prefijo; return NULL; }
+static inline void local_zona_cerrar(ZonaLocal *z) { (void)z; }
+static inline int local_cursor_abrir(CursorLocal *c, const ZonaLocal *z, const char *prefijo,
+                                     const char *tema, int desde_el_principio) {
+    (void)c; (void)z; (void)prefijo; (void)tema; (void)desde_el_principio; return -1;
+}
+static inline void local_cursor_cerrar(CursorLocal *c) { (void)c; }
+static inline int local_leer(CursorLocal *c, unsigned int *seq, char *datos, size_t cap) {
+    (void)c; (void)seq; (void)datos; (void)cap; return -1;
+}
+static inline unsigned int local_aviso(ZonaLocal *z) { (void)z; return 0; }
+static inline void local_dormir(ZonaLocal *z, unsigned int aviso, int ms) { (void)z; (void)aviso; (void)ms; }
+static inline int local_zona_reemplazada(ZonaLocal *z) { (void)z; return 1; }
+
+#endif /* _WIN32 */
+
+#endif /* MEMORIA_LOCAL_H */
@@ -0,0 +1,262 @@
+/*
+ * ============================================================================
+ * PLANIFICADOR - Cola de salida con prioridades (estricta + WFQ)
+ * ============================================================================
+ *
+ * Los brokers enviaban en orden de llegada: un gol esperaba detrás de toda
+ * la telemetría que entró antes. Ahora cada envío de una publicación pasa
+ * por una cola con tres clases:
+ *
+ *   PRIO_ALTA   (0) - Prioridad estricta: sale antes que cualquier otra.
+ *   PRIO_NORMAL (1) - Comparte con la baja por turnos ponderados (deficit
+ *   PRIO_BAJA   (2)   round robin, una forma de WFQ): PLAN_PESO_NORMAL a
+ *                     PLAN_PESO_BAJA en bytes, así la baja nunca se muere
+ *                     de hambre pero absorbe la espera bajo sobrecarga.
+ *
+ * La clase de cada tema se configura al iniciar el broker con
+ * "--prioridad clase:tema" (por defecto PRIO_NORMAL).
+ *
+ * Cada clase es un anillo de PlanMensaje (bytes listos para enviar + el
+ * destino, para los brokers UDP que comparten un socket). Si una clase se
+ * llena, el mensaje nuevo se descarta y se cuenta: las colas quedan
+ * acotadas y una clase no le quita lugar a otra.
+ *
+ * Uso:
+ *   plan_iniciar(&p, capacidad);
+ *   plan_encolar(&p, clase, datos, largo, &destino);
+ *   while ((m = plan_siguiente(&p)) != NULL) {
+ *       enviar m->datos + p.enviado ... (si el socket no acepta más, cortar)
+ *       plan_enviado(&p);
+ *   }
+ *
+ * plan_siguiente() devuelve el mismo mensaje hasta que se llame a
+ * plan_enviado(): un envío TCP parcial (p.enviado bytes) o un sendto()
+ * que no entró se retoma sin mezclar otro mensaje en el medio.
+ *
+ * Para GSO (udp_lotes.h), plan_juntar() agrega al mensaje de turno los
+ * siguientes de su clase con el mismo destino y el mismo largo, y
+ * plan_enviados() los quita juntos. Los que salen desde el medio del anillo
+ * quedan marcados (largo = -1) y se descartan al llegar a la cabeza.
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef PLANIFICADOR_H
+#define PLANIFICADOR_H
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#define PRIO_ALTA     0
+#define PRIO_NORMAL   1
+#define PRIO_BAJA     2
+#define PRIO_CLASES   3
+
+#define PLAN_MAX_MENSAJE  520      // Cabe un Paquete QUIC o una línea de TCP/UDP
+#define PLAN_QUANTUM      512      // Bytes por turno y por unidad de peso
+#define PLAN_PESO_NORMAL  4
+#define PLAN_PESO_BAJA    1
+#define PLAN_MAX_TEMAS    50
+#define PLAN_MAX_BUSQUEDA 256      // Mensajes revisados por plan_juntar
+
+typedef struct {
+    struct sockaddr_in destino;    // Solo lo usan los brokers UDP
+    int largo;
+    char datos[PLAN_MAX_MENSAJE];
+} PlanMensaje;
+
+typedef struct {
+    PlanMensaje *cola[PRIO_CLASES];        // Anillos (se reservan al primer uso)
+    int capacidad;                         // Mensajes por clase
+    int inicio[PRIO_CLASES];
+    int cantidad[PRIO_CLASES];
+    int deficit[PRIO_CLASES];              // Bytes que la clase puede enviar en su turno
+    int turno;                             // Clase WFQ a la que le toca
+    int en_curso;                          // Clase del mensaje entregado por plan_siguiente (-1 = ninguno)
+    int enviado;                           // Bytes ya enviados de ese mensaje (envíos TCP parciales)
+    unsigned long descartados[PRIO_CLASES];
+} Planificador;
+
+// Clase configurada por tema ("--prioridad 0:Goles")
+typedef struct {
+    char tema[50];
+    int clase;
+} PlanClaseTema;
+
+static PlanClaseTema plan_clases[PLAN_MAX_TEMAS];
+static int plan_num_clases = 0;
+
+/** plan_fijar_clase - Configura la clase de un tema ("0:Goles"). Retorna 0 si OK. */
+static inline int plan_fijar_clase(const char *arg) {
+    int clase = arg[0] - '0';
+    if (clase < 0 || clase >= PRIO_CLASES || arg[1] != ':' || arg[2] == '\0' ||
+        plan_num_clases == PLAN_MAX_TEMAS) return -1;
+    strncpy(plan_clases[plan_num_clases].tema, arg + 2, sizeof(plan_clases[0].tema) - 1);
+    plan_clases[plan_num_clases].clase = clase;
+    plan_num_clases++;
+    return 0;
+}
+
+/** plan_clase_tema - Clase de un tema (comparación exacta, brokers UDP y QUIC) */
+static inline int plan_clase_tema(const char *tema) {
+    for (int i = 0; i < plan_num_clases; i++) {
+        if (strcmp(plan_clases[i].tema, tema) == 0) return plan_clases[i].clase;
+    }
+    return PRIO_NORMAL;
+}
+
+/**
+ * plan_clase_texto - Clase de un mensaje sin tema explícito (broker TCP)
+ *
+ * Como las suscripciones TCP, un tema configurado aplica si aparece dentro
+ * del mensaje; si aparecen varios gana la clase más alta.
+ */
+static inline int plan_clase_texto(const char *texto) {
+    int clase = PRIO_NORMAL, hubo = 0;
+    for (int i = 0; i < plan_num_clases; i++) {
+        if (strstr(texto, plan_clases[i].tema) != NULL && (!hubo || plan_clases[i].clase < clase)) {
+            clase = plan_clases[i].clase;
+            hubo = 1;
+        }
+    }
+    return clase;
+}
+
+/** plan_iniciar - Deja la cola vacía; capacidad = mensajes por clase */
+static inline void plan_iniciar(Planificador *p, int capacidad) {
+    memset(p, 0, sizeof(*p));
+    p->capacidad = capacidad;
+    p->turno = PRIO_NORMAL;
+    p->en_curso = -1;
+}
+
+/** plan_liberar - Libera los anillos; la cola queda vacía y reutilizable */
+static inline void plan_liberar(Planificador *p) {
+    for (int c = 0; c < PRIO_CLASES; c++) free(p->cola[c]);
+    plan_iniciar(p, p->capacidad);
+}
+
+/** plan_podar - Saca de la cabeza de la clase los mensajes que ya salieron en un lote */
+static inline void plan_podar(Planificador *p, int c) {
+    while (p->cantidad[c] > 0 && p->cola[c][p->inicio[c]].largo < 0) {
+        p->inicio[c] = (p->inicio[c] + 1) % p->capacidad;
+        p->cantidad[c]--;
+    }
+}
+
+/** plan_pendientes - Mensajes encolados (todas las clases) */
+static inline int plan_pendientes(const Planificador *p) {
+    return p->cantidad[PRIO_ALTA] + p->cantidad[PRIO_NORMAL] + p->cantidad[PRIO_BAJA];
+}
+
+/**
+ * plan_encolar - Agrega un mensaje a su clase
+ *
+ * Retorna 0 si quedó encolado, -1 si la clase está llena (o no hay memoria)
+ * y se descartó.
+ */
+static inline int plan_encolar(Planificador *p, int clase, const void *datos, int largo,
+                               const struct sockaddr_in *destino) {
+    if (clase < 0 || clase >= PRIO_CLASES) clase = PRIO_NORMAL;
+    if (largo > PLAN_MAX_MENSAJE) largo = PLAN_MAX_MENSAJE;
+    if (p->cola[clase] == NULL) {
+        p->cola[clase] = malloc(sizeof(PlanMensaje) * (size_t)p->capacidad);
+    }
+    if (p->cola[clase] == NULL || p->cantidad[clase] == p->capacidad) {
+        p->descartados[clase]++;
+        return -1;
+    }
+    PlanMensaje *m = &p->cola[clase][(p->inicio[clase] + p->cantidad[clase]) % p->capacidad];
+    if (destino != NULL) m->destino = *destino;
+    m->largo = largo;
+    memcpy(m->datos, datos, (size_t)largo);
+    p->cantidad[clase]++;
+    return 0;
+}
+
+/**
+ * plan_siguiente - Mensaje que debe salir ahora, o NULL si no hay nada
+ *
+ * PRIO_ALTA primero; después deficit round robin entre normal y baja: la
+ * clase a la que le toca envía mientras su deficit cubra el mensaje, y al
+ * pasar el turno la siguiente suma su peso * PLAN_QUANTUM.
+ */
+static inline PlanMensaje *plan_siguiente(Planificador *p) {
+    if (p->en_curso < 0) {
+        if (p->cantidad[PRIO_ALTA] > 0) {
+            p->en_curso = PRIO_ALTA;
+        } else if (p->cantidad[PRIO_NORMAL] + p->cantidad[PRIO_BAJA] > 0) {
+            while (p->en_curso < 0) {
+                int c = p->turno;
+                if (p->cantidad[c] > 0 && p->deficit[c] >= p->cola[c][p->inicio[c]].largo) {
+                    p->en_curso = c;
+                    break;
+                }
+                if (p->cantidad[c] == 0) p->deficit[c] = 0;   // Una clase vacía no acumula
+                p->turno = c == PRIO_BAJA ? PRIO_NORMAL : PRIO_BAJA;
+                p->deficit[p->turno] += PLAN_QUANTUM *
+                    (p->turno == PRIO_NORMAL ? PLAN_PESO_NORMAL : PLAN_PESO_BAJA);
+            }
+        } else {
+            return NULL;
+        }
+        p->enviado = 0;
+    }
+    return &p->cola[p->en_curso][p->inicio[p->en_curso]];
+}
+
+/** plan_enviado - El mensaje de plan_siguiente ya salió completo: quitarlo */
+static inline void plan_enviado(Planificador *p) {
+    int c = p->en_curso;
+    if (c < 0) return;
+    if (c != PRIO_ALTA) p->deficit[c] -= p->cola[c][p->inicio[c]].largo;
+    p->inicio[c] = (p->inicio[c] + 1) % p->capacidad;
+    p->cantidad[c]--;
+    p->en_curso = -1;
+    p->enviado = 0;
+    plan_podar(p, c);
+}
+
+/**
+ * plan_juntar - Mensaje de turno más los que pueden salir con él en un envío GSO
+ *
+ * lote[0] = plan_siguiente(p). Después se recorre la misma clase y se
+ * agregan los mensajes al mismo destino con el mismo largo, hasta max
+ * mensajes o max_bytes. Uno más corto puede cerrar el lote; uno más largo
+ * lo corta (el orden hacia un mismo destino no cambia). Los mensajes a
+ * otros destinos se saltan y quedan en su lugar. Retorna cuántos juntó
+ * (0 si la cola está vacía); no quita nada.
+ */
+static inline int plan_juntar(Planificador *p, PlanMensaje **lote, int max, int max_bytes) {
+    PlanMensaje *m = plan_siguiente(p);
+    if (m == NULL) return 0;
+    lote[0] = m;
+    int n = 1, total = m->largo, c = p->en_curso;
+    for (int k = 1; k < p->cantidad[c] && k < PLAN_MAX_BUSQUEDA && n < max; k++) {
+        PlanMensaje *o = &p->cola[c][(p->inicio[c] + k) % p->capacidad];
+        if (o->largo < 0 || o->destino.sin_port != m->destino.sin_port ||
+            o->destino.sin_addr.s_addr != m->destino.sin_addr.s_addr) continue;
+        if (o->largo > m->largo || total + o->largo > max_bytes) break;
+        lote[n++] = o;
+        total += o->largo;
+        if (o->largo < m->largo) break;
+    }
+    return n;
+}
+
+/** plan_enviados - Quita un lote de plan_juntar que ya salió */
+static inline void plan_enviados(Planificador *p, PlanMensaje **lote, int n) {
+    for (int i = 1; i < n; i++) {
+        if (p->en_curso != PRIO_ALTA) p->deficit[p->en_curso] -= lote[i]->largo;
+        lote[i]->largo = -1;
+    }
+    plan_enviado(p);
+}
+
+#endif /* PLANIFICADOR_H */
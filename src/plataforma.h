@@ -0,0 +1,144 @@
+/*
+ * ============================================================================
+ * PLATAFORMA - Capa mínima de portabilidad Winsock / POSIX
+ * ============================================================================
+ *
+ * Los programas TCP y QUIC del laboratorio se escribieron con Winsock2 y los
+ * UDP con sockets POSIX. Las librerías cliente (cliente_pub, cliente_sub) se
+ * embeben en servicios que corren en ambos sistemas, así que este header
+ * unifica lo poco que cambia entre uno y otro:
+ *
+ *   - Tipos: SOCKET, INVALID_SOCKET, SOCKET_ERROR, socklen_t
+ *   - Cierre: closesocket()
+ *   - Inicialización: red_iniciar() / red_finalizar() (WSAStartup en Windows)
+ *   - Sockets no bloqueantes y detección de "intente de nuevo"
+ *   - Reloj monotónico en milisegundos y pausas cortas
+ *
+ * Todo es static inline: basta con incluir el header, no hay que enlazar
+ * ningún archivo extra.
+ * ============================================================================
+ */
+
+#ifndef PLATAFORMA_H
+#define PLATAFORMA_H
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR   (-1)
+#define closesocket    close
+
+#endif
+
+// En POSIX, send() sobre un TCP cerrado por el otro lado dispara SIGPIPE;
+// MSG_NOSIGNAL lo convierte en un error normal. Winsock no lo necesita.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * red_iniciar - Inicializa la pila de red (WSAStartup en Windows, nada en POSIX)
+ *
+ * Retorna 0 si todo salió bien.
+ */
+static inline int red_iniciar(void) {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2,2), &wsa);
+#else
+    return 0;
+#endif
+}
+
+/** red_finalizar - Libera la pila de red (WSACleanup en Windows) */
+static inline void red_finalizar(void) {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+/** red_no_bloqueante - Pone un socket en modo no bloqueante. Retorna 0 si OK. */
+static inline int red_no_bloqueante(SOCKET s) {
+#ifdef _WIN32
+    u_long modo = 1;
+    return ioctlsocket(s, FIONBIO, &modo);
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(s, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+/**
+ * red_reintentar - Indica si el último error de socket es temporal
+ *
+ * Verdadero cuando la operación no pudo completarse "todavía": socket no
+ * bloqueante sin datos, buffer de envío lleno o connect() en curso.
+ */
+static inline int red_reintentar(void) {
+#ifdef _WIN32
+    int e = WSAGetLastError();
+    return e == WSAEWOULDBLOCK || e == WSAEINPROGRESS || e == WSAEALREADY;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS ||
+           errno == EALREADY || errno == EINTR;
+#endif
+}
+
+/**
+ * red_timeout_recepcion - Fija SO_RCVTIMEO en milisegundos
+ *
+ * Winsock recibe un DWORD en ms; POSIX recibe un struct timeval.
+ */
+static inline int red_timeout_recepcion(SOCKET s, unsigned int ms) {
+#ifdef _WIN32
+    DWORD t = ms;
+    return setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char*)&t, sizeof(t));
+#else
+    struct timeval t;
+    t.tv_sec = ms / 1000;
+    t.tv_usec = (ms % 1000) * 1000;
+    return setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char*)&t, sizeof(t));
+#endif
+}
+
+/** reloj_ms - Milisegundos de un reloj monotónico (solo sirve para diferencias) */
+static inline unsigned long long reloj_ms(void) {
+#ifdef _WIN32
+    return (unsigned long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+#endif
+}
+
+/** dormir_ms - Pausa el hilo actual */
+static inline void dormir_ms(unsigned int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+#endif /* PLATAFORMA_H */
@@ -0,0 +1,179 @@
+/*
+ * ============================================================================
+ * PROTOCOLO QUIC - Definiciones compartidas del formato de paquete
+ * ============================================================================
+ *
+ * Broker, publisher, subscriber y las librerías cliente intercambian el
+ * mismo struct Paquete. Antes cada programa tenía su propia copia del
+ * typedef; ahora todos incluyen este header para que no puedan divergir.
+ *
+ * Tipos de paquete:
+ *   'S' = Suscripción      (subscriber → broker)  mensaje = tema
+ *   'P' = Publicación      (publisher → broker → subscriber)
+ *   'A' = ACK              (bidireccional)         mensaje = "OK"
+ *   'R' = Retransmisión    (subscriber → broker)  mensaje = tema, seq = perdido
+ *   'V' = Valor retenido   (broker → subscriber)  estado actual del tema
+ *   'U' = Baja             (subscriber → broker)  mensaje = tema
+ *   'H' = Latido           (subscriber → broker)  mantiene vivas sus suscripciones
+ *                                                  (puede llevar ACKs pendientes)
+ *   'D' = Datagrama        (broker → subscriber)  publicación QoS 0: seq = 0,
+ *                                                  sin ACK ni retransmisión
+ *   'T' = Alias de tema    (cliente → broker)      mensaje = tema
+ *                          (broker → cliente)      mensaje = "id:tema", seq = eco
+ *
+ * ACKs de subscribers:
+ *   Acumulados por tema: una línea "token:limite:acumulado[:mapa]" por tema
+ *   (token = tema o "#id", limite = crédito o 0, acumulado = último seq
+ *   recibido en orden, mapa = huecos pedidos en hexadecimal, bit k =
+ *   llegó acumulado + 2 + k). Un 'A' puede traer varias líneas.
+ *
+ * Lotes de publicación:
+ *   Un paquete 'P' del publisher puede llevar varias publicaciones, una por
+ *   línea: "tema1:contenido\ntema2:contenido". El broker las distribuye en
+ *   orden y responde con UN solo ACK que hace eco del seq del lote.
+ *
+ * Mensajes fragmentados:
+ *   Un contenido que no cabe en un paquete (o que tiene '\n' o '\0') viaja
+ *   en varias publicaciones del mismo tema, cada una con su propio seq:
+ *   "tema:\x1e<id>.<k>/<n>:<trozo>" (id en hexadecimal, elegido por el
+ *   publisher; k = 0..n-1). En el trozo '\n', '\0' y '\\' van escapados
+ *   como "\\n", "\\0" y "\\\\". Para el broker son publicaciones comunes:
+ *   historial, 'R', mapa de huecos, crédito y reanudación funcionan por
+ *   fragmento. El subscriber los rearma y entrega el mensaje entero.
+ *
+ * Estado retenido:
+ *   Junto con el ACK de una suscripción el broker envía los últimos mensajes
+ *   retenidos del tema en paquetes 'V', todos los que quepan en cada uno:
+ *   "tema:seq contenido\nseq contenido\n...", del más viejo al más nuevo
+ *   (seq del paquete = último seq que lleva). No se confirman ni se piden
+ *   por 'R': son solo el arranque del subscriber que llega tarde.
+ *
+ * Alias numéricos:
+ *   Un nombre como "Colombia vs Argentina" suele ser más largo que el evento
+ *   mismo. Con 'T' el cliente pide un id para el tema y desde entonces puede
+ *   escribir "#id:contenido" en lugar de "tema:contenido" en las líneas de
+ *   un 'P'. Si el 'T' viene de un subscriber de ese tema, el broker también
+ *   le envía sus publicaciones como "#id:contenido". id = 0 en la respuesta
+ *   significa "sin alias" (se sigue usando el texto). Un 'T' del broker con
+ *   seq = 0 y mensaje "#id" avisa que ese id no existe (ej: el broker se
+ *   reinició): el cliente debe olvidar sus alias y volver al texto. Los
+ *   temas que empiezan con '#' quedan reservados.
+ *
+ * Tamaño en el cable:
+ *   No hace falta enviar los 500 bytes de mensaje; basta con la cabecera y
+ *   el texto hasta su '\0' (ver paquete_tam). El receptor debe llamar a
+ *   paquete_terminar() con los bytes recibidos para garantizar el '\0'.
+ * ============================================================================
+ */
+
+#ifndef PROTOCOLO_QUIC_H
+#define PROTOCOLO_QUIC_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define QUIC_PUERTO      7000    // Puerto UDP por defecto del broker QUIC
+#define QUIC_MAX_MENSAJE 500     // Capacidad de Paquete.mensaje (incluye '\0')
+#define QUIC_MAX_TEMA    50      // Tamaño máximo de un tema (incluye '\0')
+
+#define PKT_SUSCRIPCION   'S'
+#define PKT_PUBLICACION   'P'
+#define PKT_ACK           'A'
+#define PKT_RETRANSMISION 'R'
+#define PKT_RETENIDO      'V'
+#define PKT_BAJA          'U'
+#define PKT_LATIDO        'H'
+#define PKT_DATAGRAMA     'D'
+#define PKT_ALIAS         'T'
+
+#define ALIAS_PREFIJO     '#'    // "#id" en lugar del tema
+
+#define FRAGMENTO_PREFIJO   '\x1e' // Primer byte del contenido de un fragmento
+#define QUIC_MAX_FRAGMENTOS 1024    // Fragmentos por mensaje (unos 470 KB)
+#define FRAGMENTO_CABECERA  20      // "\x1e" + id + ".k/n:" como mucho (8 + 4 + 4 dígitos)
+
+/**
+ * Paquete - Unidad básica de comunicación QUIC
+ *
+ *   - seq: Número de secuencia (por tema en el broker, por cliente en el
+ *          publisher, eco en los ACKs)
+ *   - tipo: Uno de los PKT_* de arriba
+ *   - mensaje: Payload de texto terminado en '\0'
+ */
+typedef struct {
+    unsigned int seq;
+    char tipo;
+    char mensaje[QUIC_MAX_MENSAJE];
+} Paquete;
+
+#define PAQUETE_CABECERA offsetof(Paquete, mensaje)
+
+/**
+ * paquete_tam - Bytes útiles de un paquete (cabecera + texto + '\0')
+ *
+ * Enviar solo esto en lugar de sizeof(Paquete) evita mandar ~500 bytes de
+ * relleno en cada ACK o publicación corta.
+ */
+static inline int paquete_tam(const Paquete *p) {
+    size_t len = strnlen(p->mensaje, QUIC_MAX_MENSAJE - 1);
+    return (int)(PAQUETE_CABECERA + len + 1);
+}
+
+/**
+ * paquete_terminar - Garantiza que mensaje quede terminado en '\0'
+ *
+ * Debe llamarse después de recvfrom() con la cantidad de bytes recibidos,
+ * porque un paquete compacto no sobrescribe el resto del buffer.
+ *
+ * Retorna 1 si el paquete tiene al menos la cabecera completa, 0 si no.
+ */
+static inline int paquete_terminar(Paquete *p, int bytes) {
+    if (bytes < (int)PAQUETE_CABECERA) return 0;
+    int len = bytes - (int)PAQUETE_CABECERA;
+    if (len >= QUIC_MAX_MENSAJE) len = QUIC_MAX_MENSAJE - 1;
+    p->mensaje[len] = '\0';
+    return 1;
+}
+
+/**
+ * fragmento_escapar - Escribe en destino lo que quepa de datos, escapado
+ *
+ * Usa como mucho espacio bytes de destino (sin '\0'); con destino = NULL
+ * solo mide. Retorna cuántos bytes de datos entraron y deja en *escritos
+ * los bytes de destino usados.
+ */
+static inline size_t fragmento_escapar(const char *datos, size_t len, char *destino, int espacio,
+                                       int *escritos) {
+    size_t i = 0;
+    int n = 0;
+    for (; i < len; i++) {
+        char c = datos[i];
+        int doble = c == '\n' || c == '\0' || c == '\\';
+        if (n + 1 + doble > espacio) break;
+        if (destino != NULL && doble) {
+            destino[n] = '\\';
+            destino[n + 1] = c == '\n' ? 'n' : c == '\0' ? '0' : '\\';
+        } else if (destino != NULL) {
+            destino[n] = c;
+        }
+        n += 1 + doble;
+    }
+    *escritos = n;
+    return i;
+}
+
+/** fragmento_desescapar - Copia el trozo en destino sin los escapes. Retorna el largo. */
+static inline int fragmento_desescapar(const char *trozo, char *destino) {
+    int n = 0;
+    for (; *trozo != '\0'; trozo++) {
+        char c = *trozo;
+        if (c == '\\' && trozo[1] != '\0') {
+            c = *++trozo;
+            c = c == 'n' ? '\n' : c == '0' ? '\0' : c;
+        }
+        destino[n++] = c;
+    }
+    return n;
+}
+
+#endif /* PROTOCOLO_QUIC_H */
@@ -10,37 +10,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <winsock2.h>
+#include "plataforma.h"
+#include "protocolo_quic.h"   // Paquete: seq, tipo ('P'=publicación, 'A'=ACK), mensaje
 
 #define BROKER_IP "127.0.0.1"
-#define PUERTO 7000
+#define PUERTO QUIC_PUERTO
 #define TIMEOUT 2000  // 2 segundos para recibir ACK
 
-// Estructura simple de paquete QUIC
-typedef struct {
-    unsigned int seq;      // Número de secuencia
-    char tipo;             // 'P'=publicación, 'A'=ACK
-    char mensaje[500];     // Contenido del mensaje
-} Paquete;
-
 
 int main() {
-    WSADATA wsa;
     SOCKET sock;
     struct sockaddr_in broker;
     Paquete pkt, ack;
     char entrada[500];
     unsigned int seq = 1;
-    int tam_broker = sizeof(broker);
+    socklen_t tam_broker = sizeof(broker);
     
-    WSAStartup(MAKEWORD(2,2), &wsa);
+    red_iniciar();
     
     // Crear socket UDP (QUIC usa UDP como base)
     sock = socket(AF_INET, SOCK_DGRAM, 0);
     
     // Configurar timeout para esperar ACK
-    DWORD timeout = TIMEOUT;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+    red_timeout_recepcion(sock, TIMEOUT);
     
     // Dirección del broker
     broker.sin_family = AF_INET;
@@ -73,7 +65,7 @@ int main() {
         int bytes = recvfrom(sock, (char*)&ack, sizeof(Paquete), 0,
                             (struct sockaddr*)&broker, &tam_broker);
         
-        if (bytes > 0 && ack.tipo == 'A') {
+        if (paquete_terminar(&ack, bytes) && ack.tipo == 'A') {
             printf("[<-] ACK recibido: %s\n\n", ack.mensaje);
         } else {
             printf("[!] Timeout - no se recibió ACK\n\n");
@@ -81,6 +73,6 @@ int main() {
     }
     
     closesocket(sock);
-    WSACleanup();
+    red_finalizar();
     return 0;
 }
@@ -0,0 +1,734 @@
+/*
+ * ============================================================================
+ * SIMULADOR RED - Proxy UDP con pérdidas reproducibles y escenarios de
+ * recuperación para el broker QUIC
+ * ============================================================================
+ *
+ * La recuperación del broker QUIC y de cliente_sub (ACKs, 'R', reanudación,
+ * reorden) solo se había probado en loopback, donde no se pierde nada. Este
+ * programa se pone en el medio y le aplica a cada datagrama, en cada
+ * sentido:
+ *
+ *   --perdida   %   se descarta
+ *   --duplicar  %   sale dos veces
+ *   --reordenar %   se demora lo suficiente para que lo pasen los siguientes
+ *   --retardo   ms  retardo fijo
+ *   --jitter    ms  retardo extra uniforme en [0, jitter] (también reordena)
+ *   --tasa      p/s paquetes por segundo por sentido (0 = sin límite); lo
+ *                   que no sale en --cola ms se descarta, como un router
+ *   --semilla   n   semilla del generador
+ *
+ * Las decisiones salen de un generador propio (xorshift64*) con un flujo
+ * por sentido: con la misma semilla y el mismo orden de llegada se pierden,
+ * duplican y demoran exactamente los mismos paquetes, así dos estrategias
+ * de recuperación se comparan sobre la misma "red". Cada paquete consume
+ * siempre la misma cantidad de números, se descarte o no.
+ *
+ * Cada cliente que le habla al proxy (un flujo) tiene su propio socket hacia
+ * el broker, así el broker ve direcciones distintas como con clientes
+ * reales y las respuestas vuelven al cliente correcto.
+ *
+ * Modo proxy (clientes sin cambios, que apuntan al puerto 7000):
+ *   broker_quic --puerto 7001
+ *   simulador_red --escuchar 7000 --broker 127.0.0.1:7001 --perdida 5 --semilla 42
+ *   subscriber_quic / publisher_quic
+ *
+ * Modo escenarios (broker_quic ya corriendo en --broker):
+ *   simulador_red --escenarios [--mensajes 2000] [--ritmo 1000] [--reorden ms]
+ *                 [--rto ms] [--credito n] [--bytes n] [otras opciones de red]
+ *
+ * Con --bytes cada mensaje ocupa n bytes en líneas de texto (con '\n'):
+ * desde unos 450 bytes sale fragmentado y se mide el mensaje rearmado.
+ *
+ * Corre un publicador (cliente_pub) y un suscriptor (cliente_sub) dentro de
+ * este proceso, ambos a través del proxy, con 0%, 1%, 5% y 20% de pérdida
+ * (o solo la de --perdida si se indica). Por escenario informa:
+ *
+ *   - entregados / duplicados: mensajes distintos recibidos y repeticiones
+ *     (un ACK perdido hace que el publicador reenvíe el lote)
+ *   - goodput: mensajes distintos por segundo, desde la primera publicación
+ *     hasta la última entrega
+ *   - latencia p50/p99: publicación → entrega al callback
+ *   - recuperación p50/p99/máx: para cada publicación que el proxy le tiró
+ *     al suscriptor, desde esa pérdida hasta que la entrega llegó igual
+ *   - sobrecosto: 'P' que el broker le envió al suscriptor por encima de
+ *     los seq distintos, 'A', 'R' y 'S' (reanudaciones) del suscriptor, y
+ *     lotes que el publicador repitió
+ *
+ * Solo POSIX (Linux, macOS). Compilar con:
+ *   gcc -O2 src/simulador_red.c src/cliente_pub.c src/cliente_sub.c -o simulador_red
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "plataforma.h"
+#include "protocolo_quic.h"
+#include "cliente_pub.h"
+#include "cliente_sub.h"
+
+#ifdef _WIN32
+#error "simulador_red usa clock_gettime y select sobre sockets POSIX"
+#endif
+
+#define MAX_FLUJOS        64
+#define MAX_DEMORADOS     16384      // Datagramas en camino dentro del proxy
+#define TAM_DATAGRAMA     2048
+#define MAX_SEQ_SEGUIDO   65536      // Seqs de 'P' con estadística por flujo
+#define HACIA_BROKER      0
+#define HACIA_CLIENTE     1
+
+typedef struct {
+    double perdida, duplicar, reordenar;   // Probabilidades en % por paquete
+    unsigned int retardo_ms, jitter_ms;
+    unsigned int tasa;                     // Paquetes/s por sentido (0 = sin límite)
+    unsigned int cola_ms;                  // Espera máxima por el límite de tasa
+    unsigned long long semilla;
+} Impedimentos;
+
+typedef struct {
+    int activo;
+    struct sockaddr_in cliente;
+    SOCKET broker;                         // Socket propio hacia el broker
+    unsigned long long visto_ms;
+    unsigned long paquetes[2], descartados[2], duplicados[2];
+    unsigned long por_tipo[2][128];        // Paquetes que entraron al proxy, por tipo
+    unsigned long p_distintos[2];          // 'P' con seq nuevo (por sentido)
+    unsigned char *seq_visto[2];           // Bitmap de seqs 'P' ya vistos
+    unsigned long long *caida_us;          // Primera pérdida de cada seq hacia el cliente (0 = no)
+} Flujo;
+
+typedef struct {
+    unsigned long long salida_us;
+    unsigned long orden;                   // Desempate: mismo instante, orden de llegada
+    int flujo, sentido, largo;
+    char datos[TAM_DATAGRAMA];
+} Demorado;
+
+static Impedimentos red;
+static SOCKET escucha = INVALID_SOCKET;
+static struct sockaddr_in dir_broker;
+static Flujo flujos[MAX_FLUJOS];
+static Demorado *demorados[MAX_DEMORADOS];   // Heap por salida_us
+static int num_demorados = 0;
+static unsigned long orden_llegada = 0;
+static unsigned long sin_lugar = 0;          // Descartes por heap lleno
+static unsigned long long azar_estado[2];
+static unsigned long long ultima_salida_us[2];
+
+/** reloj_us - Microsegundos de un reloj monotónico */
+static unsigned long long reloj_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/** azar - Número uniforme en [0, 100) del flujo del sentido (xorshift64*) */
+static double azar(int sentido) {
+    unsigned long long x = azar_estado[sentido];
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    azar_estado[sentido] = x;
+    return (double)((x * 2685821657736338717ULL) >> 11) * (100.0 / 9007199254740992.0);
+}
+
+// ============================================================================
+// COLA DE DEMORADOS (heap por instante de salida)
+// ============================================================================
+
+static int antes(const Demorado *a, const Demorado *b) {
+    return a->salida_us < b->salida_us || (a->salida_us == b->salida_us && a->orden < b->orden);
+}
+
+static void demorar(unsigned long long salida_us, int flujo, int sentido, const char *datos, int largo) {
+    if (num_demorados == MAX_DEMORADOS) {
+        sin_lugar++;
+        return;
+    }
+    Demorado *d = malloc(sizeof(Demorado));
+    if (d == NULL) {
+        sin_lugar++;
+        return;
+    }
+    d->salida_us = salida_us;
+    d->orden = orden_llegada++;
+    d->flujo = flujo;
+    d->sentido = sentido;
+    d->largo = largo;
+    memcpy(d->datos, datos, (size_t)largo);
+
+    int i = num_demorados++;
+    while (i > 0 && antes(d, demorados[(i - 1) / 2])) {
+        demorados[i] = demorados[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    demorados[i] = d;
+}
+
+static Demorado *sacar_demorado(void) {
+    Demorado *primero = demorados[0], *ultimo = demorados[--num_demorados];
+    int i = 0;
+    while (1) {
+        int hijo = 2 * i + 1;
+        if (hijo >= num_demorados) break;
+        if (hijo + 1 < num_demorados && antes(demorados[hijo + 1], demorados[hijo])) hijo++;
+        if (!antes(demorados[hijo], ultimo)) break;
+        demorados[i] = demorados[hijo];
+        i = hijo;
+    }
+    if (num_demorados > 0) demorados[i] = ultimo;
+    return primero;
+}
+
+// ============================================================================
+// PROXY
+// ============================================================================
+
+/** proxy_iniciar - Abre el puerto de escucha (0 = uno libre) y fija la red simulada */
+static int proxy_iniciar(unsigned short puerto, const struct sockaddr_in *broker, const Impedimentos *imp) {
+    struct sockaddr_in dir;
+    int buffer = 4 << 20;
+
+    red = *imp;
+    dir_broker = *broker;
+    azar_estado[HACIA_BROKER] = imp->semilla * 2654435761ULL + 1;
+    azar_estado[HACIA_CLIENTE] = imp->semilla * 40503ULL + 0x9E3779B97F4A7C15ULL;
+    ultima_salida_us[0] = ultima_salida_us[1] = 0;
+    sin_lugar = 0;
+
+    escucha = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&dir, 0, sizeof(dir));
+    dir.sin_family = AF_INET;
+    dir.sin_addr.s_addr = INADDR_ANY;
+    dir.sin_port = htons(puerto);
+    if (escucha == INVALID_SOCKET || bind(escucha, (struct sockaddr*)&dir, sizeof(dir)) < 0) {
+        printf("[!] No se pudo abrir el puerto %d\n", puerto);
+        return -1;
+    }
+    setsockopt(escucha, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    red_no_bloqueante(escucha);
+    return 0;
+}
+
+/** proxy_puerto - Puerto donde escucha el proxy */
+static unsigned short proxy_puerto(void) {
+    struct sockaddr_in dir;
+    socklen_t largo = sizeof(dir);
+    getsockname(escucha, (struct sockaddr*)&dir, &largo);
+    return ntohs(dir.sin_port);
+}
+
+/** proxy_cerrar - Cierra todo y descarta lo que estaba en camino */
+static void proxy_cerrar(void) {
+    for (int i = 0; i < MAX_FLUJOS; i++) {
+        if (!flujos[i].activo) continue;
+        closesocket(flujos[i].broker);
+        free(flujos[i].seq_visto[0]);
+        free(flujos[i].seq_visto[1]);
+        free(flujos[i].caida_us);
+    }
+    memset(flujos, 0, sizeof(flujos));
+    while (num_demorados > 0) free(sacar_demorado());
+    if (escucha != INVALID_SOCKET) closesocket(escucha);
+    escucha = INVALID_SOCKET;
+}
+
+/**
+ * buscar_flujo - Flujo del cliente; lo crea si es nuevo
+ *
+ * Con todos los lugares ocupados se recicla el que lleva más tiempo sin
+ * tráfico (en modo proxy los clientes van y vienen).
+ */
+static int buscar_flujo(const struct sockaddr_in *cliente) {
+    int libre = -1, viejo = 0;
+    for (int i = 0; i < MAX_FLUJOS; i++) {
+        if (!flujos[i].activo) {
+            if (libre < 0) libre = i;
+            continue;
+        }
+        if (flujos[i].cliente.sin_port == cliente->sin_port &&
+            flujos[i].cliente.sin_addr.s_addr == cliente->sin_addr.s_addr) return i;
+        if (flujos[i].visto_ms < flujos[viejo].visto_ms) viejo = i;
+    }
+    if (libre < 0) {
+        libre = viejo;
+        closesocket(flujos[libre].broker);
+        free(flujos[libre].seq_visto[0]);
+        free(flujos[libre].seq_visto[1]);
+        free(flujos[libre].caida_us);
+    }
+
+    Flujo *f = &flujos[libre];
+    memset(f, 0, sizeof(*f));
+    f->broker = socket(AF_INET, SOCK_DGRAM, 0);
+    if (f->broker == INVALID_SOCKET) return -1;
+    int buffer = 4 << 20;
+    setsockopt(f->broker, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    red_no_bloqueante(f->broker);
+    f->activo = 1;
+    f->cliente = *cliente;
+    return libre;
+}
+
+/** proxy_seguir - Registra el instante de cada 'P' que se le pierde a este cliente */
+static void proxy_seguir(int flujo) {
+    if (flujos[flujo].caida_us == NULL) {
+        flujos[flujo].caida_us = calloc(MAX_SEQ_SEGUIDO, sizeof(unsigned long long));
+    }
+}
+
+/** proxy_flujo_de - Flujo del cliente con ese puerto local (-1 si todavía no habló) */
+static int proxy_flujo_de(unsigned short puerto) {
+    for (int i = 0; i < MAX_FLUJOS; i++) {
+        if (flujos[i].activo && ntohs(flujos[i].cliente.sin_port) == puerto) return i;
+    }
+    return -1;
+}
+
+/** contar - Estadística de un datagrama que entra al proxy */
+static void contar(Flujo *f, int sentido, const char *datos, int largo) {
+    Paquete pkt;
+    f->paquetes[sentido]++;
+    if (largo < (int)PAQUETE_CABECERA) return;
+    memcpy(&pkt, datos, PAQUETE_CABECERA);
+    f->por_tipo[sentido][pkt.tipo & 127]++;
+    if (pkt.tipo != PKT_PUBLICACION || pkt.seq >= MAX_SEQ_SEGUIDO) return;
+    if (f->seq_visto[sentido] == NULL) f->seq_visto[sentido] = calloc(MAX_SEQ_SEGUIDO / 8, 1);
+    if (f->seq_visto[sentido] == NULL) return;
+    unsigned char bit = (unsigned char)(1u << (pkt.seq & 7));
+    if (!(f->seq_visto[sentido][pkt.seq >> 3] & bit)) {
+        f->seq_visto[sentido][pkt.seq >> 3] |= bit;
+        f->p_distintos[sentido]++;
+    }
+}
+
+/**
+ * impedir - Aplica la red simulada a un datagrama y lo deja en camino
+ *
+ * Orden fijo de sorteos por paquete: pérdida, jitter, reorden, duplicado,
+ * jitter del duplicado.
+ */
+static void impedir(int flujo, int sentido, const char *datos, int largo) {
+    Flujo *f = &flujos[flujo];
+    unsigned long long ahora = reloj_us();
+    double r_perdida = azar(sentido), r_jitter = azar(sentido);
+    double r_reorden = azar(sentido), r_duplicar = azar(sentido), r_jitter2 = azar(sentido);
+
+    contar(f, sentido, datos, largo);
+    if (r_perdida < red.perdida) {
+        f->descartados[sentido]++;
+        if (sentido == HACIA_CLIENTE && f->caida_us != NULL && largo >= (int)PAQUETE_CABECERA &&
+            datos[offsetof(Paquete, tipo)] == PKT_PUBLICACION) {
+            unsigned int seq;
+            memcpy(&seq, datos, sizeof(seq));
+            if (seq < MAX_SEQ_SEGUIDO && f->caida_us[seq] == 0) f->caida_us[seq] = ahora;
+        }
+        return;
+    }
+
+    unsigned long long salida = ahora;
+    if (red.tasa > 0) {
+        // Cola de salida de un enlace lento: un paquete cada 1/tasa s
+        unsigned long long turno = ultima_salida_us[sentido] > ahora ? ultima_salida_us[sentido] : ahora;
+        turno += 1000000ULL / red.tasa;
+        if (turno - ahora > (unsigned long long)red.cola_ms * 1000ULL) {
+            f->descartados[sentido]++;
+            return;
+        }
+        ultima_salida_us[sentido] = turno;
+        salida = turno;
+    }
+    salida += red.retardo_ms * 1000ULL + (unsigned long long)(r_jitter / 100.0 * red.jitter_ms * 1000.0);
+    if (r_reorden < red.reordenar) {
+        salida += (2ULL * red.retardo_ms + red.jitter_ms + 1) * 1000ULL;
+    }
+    demorar(salida, flujo, sentido, datos, largo);
+    if (r_duplicar < red.duplicar) {
+        f->duplicados[sentido]++;
+        demorar(salida + (unsigned long long)(r_jitter2 / 100.0 * (red.jitter_ms + 1) * 1000.0),
+                flujo, sentido, datos, largo);
+    }
+}
+
+/** enviar_vencidos - Entrega lo que ya cumplió su retardo */
+static void enviar_vencidos(void) {
+    unsigned long long ahora = reloj_us();
+    while (num_demorados > 0 && demorados[0]->salida_us <= ahora) {
+        Demorado *d = sacar_demorado();
+        Flujo *f = &flujos[d->flujo];
+        if (f->activo) {
+            if (d->sentido == HACIA_BROKER) {
+                sendto(f->broker, d->datos, d->largo, 0, (struct sockaddr*)&dir_broker, sizeof(dir_broker));
+            } else {
+                sendto(escucha, d->datos, d->largo, 0, (struct sockaddr*)&f->cliente, sizeof(f->cliente));
+            }
+        }
+        free(d);
+    }
+}
+
+/**
+ * proxy_atender - Espera hasta espera_ms, reenvía lo que llegó y lo vencido
+ *
+ * extra: sockets del llamador que también despiertan la espera (modo
+ * escenarios: publicador y suscriptor viven en este mismo proceso).
+ */
+static void proxy_atender(unsigned int espera_ms, const SOCKET *extra, int num_extra) {
+    fd_set lectura;
+    struct timeval tv;
+    SOCKET maximo = escucha;
+    char buf[TAM_DATAGRAMA];
+    struct sockaddr_in origen;
+    socklen_t largo;
+
+    unsigned long long espera_us = espera_ms * 1000ULL;
+    if (num_demorados > 0) {
+        unsigned long long ahora = reloj_us();
+        unsigned long long falta = demorados[0]->salida_us > ahora ? demorados[0]->salida_us - ahora : 0;
+        if (falta < espera_us) espera_us = falta;
+    }
+
+    FD_ZERO(&lectura);
+    FD_SET(escucha, &lectura);
+    for (int i = 0; i < MAX_FLUJOS; i++) {
+        if (!flujos[i].activo) continue;
+        FD_SET(flujos[i].broker, &lectura);
+        if (flujos[i].broker > maximo) maximo = flujos[i].broker;
+    }
+    for (int i = 0; i < num_extra; i++) {
+        if (extra[i] == INVALID_SOCKET) continue;
+        FD_SET(extra[i], &lectura);
+        if (extra[i] > maximo) maximo = extra[i];
+    }
+    tv.tv_sec = (long)(espera_us / 1000000ULL);
+    tv.tv_usec = (long)(espera_us % 1000000ULL);
+    if (select((int)maximo + 1, &lectura, NULL, NULL, &tv) > 0) {
+        if (FD_ISSET(escucha, &lectura)) {
+            int bytes;
+            largo = sizeof(origen);
+            while ((bytes = recvfrom(escucha, buf, sizeof(buf), 0, (struct sockaddr*)&origen, &largo)) > 0) {
+                int k = buscar_flujo(&origen);
+                if (k >= 0) {
+                    flujos[k].visto_ms = reloj_ms();
+                    impedir(k, HACIA_BROKER, buf, bytes);
+                }
+                largo = sizeof(origen);
+            }
+        }
+        for (int i = 0; i < MAX_FLUJOS; i++) {
+            if (!flujos[i].activo || !FD_ISSET(flujos[i].broker, &lectura)) continue;
+            int bytes;
+            while ((bytes = recv(flujos[i].broker, buf, sizeof(buf), 0)) > 0) {
+                impedir(i, HACIA_CLIENTE, buf, bytes);
+            }
+        }
+    }
+    enviar_vencidos();
+}
+
+// ============================================================================
+// ESCENARIOS
+// ============================================================================
+
+typedef struct {
+    int mensajes;
+    unsigned int ritmo;              // Publicaciones por segundo
+    unsigned int reorden_ms, rto_ms, credito;
+    unsigned int bytes;              // Tamaño de cada mensaje (0 = solo el id)
+} OpcionesEscenario;
+
+typedef struct {
+    unsigned long long *publicado_us;   // Por id de mensaje
+    unsigned char *entregado;
+    double *latencias, *recuperaciones;
+    int entregados, duplicados, recuperados;
+    unsigned long long primera_us, ultima_us;
+    int flujo_sub;                      // Flujo del suscriptor en el proxy
+    size_t bytes;                       // Largo esperado (0 = no se revisa)
+} Medicion;
+
+static void al_recibir(void *ctx, const char *tema, unsigned int seq, const char *datos, size_t len) {
+    Medicion *m = ctx;
+    int id = atoi(datos);
+    unsigned long long ahora = reloj_us();
+    (void)tema;
+    if (id < 0 || m->publicado_us[id] == 0) return;   // Estado retenido de otra corrida
+    if (m->bytes > 0 && len != m->bytes) return;      // Mal rearmado: no cuenta como entregado
+    if (m->entregado[id]) {
+        m->duplicados++;
+        return;
+    }
+    m->entregado[id] = 1;
+    m->latencias[m->entregados++] = (ahora - m->publicado_us[id]) / 1000.0;
+    m->ultima_us = ahora;
+    if (m->flujo_sub >= 0 && seq < MAX_SEQ_SEGUIDO && flujos[m->flujo_sub].caida_us != NULL &&
+        flujos[m->flujo_sub].caida_us[seq] != 0) {
+        m->recuperaciones[m->recuperados++] = (ahora - flujos[m->flujo_sub].caida_us[seq]) / 1000.0;
+    }
+}
+
+static int comparar(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/** percentil - p en [0, 100] de un arreglo ya ordenado */
+static double percentil(const double *v, int n, double p) {
+    if (n == 0) return 0;
+    int i = (int)(p / 100.0 * (n - 1) + 0.5);
+    return v[i];
+}
+
+/** girar - Una vuelta del event loop compartido por proxy, publicador y suscriptor */
+static void girar(ClientePub *pub, ClienteSub *sub, unsigned int espera_ms) {
+    SOCKET extra[2] = {pub ? pub_socket(pub) : INVALID_SOCKET, sub_socket(sub)};
+    proxy_atender(espera_ms, extra, 2);
+    if (pub) pub_procesar(pub, 0);
+    sub_procesar(sub, 0);
+}
+
+/**
+ * escenario - Publica o->mensajes a través del proxy con la red dada y mide
+ *
+ * Cada escenario usa un tema nuevo para no heredar historial ni estado
+ * retenido de corridas anteriores contra el mismo broker.
+ */
+static int escenario(const struct sockaddr_in *broker, const Impedimentos *imp,
+                     const OpcionesEscenario *o, int numero) {
+    Medicion m;
+    char tema[QUIC_MAX_TEMA], ip[INET_ADDRSTRLEN];
+    int n = o->mensajes;
+
+    memset(&m, 0, sizeof(m));
+    m.flujo_sub = -1;
+    m.bytes = o->bytes;
+    m.publicado_us = calloc((size_t)n, sizeof(unsigned long long));
+    m.entregado = calloc((size_t)n, 1);
+    m.latencias = calloc((size_t)n, sizeof(double));
+    m.recuperaciones = calloc((size_t)n, sizeof(double));
+    char *texto = malloc(o->bytes > 16 ? o->bytes : 16);
+    if (!m.publicado_us || !m.entregado || !m.latencias || !m.recuperaciones || !texto) return -1;
+    for (unsigned int i = 0; i < o->bytes; i++) texto[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+    if (proxy_iniciar(0, broker, imp) != 0) return -1;
+    inet_ntop(AF_INET, &broker->sin_addr, ip, sizeof(ip));
+    snprintf(tema, sizeof(tema), "sim-%d-%d", (int)getpid(), numero);
+
+    ConfigSub cs;
+    sub_config_defecto(&cs, "127.0.0.1");
+    cs.puerto = proxy_puerto();
+    cs.al_recibir = al_recibir;
+    cs.ctx = &m;
+    if (o->reorden_ms) cs.reorden_ms = o->reorden_ms;
+    if (o->rto_ms) cs.rto_ms = o->rto_ms;
+    cs.credito = o->credito;
+    ClienteSub *sub = sub_crear(&cs);
+
+    ConfigPub cp;
+    pub_config_defecto(&cp, PUB_QUIC, "127.0.0.1");
+    cp.puerto = proxy_puerto();
+    ClientePub *pub = NULL;
+
+    if (sub == NULL || sub_suscribir(sub, tema) != 0) {
+        printf("[!] No se pudo crear el suscriptor\n");
+        return -1;
+    }
+    unsigned long long limite = reloj_ms() + 10000;
+    while (sub_confirmados(sub) == 0 && reloj_ms() < limite) girar(NULL, sub, 5);
+    if (sub_confirmados(sub) == 0) {
+        printf("[!] El broker %s:%d no confirmó la suscripción\n", ip, ntohs(broker->sin_port));
+        sub_destruir(sub);
+        proxy_cerrar();
+        return -1;
+    }
+    struct sockaddr_in local;
+    socklen_t largo = sizeof(local);
+    getsockname(sub_socket(sub), (struct sockaddr*)&local, &largo);
+    m.flujo_sub = proxy_flujo_de(ntohs(local.sin_port));
+    if (m.flujo_sub >= 0) proxy_seguir(m.flujo_sub);
+
+    pub = pub_crear(&cp);
+    if (pub == NULL) {
+        printf("[!] No se pudo crear el publicador\n");
+        sub_destruir(sub);
+        proxy_cerrar();
+        return -1;
+    }
+
+    // Publicar a ritmo fijo; el payload empieza con el id del mensaje
+    m.primera_us = reloj_us();
+    for (int id = 0; id < n; ) {
+        unsigned long long turno = m.primera_us + (unsigned long long)id * 1000000ULL / o->ritmo;
+        if (reloj_us() >= turno) {
+            char num[16];
+            int len = snprintf(num, sizeof(num), "%d", id);
+            memcpy(texto, num, (size_t)len);
+            if (o->bytes > (unsigned int)len) len = (int)o->bytes;
+            m.publicado_us[id] = reloj_us();
+            if (pub_publicar(pub, tema, texto, (size_t)len) > 0) {
+                id++;
+                continue;
+            }
+            m.publicado_us[id] = 0;   // Cola llena: reintentar después de procesar
+        }
+        girar(pub, sub, 1);
+    }
+    // Esperar entregas hasta 10 s sin novedades
+    unsigned long long ultimo_avance = reloj_ms();
+    int vistos = 0;
+    while (m.entregados < n && reloj_ms() - ultimo_avance < 10000) {
+        girar(pub, sub, 5);
+        if (m.entregados != vistos) {
+            vistos = m.entregados;
+            ultimo_avance = reloj_ms();
+        }
+    }
+    // Un rato más para contar duplicados y retransmisiones tardías
+    for (unsigned long long fin = reloj_ms() + 300; reloj_ms() < fin; ) girar(pub, sub, 5);
+
+    // Sobrecosto, visto en el proxy (lo que entró, antes de perderse)
+    unsigned long p_total = 0, p_distintos = 0, acks = 0, pedidos_r = 0, reanudaciones = 0;
+    unsigned long lotes = 0, lotes_distintos = 0, perdidos = 0, paquetes = 0;
+    if (m.flujo_sub >= 0) {
+        Flujo *f = &flujos[m.flujo_sub];
+        p_total = f->por_tipo[HACIA_CLIENTE][PKT_PUBLICACION];
+        p_distintos = f->p_distintos[HACIA_CLIENTE];
+        acks = f->por_tipo[HACIA_BROKER][PKT_ACK];
+        pedidos_r = f->por_tipo[HACIA_BROKER][PKT_RETRANSMISION];
+        reanudaciones = f->por_tipo[HACIA_BROKER][PKT_SUSCRIPCION];
+    }
+    for (int i = 0; i < MAX_FLUJOS; i++) {
+        if (!flujos[i].activo) continue;
+        perdidos += flujos[i].descartados[0] + flujos[i].descartados[1];
+        paquetes += flujos[i].paquetes[0] + flujos[i].paquetes[1];
+        if (i == m.flujo_sub) continue;
+        // El resto es el publicador (uno por socket si llegó a reconectar)
+        lotes += flujos[i].por_tipo[HACIA_BROKER][PKT_PUBLICACION];
+        lotes_distintos += flujos[i].p_distintos[HACIA_BROKER];
+    }
+
+    qsort(m.latencias, (size_t)m.entregados, sizeof(double), comparar);
+    qsort(m.recuperaciones, (size_t)m.recuperados, sizeof(double), comparar);
+    double segundos = m.entregados > 0 ? (m.ultima_us - m.primera_us) / 1e6 : 0;
+
+    printf("%6.1f%% %6d/%-6d %5d %9.0f %8.1f %8.1f %6d %8.1f %8.1f %8.1f %7.1f%% %6lu %6lu %5lu %6.1f%%\n",
+           imp->perdida, m.entregados, n, m.duplicados, segundos > 0 ? m.entregados / segundos : 0,
+           percentil(m.latencias, m.entregados, 50), percentil(m.latencias, m.entregados, 99),
+           m.recuperados, percentil(m.recuperaciones, m.recuperados, 50),
+           percentil(m.recuperaciones, m.recuperados, 99),
+           m.recuperados ? m.recuperaciones[m.recuperados - 1] : 0,
+           p_distintos ? 100.0 * (double)(p_total - p_distintos) / p_distintos : 0,
+           acks, pedidos_r, reanudaciones > 0 ? reanudaciones - 1 : 0,
+           lotes_distintos ? 100.0 * (double)(lotes - lotes_distintos) / lotes_distintos : 0);
+    printf("        (proxy: %lu datagramas, %lu descartados, %lu sin lugar)\n",
+           paquetes, perdidos, sin_lugar);
+
+    // Dejar pasar la baja 'U' antes de cerrar: sin ella el broker sigue
+    // enviándole al suscriptor muerto durante los escenarios siguientes
+    pub_destruir(pub);
+    sub_destruir(sub);
+    for (unsigned long long fin = reloj_ms() + 200; reloj_ms() < fin; ) proxy_atender(5, NULL, 0);
+    proxy_cerrar();
+    free(m.publicado_us);
+    free(m.entregado);
+    free(m.latencias);
+    free(m.recuperaciones);
+    free(texto);
+    return 0;
+}
+
+// ============================================================================
+// FUNCIÓN PRINCIPAL
+// ============================================================================
+
+static int leer_destino(const char *texto, struct sockaddr_in *dir) {
+    char ip[64];
+    int puerto = 0;
+    if (sscanf(texto, "%63[^:]:%d", ip, &puerto) != 2 || puerto <= 0 || puerto > 65535) return -1;
+    memset(dir, 0, sizeof(*dir));
+    dir->sin_family = AF_INET;
+    dir->sin_port = htons((unsigned short)puerto);
+    return inet_pton(AF_INET, ip, &dir->sin_addr) == 1 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    Impedimentos imp;
+    OpcionesEscenario o = {2000, 1000, 0, 0, 0, 0};
+    struct sockaddr_in broker;
+    int escuchar = QUIC_PUERTO, escenarios = 0, perdida_fija = 0;
+
+    memset(&imp, 0, sizeof(imp));
+    imp.retardo_ms = 2;
+    imp.jitter_ms = 1;
+    imp.cola_ms = 100;
+    imp.semilla = 1;
+    leer_destino("127.0.0.1:7000", &broker);
+
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--escenarios") == 0) { escenarios = 1; continue; }
+        if (v == NULL) break;
+        if (strcmp(argv[i], "--escuchar") == 0) escuchar = atoi(v);
+        else if (strcmp(argv[i], "--broker") == 0) {
+            if (leer_destino(v, &broker) != 0) {
+                printf("--broker espera ip:puerto\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--perdida") == 0) { imp.perdida = atof(v); perdida_fija = 1; }
+        else if (strcmp(argv[i], "--duplicar") == 0) imp.duplicar = atof(v);
+        else if (strcmp(argv[i], "--reordenar") == 0) imp.reordenar = atof(v);
+        else if (strcmp(argv[i], "--retardo") == 0) imp.retardo_ms = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--jitter") == 0) imp.jitter_ms = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--tasa") == 0) imp.tasa = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--cola") == 0) imp.cola_ms = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--semilla") == 0) imp.semilla = strtoull(v, NULL, 10);
+        else if (strcmp(argv[i], "--mensajes") == 0) o.mensajes = atoi(v);
+        else if (strcmp(argv[i], "--ritmo") == 0) o.ritmo = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--reorden") == 0) o.reorden_ms = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--rto") == 0) o.rto_ms = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--credito") == 0) o.credito = (unsigned int)atoi(v);
+        else if (strcmp(argv[i], "--bytes") == 0) o.bytes = (unsigned int)atoi(v);
+        else {
+            printf("Opción desconocida: %s\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+    if (o.mensajes <= 0 || o.ritmo == 0) {
+        printf("--mensajes y --ritmo deben ser mayores a 0\n");
+        return 1;
+    }
+    red_iniciar();
+
+    if (!escenarios) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &broker.sin_addr, ip, sizeof(ip));
+        if (proxy_iniciar((unsigned short)escuchar, &broker, &imp) != 0) return 1;
+        printf("=== SIMULADOR RED: :%d -> %s:%d ===\n", escuchar, ip, ntohs(broker.sin_port));
+        printf("pérdida %.1f%%, duplicado %.1f%%, reorden %.1f%%, retardo %u+%u ms, tasa %u p/s, semilla %llu\n",
+               imp.perdida, imp.duplicar, imp.reordenar, imp.retardo_ms, imp.jitter_ms, imp.tasa, imp.semilla);
+        fflush(stdout);
+        while (1) proxy_atender(100, NULL, 0);
+    }
+
+    static const double perdidas[] = {0, 1, 5, 20};
+    int cantidad = perdida_fija ? 1 : (int)(sizeof(perdidas) / sizeof(perdidas[0]));
+    if (o.bytes > 0) printf("=== Mensajes de %u bytes ===\n", o.bytes);
+    printf("=== ESCENARIOS: %d mensajes a %u/s, retardo %u+%u ms, duplicado %.1f%%, reorden %.1f%%, semilla %llu ===\n\n",
+           o.mensajes, o.ritmo, imp.retardo_ms, imp.jitter_ms, imp.duplicar, imp.reordenar, imp.semilla);
+    printf("%7s %13s %5s %9s %8s %8s %6s %8s %8s %8s %8s %6s %6s %5s %7s\n",
+           "pérdida", "entregados", "dup", "goodput/s", "lat p50", "lat p99",
+           "recup", "rec p50", "rec p99", "rec máx", "P extra", "A", "R", "S", "lotes+");
+    for (int i = 0; i < cantidad; i++) {
+        if (!perdida_fija) imp.perdida = perdidas[i];
+        if (escenario(&broker, &imp, &o, i) != 0) return 1;
+    }
+    printf("\nLatencias en ms. recup = publicaciones que el proxy le tiró al suscriptor\n"
+           "y llegaron igual; P extra = 'P' repetidas del broker sobre las distintas;\n"
+           "A / R / S = ACKs, retransmisiones y reanudaciones del suscriptor;\n"
+           "lotes+ = lotes repetidos por el publicador.\n");
+    return 0;
+}
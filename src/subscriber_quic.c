@@ -1,210 +1,290 @@
 /*
  * SUBSCRIBER QUIC - Suscriptor con protocolo híbrido
- * 
+ *
  * Características QUIC:
  * - Recibe por UDP (sin conexión persistente)
  * - Verifica números de secuencia para detectar pérdidas
  * - Envía ACKs para confirmar recepción (confiabilidad)
+ *
+ * La recepción, los ACKs y las solicitudes de retransmisión los hace la
+ * librería cliente_sub: este programa solo lee los temas y muestra lo que
+ * llega. Compilar con:
+ *   gcc src/subscriber_quic.c src/cliente_sub.c -o subscriber_quic.exe -lws2_32
+ *
+ * Reanudación: con subscriber_quic.exe <archivo> se guarda ahí el último
+ * seq recibido de cada tema. Al volver a abrirlo con el mismo archivo, el
+ * broker reenvía lo que se publicó mientras estaba cerrado.
+ *
+ * Local: con --local (en la misma máquina que un broker_quic --local) los
+ * mensajes se leen de los anillos en memoria compartida del broker en vez
+ * de la red. Sin suscripción, ACKs ni retransmisiones; si el lector se
+ * atrasa más que el anillo, se avisa cuántos se perdieron. Solo POSIX.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <winsock2.h>
-#include <windows.h>
+#include <signal.h>
+#include "cliente_sub.h"
+#include "memoria_local.h"
 
 #define BROKER_IP "127.0.0.1"
 #define PUERTO 7000
-#define TIMEOUT 5000  // Timeout general en ms
+#define ESPERA_CONFIRMACION 5000  // ms máximos esperando los ACK de suscripción
+#define MAX_TEMAS 64
 
-// Estructura simple de paquete QUIC
-typedef struct {
-    unsigned int seq;      // Número de secuencia
-    char tipo;             // 'S'=suscripción, 'P'=publicación, 'A'=ACK, 'R'=retransmisión
-    char mensaje[500];     // Contenido del mensaje
-} Paquete;
-
-// Estructura para rastrear secuencias por tema
+// Último seq recibido por tema (lo que se guarda en el archivo de estado)
 typedef struct {
     char tema[50];
-    unsigned int ultimo_seq;
-} SecuenciaTema;
-
-int main() {
-    WSADATA wsa;
-    SOCKET sock;
-    struct sockaddr_in broker;
-    Paquete pkt, ack;
-    char input[200];
-    char tema[50];
-    int tam_broker = sizeof(broker);
-    int num_temas = 0;
-    int bytes;
-    SecuenciaTema temas_suscritos[10];  // Hasta 10 temas
-    memset(temas_suscritos, 0, sizeof(temas_suscritos));
-    
-    WSAStartup(MAKEWORD(2,2), &wsa);
-    
-    // Crear socket UDP (QUIC usa UDP como base)
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    
-    // Dirección del broker
-    broker.sin_family = AF_INET;
-    broker.sin_addr.s_addr = inet_addr(BROKER_IP);
-    broker.sin_port = htons(PUERTO);
-    
-    printf("=== SUBSCRIBER QUIC ===\n");
-    printf("Broker: %s:%d\n\n", BROKER_IP, PUERTO);
-    
-    // Suscribirse a múltiples temas
+    unsigned int seq;
+} Progreso;
+
+volatile sig_atomic_t activo = 1;
+
+// Ctrl+C: salir del bucle para que sub_destruir() envíe la baja de los temas
+void detener(int sig) {
+    (void)sig;
+    activo = 0;
+}
+
+Progreso progreso[MAX_TEMAS];
+int num_progreso = 0;
+int progreso_cambio = 0;
+
+// Busca (o agrega) el progreso de un tema
+Progreso *buscar_progreso(const char *tema) {
+    for (int i = 0; i < num_progreso; i++) {
+        if (strcmp(progreso[i].tema, tema) == 0) return &progreso[i];
+    }
+    if (num_progreso == MAX_TEMAS) return NULL;
+    strncpy(progreso[num_progreso].tema, tema, sizeof(progreso[0].tema) - 1);
+    progreso[num_progreso].seq = 0;
+    return &progreso[num_progreso++];
+}
+
+// Archivo de estado: una línea "seq tema" por tema
+void cargar_progreso(const char *archivo) {
+    char linea[100];
+    FILE *f = fopen(archivo, "r");
+    if (f == NULL) return;
+    while (fgets(linea, sizeof(linea), f) != NULL) {
+        unsigned int seq;
+        int desde = 0;
+        linea[strcspn(linea, "\n")] = '\0';
+        if (sscanf(linea, "%u %n", &seq, &desde) == 1 && linea[desde] != '\0') {
+            Progreso *p = buscar_progreso(linea + desde);
+            if (p != NULL) p->seq = seq;
+        }
+    }
+    fclose(f);
+}
+
+void guardar_progreso(const char *archivo) {
+    FILE *f = fopen(archivo, "w");
+    if (f == NULL) return;
+    for (int i = 0; i < num_progreso; i++) {
+        if (progreso[i].seq > 0) fprintf(f, "%u %s\n", progreso[i].seq, progreso[i].tema);
+    }
+    fclose(f);
+    progreso_cambio = 0;
+}
+
+// Muestra cada mensaje CON EL TEMA (los punteros apuntan al buffer de recepción)
+void mostrar_mensaje(void *ctx, const char *tema, unsigned int seq,
+                     const char *datos, size_t len) {
+    (void)ctx;
+    printf("[RX] [%s] seq=%u: %.*s\n", tema, seq, (int)len, datos);
+
+    Progreso *p = buscar_progreso(tema);
+    if (p != NULL && seq > p->seq) {
+        p->seq = seq;
+        progreso_cambio = 1;
+    }
+}
+
+// Lee los temas separados por comas (sin espacios al inicio de cada uno)
+int leer_temas(char *input, size_t tam, char *temas[], int max) {
+    int n = 0;
     printf("Ingrese temas separados por comas (ej: Colombia vs Argentina, Brasil vs Uruguay)\n");
     printf("O un solo tema (ej: Colombia vs Argentina): ");
-    fgets(input, sizeof(input), stdin);
+    if (fgets(input, (int)tam, stdin) == NULL) return 0;
     input[strcspn(input, "\n")] = '\0';
-    
-    // Procesar y enviar cada suscripción
-    char *token = strtok(input, ",");
-    while (token != NULL) {
-        // Eliminar espacios al inicio
+    for (char *token = strtok(input, ","); token != NULL && n < max; token = strtok(NULL, ",")) {
         while (*token == ' ') token++;
-        
-        // Copiar tema limpio
-        strcpy(tema, token);
-        
-        // Guardar tema en la lista de suscritos
-        strcpy(temas_suscritos[num_temas].tema, tema);
-        temas_suscritos[num_temas].ultimo_seq = 0;
-        
-        // Enviar suscripción (sin conexión previa - característica UDP)
-        pkt.seq = num_temas + 1;
-        pkt.tipo = 'S';
-        strcpy(pkt.mensaje, tema);
-        
-        printf("[->] Enviando suscripción a '%s'...\n", tema);
-        sendto(sock, (char*)&pkt, sizeof(Paquete), 0,
-               (struct sockaddr*)&broker, sizeof(broker));
-        
-        // Esperar ACK de confirmación
-        bytes = recvfrom(sock, (char*)&ack, sizeof(Paquete), 0,
-                        (struct sockaddr*)&broker, &tam_broker);
-        
-        if (bytes > 0 && ack.tipo == 'A') {
-            printf("[<-] Confirmación: %s\n", ack.mensaje);
-        }
-        
-        num_temas++;
-        token = strtok(NULL, ",");
+        if (*token != '\0') temas[n++] = token;
     }
-    
-    printf("\nSuscrito a %d tema(s). Esperando mensajes...\n", num_temas);
+    return n;
+}
+
+// Modo --local: lee los anillos del broker en memoria compartida. Los
+// anillos que todavía no existen (tema sin publicaciones) se reintentan, y
+// si el broker se reinicia se vuelven a abrir.
+int recibir_local(const char *archivo_estado) {
+    char input[200], prefijo[32], datos[LOCAL_MAX_DATOS];
+    char *temas[MAX_TEMAS];
+    CursorLocal cursores[MAX_TEMAS];
+    unsigned long long perdidos_vistos[MAX_TEMAS];
+    int esperando[MAX_TEMAS];          // El anillo no existía: leerlo desde el principio
+    ZonaLocal *zona = NULL;
+
+#ifdef _WIN32
+    (void)archivo_estado;
+    printf("--local usa memoria compartida POSIX: no está disponible en Windows.\n");
+    return 1;
+#endif
+    snprintf(prefijo, sizeof(prefijo), "/pubsub-quic-%d", PUERTO);
+    printf("=== SUBSCRIBER QUIC (local) ===\n");
+    printf("Anillos: %s-*\n\n", prefijo);
+    if (archivo_estado != NULL) cargar_progreso(archivo_estado);
+    int num_temas = leer_temas(input, sizeof(input), temas, MAX_TEMAS);
+    memset(cursores, 0, sizeof(cursores));
+    memset(esperando, 0, sizeof(esperando));
+
+    printf("\nLeyendo %d tema(s) de la memoria compartida...\n", num_temas);
     printf("(Presiona Ctrl+C para salir)\n\n");
-    
-    // Bucle para recibir publicaciones
-    while (1) {
-        bytes = recvfrom(sock, (char*)&pkt, sizeof(Paquete), 0,
-                        (struct sockaddr*)&broker, &tam_broker);
-        
-        if (bytes > 0 && pkt.tipo == 'P') {
-            // Extraer el tema del mensaje (formato: "Tema:Mensaje")
-            char tema_msg[50] = {0};
-            char contenido[500] = {0};
-            char *separador = strchr(pkt.mensaje, ':');
-            
-            if (separador != NULL) {
-                int len_tema = separador - pkt.mensaje;
-                strncpy(tema_msg, pkt.mensaje, len_tema);
-                tema_msg[len_tema] = '\0';
-                strcpy(contenido, separador + 1);
-            } else {
-                strcpy(contenido, pkt.mensaje);
-            }
-            
-            // Buscar el tema en la lista de suscritos
-            int tema_encontrado = -1;
+    unsigned long long guardado_ms = 0;
+    signal(SIGINT, detener);
+    while (activo) {
+        if (zona != NULL && local_zona_reemplazada(zona)) {
+            printf("[!] El broker se reinició: volviendo a abrir los anillos\n");
             for (int i = 0; i < num_temas; i++) {
-                if (strcmp(temas_suscritos[i].tema, tema_msg) == 0) {
-                    tema_encontrado = i;
-                    break;
-                }
+                local_cursor_cerrar(&cursores[i]);
+                esperando[i] = 1;
             }
-            
-            // Solo procesar si estamos suscritos a este tema
-            if (tema_encontrado >= 0) {
-                unsigned int ultimo_seq_tema = temas_suscritos[tema_encontrado].ultimo_seq;
-                
-                // Verificar secuencia para detectar pérdidas SOLO en este tema
-                if (ultimo_seq_tema > 0 && pkt.seq != ultimo_seq_tema + 1) {
-                    // RETRANSMISIÓN: Solicitar paquetes perdidos
-                    for (unsigned int seq_perdido = ultimo_seq_tema + 1; seq_perdido < pkt.seq; seq_perdido++) {
-                        printf("[!] Pérdida detectada en '%s' - solicitando retransmisión de seq=%u\n", 
-                               tema_msg, seq_perdido);
-                        
-                        // Solicitar retransmisión - INCLUIR EL TEMA ESPERADO
-                        Paquete retrans_req;
-                        retrans_req.seq = seq_perdido;
-                        retrans_req.tipo = 'R';  // Tipo Retransmisión
-                        sprintf(retrans_req.mensaje, "%s", tema_msg);  // Enviar tema esperado
-                        
-                        sendto(sock, (char*)&retrans_req, sizeof(Paquete), 0,
-                               (struct sockaddr*)&broker, sizeof(broker));
-                        
-                        // Esperar retransmisión (timeout corto)
-                        DWORD timeout_original = TIMEOUT;
-                        DWORD timeout_retrans = 500;  // 500ms para retransmisión
-                        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout_retrans, sizeof(timeout_retrans));
-                        
-                        int bytes_retrans = recvfrom(sock, (char*)&ack, sizeof(Paquete), 0,
-                                                    (struct sockaddr*)&broker, &tam_broker);
-                        
-                        if (bytes_retrans > 0 && ack.tipo == 'P' && ack.seq == seq_perdido) {
-                            // Extraer contenido del mensaje retransmitido
-                            char *sep_retrans = strchr(ack.mensaje, ':');
-                            char contenido_retrans[500];
-                            if (sep_retrans != NULL) {
-                                strcpy(contenido_retrans, sep_retrans + 1);
-                            } else {
-                                strcpy(contenido_retrans, ack.mensaje);
-                            }
-                            
-                            printf("[<-] RETRANSMITIDO [%s] seq=%u: %s\n", 
-                                   tema_msg, ack.seq, contenido_retrans);
-                            
-                            // Enviar ACK
-                            Paquete ack_retrans;
-                            ack_retrans.seq = ack.seq;
-                            ack_retrans.tipo = 'A';
-                            strcpy(ack_retrans.mensaje, "OK");
-                            sendto(sock, (char*)&ack_retrans, sizeof(Paquete), 0,
-                                   (struct sockaddr*)&broker, sizeof(broker));
-                        } else {
-                            printf("[!] No se pudo recuperar seq=%u de '%s'\n", seq_perdido, tema_msg);
-                        }
-                        
-                        // Restaurar timeout original
-                        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout_original, sizeof(timeout_original));
-                    }
+            local_zona_cerrar(zona);
+            zona = NULL;
+        }
+        if (zona == NULL && (zona = local_zona_abrir(prefijo)) == NULL) {
+            for (int i = 0; i < num_temas; i++) esperando[i] = 1;
+            struct timeval pausa = {0, 200000};   // Broker sin --local (todavía)
+            select(0, NULL, NULL, NULL, &pausa);
+            continue;
+        }
+        unsigned int aviso = local_aviso(zona);   // Antes de revisar los anillos
+        int leidos = 0;
+        for (int i = 0; i < num_temas; i++) {
+            if (cursores[i].anillo == NULL) {
+                if (local_cursor_abrir(&cursores[i], zona, prefijo, temas[i], esperando[i]) != 0) {
+                    esperando[i] = 1;
+                    continue;
                 }
-                
-                // Mostrar mensaje recibido CON EL TEMA
-                printf("[RX] [%s] seq=%u: %s\n", tema_msg, pkt.seq, contenido);
-                
-                // Actualizar última secuencia de ESTE tema
-                temas_suscritos[tema_encontrado].ultimo_seq = pkt.seq;
-                
-                // Enviar ACK al broker (confirmar recepción)
-                ack.seq = pkt.seq;
-                ack.tipo = 'A';
-                strcpy(ack.mensaje, "OK");
-                sendto(sock, (char*)&ack, sizeof(Paquete), 0,
-                       (struct sockaddr*)&broker, sizeof(broker));
+                perdidos_vistos[i] = 0;
+                printf("[<-] Anillo de '%s' abierto\n", temas[i]);
+            }
+            unsigned int seq;
+            int n;
+            while ((n = local_leer(&cursores[i], &seq, datos, sizeof(datos))) > 0) {
+                mostrar_mensaje(NULL, temas[i], seq, datos, (size_t)n);
+                leidos++;
+            }
+            if (n < 0) {
+                local_cursor_cerrar(&cursores[i]);   // Anillo reemplazado: el nuevo es todo posterior
+                esperando[i] = 1;
             }
-            // Si no estamos suscritos, simplemente ignoramos el mensaje
+            else if (cursores[i].perdidos != perdidos_vistos[i]) {
+                printf("[!] '%s': %llu mensaje(s) sobrescritos antes de leerlos\n", temas[i],
+                       cursores[i].perdidos - perdidos_vistos[i]);
+                perdidos_vistos[i] = cursores[i].perdidos;
+            }
+        }
+        if (archivo_estado != NULL && progreso_cambio && reloj_ms() - guardado_ms >= 1000) {
+            guardar_progreso(archivo_estado);
+            guardado_ms = reloj_ms();
         }
-        
-        Sleep(50);  // Pequeña pausa para no saturar CPU
+        fflush(stdout);
+        if (leidos == 0) local_dormir(zona, aviso, 200);
     }
-    
-    closesocket(sock);
-    WSACleanup();
+    if (archivo_estado != NULL) guardar_progreso(archivo_estado);
+    for (int i = 0; i < num_temas; i++) local_cursor_cerrar(&cursores[i]);
+    local_zona_cerrar(zona);
+    return 0;
+}
+
+// Avisa cuando se detecta un salto de secuencia (la librería ya pidió el 'R')
+void mostrar_perdida(void *ctx, const char *tema, unsigned int seq) {
+    (void)ctx;
+    printf("[!] Pérdida detectada en '%s' - solicitando retransmisión de seq=%u\n", tema, seq);
+}
+
+// Uso: subscriber_quic.exe [archivo_estado] [--local]
+int main(int argc, char *argv[]) {
+    const char *archivo_estado = NULL;
+    ConfigSub cfg;
+    char input[200];
+    char *temas[MAX_TEMAS];
+    int num_temas = 0, local = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--local") == 0) local = 1;
+        else archivo_estado = argv[i];
+    }
+    if (local) return recibir_local(archivo_estado);
+
+    sub_config_defecto(&cfg, BROKER_IP);
+    cfg.puerto = PUERTO;
+    cfg.al_recibir = mostrar_mensaje;
+    cfg.al_perdida = mostrar_perdida;
+
+    ClienteSub *cliente = sub_crear(&cfg);
+    if (cliente == NULL) {
+        printf("No se pudo crear el socket del subscriber.\n");
+        return 1;
+    }
+
+    printf("=== SUBSCRIBER QUIC ===\n");
+    printf("Broker: %s:%d\n", BROKER_IP, PUERTO);
+    if (archivo_estado != NULL) {
+        cargar_progreso(archivo_estado);
+        printf("Estado: %s (%d tema(s) con progreso guardado)\n", archivo_estado, num_progreso);
+    }
+    printf("\n");
+
+    // Suscribirse a múltiples temas; cada suscripción va por el mismo socket
+    int pedidos = leer_temas(input, sizeof(input), temas, MAX_TEMAS);
+    for (int t = 0; t < pedidos; t++) {
+        const char *token = temas[t];
+
+        // Si hay progreso guardado del tema, reanudar desde ahí
+        Progreso *p = archivo_estado != NULL ? buscar_progreso(token) : NULL;
+        unsigned int desde = p != NULL ? p->seq : 0;
+        if (desde > 0) {
+            printf("[->] Reanudando '%s' después de seq=%u...\n", token, desde);
+        } else {
+            printf("[->] Enviando suscripción a '%s'...\n", token);
+        }
+        if (sub_suscribir_desde(cliente, token, desde) == 0) {
+            num_temas++;
+        } else {
+            printf("[!] Tema inválido: '%s'\n", token);
+        }
+    }
+
+    // Esperar las confirmaciones (la librería reenvía 'S' si no llega el ACK)
+    unsigned long long inicio = reloj_ms();
+    while (sub_confirmados(cliente) < num_temas && reloj_ms() - inicio < ESPERA_CONFIRMACION) {
+        sub_procesar(cliente, 50);
+    }
+    printf("[<-] Confirmación: %d de %d tema(s)\n", sub_confirmados(cliente), num_temas);
+
+    printf("\nSuscrito a %d tema(s). Esperando mensajes...\n", num_temas);
+    printf("(Presiona Ctrl+C para salir)\n\n");
+
+    // Bucle de recepción: sub_procesar espera hasta que haya datos y entrega
+    // toda la ráfaga disponible de una vez (sin pausas entre mensajes). El
+    // progreso se guarda como mucho una vez por segundo.
+    unsigned long long guardado_ms = 0;
+    signal(SIGINT, detener);
+    while (activo) {
+        sub_procesar(cliente, 1000);
+        if (archivo_estado != NULL && progreso_cambio && reloj_ms() - guardado_ms >= 1000) {
+            guardar_progreso(archivo_estado);
+            guardado_ms = reloj_ms();
+        }
+        fflush(stdout);
+    }
+
+    if (archivo_estado != NULL) guardar_progreso(archivo_estado);
+    printf("\nEnviando baja de %d tema(s)...\n", num_temas);
+    sub_destruir(cliente);
     return 0;
 }
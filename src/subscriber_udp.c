@@ -6,11 +6,85 @@
 // arpa/inet.h sirve para inet_addr() y htons(), que convierten direcciones y puertos
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/select.h>
 
 #define BROKER_IP "127.0.0.1" // IP del broker (local)
 #define BROKER_PORT 8080 // Puerto del broker
 #define LOCAL_PORT 0 // el sistema elige el puerto local
 #define MAX_MSG 512 // Máximo tamaño del mensaje
+#define HEARTBEAT_INTERVAL 10 // Segundos entre PING (el broker expira a los 30)
+#define MAX_NACK 32 // Seqs faltantes que se piden como máximo por salto
+#define SEEN_WINDOW 64 // Seqs multicast recientes recordados para descartar duplicados
+
+volatile sig_atomic_t running = 1;
+
+// Estado del modo multicast (el broker avisa con "MULTICAST:grupo:puerto")
+int mcast_sock = -1;
+unsigned int last_seq = 0; // Mayor seq recibido del grupo
+unsigned int seen[SEEN_WINDOW]; // seen[s % SEEN_WINDOW] == s si ya se mostró
+
+// Se une al grupo multicast del tema con un segundo socket
+void join_group(char *notice) {
+    char group[32];
+    int port;
+    if (mcast_sock >= 0 || sscanf(notice, "MULTICAST:%31[^:]:%d", group, &port) != 2) return;
+
+    mcast_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int yes = 1; // Varios suscriptores en la misma máquina comparten el puerto
+    setsockopt(mcast_sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, group, &addr.sin_addr); // Solo datagramas de este grupo
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = addr.sin_addr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    if (bind(mcast_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(mcast_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        perror("No se pudo unir al grupo multicast");
+        close(mcast_sock);
+        mcast_sock = -1;
+        return;
+    }
+    printf("[Multicast] Unido al grupo %s:%d\n", group, port);
+}
+
+// "SEQ:n:mensaje" (por el grupo o reenviado por NACK): pide los seqs que
+// faltan antes de n y descarta los que ya se mostraron
+void handle_seq(int sock, struct sockaddr_in *broker_addr, char *topic, char *packet) {
+    char *end;
+    unsigned int seq = (unsigned int)strtoul(packet + 4, &end, 10);
+    if (*end != ':' || seq == 0) return;
+    if (seen[seq % SEEN_WINDOW] == seq) return; // Duplicado
+
+    if (last_seq > 0 && seq > last_seq + 1) {
+        unsigned int from = seq - last_seq - 1 > MAX_NACK ? seq - MAX_NACK : last_seq + 1;
+        char nack[100];
+        for (unsigned int s = from; s < seq; s++) {
+            snprintf(nack, sizeof(nack), "NACK:%s:%u", topic, s);
+            sendto(sock, nack, strlen(nack), 0,
+                   (struct sockaddr *)broker_addr, sizeof(*broker_addr));
+        }
+        printf("[Multicast] Faltan %u mensaje(s) antes de seq %u, NACK enviado\n",
+               seq - from, seq);
+    }
+    seen[seq % SEEN_WINDOW] = seq;
+    if (seq > last_seq) {
+        printf("[Mensaje recibido] %s\n", end + 1);
+        last_seq = seq;
+    } else {
+        printf("[Mensaje recuperado] %s\n", end + 1);
+    }
+}
+
+// Ctrl+C: salir del bucle para enviar la baja antes de cerrar
+void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
 
 int main() {
     int sock;
@@ -53,17 +127,71 @@ int main() {
 
     printf("Suscrito al tema: '%s'. Esperando mensajes...\n", topic);
 
-    while (1) {
-        // Esperar mensajes del broker
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop; // Sin SA_RESTART: select() se interrumpe
+    sigaction(SIGINT, &action, NULL);
+    time_t last_ping = time(NULL);
+
+    while (running) {
+        if (time(NULL) - last_ping >= HEARTBEAT_INTERVAL) {
+            sendto(sock, "PING", 4, 0, (struct sockaddr *)&broker_addr, sizeof(broker_addr));
+            last_ping = time(NULL);
+        }
+
+        // Esperar mensajes del broker o del grupo multicast. select() vuelve
+        // cada HEARTBEAT_INTERVAL aunque no llegue nada, para poder enviar el
+        // latido que mantiene viva la suscripción
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(sock, &readfds);
+        int maxfd = sock;
+        if (mcast_sock >= 0) {
+            FD_SET(mcast_sock, &readfds);
+            if (mcast_sock > maxfd) maxfd = mcast_sock;
+        }
+        struct timeval timeout = {HEARTBEAT_INTERVAL, 0};
+        if (select(maxfd + 1, &readfds, NULL, NULL, &timeout) <= 0) continue;
+
+        if (mcast_sock >= 0 && FD_ISSET(mcast_sock, &readfds)) {
+            int bytes = recvfrom(mcast_sock, buffer, sizeof(buffer) - 1, 0, NULL, NULL);
+            if (bytes > 0) {
+                buffer[bytes] = '\0';
+                if (strncmp(buffer, "SEQ:", 4) == 0)
+                    handle_seq(sock, &broker_addr, topic, buffer);
+            }
+        }
+        if (!FD_ISSET(sock, &readfds)) continue;
+
         int bytes = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
                              NULL, NULL);
         if (bytes > 0) {
             buffer[bytes] = '\0';
-            // Mostrar mensaje recibido
-            printf("[Mensaje recibido] %s\n", buffer);
+            if (strncmp(buffer, "MULTICAST:", 10) == 0) {
+                join_group(buffer);
+                continue;
+            }
+            if (strncmp(buffer, "SEQ:", 4) == 0) { // Respuesta a un NACK
+                handle_seq(sock, &broker_addr, topic, buffer);
+                continue;
+            }
+            // Mostrar mensaje recibido (el estado retenido llega como
+            // varios mensajes en un solo datagrama, uno por línea)
+            char *line = strtok(buffer, "\n");
+            while (line != NULL) {
+                printf("[Mensaje recibido] %s\n", line);
+                line = strtok(NULL, "\n");
+            }
         }
     }
 
+    // Baja explícita: el broker deja de enviar sin esperar la expiración
+    snprintf(sub_msg, sizeof(sub_msg), "UNSUBSCRIBE:%s", topic);
+    sendto(sock, sub_msg, strlen(sub_msg), 0,
+           (struct sockaddr *)&broker_addr, sizeof(broker_addr));
+    printf("\nBaja enviada para el tema: '%s'\n", topic);
+
+    if (mcast_sock >= 0) close(mcast_sock);
     close(sock);
     return 0;
 }
@@ -0,0 +1,190 @@
+/*
+ * ============================================================================
+ * TABLAS - Columnas en slabs y temas internados
+ * ============================================================================
+ *
+ * Los brokers guardaban suscripciones y temas como arreglos de structs con
+ * el nombre del tema adentro ("char tema[50]" + dirección + contadores):
+ * para encontrar a los suscriptores de un tema había que recorrer cientos
+ * de bytes por entrada y comparar texto, y las tablas tenían un tope fijo
+ * (MAX_SUBS, 50 temas).
+ *
+ * Ahora cada campo vive en su propio arreglo (struct-of-arrays):
+ *
+ *   - Columna: arreglo de elementos de un mismo tipo que crece de a slabs
+ *     de TABLA_SLAB elementos. Un slab nunca se mueve (los punteros siguen
+ *     válidos, no hay realloc) y no hay máximo salvo la memoria.
+ *   - TablaTemas: interna cada nombre de tema en un id denso (0, 1, 2...)
+ *     con un índice hash. El resto del estado por tema (secuencias, etc.)
+ *     lo guarda cada broker en columnas indexadas por ese id.
+ *
+ * Así el fan-out de una publicación compara un entero de 4 bytes por
+ * suscriptor (columna_proximo) y solo toca la dirección de los que
+ * coinciden.
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef TABLAS_H
+#define TABLAS_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLA_SLAB_BITS  8
+#define TABLA_SLAB       (1 << TABLA_SLAB_BITS)   // Elementos por slab
+#define TABLA_MAX_TEMA   50                       // Largo máximo de un tema (incluye '\0')
+
+typedef struct {
+    char **slabs;
+    int num_slabs;
+    size_t tam;                     // Bytes por elemento
+} Columna;
+
+/** COLUMNA - Elemento i de la columna, como lvalue del tipo indicado */
+#define COLUMNA(c, tipo, i) \
+    (((tipo *)(c).slabs[(i) >> TABLA_SLAB_BITS])[(i) & (TABLA_SLAB - 1)])
+
+/** columna_en - Dirección del elemento i (para elementos que no son escalares) */
+static inline void *columna_en(const Columna *c, int i) {
+    return c->slabs[i >> TABLA_SLAB_BITS] + (size_t)(i & (TABLA_SLAB - 1)) * c->tam;
+}
+
+/** columna_iniciar - Columna vacía de elementos de tam bytes */
+static inline void columna_iniciar(Columna *c, size_t tam) {
+    c->slabs = NULL;
+    c->num_slabs = 0;
+    c->tam = tam;
+}
+
+/**
+ * columna_asegurar - Reserva slabs hasta que quepan n elementos
+ *
+ * Los slabs nuevos llegan en cero. Retorna 0 si OK, -1 sin memoria (la
+ * columna queda como estaba).
+ */
+static inline int columna_asegurar(Columna *c, int n) {
+    int necesarios = (n + TABLA_SLAB - 1) >> TABLA_SLAB_BITS;
+    if (necesarios <= c->num_slabs) return 0;
+    char **slabs = realloc(c->slabs, sizeof(char *) * (size_t)necesarios);
+    if (slabs == NULL) return -1;
+    c->slabs = slabs;
+    while (c->num_slabs < necesarios) {
+        c->slabs[c->num_slabs] = calloc(TABLA_SLAB, c->tam);
+        if (c->slabs[c->num_slabs] == NULL) return -1;
+        c->num_slabs++;
+    }
+    return 0;
+}
+
+/** columna_liberar - Libera todos los slabs */
+static inline void columna_liberar(Columna *c) {
+    for (int i = 0; i < c->num_slabs; i++) free(c->slabs[i]);
+    free(c->slabs);
+    columna_iniciar(c, c->tam);
+}
+
+/**
+ * columna_proximo - Primer i en [desde, n) con valor en una columna de
+ * unsigned int, o -1
+ *
+ * Recorre slab por slab sobre memoria contigua: es el bucle del fan-out.
+ */
+static inline int columna_proximo(const Columna *c, int n, unsigned int valor, int desde) {
+    while (desde < n) {
+        const unsigned int *v = (const unsigned int *)c->slabs[desde >> TABLA_SLAB_BITS];
+        int fin = (desde | (TABLA_SLAB - 1)) + 1;
+        if (fin > n) fin = n;
+        for (; desde < fin; desde++) {
+            if (v[desde & (TABLA_SLAB - 1)] == valor) return desde;
+        }
+    }
+    return -1;
+}
+
+// ============================================================================
+// TEMAS INTERNADOS
+// ============================================================================
+
+typedef struct {
+    Columna nombre;                 // char[TABLA_MAX_TEMA] por id (frío: solo para logs y réplica)
+    Columna hash;                   // unsigned int por id (para crecer el índice sin rehashear texto)
+    int cantidad;
+    int *indice;                    // Direccionamiento abierto: id + 1 (0 = libre)
+    int capacidad;                  // Potencia de 2, al menos el doble de cantidad
+} TablaTemas;
+
+/** tabla_hash - FNV-1a del nombre */
+static inline unsigned int tabla_hash(const char *s) {
+    unsigned int h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/** temas_iniciar - Tabla vacía */
+static inline void temas_iniciar(TablaTemas *t) {
+    memset(t, 0, sizeof(*t));
+    columna_iniciar(&t->nombre, TABLA_MAX_TEMA);
+    columna_iniciar(&t->hash, sizeof(unsigned int));
+}
+
+/** tema_nombre - Nombre del tema id (válido mientras exista la tabla) */
+static inline const char *tema_nombre(const TablaTemas *t, int id) {
+    return columna_en(&t->nombre, id);
+}
+
+/** tema_buscar - Id del tema, o -1 si nunca se internó */
+static inline int tema_buscar(const TablaTemas *t, const char *nombre) {
+    if (t->capacidad == 0) return -1;
+    unsigned int h = tabla_hash(nombre);
+    for (unsigned int k = h & (unsigned int)(t->capacidad - 1); t->indice[k] != 0;
+         k = (k + 1) & (unsigned int)(t->capacidad - 1)) {
+        int id = t->indice[k] - 1;
+        if (COLUMNA(t->hash, unsigned int, id) == h && strcmp(tema_nombre(t, id), nombre) == 0) return id;
+    }
+    return -1;
+}
+
+/** temas_reindexar - Duplica el índice y reubica los ids existentes */
+static inline int temas_reindexar(TablaTemas *t) {
+    int capacidad = t->capacidad ? t->capacidad * 2 : 64;
+    int *indice = calloc((size_t)capacidad, sizeof(int));
+    if (indice == NULL) return -1;
+    for (int id = 0; id < t->cantidad; id++) {
+        unsigned int k = COLUMNA(t->hash, unsigned int, id) & (unsigned int)(capacidad - 1);
+        while (indice[k] != 0) k = (k + 1) & (unsigned int)(capacidad - 1);
+        indice[k] = id + 1;
+    }
+    free(t->indice);
+    t->indice = indice;
+    t->capacidad = capacidad;
+    return 0;
+}
+
+/**
+ * tema_internar - Id del tema; lo agrega si es nuevo
+ *
+ * Los ids no se reutilizan: un tema queda en la tabla aunque nadie lo use
+ * (los alias numéricos dependen de eso). Retorna -1 si el nombre no entra
+ * en TABLA_MAX_TEMA o no hay memoria.
+ */
+static inline int tema_internar(TablaTemas *t, const char *nombre) {
+    int id = tema_buscar(t, nombre);
+    if (id >= 0) return id;
+    if (strlen(nombre) >= TABLA_MAX_TEMA) return -1;
+    if (2 * (t->cantidad + 1) > t->capacidad && temas_reindexar(t) != 0) return -1;
+    if (columna_asegurar(&t->nombre, t->cantidad + 1) != 0 ||
+        columna_asegurar(&t->hash, t->cantidad + 1) != 0) return -1;
+
+    id = t->cantidad++;
+    unsigned int h = tabla_hash(nombre);
+    strcpy(columna_en(&t->nombre, id), nombre);
+    COLUMNA(t->hash, unsigned int, id) = h;
+    unsigned int k = h & (unsigned int)(t->capacidad - 1);
+    while (t->indice[k] != 0) k = (k + 1) & (unsigned int)(t->capacidad - 1);
+    t->indice[k] = id + 1;
+    return id;
+}
+
+#endif /* TABLAS_H */
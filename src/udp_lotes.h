@@ -0,0 +1,175 @@
+/*
+ * ============================================================================
+ * UDP LOTES - Envío GSO y recepción GRO de datagramas (Linux), con respaldo
+ * ============================================================================
+ *
+ * Con el fan-out y los lotes de publicaciones ya armados, lo que más cuesta
+ * en los brokers UDP y QUIC es el viaje por la pila de red de cada
+ * datagrama: un sendto() o recvfrom() por paquete. Linux permite pasar
+ * varios datagramas en una sola llamada:
+ *
+ *   - GSO (UDP_SEGMENT, kernel >= 4.18): un sendmsg() con N segmentos del
+ *     mismo tamaño (el último puede ser más corto) hacia UN destino. El
+ *     kernel (o la placa de red) lo corta en N datagramas normales: el
+ *     receptor no nota la diferencia.
+ *   - GRO (UDP_GRO, kernel >= 5.0): un recvmsg() puede devolver varios
+ *     datagramas del mismo origen pegados; un cmsg indica el tamaño de
+ *     segmento para volver a separarlos.
+ *
+ * udp_gso_probar() y udp_gro_activar() detectan el soporte en tiempo de
+ * ejecución. Si no hay soporte (otro sistema, kernel viejo, placa de red
+ * que rechaza el envío) todo sigue funcionando con un datagrama por
+ * llamada: udp_recibir() se comporta como recvfrom() y el broker envía de a
+ * uno.
+ *
+ * Todo es static inline (como plataforma.h): basta con incluir el header.
+ * ============================================================================
+ */
+
+#ifndef UDP_LOTES_H
+#define UDP_LOTES_H
+
+#include "plataforma.h"
+#include "planificador.h"
+
+#define UDP_MAX_SEGMENTOS  64        // Datagramas por envío GSO
+#define UDP_MAX_LOTE       65000     // Bytes por envío GSO o recepción GRO (< 65507)
+
+#ifdef __linux__
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+
+// Headers de glibc anteriores a 2.28 no traen las constantes
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+/** udp_gso_probar - 1 si el kernel acepta UDP_SEGMENT en este socket */
+static inline int udp_gso_probar(SOCKET s) {
+    int cero = 0;   // 0 = sin segmentación por defecto; cada envío indica la suya
+    return setsockopt(s, SOL_UDP, UDP_SEGMENT, &cero, sizeof(cero)) == 0;
+}
+
+/** udp_gro_activar - Pide recepción GRO; 1 si el kernel la soporta */
+static inline int udp_gro_activar(SOCKET s) {
+    int uno = 1;
+    return setsockopt(s, SOL_UDP, UDP_GRO, &uno, sizeof(uno)) == 0;
+}
+
+/**
+ * udp_gso_no_soportado - ¿El último envío GSO falló por falta de soporte?
+ *
+ * EIO aparece cuando la placa de red no calcula checksums por hardware.
+ * Cualquier otro error es del destino y se trata como en un sendto().
+ */
+static inline int udp_gso_no_soportado(void) {
+    return errno == EIO || errno == EINVAL || errno == EOPNOTSUPP ||
+           errno == ENOPROTOOPT || errno == EMSGSIZE;
+}
+
+/**
+ * udp_enviar_lote - Envía lote[0..n) con un solo sendmsg() GSO
+ *
+ * Todos van al destino de lote[0] y tienen su largo, salvo el último que
+ * puede ser más corto (ver plan_juntar). Retorna 0 si salió, -1 si falló
+ * (errno indica por qué).
+ */
+static inline int udp_enviar_lote(SOCKET s, PlanMensaje **lote, int n) {
+    struct iovec iov[UDP_MAX_SEGMENTOS];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr alineado;
+    } control;
+    struct msghdr msg;
+
+    if (n > UDP_MAX_SEGMENTOS) n = UDP_MAX_SEGMENTOS;
+    for (int i = 0; i < n; i++) {
+        iov[i].iov_base = lote[i]->datos;
+        iov[i].iov_len = (size_t)lote[i]->largo;
+    }
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    msg.msg_name = &lote[0]->destino;
+    msg.msg_namelen = sizeof(lote[0]->destino);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)n;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segmento = (uint16_t)lote[0]->largo;
+    memcpy(CMSG_DATA(cm), &segmento, sizeof(segmento));
+
+    return sendmsg(s, &msg, 0) < 0 ? -1 : 0;
+}
+
+/**
+ * udp_recibir - recvfrom() que además informa el tamaño de segmento GRO
+ *
+ * Con GRO activo buf puede traer varios datagramas del mismo origen uno
+ * detrás de otro, cada uno de *segmento bytes (el último puede ser más
+ * corto). Sin GRO *segmento = bytes recibidos. Retorna lo mismo que
+ * recvfrom().
+ */
+static inline int udp_recibir(SOCKET s, char *buf, int tam, struct sockaddr_in *origen,
+                              int *segmento) {
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr alineado;
+    } control;
+    struct msghdr msg;
+
+    iov.iov_base = buf;
+    iov.iov_len = (size_t)tam;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = origen;
+    msg.msg_namelen = sizeof(*origen);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int bytes = (int)recvmsg(s, &msg, 0);
+    *segmento = bytes;
+    if (bytes <= 0) return bytes;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            int gso;
+            memcpy(&gso, CMSG_DATA(cm), sizeof(gso));
+            if (gso > 0) *segmento = gso;
+        }
+    }
+    return bytes;
+}
+
+#else
+
+// Sin GSO/GRO: nunca se activan y se recibe con recvfrom() de siempre
+#define udp_gso_probar(s)         0
+#define udp_gro_activar(s)        0
+#define udp_gso_no_soportado()    1
+#define udp_enviar_lote(s, l, n)  (-1)
+
+static inline int udp_recibir(SOCKET s, char *buf, int tam, struct sockaddr_in *origen,
+                              int *segmento) {
+    socklen_t largo = sizeof(*origen);
+    int bytes = recvfrom(s, buf, tam, 0, (struct sockaddr*)origen, &largo);
+    *segmento = bytes;
+    return bytes;
+}
+
+#endif
+
+#endif /* UDP_LOTES_H */